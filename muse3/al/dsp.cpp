@@ -30,6 +30,9 @@ namespace AL {
 
 Dsp* dsp = 0;
 
+// In dspSIMD.cpp
+extern Dsp* createSIMDDsp();
+
 #ifdef __i386__
 
 //---------------------------------------------------------
@@ -65,7 +68,8 @@ class DspSSE86 : public Dsp {
                   x86_sse_apply_gain_to_buffer(buf, n, gain);
             }
 
-      virtual void mixWithGain(float* dst, float* src, unsigned n, float gain) {
+      // Note: The asm routine takes the gain as float.
+      virtual void mixWithGain(float* dst, float* src, unsigned n, double gain) {
             if ( ((intptr_t)dst & 15) != 0)
                   fprintf(stderr, "mixWithGainain(): dst unaligned! (%p)\n", dst);
             if (((intptr_t)dst & 15) != ((intptr_t)src & 15) ) {
@@ -137,6 +141,14 @@ void initDsp()
             }
       // fall through to not hardware optimized routines
 #endif
+      // Pick the widest instruction set the cpu supports.
+      dsp = createSIMDDsp();
+      if (dsp) {
+            if(debugMsg)
+              printf("Muse: using %s optimized dsp routines\n", dsp->name());
+            return;
+            }
+
       if(debugMsg)
         printf("Muse: using unoptimized non-SSE dsp routines\n");
       dsp = new Dsp();
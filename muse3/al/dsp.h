@@ -61,7 +61,8 @@ class Dsp {
             for (unsigned i = 0; i < n; ++i)
                   buf[i] *= gain;
             }
-      virtual void mixWithGain(float* dst, float* src, unsigned n, float gain) {
+      // dst += src * gain, done in double like the gain routines below.
+      virtual void mixWithGain(float* dst, float* src, unsigned n, double gain) {
             for (unsigned i = 0; i < n; ++i)
                   dst[i] += src[i] * gain;
             }
@@ -70,6 +71,67 @@ class Dsp {
                   dst[i] += src[i];
             }
       virtual void cpy(float* dst, float* src, unsigned n, bool addDenormal = false);
+
+      //---------------------------------------------------
+      //   gain routines
+      //    The gains are doubles, like the track volumes
+      //    and pans they come from, and the products are
+      //    done in double. So all versions give exactly
+      //    the same result as these.
+      //---------------------------------------------------
+
+      // dst = src * gain
+      virtual void cpyWithGain(float* dst, float* src, unsigned n, double gain) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] = src[i] * gain;
+            }
+      // Stereo volume and pan in one pass: dstL = srcL * gainL, dstR = srcR * gainR.
+      // For a mono source srcL and srcR may be the same buffer.
+      virtual void panGain(float* dstL, float* dstR, float* srcL, float* srcR, unsigned n, double gainL, double gainR) {
+            for (unsigned i = 0; i < n; ++i) {
+                  dstL[i] = srcL[i] * gainL;
+                  dstR[i] = srcR[i] * gainR;
+                  }
+            }
+
+      //---------------------------------------------------
+      //   ramp routines
+      //    For automation lanes rendered a cycle at a time.
+      //    The values are done in double. expRamp() keeps 8
+      //    products going, each stepping by factor^8, so all
+      //    versions give exactly the same result as these.
+      //---------------------------------------------------
+
+      // dst[i] = start + i * step
+      virtual void linearRamp(float* dst, unsigned n, double start, double step) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] = start + double(i) * step;
+            }
+      // dst[i] = start * factor^i
+      virtual void expRamp(float* dst, unsigned n, double start, double factor) {
+            double v[8];
+            const double f8 = expRampStart(v, start, factor);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  for (int k = 0; k < 8; ++k) {
+                        dst[i + k] = v[k];
+                        v[k] *= f8;
+                        }
+            for (int k = 0; i < n; ++i, ++k)
+                  dst[i] = v[k];
+            }
+      // The first 8 values of expRamp(), returns factor^8.
+      static double expRampStart(double* v, double start, double factor) {
+            v[0] = start;
+            for (int k = 1; k < 8; ++k)
+                  v[k] = v[k - 1] * factor;
+            const double f2 = factor * factor;
+            const double f4 = f2 * f2;
+            return f4 * f4;
+            }
+
+      // Name of the instruction set used, for diagnostics.
+      virtual const char* name() const { return "generic"; }
 /*      
       {
 // Changed by T356. Not defined. Where are these???
@@ -0,0 +1,544 @@
+//=============================================================================
+//  AL
+//  Audio Utility Library
+//
+//  dspSIMD.cpp
+//  Copyright (C) 2018 by the MusE development team
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//=============================================================================
+
+//---------------------------------------------------------
+//   SSE, AVX2 and AVX-512 versions of the Dsp routines.
+//   Every routine is compiled for its instruction set with
+//    a target attribute, so the rest of the library does not
+//    need any special compiler flags. createSIMDDsp() picks
+//    the best set the cpu supports at run time.
+//   All loads and stores are unaligned: The buffers we get
+//    are not always posix_memalign'ed (jack port buffers,
+//    offsets into buffers etc.) and on current cpus the
+//    unaligned instructions cost nothing on aligned data.
+//   The gain and ramp routines work in double, as the
+//    scalar versions in dsp.h do, so every version gives
+//    exactly the same samples.
+//---------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "al.h"
+#include "dsp.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+#define AL_TARGET_SSE    __attribute__((target("sse2")))
+#define AL_TARGET_AVX2   __attribute__((target("avx2")))
+#define AL_TARGET_AVX512 __attribute__((target("avx512f")))
+
+namespace AL {
+
+//---------------------------------------------------------
+//   helpers
+//    src * gain, and dst + src * gain, in double,
+//    one vector of floats at a time
+//---------------------------------------------------------
+
+AL_TARGET_SSE static inline __m128 mulGainSSE(const float* src, __m128d g)
+      {
+      const __m128 s = _mm_loadu_ps(src);
+      const __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(s), g));
+      const __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(s, s)), g));
+      return _mm_movelh_ps(lo, hi);
+      }
+
+AL_TARGET_SSE static inline __m128 mixGainSSE(const float* dst, const float* src, __m128d g)
+      {
+      const __m128 s = _mm_loadu_ps(src);
+      const __m128 d = _mm_loadu_ps(dst);
+      const __m128 lo = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(d), _mm_mul_pd(_mm_cvtps_pd(s), g)));
+      const __m128 hi = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(d, d)),
+                                                _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(s, s)), g)));
+      return _mm_movelh_ps(lo, hi);
+      }
+
+AL_TARGET_AVX2 static inline __m256 mulGainAVX2(const float* src, __m256d g)
+      {
+      const __m256 s = _mm256_loadu_ps(src);
+      const __m128 lo = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(s)), g));
+      const __m128 hi = _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)), g));
+      return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+      }
+
+AL_TARGET_AVX2 static inline __m256 mixGainAVX2(const float* dst, const float* src, __m256d g)
+      {
+      const __m256 s = _mm256_loadu_ps(src);
+      const __m256 d = _mm256_loadu_ps(dst);
+      const __m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(d)),
+                                        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(s)), g)));
+      const __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)),
+                                        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)), g)));
+      return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+      }
+
+// These do 8 samples, the 16 wide loops call them twice.
+AL_TARGET_AVX512 static inline __m256 mulGainAVX512(const float* src, __m512d g)
+      {
+      return _mm512_cvtpd_ps(_mm512_mul_pd(_mm512_cvtps_pd(_mm256_loadu_ps(src)), g));
+      }
+
+AL_TARGET_AVX512 static inline __m256 mixGainAVX512(const float* dst, const float* src, __m512d g)
+      {
+      return _mm512_cvtpd_ps(_mm512_add_pd(_mm512_cvtps_pd(_mm256_loadu_ps(dst)),
+                                           _mm512_mul_pd(_mm512_cvtps_pd(_mm256_loadu_ps(src)), g)));
+      }
+
+//---------------------------------------------------------
+//   DspSSE
+//---------------------------------------------------------
+
+class DspSSE : public Dsp {
+   public:
+      DspSSE() {}
+      virtual ~DspSSE() {}
+      virtual const char* name() const { return "SSE"; }
+
+      AL_TARGET_SSE virtual float peak(float* buf, unsigned n, float current) {
+            const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            __m128 m = _mm_set1_ps(current);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  m = _mm_max_ps(m, _mm_and_ps(_mm_loadu_ps(buf + i), mask));
+            float r[4];
+            _mm_storeu_ps(r, m);
+            current = f_max(f_max(r[0], r[1]), f_max(r[2], r[3]));
+            for ( ; i < n; ++i)
+                  current = f_max(current, fabsf(buf[i]));
+            return current;
+            }
+
+      AL_TARGET_SSE virtual void applyGainToBuffer(float* buf, unsigned n, float gain) {
+            const __m128 g = _mm_set1_ps(gain);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+            for ( ; i < n; ++i)
+                  buf[i] *= gain;
+            }
+
+      AL_TARGET_SSE virtual void mixWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m128d g = _mm_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  _mm_storeu_ps(dst + i, mixGainSSE(dst + i, src + i, g));
+            for ( ; i < n; ++i)
+                  dst[i] += src[i] * gain;
+            }
+
+      AL_TARGET_SSE virtual void mix(float* dst, float* src, unsigned n) {
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+            for ( ; i < n; ++i)
+                  dst[i] += src[i];
+            }
+
+      AL_TARGET_SSE virtual void cpy(float* dst, float* src, unsigned n, bool addDenormal = false) {
+            if (!addDenormal) {
+                  memcpy(dst, src, sizeof(float) * n);
+                  return;
+                  }
+            const __m128 d = _mm_set1_ps(denormalBias);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(src + i), d));
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] + denormalBias;
+            }
+
+      AL_TARGET_SSE virtual void cpyWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m128d g = _mm_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4)
+                  _mm_storeu_ps(dst + i, mulGainSSE(src + i, g));
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] * gain;
+            }
+
+      AL_TARGET_SSE virtual void panGain(float* dstL, float* dstR, float* srcL, float* srcR, unsigned n, double gainL, double gainR) {
+            const __m128d gl = _mm_set1_pd(gainL);
+            const __m128d gr = _mm_set1_pd(gainR);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4) {
+                  // Both loads first, srcL and srcR may be dstR and dstL.
+                  const __m128 l = mulGainSSE(srcL + i, gl);
+                  const __m128 r = mulGainSSE(srcR + i, gr);
+                  _mm_storeu_ps(dstL + i, l);
+                  _mm_storeu_ps(dstR + i, r);
+                  }
+            for ( ; i < n; ++i) {
+                  const float l = srcL[i] * gainL;
+                  const float r = srcR[i] * gainR;
+                  dstL[i] = l;
+                  dstR[i] = r;
+                  }
+            }
+
+      AL_TARGET_SSE virtual void linearRamp(float* dst, unsigned n, double start, double step) {
+            const __m128d s  = _mm_set1_pd(start);
+            const __m128d st = _mm_set1_pd(step);
+            const __m128d two = _mm_set1_pd(2.0);
+            unsigned i = 0;
+            for ( ; i + 4 <= n; i += 4) {
+                  const __m128d i0 = _mm_set_pd(double(i + 1), double(i));
+                  const __m128d i1 = _mm_add_pd(i0, two);
+                  const __m128 lo = _mm_cvtpd_ps(_mm_add_pd(s, _mm_mul_pd(i0, st)));
+                  const __m128 hi = _mm_cvtpd_ps(_mm_add_pd(s, _mm_mul_pd(i1, st)));
+                  _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+                  }
+            for ( ; i < n; ++i)
+                  dst[i] = start + double(i) * step;
+            }
+
+      AL_TARGET_SSE virtual void expRamp(float* dst, unsigned n, double start, double factor) {
+            double v[8];
+            const __m128d f8 = _mm_set1_pd(expRampStart(v, start, factor));
+            __m128d v0 = _mm_loadu_pd(v), v1 = _mm_loadu_pd(v + 2), v2 = _mm_loadu_pd(v + 4), v3 = _mm_loadu_pd(v + 6);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  _mm_storeu_ps(dst + i,     _mm_movelh_ps(_mm_cvtpd_ps(v0), _mm_cvtpd_ps(v1)));
+                  _mm_storeu_ps(dst + i + 4, _mm_movelh_ps(_mm_cvtpd_ps(v2), _mm_cvtpd_ps(v3)));
+                  v0 = _mm_mul_pd(v0, f8);
+                  v1 = _mm_mul_pd(v1, f8);
+                  v2 = _mm_mul_pd(v2, f8);
+                  v3 = _mm_mul_pd(v3, f8);
+                  }
+            _mm_storeu_pd(v, v0);
+            _mm_storeu_pd(v + 2, v1);
+            _mm_storeu_pd(v + 4, v2);
+            _mm_storeu_pd(v + 6, v3);
+            for (int k = 0; i < n; ++i, ++k)
+                  dst[i] = v[k];
+            }
+      };
+//---------------------------------------------------------
+//   DspAVX2
+//---------------------------------------------------------
+
+class DspAVX2 : public Dsp {
+   public:
+      DspAVX2() {}
+      virtual ~DspAVX2() {}
+      virtual const char* name() const { return "AVX2"; }
+
+      AL_TARGET_AVX2 virtual float peak(float* buf, unsigned n, float current) {
+            const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            __m256 m = _mm256_set1_ps(current);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(buf + i), mask));
+            float r[8];
+            _mm256_storeu_ps(r, m);
+            for (int k = 0; k < 8; ++k)
+                  current = f_max(current, r[k]);
+            for ( ; i < n; ++i)
+                  current = f_max(current, fabsf(buf[i]));
+            return current;
+            }
+
+      AL_TARGET_AVX2 virtual void applyGainToBuffer(float* buf, unsigned n, float gain) {
+            const __m256 g = _mm256_set1_ps(gain);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+            for ( ; i < n; ++i)
+                  buf[i] *= gain;
+            }
+
+      AL_TARGET_AVX2 virtual void mixWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m256d g = _mm256_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  _mm256_storeu_ps(dst + i, mixGainAVX2(dst + i, src + i, g));
+            for ( ; i < n; ++i)
+                  dst[i] += src[i] * gain;
+            }
+
+      AL_TARGET_AVX2 virtual void mix(float* dst, float* src, unsigned n) {
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+            for ( ; i < n; ++i)
+                  dst[i] += src[i];
+            }
+
+      AL_TARGET_AVX2 virtual void cpy(float* dst, float* src, unsigned n, bool addDenormal = false) {
+            if (!addDenormal) {
+                  memcpy(dst, src, sizeof(float) * n);
+                  return;
+                  }
+            const __m256 d = _mm256_set1_ps(denormalBias);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(src + i), d));
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] + denormalBias;
+            }
+
+      AL_TARGET_AVX2 virtual void cpyWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m256d g = _mm256_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8)
+                  _mm256_storeu_ps(dst + i, mulGainAVX2(src + i, g));
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] * gain;
+            }
+
+      AL_TARGET_AVX2 virtual void panGain(float* dstL, float* dstR, float* srcL, float* srcR, unsigned n, double gainL, double gainR) {
+            const __m256d gl = _mm256_set1_pd(gainL);
+            const __m256d gr = _mm256_set1_pd(gainR);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  const __m256 l = mulGainAVX2(srcL + i, gl);
+                  const __m256 r = mulGainAVX2(srcR + i, gr);
+                  _mm256_storeu_ps(dstL + i, l);
+                  _mm256_storeu_ps(dstR + i, r);
+                  }
+            for ( ; i < n; ++i) {
+                  const float l = srcL[i] * gainL;
+                  const float r = srcR[i] * gainR;
+                  dstL[i] = l;
+                  dstR[i] = r;
+                  }
+            }
+
+      AL_TARGET_AVX2 virtual void linearRamp(float* dst, unsigned n, double start, double step) {
+            const __m256d s  = _mm256_set1_pd(start);
+            const __m256d st = _mm256_set1_pd(step);
+            const __m256d four = _mm256_set1_pd(4.0);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  const __m256d i0 = _mm256_set_pd(double(i + 3), double(i + 2), double(i + 1), double(i));
+                  const __m256d i1 = _mm256_add_pd(i0, four);
+                  const __m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(s, _mm256_mul_pd(i0, st)));
+                  const __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(s, _mm256_mul_pd(i1, st)));
+                  _mm256_storeu_ps(dst + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+                  }
+            for ( ; i < n; ++i)
+                  dst[i] = start + double(i) * step;
+            }
+
+      AL_TARGET_AVX2 virtual void expRamp(float* dst, unsigned n, double start, double factor) {
+            double v[8];
+            const __m256d f8 = _mm256_set1_pd(expRampStart(v, start, factor));
+            __m256d v0 = _mm256_loadu_pd(v), v1 = _mm256_loadu_pd(v + 4);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  const __m128 lo = _mm256_cvtpd_ps(v0);
+                  const __m128 hi = _mm256_cvtpd_ps(v1);
+                  _mm256_storeu_ps(dst + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+                  v0 = _mm256_mul_pd(v0, f8);
+                  v1 = _mm256_mul_pd(v1, f8);
+                  }
+            _mm256_storeu_pd(v, v0);
+            _mm256_storeu_pd(v + 4, v1);
+            for (int k = 0; i < n; ++i, ++k)
+                  dst[i] = v[k];
+            }
+      };
+//---------------------------------------------------------
+//   DspAVX512
+//---------------------------------------------------------
+
+class DspAVX512 : public Dsp {
+   public:
+      DspAVX512() {}
+      virtual ~DspAVX512() {}
+      virtual const char* name() const { return "AVX-512"; }
+
+      AL_TARGET_AVX512 virtual float peak(float* buf, unsigned n, float current) {
+            __m512 m = _mm512_set1_ps(current);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16)
+                  m = _mm512_mask_max_ps(m, 0xffff, m, _mm512_abs_ps(_mm512_loadu_ps(buf + i)));
+            float r[16];
+            _mm512_storeu_ps(r, m);
+            for (int k = 0; k < 16; ++k)
+                  current = f_max(current, r[k]);
+            for ( ; i < n; ++i)
+                  current = f_max(current, fabsf(buf[i]));
+            return current;
+            }
+
+      AL_TARGET_AVX512 virtual void applyGainToBuffer(float* buf, unsigned n, float gain) {
+            const __m512 g = _mm512_set1_ps(gain);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16)
+                  _mm512_storeu_ps(buf + i, _mm512_mul_ps(_mm512_loadu_ps(buf + i), g));
+            for ( ; i < n; ++i)
+                  buf[i] *= gain;
+            }
+
+      AL_TARGET_AVX512 virtual void mixWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m512d g = _mm512_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16) {
+                  const __m256 a = mixGainAVX512(dst + i, src + i, g);
+                  const __m256 b = mixGainAVX512(dst + i + 8, src + i + 8, g);
+                  _mm256_storeu_ps(dst + i, a);
+                  _mm256_storeu_ps(dst + i + 8, b);
+                  }
+            for ( ; i < n; ++i)
+                  dst[i] += src[i] * gain;
+            }
+
+      AL_TARGET_AVX512 virtual void mix(float* dst, float* src, unsigned n) {
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16)
+                  _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(dst + i), _mm512_loadu_ps(src + i)));
+            for ( ; i < n; ++i)
+                  dst[i] += src[i];
+            }
+
+      AL_TARGET_AVX512 virtual void cpy(float* dst, float* src, unsigned n, bool addDenormal = false) {
+            if (!addDenormal) {
+                  memcpy(dst, src, sizeof(float) * n);
+                  return;
+                  }
+            const __m512 d = _mm512_set1_ps(denormalBias);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16)
+                  _mm512_storeu_ps(dst + i, _mm512_add_ps(_mm512_loadu_ps(src + i), d));
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] + denormalBias;
+            }
+
+      AL_TARGET_AVX512 virtual void cpyWithGain(float* dst, float* src, unsigned n, double gain) {
+            const __m512d g = _mm512_set1_pd(gain);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16) {
+                  const __m256 a = mulGainAVX512(src + i, g);
+                  const __m256 b = mulGainAVX512(src + i + 8, g);
+                  _mm256_storeu_ps(dst + i, a);
+                  _mm256_storeu_ps(dst + i + 8, b);
+                  }
+            for ( ; i < n; ++i)
+                  dst[i] = src[i] * gain;
+            }
+
+      AL_TARGET_AVX512 virtual void panGain(float* dstL, float* dstR, float* srcL, float* srcR, unsigned n, double gainL, double gainR) {
+            const __m512d gl = _mm512_set1_pd(gainL);
+            const __m512d gr = _mm512_set1_pd(gainR);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  const __m256 l = mulGainAVX512(srcL + i, gl);
+                  const __m256 r = mulGainAVX512(srcR + i, gr);
+                  _mm256_storeu_ps(dstL + i, l);
+                  _mm256_storeu_ps(dstR + i, r);
+                  }
+            for ( ; i < n; ++i) {
+                  const float l = srcL[i] * gainL;
+                  const float r = srcR[i] * gainR;
+                  dstL[i] = l;
+                  dstR[i] = r;
+                  }
+            }
+
+      AL_TARGET_AVX512 virtual void linearRamp(float* dst, unsigned n, double start, double step) {
+            const __m512d s  = _mm512_set1_pd(start);
+            const __m512d st = _mm512_set1_pd(step);
+            const __m512d eight = _mm512_set1_pd(8.0);
+            unsigned i = 0;
+            for ( ; i + 16 <= n; i += 16) {
+                  const __m512d i0 = _mm512_set_pd(double(i + 7), double(i + 6), double(i + 5), double(i + 4),
+                                                   double(i + 3), double(i + 2), double(i + 1), double(i));
+                  const __m512d i1 = _mm512_add_pd(i0, eight);
+                  _mm256_storeu_ps(dst + i,     _mm512_cvtpd_ps(_mm512_add_pd(s, _mm512_mul_pd(i0, st))));
+                  _mm256_storeu_ps(dst + i + 8, _mm512_cvtpd_ps(_mm512_add_pd(s, _mm512_mul_pd(i1, st))));
+                  }
+            for ( ; i < n; ++i)
+                  dst[i] = start + double(i) * step;
+            }
+
+      AL_TARGET_AVX512 virtual void expRamp(float* dst, unsigned n, double start, double factor) {
+            double v[8];
+            const __m512d f8 = _mm512_set1_pd(expRampStart(v, start, factor));
+            __m512d v0 = _mm512_loadu_pd(v);
+            unsigned i = 0;
+            for ( ; i + 8 <= n; i += 8) {
+                  _mm256_storeu_ps(dst + i, _mm512_cvtpd_ps(v0));
+                  v0 = _mm512_mul_pd(v0, f8);
+                  }
+            _mm512_storeu_pd(v, v0);
+            for (int k = 0; i < n; ++i, ++k)
+                  dst[i] = v[k];
+            }
+      };
+//---------------------------------------------------------
+//   createSIMDDsp
+//    return the best routines for this cpu, or 0 if none
+//---------------------------------------------------------
+
+Dsp* createSIMDDsp()
+      {
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f"))
+            return new DspAVX512();
+      if (__builtin_cpu_supports("avx2"))
+            return new DspAVX2();
+      if (__builtin_cpu_supports("sse2"))
+            return new DspSSE();
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   createSIMDDsp
+//    return the routines for one instruction set
+//    ("avx512f", "avx2" or "sse2"), or 0 if this cpu does
+//    not have it. Used by the tests to check every version
+//    against the scalar one, not only the best.
+//---------------------------------------------------------
+
+Dsp* createSIMDDsp(const char* isa)
+      {
+      __builtin_cpu_init();
+      if (strcmp(isa, "avx512f") == 0 && __builtin_cpu_supports("avx512f"))
+            return new DspAVX512();
+      if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+            return new DspAVX2();
+      if (strcmp(isa, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+            return new DspSSE();
+      return 0;
+      }
+
+} // namespace AL
+
+#else
+
+namespace AL {
+
+Dsp* createSIMDDsp()
+      {
+      return 0;
+      }
+
+Dsp* createSIMDDsp(const char*)
+      {
+      return 0;
+      }
+
+} // namespace AL
+
+#endif
@@ -303,30 +303,36 @@ size_t SysExOutputProcessor::stageEvData(const EvData& evData, unsigned int fram
 //    variable len event data (sysex, meta etc.)
 //---------------------------------------------------------
 
+void EvData::alloc(int l)
+{
+      char* block = static_cast<char*>(rtArena().alloc(HEADER_SIZE + l));
+      if(!block)
+      {
+        // Refused in the audio thread. The event goes out empty.
+        dataLen = 0;
+        return;
+      }
+      refCount = reinterpret_cast<int*>(block);
+      refCount[0] = 1;
+      refCount[1] = l;
+      data = reinterpret_cast<unsigned char*>(block + HEADER_SIZE);
+      dataLen = l;
+}
+
 void EvData::setData(const unsigned char* p, int l) 
 {
       // Setting the data destroys any reference. Dereference now.
       // The data may still be shared. Destroy it only if no more references.
-      if (refCount && (--(*refCount) == 0)) 
-      {
-        delete refCount;
-        refCount = 0;
-        
-        if(data)
-          delete[] data;
-      }
-      // Clear the data variable.
-      data = 0;  
+      release();
+      dataLen = 0;
         
       if(l > 0) 
       {
-        data = new unsigned char[l];
-        memcpy(data, p, l);
-        
         // Setting the data destroys any reference. Create a new reference now.
-        refCount = new int(1);
+        alloc(l);
+        if(data)
+          memcpy(data, p, l);
       }
-      dataLen = l;
 }
             
 void EvData::setData(const SysExInputProcessor* q) 
@@ -336,28 +342,19 @@ void EvData::setData(const SysExInputProcessor* q)
         return;
       // Setting the data destroys any reference. Dereference now.
       // The data may still be shared. Destroy it only if no more references.
-      if (refCount && (--(*refCount) == 0)) 
-      {
-        delete refCount;
-        refCount = 0;
-        
-        if(data)
-          delete[] data;
-      }
-      // Clear the data variable.
-      data = 0;  
+      release();
+      dataLen = 0;
         
       const size_t l = q->size();
       if(l > 0) 
       {
-        // Create a contiguous memory block to hold the data.
-        data = new unsigned char[l];
+        // Create a contiguous memory block to hold the data,
+        //  and a new reference.
+        alloc(l);
         // Copy the non-contiguous chunks of data to the contiguous data.
-        q->copy(data, l);
-        // Setting the data destroys any reference. Create a new reference now.
-        refCount = new int(1);
+        if(data)
+          q->copy(data, l);
       }
-      dataLen = l;
 }
 
 } // namespace MusECore
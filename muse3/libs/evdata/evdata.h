@@ -33,10 +33,26 @@ class SysExInputProcessor;
 //---------------------------------------------------------
 //   EvData
 //    variable len event data (sysex, meta etc.)
+//    The reference count and the data share one block
+//     from the realtime arena.
 //---------------------------------------------------------
 
 class EvData {
-      int* refCount;
+      // Room for the reference count and the allocated length in
+      //  front of the data. The block is freed with the length it
+      //  was allocated with, whatever dataLen has been set to.
+      enum { HEADER_SIZE = 16 };
+
+      int* refCount;       // refCount[1] is the allocated length.
+
+      void release() {
+            if (refCount && (--(*refCount) == 0))
+                  rtArena().free(refCount, HEADER_SIZE + refCount[1]);
+            refCount = 0;
+            data     = 0;
+            }
+      // Leaves data 0 if the arena refused.
+      void alloc(int l);
 
    public:
       unsigned char* data;
@@ -59,12 +75,7 @@ class EvData {
       EvData& operator=(const EvData& ed) {
             if (data == ed.data)
                   return *this;
-            if (refCount && (--(*refCount) == 0)) 
-            {
-              delete refCount;
-              if(data)
-                delete[] data;
-            }
+            release();
             
             data     = ed.data;
             dataLen  = ed.dataLen;
@@ -76,15 +87,7 @@ class EvData {
             }
 
       ~EvData() {
-            if (refCount && (--(*refCount) == 0)) {
-                  if(data)
-                  {  
-                    delete[] data;
-                    data = 0;
-                  }  
-                  delete refCount;
-                  refCount = 0;
-                }
+            release();
             }
       void setData(const unsigned char* p, int l);
       void setData(const SysExInputProcessor* q);
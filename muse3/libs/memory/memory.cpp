@@ -83,6 +83,446 @@ void Pool::grow(int idx)
 
 #endif
 
+//---------------------------------------------------------
+//   RTArena
+//---------------------------------------------------------
+
+thread_local int RTArena::_realtime = 0;
+thread_local void* RTArena::_node = 0;
+thread_local int RTArena::_nodeClass = -1;
+
+RTArena& rtArena()
+{
+  // Never destroyed: event lists in static objects may outlive it otherwise.
+  static RTArena* arena = new RTArena();
+  return *arena;
+}
+
+RTArena::RTArena(int slabs)
+{
+  for(int i = 0; i < CLASSES; ++i)
+  {
+    Class& c = _classes[i];
+    c.size = size_t(1) << (i + MIN_SHIFT);
+    c.slabItems = SLAB_BYTES / c.size;
+    for(int k = 0; k < MAX_SLABS; ++k)
+      c.slabs[k] = 0;
+    c.slabCount = 0;
+    c.head = 0;
+    c.inUse = 0;
+    c.highWater = 0;
+    c.failed = 0;
+  }
+  _heapInUse = 0;
+  _heapHighWater = 0;
+  _heapFailed = 0;
+  _deferred = 0;
+  _failSafe = true;
+  _reported = 0;
+  pthread_mutex_init(&_growLock, 0);
+
+  for(int i = 0; i < CLASSES; ++i)
+    for(int k = 0; k < slabs; ++k)
+      grow(i);
+}
+
+RTArena::~RTArena()
+{
+  void* p = _deferred.exchange(0);
+  while(p)
+  {
+    void* next = *static_cast<void**>(p);
+    ::free(p);
+    p = next;
+  }
+  for(int i = 0; i < CLASSES; ++i)
+  {
+    const unsigned n = _classes[i].slabCount.load();
+    for(unsigned k = 0; k < n; ++k)
+      ::free(_classes[i].slabs[k]);
+  }
+  pthread_mutex_destroy(&_growLock);
+}
+
+//---------------------------------------------------------
+//   classOf
+//    Returns -1 if n is too big for any class.
+//---------------------------------------------------------
+
+int RTArena::classOf(size_t n)
+{
+  int cls = 0;
+  size_t sz = size_t(1) << MIN_SHIFT;
+  while(sz < n)
+  {
+    sz <<= 1;
+    if(++cls == CLASSES)
+      return -1;
+  }
+  return cls;
+}
+
+//---------------------------------------------------------
+//   slot
+//    The first word of a free block links to the next one.
+//---------------------------------------------------------
+
+char* RTArena::slot(const Class& c, unsigned idx) const
+{
+  return c.slabs[idx / c.slabItems] + size_t(idx % c.slabItems) * c.size;
+}
+
+//---------------------------------------------------------
+//   reserveOf
+//    Only classes small enough for list nodes keep a reserve.
+//---------------------------------------------------------
+
+unsigned RTArena::reserveOf(const Class& c)
+{
+  return c.slabItems >= 4 * (unsigned)NODE_RESERVE ? (unsigned)NODE_RESERVE : 0;
+}
+
+static inline std::atomic<uint32_t>* nextOf(char* p)
+{
+  return reinterpret_cast<std::atomic<uint32_t>*>(p);
+}
+
+//---------------------------------------------------------
+//   indexOf
+//    Returns -1 if p is not in a slab of the class.
+//---------------------------------------------------------
+
+long RTArena::indexOf(const Class& c, const void* p) const
+{
+  const char* cp = static_cast<const char*>(p);
+  const unsigned n = c.slabCount.load(std::memory_order_acquire);
+  for(unsigned k = 0; k < n; ++k)
+  {
+    if(cp >= c.slabs[k] && cp < c.slabs[k] + SLAB_BYTES)
+      return long(k) * c.slabItems + long((cp - c.slabs[k]) / c.size);
+  }
+  return -1;
+}
+
+//---------------------------------------------------------
+//   pop
+//    The tag in the upper half of head keeps a block taken
+//     and given back meanwhile from passing the compare.
+//---------------------------------------------------------
+
+void* RTArena::pop(Class& c)
+{
+  uint64_t h = c.head.load(std::memory_order_acquire);
+  for(;;)
+  {
+    const uint32_t idx = uint32_t(h);
+    if(idx == 0)
+      return 0;
+    char* p = slot(c, idx - 1);
+    const uint64_t nh = (((h >> 32) + 1) << 32) | nextOf(p)->load(std::memory_order_relaxed);
+    if(c.head.compare_exchange_weak(h, nh, std::memory_order_acq_rel, std::memory_order_acquire))
+      return p;
+  }
+}
+
+//---------------------------------------------------------
+//   push
+//    Puts back the chain of blocks first .. last, which
+//     must already be linked except for last.
+//---------------------------------------------------------
+
+void RTArena::push(Class& c, unsigned first, unsigned last)
+{
+  char* lp = slot(c, last);
+  uint64_t h = c.head.load(std::memory_order_relaxed);
+  for(;;)
+  {
+    nextOf(lp)->store(uint32_t(h), std::memory_order_relaxed);
+    const uint64_t nh = (((h >> 32) + 1) << 32) | (first + 1);
+    if(c.head.compare_exchange_weak(h, nh, std::memory_order_release, std::memory_order_relaxed))
+      return;
+  }
+}
+
+//---------------------------------------------------------
+//   grow
+//    Adds a slab to a class. Not for realtime threads.
+//---------------------------------------------------------
+
+bool RTArena::grow(int cls)
+{
+  Class& c = _classes[cls];
+  pthread_mutex_lock(&_growLock);
+  const unsigned n = c.slabCount.load(std::memory_order_relaxed);
+  char* m = n < MAX_SLABS ? static_cast<char*>(malloc(SLAB_BYTES)) : 0;
+  if(!m)
+  {
+    pthread_mutex_unlock(&_growLock);
+    return false;
+  }
+  c.slabs[n] = m;
+  const unsigned base = n * c.slabItems;
+  for(unsigned i = 0; i < c.slabItems - 1; ++i)
+    nextOf(m + size_t(i) * c.size)->store(base + i + 2, std::memory_order_relaxed);
+  c.slabCount.store(n + 1, std::memory_order_release);
+  push(c, base, base + c.slabItems - 1);
+  pthread_mutex_unlock(&_growLock);
+  return true;
+}
+
+//---------------------------------------------------------
+//   count
+//---------------------------------------------------------
+
+void RTArena::count(std::atomic<unsigned>& inUse, std::atomic<unsigned>& highWater)
+{
+  const unsigned u = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+  unsigned hw = highWater.load(std::memory_order_relaxed);
+  while(u > hw && !highWater.compare_exchange_weak(hw, u, std::memory_order_relaxed))
+    ;
+}
+
+//---------------------------------------------------------
+//   heapAlloc
+//---------------------------------------------------------
+
+void* RTArena::heapAlloc(size_t n)
+{
+  // Room for the link in case it is freed in a realtime section.
+  void* p = malloc(n < sizeof(void*) ? sizeof(void*) : n);
+  if(p)
+    count(_heapInUse, _heapHighWater);
+  return p;
+}
+
+//---------------------------------------------------------
+//   alloc
+//---------------------------------------------------------
+
+void* RTArena::alloc(size_t n)
+{
+  if(n == 0)
+    return 0;
+  const bool refuse = inRealtime() && failSafe();
+  const int cls = classOf(n);
+  if(cls < 0)
+  {
+    if(refuse)
+    {
+      _heapFailed.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    return heapAlloc(n);
+  }
+
+  Class& c = _classes[cls];
+  if(refuse)
+  {
+    const unsigned cap = c.slabCount.load(std::memory_order_relaxed) * c.slabItems;
+    if(cap - c.inUse.load(std::memory_order_relaxed) <= reserveOf(c))
+    {
+      c.failed.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+  }
+  void* p = pop(c);
+  if(!p && !inRealtime() && grow(cls))
+    p = pop(c);
+  if(!p)
+  {
+    if(refuse)
+    {
+      c.failed.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    return heapAlloc(n);
+  }
+  count(c.inUse, c.highWater);
+  return p;
+}
+
+//---------------------------------------------------------
+//   allocNode
+//---------------------------------------------------------
+
+void* RTArena::allocNode(size_t n)
+{
+  const int cls = classOf(n);
+  if(cls < 0 || !inRealtime())
+    return alloc(n);
+  Class& c = _classes[cls];
+  if(_node && _nodeClass == cls)
+  {
+    void* p = _node;
+    _node = 0;
+    return p;
+  }
+  void* p = pop(c);
+  if(p)
+  {
+    count(c.inUse, c.highWater);
+    return p;
+  }
+  // A container cannot be told no.
+  c.failed.fetch_add(1, std::memory_order_relaxed);
+  return heapAlloc(n);
+}
+
+//---------------------------------------------------------
+//   reserveNode
+//---------------------------------------------------------
+
+bool RTArena::reserveNode(size_t n)
+{
+  if(!inRealtime() || !failSafe())
+    return true;
+  const int cls = classOf(n);
+  if(cls < 0)
+  {
+    _heapFailed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if(_node)
+  {
+    if(_nodeClass == cls)
+      return true;
+    releaseNode();
+  }
+  Class& c = _classes[cls];
+  void* p = pop(c);
+  if(!p)
+  {
+    c.failed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  count(c.inUse, c.highWater);
+  _node = p;
+  _nodeClass = cls;
+  return true;
+}
+
+//---------------------------------------------------------
+//   releaseNode
+//    Gives back a block reserveNode() took but no insert used.
+//---------------------------------------------------------
+
+void RTArena::releaseNode()
+{
+  Class& c = _classes[_nodeClass];
+  c.inUse.fetch_sub(1, std::memory_order_relaxed);
+  const long idx = indexOf(c, _node);
+  push(c, idx, idx);
+  _node = 0;
+}
+
+//---------------------------------------------------------
+//   free
+//---------------------------------------------------------
+
+void RTArena::free(void* p, size_t n)
+{
+  if(!p)
+    return;
+  const int cls = classOf(n);
+  if(cls >= 0)
+  {
+    Class& c = _classes[cls];
+    const long idx = indexOf(c, p);
+    if(idx >= 0)
+    {
+      c.inUse.fetch_sub(1, std::memory_order_relaxed);
+      push(c, idx, idx);
+      return;
+    }
+  }
+  _heapInUse.fetch_sub(1, std::memory_order_relaxed);
+  if(!inRealtime())
+  {
+    ::free(p);
+    return;
+  }
+  void* h = _deferred.load(std::memory_order_relaxed);
+  do
+    *static_cast<void**>(p) = h;
+  while(!_deferred.compare_exchange_weak(h, p, std::memory_order_release, std::memory_order_relaxed));
+}
+
+//---------------------------------------------------------
+//   maintain
+//---------------------------------------------------------
+
+void RTArena::maintain()
+{
+  void* p = _deferred.exchange(0, std::memory_order_acquire);
+  while(p)
+  {
+    void* next = *static_cast<void**>(p);
+    ::free(p);
+    p = next;
+  }
+
+  unsigned failed = _heapFailed.load(std::memory_order_relaxed);
+  for(int i = 0; i < CLASSES; ++i)
+  {
+    Class& c = _classes[i];
+    // Keep a quarter free, and at least twice the node reserve.
+    const unsigned cap = c.slabCount.load(std::memory_order_relaxed) * c.slabItems;
+    const unsigned free = cap - c.inUse.load(std::memory_order_relaxed);
+    if(free < cap / 4 || free < 2 * reserveOf(c))
+      grow(i);
+    failed += c.failed.load(std::memory_order_relaxed);
+  }
+
+  if(failed != _reported)
+  {
+    fprintf(stderr, "RTArena: %u realtime allocations could not be served from the arena\n", failed - _reported);
+    dump(stderr);
+    _reported = failed;
+  }
+}
+
+//---------------------------------------------------------
+//   stats
+//---------------------------------------------------------
+
+void RTArena::stats(int cls, Stats* st) const
+{
+  if(cls < 0 || cls >= CLASSES)
+  {
+    st->size = 0;
+    st->capacity = 0;
+    st->inUse = _heapInUse.load();
+    st->highWater = _heapHighWater.load();
+    st->failed = _heapFailed.load();
+    return;
+  }
+  const Class& c = _classes[cls];
+  st->size = c.size;
+  st->capacity = c.slabCount.load() * c.slabItems;
+  st->inUse = c.inUse.load();
+  st->highWater = c.highWater.load();
+  st->failed = c.failed.load();
+}
+
+//---------------------------------------------------------
+//   dump
+//---------------------------------------------------------
+
+void RTArena::dump(FILE* f) const
+{
+  fprintf(f, "RTArena: %s\n   size capacity    inUse highWater  failed\n", failSafe() ? "fail-safe" : "heap fallback");
+  for(int i = 0; i <= CLASSES; ++i)
+  {
+    Stats st;
+    stats(i, &st);
+    if(i == CLASSES)
+      fprintf(f, "   heap ");
+    else
+      fprintf(f, " %6zu ", st.size);
+    fprintf(f, "%8u %8u %9u %7u\n", st.capacity, st.inUse, st.highWater, st.failed);
+  }
+}
+
 //---------------------------------------------------------
 //   MemoryQueue
 //---------------------------------------------------------
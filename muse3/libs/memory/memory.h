@@ -26,6 +26,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <new>
 
 // NOTE: Keep this code in case we need a dimensioned pool!
 #if 0
@@ -193,6 +198,177 @@ template <typename T, int itemsPerChunk> class TypedMemoryPool
       }
 };
 
+//---------------------------------------------------------
+//   RTArena
+//    Preallocated allocator shared by the realtime midi
+//     paths: event list nodes, sysex payloads and their
+//     reference counts.
+//    Blocks come in power of two size classes, each with a
+//     lock-free free list, so any thread may allocate and
+//     any other free. Slabs are only added by maintain() or
+//     by allocations outside a realtime section.
+//    Inside a realtime section (see RTArenaScope) an empty
+//     class or an oversized request is not served from the
+//     heap in fail-safe mode: alloc() returns 0 and the
+//     failure is counted. Containers cannot take a refusal,
+//     so they must take their node with reserveNode() before
+//     inserting. Heap blocks freed in a realtime section are
+//     handed to maintain() to release.
+//---------------------------------------------------------
+
+class RTArena {
+   public:
+      enum { MIN_SHIFT = 4, CLASSES = 10 };         // 16 bytes to 8 KiB.
+      enum { SLAB_BYTES = 64 * 1024, MAX_SLABS = 256 };
+      // Free blocks of the classes up to 256 bytes which alloc() leaves
+      //  for event list nodes in a realtime section, so that sysex data
+      //  can't starve the lists.
+      enum { NODE_RESERVE = 64 };
+
+      struct Stats {
+            size_t size;          // Block size of the class, 0 for heap blocks.
+            unsigned capacity;    // Blocks in the slabs so far.
+            unsigned inUse;
+            unsigned highWater;   // Most blocks in use at once.
+            unsigned failed;      // Realtime requests refused.
+            };
+
+   private:
+      struct Class {
+            size_t size;
+            unsigned slabItems;
+            char* slabs[MAX_SLABS];
+            std::atomic<unsigned> slabCount;
+            std::atomic<uint64_t> head;       // Tag << 32 | (index + 1), 0 index = empty.
+            std::atomic<unsigned> inUse;
+            std::atomic<unsigned> highWater;
+            std::atomic<unsigned> failed;
+            };
+
+      Class _classes[CLASSES];
+      // Blocks too big for any class, or taken from the heap because
+      //  their class was empty.
+      std::atomic<unsigned> _heapInUse;
+      std::atomic<unsigned> _heapHighWater;
+      std::atomic<unsigned> _heapFailed;
+      std::atomic<void*> _deferred;         // Heap blocks freed in a realtime section.
+      std::atomic<bool> _failSafe;
+      unsigned _reported;                   // Failures already reported by maintain().
+      pthread_mutex_t _growLock;
+
+      static thread_local int _realtime;
+      // The block taken by reserveNode() for the next allocNode()
+      //  of the thread, and its class.
+      static thread_local void* _node;
+      static thread_local int _nodeClass;
+
+      RTArena(const RTArena&);
+      void operator=(const RTArena&);
+
+      static int classOf(size_t n);
+      static unsigned reserveOf(const Class& c);
+      char* slot(const Class& c, unsigned idx) const;
+      long indexOf(const Class& c, const void* p) const;
+      void* pop(Class& c);
+      void push(Class& c, unsigned first, unsigned last);
+      bool grow(int cls);
+      void* heapAlloc(size_t n);
+      static void count(std::atomic<unsigned>& inUse, std::atomic<unsigned>& highWater);
+      void releaseNode();
+
+      friend class RTArenaScope;
+
+   public:
+      // Preallocates slabs slabs for each class.
+      RTArena(int slabs = 2);
+      ~RTArena();
+
+      // Returns 0 if refused in a realtime section. There, the last
+      //  NODE_RESERVE blocks of a class are left for allocNode().
+      void* alloc(size_t n);
+      // For containers, which cannot take a refusal. In a realtime
+      //  section it hands out the block taken by reserveNode(). Only
+      //  an insert which skipped reserveNode() can reach the heap
+      //  here, which counts as a failure.
+      void* allocNode(size_t n);
+      // n must be the size given to alloc() or allocNode().
+      void free(void* p, size_t n);
+
+      // Takes a block for the list node of n bytes the calling thread
+      //  is about to insert. In fail-safe mode in a realtime section a
+      //  false answer means there is none left. It counts as a failure
+      //  and the caller drops the item. Otherwise always true.
+      bool reserveNode(size_t n);
+
+      bool failSafe() const              { return _failSafe.load(std::memory_order_relaxed); }
+      void setFailSafe(bool v)           { _failSafe.store(v); }
+      static bool inRealtime()           { return _realtime != 0; }
+
+      // Called periodically outside the realtime threads. Adds slabs to
+      //  classes running low, releases deferred heap blocks and reports
+      //  new realtime failures.
+      void maintain();
+
+      // cls 0 .. CLASSES - 1, or CLASSES for the heap blocks.
+      void stats(int cls, Stats* st) const;
+      void dump(FILE* f) const;
+      };
+
+// The one arena of the process.
+extern RTArena& rtArena();
+
+//---------------------------------------------------------
+//   RTArenaScope
+//    Marks the enclosing block of the calling thread as
+//     realtime. Scopes may nest.
+//---------------------------------------------------------
+
+class RTArenaScope {
+   public:
+      RTArenaScope()  { ++RTArena::_realtime; }
+      ~RTArenaScope() { if(--RTArena::_realtime == 0 && RTArena::_node) rtArena().releaseNode(); }
+      };
+
+//---------------------------------------------------------
+//   RTArenaAlloc
+//    Standard allocator on the arena.
+//---------------------------------------------------------
+
+template <typename T> class RTArenaAlloc
+{
+  public:
+    typedef T         value_type;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+
+    typedef T&        reference;
+    typedef const T&  const_reference;
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    RTArenaAlloc() { }
+    template <typename U> RTArenaAlloc(const RTArenaAlloc<U>&) {}
+    ~RTArenaAlloc() {}
+
+    pointer allocate(size_type n, void * = 0) { return static_cast<T*>(rtArena().allocNode(n * sizeof(T))); }
+    void deallocate(pointer p, size_type n) { rtArena().free(p, n * sizeof(T)); }
+
+    RTArenaAlloc<T>&  operator=(const RTArenaAlloc&) { return *this; }
+    void construct(pointer p, const T& val) { new ((T*) p) T(val); }
+    void destroy(pointer p) { p->~T(); }
+    size_type max_size() const { return size_t(-1) / sizeof(T); }
+
+    template <typename U> struct rebind { typedef RTArenaAlloc<U> other; };
+    template <typename U> RTArenaAlloc& operator=(const RTArenaAlloc<U>&) { return *this; }
+    template <typename U> bool operator==(const RTArenaAlloc<U>&) const { return true; }
+    template <typename U> bool operator!=(const RTArenaAlloc<U>&) const { return false; }
+};
+
+
 //---------------------------------------------------------
 //   MemoryQueue
 //   An efficient queue which grows by fixed chunk sizes,
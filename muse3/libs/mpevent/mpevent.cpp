@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <utility>
 
 #include "mpevent.h"
 
@@ -32,12 +33,6 @@
 namespace MusECore {
 
 
-template <typename T> TypedMemoryPool<T, 2048> audioMPEventRTalloc<T>::pool;
-template <typename T> TypedMemoryPool<T, 2048> seqMPEventRTalloc<T>::pool;
-
-//template <typename T, MPEventRTallocID aid> TypedMemoryPool<T, 2048> MPEventRTalloc<T, aid>::audio_pool;
-//template <typename T, MPEventRTallocID aid> TypedMemoryPool<T, 2048> MPEventRTalloc<T, aid>::seq_pool;
-
 //---------------------------------------------------------
 //   MEvent
 //---------------------------------------------------------
@@ -231,6 +226,24 @@ int MEvent::translateCtrlNum() const
   return ctrl;
 }
 
+//---------------------------------------------------------
+//   insert
+//---------------------------------------------------------
+
+iMPEvent MPEventList::insert(const MidiPlayEvent& ev)
+{
+  if(!rtArena().reserveNode(MPEVENT_NODE_SIZE))
+    return end();
+  return MPEL::insert(ev);
+}
+
+iMPEvent MPEventList::insert(MidiPlayEvent&& ev)
+{
+  if(!rtArena().reserveNode(MPEVENT_NODE_SIZE))
+    return end();
+  return MPEL::insert(std::move(ev));
+}
+
 //---------------------------------------------------------
 //   add
 //    Optimize to eliminate duplicate events at the SAME time.
@@ -311,6 +324,24 @@ void MPEventList::add(const MidiPlayEvent& ev)
   insert(ev);
 }
 
+//---------------------------------------------------------
+//   insert
+//---------------------------------------------------------
+
+iSeqMPEvent SeqMPEventList::insert(const MidiPlayEvent& ev)
+{
+  if(!rtArena().reserveNode(MPEVENT_NODE_SIZE))
+    return end();
+  return SMPEL::insert(ev);
+}
+
+iSeqMPEvent SeqMPEventList::insert(MidiPlayEvent&& ev)
+{
+  if(!rtArena().reserveNode(MPEVENT_NODE_SIZE))
+    return end();
+  return SMPEL::insert(std::move(ev));
+}
+
 //---------------------------------------------------------
 //   add
 //    Optimize to eliminate duplicate events at the SAME time.
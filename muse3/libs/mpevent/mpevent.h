@@ -181,93 +181,31 @@ class MidiRecFifo {
       int getSize() const  { return size; }
       };
 
-//---------------------------------------------------------
-//   audioMPEventRTalloc
-//---------------------------------------------------------
-
-template <typename T> class audioMPEventRTalloc
-{
-  private:
-    static TypedMemoryPool<T, 2048> pool;
-    
-  public:
-    typedef T         value_type;
-    typedef size_t    size_type;
-    typedef ptrdiff_t difference_type;
-
-    typedef T*        pointer;
-    typedef const T*  const_pointer;
-
-    typedef T&        reference;
-    typedef const T&  const_reference;
-
-    pointer address(reference x) const { return &x; }
-    const_pointer address(const_reference x) const { return &x; }
-
-    audioMPEventRTalloc() { } 
-    template <typename U> audioMPEventRTalloc(const audioMPEventRTalloc<U>&) {}
-    ~audioMPEventRTalloc() {}
-
-    pointer allocate(size_type n, void * = 0) { return static_cast<T*>(pool.alloc(n)); }
-    void deallocate(pointer p, size_type n) { pool.free(p, n); }
-
-    audioMPEventRTalloc<T>&  operator=(const audioMPEventRTalloc&) { return *this; }
-    void construct(pointer p, const T& val) { new ((T*) p) T(val); }
-    void destroy(pointer p) { p->~T(); }
-    size_type max_size() const { return size_t(-1); }
-
-    template <typename U> struct rebind { typedef audioMPEventRTalloc<U> other; };
-    template <typename U> audioMPEventRTalloc& operator=(const audioMPEventRTalloc<U>&) { return *this; }
-};
-
-//---------------------------------------------------------
-//   seqMPEventRTalloc
-//---------------------------------------------------------
-
-template <typename T> class seqMPEventRTalloc
-{
-  private:
-    static TypedMemoryPool<T, 2048> pool;
-    
-  public:
-    typedef T         value_type;
-    typedef size_t    size_type;
-    typedef ptrdiff_t difference_type;
-
-    typedef T*        pointer;
-    typedef const T*  const_pointer;
-
-    typedef T&        reference;
-    typedef const T&  const_reference;
-
-    pointer address(reference x) const { return &x; }
-    const_pointer address(const_reference x) const { return &x; }
-
-    seqMPEventRTalloc() { }
-    template <typename U> seqMPEventRTalloc(const seqMPEventRTalloc<U>&) {}
-    ~seqMPEventRTalloc() {}
-
-    pointer allocate(size_type n, void * = 0) { return static_cast<T*>(pool.alloc(n)); }
-    void deallocate(pointer p, size_type n) { pool.free(p, n); }
-
-    seqMPEventRTalloc<T>&  operator=(const seqMPEventRTalloc&) { return *this; }
-    void construct(pointer p, const T& val) { new ((T*) p) T(val); }
-    void destroy(pointer p) { p->~T(); }
-    size_type max_size() const { return size_t(-1); }
-
-    template <typename U> struct rebind { typedef seqMPEventRTalloc<U> other; };
-    template <typename U> seqMPEventRTalloc& operator=(const seqMPEventRTalloc<U>&) { return *this; }
-};
+// The size of a list node, for taking one from the arena before inserting.
+// It is that of a tree node: the event after a colour and three links.
+static const size_t MPEVENT_NODE_SIZE = sizeof(MidiPlayEvent) + 4 * sizeof(void*);
+#ifdef __GLIBCXX__
+// The node the lists' allocator is rebound to. A reserved block of another
+//  size class would not be the one the insert takes.
+static_assert(sizeof(std::_Rb_tree_node<MidiPlayEvent>) == MPEVENT_NODE_SIZE,
+              "MPEVENT_NODE_SIZE is not the size of a std::multiset node");
+#endif
 
 //---------------------------------------------------------
 //   MPEventList
 //    memory allocation in audio thread domain
 //---------------------------------------------------------
 
-typedef std::multiset<MidiPlayEvent, std::less<MidiPlayEvent>, audioMPEventRTalloc<MidiPlayEvent> > MPEL;
+typedef std::multiset<MidiPlayEvent, std::less<MidiPlayEvent>, RTArenaAlloc<MidiPlayEvent> > MPEL;
 
 class MPEventList : public MPEL {
   public:
+      // These hide all other forms of insert, so that every insert takes
+      //  its node from the arena first. Don't use emplace.
+      // In a realtime section the event is dropped, and end() returned,
+      //  if the arena has no node left for it.
+      iterator insert(const MidiPlayEvent& ev);
+      iterator insert(MidiPlayEvent&& ev);
       // Optimize to eliminate duplicate events at the SAME time.
       // It will not handle duplicate events at DIFFERENT times.
       // Replaces event if it already exists.
@@ -283,10 +221,16 @@ typedef std::pair<iMPEvent, iMPEvent> MPEventListRangePair_t;
 //    memory allocation in sequencer thread domain
 //---------------------------------------------------------
 
-typedef std::multiset<MidiPlayEvent, std::less<MidiPlayEvent>, seqMPEventRTalloc<MidiPlayEvent> > SMPEL;
+typedef std::multiset<MidiPlayEvent, std::less<MidiPlayEvent>, RTArenaAlloc<MidiPlayEvent> > SMPEL;
 
 class SeqMPEventList : public SMPEL {
   public:
+      // These hide all other forms of insert, so that every insert takes
+      //  its node from the arena first. Don't use emplace.
+      // In a realtime section the event is dropped, and end() returned,
+      //  if the arena has no node left for it.
+      iterator insert(const MidiPlayEvent& ev);
+      iterator insert(MidiPlayEvent&& ev);
       // Optimize to eliminate duplicate events at the SAME time.
       // It will not handle duplicate events at DIFFERENT times.
       // Replaces event if it already exists.
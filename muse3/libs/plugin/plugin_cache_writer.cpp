@@ -22,7 +22,10 @@
 //=========================================================
 
 #include <QDir>
-#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QThread>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileInfoList>
@@ -1495,82 +1498,366 @@ void writePluginScanInfo(int level, MusECore::Xml& xml, const PluginScanInfoStru
       }
 
 //---------------------------------------------------------
-//   pluginScan
-//   If debugStdErr is true, any stderr content received
-//    from the scan program will be printed.
-//   Returns true on success
+//   PluginFileCache
+//---------------------------------------------------------
+
+PluginFileCache::PluginFileCache(const QString& dir)
+  : _dir(dir), _dirty(false)
+{
+}
+
+QString PluginFileCache::indexFile() const
+{
+  return _dir + "/index";
+}
+
+//---------------------------------------------------------
+//   fileStat
+//---------------------------------------------------------
+
+bool PluginFileCache::fileStat(const QString& filename, qint64* size, qint64* mtime)
+{
+  const QFileInfo fi(filename);
+  if(!fi.exists())
+    return false;
+  *size = fi.size();
+  *mtime = fi.lastModified().toMSecsSinceEpoch();
+  return true;
+}
+
+//---------------------------------------------------------
+//   fileHash
+//    FNV-1a over the contents, 0 if unreadable.
+//---------------------------------------------------------
+
+quint64 PluginFileCache::fileHash(const QString& filename)
+{
+  QFile f(filename);
+  if(!f.open(QIODevice::ReadOnly))
+    return 0;
+  quint64 h = 14695981039346656037ULL;
+  char buf[65536];
+  qint64 n;
+  while((n = f.read(buf, sizeof(buf))) > 0)
+  {
+    for(qint64 i = 0; i < n; ++i)
+    {
+      h ^= (unsigned char)buf[i];
+      h *= 1099511628211ULL;
+    }
+  }
+  return h;
+}
+
+//---------------------------------------------------------
+//   resultFile
+//    Named after a hash of the path.
+//---------------------------------------------------------
+
+QString PluginFileCache::resultFile(const QString& filename) const
+{
+  const QByteArray ba = filename.toUtf8();
+  quint64 h = 14695981039346656037ULL;
+  for(int i = 0; i < ba.size(); ++i)
+  {
+    h ^= (unsigned char)ba.at(i);
+    h *= 1099511628211ULL;
+  }
+  return _dir + QString("/%1.scan").arg(h, 16, 16, QChar('0'));
+}
+
+//---------------------------------------------------------
+//   load
+//---------------------------------------------------------
+
+bool PluginFileCache::load()
+{
+  _entries.clear();
+  _dirty = false;
+  QFile f(indexFile());
+  if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    return false;
+  MusECore::Xml xml(&f);
+  QString filename;
+  Entry e;
+  for(;;)
+  {
+    MusECore::Xml::Token token(xml.parse());
+    const QString& tag(xml.s1());
+    switch(token)
+    {
+      case MusECore::Xml::Error:
+      case MusECore::Xml::End:
+        return true;
+      case MusECore::Xml::TagStart:
+        if(tag == "file")
+        {
+          filename = QString();
+          e._size = -1;
+          e._mtime = 0;
+          e._hash = 0;
+          e._ports = false;
+          e._ok = false;
+        }
+        else if(tag != "muse")
+          xml.unknown("PluginFileCache");
+        break;
+      case MusECore::Xml::Attribut:
+        if(tag == "path")
+          filename = xml.s2();
+        else if(tag == "size")
+          e._size = xml.s2().toLongLong();
+        else if(tag == "mtime")
+          e._mtime = xml.s2().toLongLong();
+        else if(tag == "hash")
+          e._hash = xml.s2().toULongLong(0, 16);
+        else if(tag == "ports")
+          e._ports = xml.s2().toInt();
+        else if(tag == "ok")
+          e._ok = xml.s2().toInt();
+        break;
+      case MusECore::Xml::TagEnd:
+        if(tag == "file")
+        {
+          if(!filename.isEmpty())
+            _entries.insert(filename, e);
+        }
+        else if(tag == "muse")
+          return true;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+//---------------------------------------------------------
+//   save
 //---------------------------------------------------------
 
-static bool pluginScan(
+bool PluginFileCache::save()
+{
+  for(QMap<QString, Entry>::iterator it = _entries.begin(); it != _entries.end(); )
+  {
+    if(QFile::exists(it.key()))
+      ++it;
+    else
+    {
+      QFile::remove(resultFile(it.key()));
+      it = _entries.erase(it);
+      _dirty = true;
+    }
+  }
+  if(!_dirty)
+    return true;
+
+  const QDir dir(_dir);
+  if(!dir.exists())
+    dir.mkpath(".");
+  QFile f(indexFile());
+  if(!f.open(QIODevice::WriteOnly | QIODevice::Text))
+  {
+    std::fprintf(stderr, "PluginFileCache: cannot write %s\n", indexFile().toLocal8Bit().constData());
+    return false;
+  }
+  // Xml writes to a device as UTF-8 and reads back from UTF-8,
+  //  so paths outside Latin-1 survive the round trip.
+  MusECore::Xml xml(&f);
+  xml.header();
+  const int level = xml.putFileVersion(0);
+  for(QMap<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it)
+  {
+    const Entry& e = it.value();
+    xml.put(level, "<file path=\"%s\" size=\"%lld\" mtime=\"%lld\" hash=\"%llx\" ports=\"%d\" ok=\"%d\" />",
+            MusECore::Xml::xmlString(it.key()).toUtf8().constData(),
+            (long long)e._size, (long long)e._mtime, (unsigned long long)e._hash, e._ports, e._ok);
+  }
+  xml.tag(0, "/muse");
+  f.close();
+  _dirty = false;
+  return true;
+}
+
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void PluginFileCache::clear()
+{
+  for(QMap<QString, Entry>::const_iterator it = _entries.constBegin(); it != _entries.constEnd(); ++it)
+    QFile::remove(resultFile(it.key()));
+  _entries.clear();
+  _dirty = true;
+}
+
+//---------------------------------------------------------
+//   lookup
+//---------------------------------------------------------
+
+bool PluginFileCache::lookup(const QString& filename, bool ports, bool* ok)
+{
+  QMap<QString, Entry>::iterator it = _entries.find(filename);
+  if(it == _entries.end())
+    return false;
+  Entry& e = it.value();
+  if(ports && !e._ports)
+    return false;
+  qint64 size, mtime;
+  if(!fileStat(filename, &size, &mtime) || size != e._size)
+    return false;
+  if(mtime != e._mtime)
+  {
+    // Touched or reinstalled. Only the contents count.
+    if(fileHash(filename) != e._hash)
+      return false;
+    e._mtime = mtime;
+    _dirty = true;
+  }
+  if(e._ok && !QFile::exists(resultFile(filename)))
+    return false;
+  *ok = e._ok;
+  return true;
+}
+
+//---------------------------------------------------------
+//   store
+//---------------------------------------------------------
+
+void PluginFileCache::store(const QString& filename, bool ports, bool ok)
+{
+  Entry e;
+  if(!fileStat(filename, &e._size, &e._mtime))
+    return;
+  e._hash = fileHash(filename);
+  e._ports = ports;
+  e._ok = ok;
+  _entries.insert(filename, e);
+  _dirty = true;
+}
+
+//---------------------------------------------------------
+//   PluginScanJob
+//    One run of the scan program.
+//---------------------------------------------------------
+
+struct PluginScanJob
+{
+  QProcess _process;
+  QString _filename;
+  QString _outFile;
+  QElapsedTimer _timer;
+};
+
+// Time allowed for the scan of one file.
+static const int PLUGIN_SCAN_TIMEOUT = 4000;
+static const int MAX_PLUGIN_SCAN_JOBS = 16;
+
+//---------------------------------------------------------
+//   pluginScanJobs
+//    How many scan programs may run at once.
+//---------------------------------------------------------
+
+static int pluginScanJobs()
+{
+  const int n = QThread::idealThreadCount();
+  if(n < 1)
+    return 1;
+  return n > MAX_PLUGIN_SCAN_JOBS ? MAX_PLUGIN_SCAN_JOBS : n;
+}
+
+//---------------------------------------------------------
+//   startPluginScan
+//---------------------------------------------------------
+
+static PluginScanJob* startPluginScan(
   const QString& filename,
+  const QString& outFile,
   PluginScanInfoStruct::PluginType_t types,
-  PluginScanList* list,
   bool scanPorts,
   bool debugStdErr)
 {
-  const QByteArray filename_ba = filename.toLocal8Bit();
-  QTemporaryFile tmpfile;
-  // Must open the temp file to get its name.
-  if(!tmpfile.open())
+  if(debugStdErr)
+    std::fprintf(stderr, "\nChecking file: <%s>\n", filename.toLocal8Bit().constData());
+
+  PluginScanJob* job = new PluginScanJob;
+  job->_filename = filename;
+  job->_outFile = outFile;
+  // Never into pipes: with several scans running, nothing would read
+  //  them while waiting on another one, and a chatty plugin would
+  //  block on a full pipe until it timed out.
+  // The output is only wanted for debugging.
+  if(debugStdErr)
   {
-    std::fprintf(stderr, "\npluginScan FAILED: Could not create temporary output file for input file: %s\n\n", filename_ba.constData());
-    return false;
+    job->_process.setStandardOutputFile(outFile + ".stdout");
+    job->_process.setStandardErrorFile(outFile + ".stderr");
+  }
+  else
+  {
+    job->_process.setStandardOutputFile(QString("/dev/null"));
+    job->_process.setStandardErrorFile(QString("/dev/null"));
   }
-  // Get the unique temp file name.
-  const QString tmpfilename = tmpfile.fileName();
-  const QByteArray tmpfilename_ba = tmpfilename.toLocal8Bit();
-  // Close the temp file. It exists until tmpfile goes out of scope.
-  tmpfile.close();
-  
-  if(debugStdErr)
-    std::fprintf(stderr, "\nChecking file: <%s>\n", filename_ba.constData());
-
-  QProcess process;
 
   const QString prog = QString(BINDIR) + QString("/muse_plugin_scan");
 
   QStringList args;
-  args << QString("-t") + QString::number(types) << QString("-f") + filename << QString("-o") + tmpfilename;
+  args << QString("-t") + QString::number(types) << QString("-f") + filename << QString("-o") + outFile;
   if(scanPorts)
     args << QString("-p");
 
-  process.start(prog, args);
-
-//   if(!process.waitForStarted(4000))
-//   {
-//     std::fprintf(stderr, "pluginScan: waitForStarted failed\n");
-//     return false;
-//   }
-
-//   if(!process.waitForReadyRead(4000))
-//   {
-//     std::fprintf(stderr, "pluginScan: waitForReadyRead failed\n");
-//     return false;
-//   }
+  job->_timer.start();
+  job->_process.start(prog, args);
+  return job;
+}
 
-  if(!process.waitForFinished(4000))
-  {
-    std::fprintf(stderr, "\npluginScan FAILED: waitForFinished: file: %s\n\n", filename_ba.constData());
-    return false;
-  }
+//---------------------------------------------------------
+//   printPluginScanOutput
+//   Prints and removes what the scan program wrote to
+//    standard output and error, if debugStdErr is true.
+//---------------------------------------------------------
 
-  if(debugStdErr)
+static void printPluginScanOutput(PluginScanJob* job, bool debugStdErr)
+{
+  if(!debugStdErr)
+    return;
+  const char* suffix[2] = { ".stdout", ".stderr" };
+  const char* title[2] = { "Standard output", "Standard error output" };
+  for(int i = 0; i < 2; ++i)
   {
-    QByteArray out_array = process.readAllStandardOutput();
-    if(!out_array.isEmpty() && out_array.at(0) != 0)
-    {
-      // Terminate just to be sure.
-      out_array.append(char(0));
-      std::fprintf(stderr, "\npluginScan: Standard output from scan:\n%s\n", out_array.constData());
-    }
-    QByteArray err_array = process.readAllStandardError();
-    if(!err_array.isEmpty() && err_array.at(0) != 0)
+    QFile f(job->_outFile + suffix[i]);
+    if(!f.open(QIODevice::ReadOnly))
+      continue;
+    QByteArray array = f.readAll();
+    f.close();
+    f.remove();
+    if(!array.isEmpty() && array.at(0) != 0)
     {
       // Terminate just to be sure.
-      err_array.append(char(0));
-      std::fprintf(stderr, "\npluginScan: Standard error output from scan:\n%s\n", err_array.constData());
+      array.append(char(0));
+      std::fprintf(stderr, "\npluginScan: %s from scan:\n%s\n", title[i], array.constData());
     }
   }
+}
+
+//---------------------------------------------------------
+//   finishPluginScan
+//   If debugStdErr is true, any output received
+//    from the scan program will be printed.
+//   Returns true on success
+//---------------------------------------------------------
+
+static bool finishPluginScan(PluginScanJob* job, bool debugStdErr)
+{
+  const QByteArray filename_ba = job->_filename.toLocal8Bit();
+  QProcess& process = job->_process;
+
+  printPluginScanOutput(job, debugStdErr);
+
+  if(process.error() == QProcess::FailedToStart)
+  {
+    std::fprintf(stderr, "\npluginScan FAILED: Could not start scan program: file: %s\n\n", filename_ba.constData());
+    return false;
+  }
 
   if(process.exitStatus() != QProcess::NormalExit)
   {
@@ -1583,50 +1870,156 @@ static bool pluginScan(
     std::fprintf(stderr, "\npluginScan FAILED: Scan exit code not 0: file: %s\n\n", filename_ba.constData());
     return false;
   }
-  
-  // Open the temp file again...
-  QFile infile(tmpfilename);
-  if(!infile.exists())
+
+  if(!QFile::exists(job->_outFile))
   {
-    std::fprintf(stderr, "\npluginScan FAILED: Temporary file does not exist: %s\n\n", tmpfilename_ba.constData());
+    std::fprintf(stderr, "\npluginScan FAILED: Output file does not exist: %s\n\n",
+                 job->_outFile.toLocal8Bit().constData());
     return false;
   }
+  return true;
+}
+
+//---------------------------------------------------------
+//   readPluginScanResult
+//---------------------------------------------------------
+
+static void readPluginScanResult(const QString& filename, const QString& resultFile,
+                                 PluginScanList* list, bool scanPorts)
+{
+  QFile infile(resultFile);
   if(!infile.open(QIODevice::ReadOnly /*| QIODevice::Text*/))
   {
-    std::fprintf(stderr, "\npluginScan FAILED: Could not re-open temporary output file: %s\n\n",
-                 tmpfilename_ba.constData());
-    return false;
+    std::fprintf(stderr, "\npluginScan FAILED: Could not open scan output file: %s\n\n",
+                 resultFile.toLocal8Bit().constData());
+    return;
   }
-  
+
   // Create an xml object based on the file.
   MusECore::Xml xml(&infile);
-  
+
   // Read the list of plugins found in the xml.
   // For now we don't supply a separate scanEnums flag in pluginScan(), so just use scanPorts instead.
   if(readPluginScan(xml, list, scanPorts, scanPorts))
   {
-    std::fprintf(stderr, "\npluginScan FAILED: On readPluginScan(): file: %s\n\n", filename_ba.constData());
+    std::fprintf(stderr, "\npluginScan FAILED: On readPluginScan(): file: %s\n\n",
+                 filename.toLocal8Bit().constData());
   }
 
-  // Close the temp file.
   infile.close();
-  
-  // Now going out of scope destroys the temporary file...
-  
-  return true;
 }
 
 //---------------------------------------------------------
-//   scanPluginDir
-//   This might be called recursively!
+//   pluginScanFiles
+//   Runs the scan program on each file not in the cache,
+//    several at a time, then reads all the results into
+//    the list in the order of the files, so that the same
+//    duplicates are skipped however the scans finished.
 //---------------------------------------------------------
 
-static void scanPluginDir(
-  const QString& dirname,
+static void pluginScanFiles(
+  const QStringList& files,
   PluginScanInfoStruct::PluginType_t types,
   PluginScanList* list,
   bool scanPorts,
   bool debugStdErr,
+  PluginFileCache* fileCache)
+{
+  // Without a cache the results only live until they are read.
+  QTemporaryDir tmpdir;
+  PluginFileCache tmpcache(tmpdir.path());
+  PluginFileCache* cache = fileCache ? fileCache : &tmpcache;
+  if(!fileCache && !tmpdir.isValid())
+  {
+    std::fprintf(stderr, "\npluginScan FAILED: Could not create temporary output directory\n\n");
+    return;
+  }
+  const QDir cacheDir(cache->dir());
+  if(!cacheDir.exists())
+    cacheDir.mkpath(".");
+
+  QStringList pending;
+  for(QStringList::const_iterator it = files.cbegin(); it != files.cend(); ++it)
+  {
+    bool ok;
+    if(!cache->lookup(*it, scanPorts, &ok))
+      pending.append(*it);
+  }
+
+  if(debugStdErr && !files.isEmpty())
+    std::fprintf(stderr, "pluginScan: %d of %d files need scanning\n", pending.size(), files.size());
+
+  const int jobs = pluginScanJobs();
+  QList<PluginScanJob*> running;
+  int next = 0;
+  while(next < pending.size() || !running.isEmpty())
+  {
+    while(running.size() < jobs && next < pending.size())
+    {
+      const QString& fn = pending.at(next++);
+      // Written next to the result and renamed on success, so that a
+      //  killed scan never leaves a partial result behind.
+      const QString out = cache->resultFile(fn) + ".tmp";
+      QFile::remove(out);
+      running.append(startPluginScan(fn, out, types, scanPorts, debugStdErr));
+    }
+
+    // A short wait on each, so that any finished one frees its slot soon.
+    const int slice = running.size() > 1 ? 5 : 50;
+    for(int i = 0; i < running.size(); )
+    {
+      PluginScanJob* job = running.at(i);
+      QProcess& process = job->_process;
+      if(!process.waitForFinished(slice) && process.state() != QProcess::NotRunning)
+      {
+        if(job->_timer.elapsed() < PLUGIN_SCAN_TIMEOUT)
+        {
+          ++i;
+          continue;
+        }
+        std::fprintf(stderr, "\npluginScan FAILED: waitForFinished: file: %s\n\n",
+                     job->_filename.toLocal8Bit().constData());
+        process.kill();
+        process.waitForFinished(1000);
+        printPluginScanOutput(job, debugStdErr);
+        QFile::remove(job->_outFile);
+        // Not cached: a busy machine or a slow disk may be all that
+        //  was wrong, so the file is tried again on the next start.
+      }
+      else
+      {
+        const QString result = cache->resultFile(job->_filename);
+        bool ok = finishPluginScan(job, debugStdErr);
+        if(ok)
+        {
+          QFile::remove(result);
+          ok = QFile::rename(job->_outFile, result);
+        }
+        else
+          QFile::remove(job->_outFile);
+        cache->store(job->_filename, scanPorts, ok);
+      }
+      running.removeAt(i);
+      delete job;
+    }
+  }
+
+  for(QStringList::const_iterator it = files.cbegin(); it != files.cend(); ++it)
+  {
+    bool ok;
+    if(cache->lookup(*it, scanPorts, &ok) && ok)
+      readPluginScanResult(*it, cache->resultFile(*it), list, scanPorts);
+  }
+}
+
+//---------------------------------------------------------
+//   collectPluginFiles
+//   This might be called recursively!
+//---------------------------------------------------------
+
+static void collectPluginFiles(
+  const QString& dirname,
+  QStringList* files,
   // Only for recursions, original top caller should not touch!
   int recurseLevel = 0
 )
@@ -1656,47 +2049,65 @@ static void scanPluginDir(
       const QFileInfo& fi = *it;
       if(fi.isDir())
         // RECURSIVE!
-        scanPluginDir(fi.filePath(), types, list, scanPorts, debugStdErr, recurseLevel + 1);
+        collectPluginFiles(fi.filePath(), files, recurseLevel + 1);
       else
-        pluginScan(fi.filePath(), types, list, scanPorts, debugStdErr);
+        files->append(fi.filePath());
       
       ++it;
     }
   }
 }
 
+//---------------------------------------------------------
+//   scanPluginDirs
+//---------------------------------------------------------
+
+static void scanPluginDirs(
+  const QStringList& dirs,
+  PluginScanInfoStruct::PluginType_t types,
+  PluginScanList* list,
+  bool scanPorts,
+  bool debugStdErr,
+  PluginFileCache* fileCache)
+{
+  QStringList files;
+  for(QStringList::const_iterator it = dirs.cbegin(); it != dirs.cend(); ++it)
+    collectPluginFiles(*it, &files);
+  pluginScanFiles(files, types, list, scanPorts, debugStdErr, fileCache);
+}
+
 //---------------------------------------------------------
 //   scanLadspaPlugins
 //---------------------------------------------------------
 
-void scanLadspaPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr)
+void scanLadspaPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr,
+                       PluginFileCache* fileCache)
 {
-  QStringList sl = pluginGetLadspaDirectories(museGlobalLib);
-  for(QStringList::const_iterator it = sl.cbegin(); it != sl.cend(); ++it)
-    scanPluginDir(*it, PluginScanInfoStruct::PluginTypeAll, list, scanPorts, debugStdErr);
+  scanPluginDirs(pluginGetLadspaDirectories(museGlobalLib), PluginScanInfoStruct::PluginTypeAll,
+                 list, scanPorts, debugStdErr, fileCache);
 }
 
 //---------------------------------------------------------
 //   scanMessPlugins
 //---------------------------------------------------------
 
-void scanMessPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr)
+void scanMessPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr,
+                     PluginFileCache* fileCache)
 {
-  QStringList sl = pluginGetMessDirectories(museGlobalLib);
-  for(QStringList::const_iterator it = sl.cbegin(); it != sl.cend(); ++it)
-    scanPluginDir(*it, PluginScanInfoStruct::PluginTypeAll, list, scanPorts, debugStdErr);
+  scanPluginDirs(pluginGetMessDirectories(museGlobalLib), PluginScanInfoStruct::PluginTypeAll,
+                 list, scanPorts, debugStdErr, fileCache);
 }
 
 //---------------------------------------------------------
 //   scanDssiPlugins
 //---------------------------------------------------------
 
-void scanDssiPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr)
+void scanDssiPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr,
+                     PluginFileCache* fileCache)
 {
   #ifdef DSSI_SUPPORT
-  QStringList sl = pluginGetDssiDirectories();
-  for(QStringList::const_iterator it = sl.cbegin(); it != sl.cend(); ++it)
-    scanPluginDir(*it, PluginScanInfoStruct::PluginTypeAll, list, scanPorts, debugStdErr);
+  scanPluginDirs(pluginGetDssiDirectories(), PluginScanInfoStruct::PluginTypeAll,
+                 list, scanPorts, debugStdErr, fileCache);
   #endif
 }
 
@@ -1704,7 +2115,8 @@ void scanDssiPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr)
 //   scanLinuxVSTPlugins
 //---------------------------------------------------------
 
-void scanLinuxVSTPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr)
+void scanLinuxVSTPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr,
+                         PluginFileCache* fileCache)
 {
 #ifdef VST_NATIVE_SUPPORT
   #ifdef VST_VESTIGE_SUPPORT
@@ -1715,9 +2127,8 @@ void scanLinuxVSTPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr)
     
 //   sem_init(&_vstIdLock, 0, 1);
   
-  QStringList sl = pluginGetLinuxVstDirectories();
-  for(QStringList::const_iterator it = sl.cbegin(); it != sl.cend(); ++it)
-    scanPluginDir(*it, PluginScanInfoStruct::PluginTypeAll, list, scanPorts, debugStdErr);
+  scanPluginDirs(pluginGetLinuxVstDirectories(), PluginScanInfoStruct::PluginTypeAll,
+                 list, scanPorts, debugStdErr, fileCache);
   #endif
 }
 
@@ -2383,23 +2794,24 @@ void scanAllPlugins(
   PluginScanList* list,
   bool scanPorts,
   bool debugStdErr,
-  PluginScanInfoStruct::PluginType_t types)
+  PluginScanInfoStruct::PluginType_t types,
+  PluginFileCache* fileCache)
 {
   if(types & (PluginScanInfoStruct::PluginTypeDSSI | PluginScanInfoStruct::PluginTypeDSSIVST))
     // Take care of DSSI plugins first...
-    scanDssiPlugins(list, scanPorts, debugStdErr);
+    scanDssiPlugins(list, scanPorts, debugStdErr, fileCache);
 
   if(types & (PluginScanInfoStruct::PluginTypeLADSPA))
     // Now do LADSPA plugins...
-    scanLadspaPlugins(museGlobalLib, list, scanPorts, debugStdErr);
+    scanLadspaPlugins(museGlobalLib, list, scanPorts, debugStdErr, fileCache);
   
   if(types & (PluginScanInfoStruct::PluginTypeMESS))
     // Now do MESS plugins...
-    scanMessPlugins(museGlobalLib, list, scanPorts, debugStdErr);
+    scanMessPlugins(museGlobalLib, list, scanPorts, debugStdErr, fileCache);
   
   if(types & (PluginScanInfoStruct::PluginTypeLinuxVST))
     // Now do LinuxVST plugins...
-    scanLinuxVSTPlugins(list, scanPorts, debugStdErr);
+    scanLinuxVSTPlugins(list, scanPorts, debugStdErr, fileCache);
   
   if(types & (PluginScanInfoStruct::PluginTypeLV2))
     // Now do LV2 plugins...
@@ -2474,10 +2886,11 @@ bool createPluginCacheFile(
   bool writePorts,
   const QString& museGlobalLib,
   PluginScanInfoStruct::PluginType_t types,
-  bool debugStdErr)
+  bool debugStdErr,
+  PluginFileCache* fileCache)
 {
   // Scan all plugins into the list.
-  scanAllPlugins(museGlobalLib, list, writePorts, debugStdErr, type);
+  scanAllPlugins(museGlobalLib, list, writePorts, debugStdErr, type, fileCache);
   
   // Write the list's cache file.
   if(!writePluginCacheFile(path, QString(pluginCacheFilename(type)), *list, writePorts, types))
@@ -2499,32 +2912,42 @@ bool createPluginCacheFiles(
   bool writePorts,
   const QString& museGlobalLib,
   PluginScanInfoStruct::PluginType_t types,
-  bool debugStdErr)
+  bool debugStdErr,
+  bool rescanAll)
 {
+  // Results of earlier scans, by file. Shared by all types since
+  //  their directories may overlap.
+  PluginFileCache fileCache(path + "/files");
+  if(rescanAll)
+    fileCache.clear();
+  else
+    fileCache.load();
+
   if(types & (PluginScanInfoStruct::PluginTypeDSSI | PluginScanInfoStruct::PluginTypeDSSIVST))
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeDSSI, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeDSSI | PluginScanInfoStruct::PluginTypeDSSIVST, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeDSSI | PluginScanInfoStruct::PluginTypeDSSIVST, debugStdErr, &fileCache);
 
   if(types & PluginScanInfoStruct::PluginTypeLADSPA)
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeLADSPA, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeLADSPA, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeLADSPA, debugStdErr, &fileCache);
     
   if(types & PluginScanInfoStruct::PluginTypeLinuxVST)
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeLinuxVST, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeLinuxVST, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeLinuxVST, debugStdErr, &fileCache);
     
   if(types & PluginScanInfoStruct::PluginTypeMESS)
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeMESS, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeMESS, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeMESS, debugStdErr, &fileCache);
     
   if(types & PluginScanInfoStruct::PluginTypeLV2)
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeLV2, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeLV2, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeLV2, debugStdErr, &fileCache);
     
   if(types & PluginScanInfoStruct::PluginTypeVST)
     createPluginCacheFile(path, PluginScanInfoStruct::PluginTypeVST, list, writePorts,
-      museGlobalLib, PluginScanInfoStruct::PluginTypeVST, debugStdErr);
+      museGlobalLib, PluginScanInfoStruct::PluginTypeVST, debugStdErr, &fileCache);
     
+  fileCache.save();
   return true;
 }
 
@@ -2552,6 +2975,8 @@ bool checkPluginCacheFiles(
   // If ANY of the caches are dirty or we are forcing recreation, create them now.
   // Dirty checks whether any of the directories' date/time stamps are
   //  GREATER than the cache file's.
+  // Recreating only runs the scan program on files which are new or
+  //  changed since the last time, see PluginFileCache.
   if(alwaysRecreate || 
     (pluginCacheFilesExist(path, types) != types) ||
     (pluginCachesAreDirty(path, museGlobalLib, types, debugStdErr) != PluginScanInfoStruct::PluginTypeNone))
@@ -2559,7 +2984,7 @@ bool checkPluginCacheFiles(
     if(debugStdErr)
       std::fprintf(stderr, "Re-scanning and creating plugin cache files...\n");
 
-    if(!createPluginCacheFiles(path, list, writePorts, museGlobalLib, types, debugStdErr))
+    if(!createPluginCacheFiles(path, list, writePorts, museGlobalLib, types, debugStdErr, alwaysRecreate))
       std::fprintf(stderr, "checkPluginCacheFiles: createPluginCacheFiles() failed\n");
     else
       res = true;
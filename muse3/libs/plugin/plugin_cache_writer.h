@@ -26,6 +26,7 @@
 
 #include <QString>
 #include <QStringList>
+#include <QMap>
 
 #include "config.h"
 #include "globaldefs.h"
@@ -105,6 +106,60 @@ class Xml;
 
 namespace MusEPlugin {
 
+//-----------------------------------------
+// PluginFileCache
+//  Scan results of each plugin binary, kept in a directory
+//   of their own so that a rescan only runs the scan program
+//   on new or changed files. A file is unchanged if its size
+//   and modification time match, or failing that if its
+//   contents hash the same.
+//  Failed scans are remembered too and are not retried until
+//   the file changes.
+//-----------------------------------------
+
+class PluginFileCache
+{
+  public:
+    struct Entry
+    {
+      qint64 _size;
+      qint64 _mtime;      // Milliseconds since the epoch.
+      quint64 _hash;
+      bool _ports;        // Scanned with port information.
+      bool _ok;
+    };
+
+  private:
+    QString _dir;
+    QMap<QString, Entry> _entries;
+    bool _dirty;
+
+    QString indexFile() const;
+    static bool fileStat(const QString& filename, qint64* size, qint64* mtime);
+
+  public:
+    PluginFileCache(const QString& dir);
+
+    const QString& dir() const { return _dir; }
+    // Reads the index. Returns false if there is none.
+    bool load();
+    // Writes the index if anything changed, dropping files which
+    //  no longer exist. Returns true on success.
+    bool save();
+    // Forgets everything, so that every file is scanned again.
+    void clear();
+
+    // Returns true if the stored result for filename is still good.
+    //  ok tells whether the scan had succeeded.
+    bool lookup(const QString& filename, bool ports, bool* ok);
+    // Records the scan of filename. On success the scan program
+    //  must have written resultFile(filename).
+    void store(const QString& filename, bool ports, bool ok);
+    QString resultFile(const QString& filename) const;
+
+    static quint64 fileHash(const QString& filename);
+};
+
 //-----------------------------------------
 // functions
 //-----------------------------------------
@@ -139,17 +194,23 @@ void scanLv2Ports(const LilvPlugin *plugin, PluginScanInfoStruct* info, bool deb
 void writePluginScanInfo(int level, MusECore::Xml& xml, const PluginScanInfoStruct& info, bool writePorts);
 
 // The museGlobalLib is where to find the application's installed libraries.
-void scanLadspaPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr);
-void scanMessPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr);
-void scanDssiPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr);
-void scanLinuxVSTPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr);
+void scanLadspaPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr,
+                       PluginFileCache* fileCache = 0);
+void scanMessPlugins(const QString& museGlobalLib, PluginScanList* list, bool scanPorts, bool debugStdErr,
+                     PluginFileCache* fileCache = 0);
+void scanDssiPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr,
+                     PluginFileCache* fileCache = 0);
+void scanLinuxVSTPlugins(PluginScanList* list, bool scanPorts, bool debugStdErr,
+                         PluginFileCache* fileCache = 0);
 void scanLv2Plugins(PluginScanList* list, bool scanPorts, bool debugStdErr);
 
 void scanAllPlugins(const QString& museGlobalLib,
                     PluginScanList* list,
                     bool scanPorts,
                     bool debugStdErr,
-                    PluginScanInfoStruct::PluginType_t types = PluginScanInfoStruct::PluginTypeAll);
+                    PluginScanInfoStruct::PluginType_t types = PluginScanInfoStruct::PluginTypeAll,
+                    // Scan results to reuse and add to, or none.
+                    PluginFileCache* fileCache = 0);
 
 //-----------------------------------------
 // Public cache writer functions
@@ -170,7 +231,9 @@ bool createPluginCacheFile(
   // The types of plugins to write into this one file.
   PluginScanInfoStruct::PluginType_t types = PluginScanInfoStruct::PluginTypeAll,
   // Print some stderr text
-  bool debugStdErr = false
+  bool debugStdErr = false,
+  // Scan results to reuse and add to, or none.
+  PluginFileCache* fileCache = 0
 );
 
 bool createPluginCacheFiles(
@@ -185,7 +248,9 @@ bool createPluginCacheFiles(
   // The types of plugin cache files to create.
   PluginScanInfoStruct::PluginType_t types = PluginScanInfoStruct::PluginTypeAll,
   // Print some stderr text
-  bool debugStdErr = false
+  bool debugStdErr = false,
+  // Scan every file again instead of reusing the results of unchanged ones.
+  bool rescanAll = false
 );
 
 // Checks existence of given cache file types.
@@ -23,6 +23,7 @@
 //=========================================================
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "xml.h"
 
@@ -53,10 +54,11 @@ Xml::Xml(FILE* _f)
       level      = 0;
       inTag      = false;
       inComment  = false;
-      lbuffer[0] = 0;
-      bufptr     = lbuffer;
+      bufptr     = "";
+      _rend      = bufptr;
       _minorVersion = -1;
       _majorVersion = -1;
+      initRead();
       }
 
 Xml::Xml(const char* buf)
@@ -70,8 +72,10 @@ Xml::Xml(const char* buf)
       inTag     = false;
       inComment = false;
       bufptr    = buf;
+      _rend     = buf + strlen(buf);
       _minorVersion = -1;
       _majorVersion = -1;
+      initRead();
       }
 
 Xml::Xml(QString* s)
@@ -83,11 +87,12 @@ Xml::Xml(QString* s)
       level     = 0;
       inTag     = false;
       inComment = false;
-      lbuffer[0] = 0;
-      bufptr     = lbuffer;
+      bufptr     = "";
+      _rend      = bufptr;
       _destStr   = s;
       _minorVersion = -1;
       _majorVersion = -1;
+      initRead();
       }
 
 Xml::Xml(QIODevice* d)
@@ -100,10 +105,11 @@ Xml::Xml(QIODevice* d)
       level     = 0;
       inTag     = false;
       inComment = false;
-      lbuffer[0] = 0;
-      bufptr     = lbuffer;
+      bufptr     = "";
+      _rend      = bufptr;
       _minorVersion = -1;
       _majorVersion = -1;
+      initRead();
       }
 
 
@@ -111,26 +117,130 @@ Xml::Xml(QIODevice* d)
 //   BEGIN Read functions:
 //---------------------------------------------------------
 
-      
+// Size of the blocks read from a file or device.
+static const int READ_BLOCK = 256 * 1024;
+
+// Characters ending a run in appendRun(), one bit per kind of run.
+enum { RUN_NAME = 1,     // tag name
+       RUN_ATTR = 2,     // attribute name
+       RUN_VALUE = 4,    // unquoted attribute value
+       RUN_QUOTED = 8,   // quoted attribute value
+       RUN_TEXT = 16     // element text
+       };
+
+static unsigned char runStops[256];
+
+static bool initRunStops()
+      {
+      runStops[0] = 0xff;     // End of the buffer.
+      runStops[(unsigned char)' ']  |= RUN_NAME | RUN_ATTR | RUN_VALUE;
+      runStops[(unsigned char)'\t'] |= RUN_NAME | RUN_ATTR | RUN_VALUE;
+      runStops[(unsigned char)'\n'] |= RUN_NAME | RUN_ATTR | RUN_VALUE;
+      runStops[(unsigned char)'/']  |= RUN_NAME;
+      runStops[(unsigned char)'>']  |= RUN_NAME | RUN_VALUE;
+      runStops[(unsigned char)'=']  |= RUN_ATTR;
+      runStops[(unsigned char)'"']  |= RUN_QUOTED;
+      runStops[(unsigned char)'&']  |= RUN_QUOTED | RUN_TEXT;
+      runStops[(unsigned char)'<']  |= RUN_TEXT;
+      return true;
+      }
+
+static const bool runStopsInitialized = initRunStops();
+
+//---------------------------------------------------------
+//   assign
+//    Copies into the capacity already reserved by dst,
+//     where a plain assignment would share and allocate
+//     again on the next change.
+//---------------------------------------------------------
+
+static inline void assign(QByteArray& dst, const QByteArray& src)
+      {
+      dst.resize(0);
+      dst.append(src.constData(), src.size());
+      }
+
+// Song files are UTF-8, as written by the put and tag functions.
+static inline QString decode(const QByteArray& b)
+      {
+      return QString::fromUtf8(b.constData(), b.size());
+      }
+
+//---------------------------------------------------------
+//   initRead
+//---------------------------------------------------------
+
+void Xml::initRead()
+      {
+      _s1Valid = true;
+      _s2Valid = true;
+      // Reserved capacity is kept when they are emptied for the next token.
+      _b1.reserve(256);
+      _b2.reserve(256);
+      _tag.reserve(64);
+      _text.reserve(256);
+      _endTag.reserve(64);
+      }
+
+//---------------------------------------------------------
+//   s1
+//   s2
+//---------------------------------------------------------
+
+const QString& Xml::s1()
+      {
+      if (!_s1Valid) {
+            _s1 = decode(_b1);
+            _s1Valid = true;
+            }
+      return _s1;
+      }
+
+const QString& Xml::s2()
+      {
+      if (!_s2Valid) {
+            _s2 = decode(_b2);
+            _s2Valid = true;
+            }
+      return _s2;
+      }
+
+//---------------------------------------------------------
+//   fill
+//    Read the next block of the file or device.
+//---------------------------------------------------------
+
+bool Xml::fill()
+      {
+      if (!f && !_destIODev)
+            return false;
+      if (_rbuf.empty())
+            _rbuf.resize(READ_BLOCK + 1);
+      qint64 n;
+      if (f)
+            n = fread(&_rbuf[0], 1, READ_BLOCK, f);
+      else
+            n = _destIODev->read(&_rbuf[0], READ_BLOCK);
+      if (n <= 0)
+            return false;
+      _rbuf[n] = 0;
+      bufptr = &_rbuf[0];
+      _rend = bufptr + n;
+      return true;
+      }
+
 //---------------------------------------------------------
 //   next
 //---------------------------------------------------------
 
 void Xml::next()
       {
-      if (*bufptr == 0) {
-        
-            if((!f && !_destIODev) ||
-               (f && fgets(lbuffer, 512, f) == 0) ||
-               (_destIODev && _destIODev->readLine(lbuffer, 512) <= 0))
-            {
-              c = EOF;
-              return;
+      if (bufptr == _rend && !fill()) {
+            c = EOF;
+            return;
             }
-                  
-            bufptr = lbuffer;
-            }
-      c = *bufptr++;
+      // Unsigned, a 0xff byte is not EOF.
+      c = (unsigned char)*bufptr++;
       if (c == '\n') {
             ++_line;
             _col = -1;
@@ -151,112 +261,110 @@ void Xml::nextc()
       }
 
 //---------------------------------------------------------
-//   token
-//    read token into _s2
+//   appendRun
+//    Append characters to b from the current one up to
+//     one of the kind of stop characters, which is left
+//     in c. Whatever is in the buffer is copied at once.
 //---------------------------------------------------------
 
-void Xml::token(int cc)
+void Xml::appendRun(QByteArray& b, int stops)
       {
-      _s2.clear();  
-      int i = 0;
-      for (; i < 9999999;) {   // Stop at a reasonably large amount 10 million.
-            if (c == ' ' || c == '\t' || c == cc || c == '\n' || c == EOF)
-                  break;
-            _s2.append(c);
-            i++;
+      // A zero byte stops the inner loop, as the end of the block
+      //  does, but is data if it comes before the end.
+      while (c != EOF && (c == 0 || !(runStops[(unsigned char)c] & stops))) {
+            // c was just read, it is at bufptr[-1].
+            const char* p = bufptr;
+            while (!(runStops[(unsigned char)*p] & stops))
+                  ++p;
+            b.append(bufptr - 1, p - bufptr + 1);
+            for (; bufptr < p; ++bufptr) {
+                  if (*bufptr == '\n') {
+                        ++_line;
+                        _col = 0;
+                        }
+                  else
+                        ++_col;
+                  }
             next();
             }
       }
 
+//---------------------------------------------------------
+//   token
+//    read token into b
+//---------------------------------------------------------
+
+void Xml::token(QByteArray& b, int stops)
+      {
+      b.resize(0);
+      appendRun(b, stops);
+      }
+
 //---------------------------------------------------------
 //   stoken
-//    read string token into _s2
+//    read string token into _b2, without the quotes
 //---------------------------------------------------------
 
 void Xml::stoken()
       {
-      _s2.clear();  
-      int i = 0;
-      _s2.append(c);
-      ++i;
+      _b2.resize(0);
       next();
 
-      for (;i < 10000000*4-1;) {  // Stop at a reasonably large amount 10 million.
+      for (;;) {
+            appendRun(_b2, RUN_QUOTED);
             if (c == '"') {
-                  _s2.append(c);
-                  i++;
                   next();
                   break;
                   }
-            if (c == '&') {
-                  char entity[6];
-                  int k = 0;
-                  for (; k < 6; ++k) {
-                        next();
-                        if (c == EOF)
-                             break;
-                        else if (c == ';') {
-                              entity[k] = 0;
-                              if (strcmp(entity, "quot") == 0)
-                                    c = '"';
-                              else if (strcmp(entity, "amp") == 0)
-                                    c = '&';
-                              else if (strcmp(entity, "lt") == 0)
-                                    c = '<';
-                              else if (strcmp(entity, "gt") == 0)
-                                    c = '>';
-                              else if (strcmp(entity, "apos") == 0)
-                                    c = '\'';
-                              else
-                                    entity[k] = c;
-                              break;
-                              }
+            if (c == EOF)
+                  break;
+            // c == '&'
+            char entity[6];
+            int k = 0;
+            for (; k < 6; ++k) {
+                  next();
+                  if (c == EOF)
+                       break;
+                  else if (c == ';') {
+                        entity[k] = 0;
+                        if (strcmp(entity, "quot") == 0)
+                              c = '"';
+                        else if (strcmp(entity, "amp") == 0)
+                              c = '&';
+                        else if (strcmp(entity, "lt") == 0)
+                              c = '<';
+                        else if (strcmp(entity, "gt") == 0)
+                              c = '>';
+                        else if (strcmp(entity, "apos") == 0)
+                              c = '\'';
                         else
                               entity[k] = c;
+                        break;
                         }
-                  if (c == EOF || k == 6) {
-                        // dump entity
-                        int n = 0;
-                        _s2.append('&');
-                        i++;
-                        for (;(i < 511) && (n < k); ++i, ++n)
-                             _s2.append(entity[n]);
-                        }
-                  else {
-                        _s2.append(c);
-                        i++;
-                        }
+                  else
+                        entity[k] = c;
                   }
-            else if(c != EOF)
-            {
-              _s2.append(c);
-              i++;
-            }
+            if (c == EOF || k == 6) {
+                  // dump entity
+                  _b2.append('&');
+                  _b2.append(entity, k);
+                  }
+            else
+                  _b2.append(char(c));
             if (c == EOF)
                   break;
             next();
             }
       }
 
-//---------------------------------------------------------
-//   strip
-//    strip `"` from string
-//---------------------------------------------------------
-
-QString Xml::strip(const QString& s)
-      {
-      int l = s.length();
-      if (l >= 2 && s[0] == '"')
-            return s.mid(1, l-2);
-      return s;
-      }
-
 //---------------------------------------------------------
 //   parse
 //---------------------------------------------------------
 
 Xml::Token Xml::parse()
       {
+      _s1Valid = false;
+      _s2Valid = false;
  again:
       bool endFlag = false;
       nextc();
@@ -264,47 +372,44 @@ Xml::Token Xml::parse()
             //if (level > 0 || MusEGlobal::debugMsg)
             if (level > 0)
               fprintf(stderr, "WARNING: unexpected EOF reading xml file at level %d, line %d, <%s><%s><%s>\n",
-                level, _line, _tag.toLatin1().constData(), _s1.toLatin1().constData(), _s2.toLatin1().constData());
+                level, _line, _tag.constData(), _b1.constData(), _b2.constData());
             return level == 0 ? End : Error;
             }
 
-      _s1.clear();
+      _b1.resize(0);
       if (inTag) {
             //-------------------
             // parse Attributes
             //-------------------
             if (c == '/') {
                   nextc();
-                  token('>');
+                  token(_b2, RUN_VALUE);
                   if (c != '>') {
                         fprintf(stderr, "Xml: unexpected char '%c', expected '>'\n", c);
                         goto error;
                         }
-                  _s1   = _tag;
+                  assign(_b1, _tag);
                   inTag = false;
                   --level;
                   return TagEnd;
                   }
-            _s2.clear();
-            token('=');
-            _s1 = _s2;
+            token(_b1, RUN_ATTR);
             nextc();      // skip space
             if (c == EOF) {
                   //if (level > 0 || MusEGlobal::debugMsg)
                   if (level > 0)
                     fprintf(stderr, "WARNING: unexpected EOF reading xml file at level %d, line %d, <%s><%s><%s>\n",
-                      level, _line, _tag.toLatin1().constData(), _s1.toLatin1().constData(), _s2.toLatin1().constData());
+                      level, _line, _tag.constData(), _b1.constData(), _b2.constData());
                   return level == 0 ? End : Error;
                   }
             if (c == '"')
                   stoken();
             else
-                  token('>');
+                  token(_b2, RUN_VALUE);
             if (c == '>')
                   inTag = false;
             else
                   --bufptr;
-            _s2 = strip(_s2);
             return Attribut;
             }
       if (c == '<') {
@@ -322,9 +427,8 @@ Xml::Token Xml::parse()
                         if (c == '?' || c == EOF || c == '>')
                               break;
                         
-                        _s1.append(c);
+                        _b1.append(char(c));
                         
-                        // TODO: check overflow
                         next();
                         }
                   
@@ -355,15 +459,7 @@ Xml::Token Xml::parse()
                   goto again;
                   }
 
-            for (;;) {
-                  if (c == '/' || c == ' ' || c == '\t' || c == '>' || c == '\n' || c == EOF)
-                        break;
-                  // TODO: check overflow
-                  
-                  _s1.append(c);
-                  
-                  next();
-                  }
+            appendRun(_b1, RUN_NAME);
             
             // skip white space:
             while (c == ' ' || c == '\t' || c == '\n')
@@ -393,7 +489,7 @@ Xml::Token Xml::parse()
                         }
                   }
             else {
-                  _tag = _s1;
+                  assign(_tag, _b1);
                   --bufptr;
                   inTag = true;
                   ++level;
@@ -413,43 +509,43 @@ Xml::Token Xml::parse()
                   goto error;
                   }
             for (;;) {
+                  appendRun(_b1, RUN_TEXT);
                   if (c == EOF || c == '<')
                         break;
-                  if (c == '&') {
-                        next();
-                        if (c == '<') {         // be tolerant with old muse files
-                              _s1.append('&');
-                              continue;
-                              }
-                              
-                        QString name;
-                        int name_idx = 0;
-                        name.append(c);
-                        name_idx++;
-                        
-                        for (; name_idx < 9999999;) {   // Stop at a reasonably large amount 10 million.
-                              next();
-                              if (c == ';')
-                                    break;
-                              name.append(c);
-                              name_idx++;
-                              }
-                              
-                        if (name == "lt")
-                              c = '<';
-                        else if (name == "gt")
-                              c = '>';
-                        else if (name == "apos")
-                              c = '\'';
-                        else if (name == "quot")
-                              c = '"';
-                        else if (name == "amp")
-                              c = '&';
-                        else
-                              c = '?';
+                  // c == '&'
+                  next();
+                  if (c == '<') {         // be tolerant with old muse files
+                        _b1.append('&');
+                        continue;
                         }
 
-                  _s1.append(c);
+                  // Only the known names matter, longer ones are cut.
+                  char name[8];
+                  int n = 0;
+                  do {
+                        if (n < 7)
+                              name[n] = c;
+                        ++n;
+                        next();
+                        } while (c != ';' && c != EOF);
+                  name[n < 7 ? n : 7] = 0;
+
+                  if (n > 7)
+                        c = '?';
+                  else if (strcmp(name, "lt") == 0)
+                        c = '<';
+                  else if (strcmp(name, "gt") == 0)
+                        c = '>';
+                  else if (strcmp(name, "apos") == 0)
+                        c = '\'';
+                  else if (strcmp(name, "quot") == 0)
+                        c = '"';
+                  else if (strcmp(name, "amp") == 0)
+                        c = '&';
+                  else
+                        c = '?';
+
+                  _b1.append(char(c));
                   
                   next();
                   }
@@ -464,32 +560,55 @@ error:
       }
 
 //---------------------------------------------------------
-//   parse(QString)
+//   parseText
+//    Read up to the end tag, returns the last text read
+//     on the way. The tag must not be _b1.
 //---------------------------------------------------------
 
-QString Xml::parse(const QString& tag)
+const QByteArray& Xml::parseText(const QByteArray& tag)
       {
-      QString a;
+      _text.resize(0);
 
       for (;;) {
             switch (parse()) {
                   case Error:
                   case End:
-                        return a;
+                        return _text;
                   default:
                   case TagStart:
                   case Attribut:
                         break;
                   case Text:
-                        a = _s1;
+                        assign(_text, _b1);
                         break;
                   case TagEnd:
-                        if (_s1 == tag)
-                              return a;
+                        if (_b1 == tag)
+                              return _text;
                         break;
                   }
             }
-      return a;
+      return _text;
+      }
+
+//---------------------------------------------------------
+//   parse(QString)
+//---------------------------------------------------------
+
+QString Xml::parse(const QString& tag)
+      {
+      return decode(parseText(tag.toUtf8()));
+      }
+
+//---------------------------------------------------------
+//   parseRaw1
+//    parse1() without decoding the text, numbers are
+//     converted straight from the bytes.
+//---------------------------------------------------------
+
+const QByteArray& Xml::parseRaw1()
+      {
+      assign(_endTag, _b1.trimmed());
+      return parseText(_endTag);
       }
 
 //---------------------------------------------------------
@@ -498,7 +617,7 @@ QString Xml::parse(const QString& tag)
 
 QString Xml::parse1()
       {
-      return parse(_s1.simplified());
+      return decode(parseRaw1());
       }
 
 //---------------------------------------------------------
@@ -507,14 +626,11 @@ QString Xml::parse1()
 
 int Xml::parseInt()
       {
-      QString s(parse1().simplified());
+      const QByteArray s(parseRaw1().trimmed());
       bool ok;
-      int base = 10;
-      if (s.startsWith("0x") || s.startsWith("0X")) {
-            base = 16;
-            s = s.mid(2);
-            }
-      int n = s.toInt(&ok, base);
+      if (s.startsWith("0x") || s.startsWith("0X"))
+            return s.mid(2).toInt(&ok, 16);
+      int n = s.toInt(&ok, 10);
       return n;
       }
 
@@ -524,14 +640,11 @@ int Xml::parseInt()
 
 unsigned int Xml::parseUInt()
       {
-      QString s(parse1().simplified());
+      const QByteArray s(parseRaw1().trimmed());
       bool ok;
-      int base = 10;
-      if (s.startsWith("0x") || s.startsWith("0X")) {
-            base = 16;
-            s = s.mid(2);
-            }
-      unsigned int n = s.toUInt(&ok, base);
+      if (s.startsWith("0x") || s.startsWith("0X"))
+            return s.mid(2).toUInt(&ok, 16);
+      unsigned int n = s.toUInt(&ok, 10);
       return n;
       }
 
@@ -541,8 +654,7 @@ unsigned int Xml::parseUInt()
 
 float Xml::parseFloat()
       {
-      QString s(parse1().simplified());
-      return s.toFloat();
+      return parseRaw1().trimmed().toFloat();
       }
 
 //---------------------------------------------------------
@@ -551,8 +663,7 @@ float Xml::parseFloat()
 
 double Xml::parseDouble()
       {
-      QString s(parse1().simplified());
-      return s.toDouble();
+      return parseRaw1().trimmed().toDouble();
       }
 
 //---------------------------------------------------------
@@ -587,6 +698,7 @@ void Xml::dump(QString &dump)
       {
       if(f)
       {
+        char lbuffer[512];
         fpos_t pos;
         fgetpos(f, &pos);
         rewind(f);
@@ -599,10 +711,12 @@ void Xml::dump(QString &dump)
         // Only if not sequential.
         if(!_destIODev->isSequential())
         {
+          char lbuffer[512];
+          qint64 n;
           const qint64 pos = _destIODev->pos();
           _destIODev->seek(0);
-          while(_destIODev->read(lbuffer, 512) > 0)
-              dump.append(lbuffer);
+          while((n = _destIODev->read(lbuffer, 512)) > 0)
+              dump.append(QString::fromUtf8(lbuffer, n));
           _destIODev->seek(pos);
         }
       }
@@ -694,8 +808,8 @@ QColor readColor(Xml& xml)
 void Xml::unknown(const char* s)
       {
       fprintf(stderr, "%s: unknown tag <%s> at line %d\n",
-         s, _s1.toLatin1().constData(), _line+1);
-      parse1();
+         s, _b1.constData(), _line+1);
+      parseRaw1();
       }
 
       
@@ -752,7 +866,7 @@ void Xml::put(const char* format, ...)
         const QString s = QString::vasprintf(format, args) + '\n';
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -775,7 +889,7 @@ void Xml::put(int level, const char* format, ...)
         const QString s = QString::vasprintf(format, args) + '\n';
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -801,7 +915,7 @@ void Xml::nput(int level, const char* format, ...)
         const QString s = QString::vasprintf(format, args);
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -822,7 +936,7 @@ void Xml::nput(const char* format, ...)
         const QString s = QString::vasprintf(format, args);
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -851,7 +965,7 @@ void Xml::tag(int level, const char* format, ...)
         const QString s = '<' + QString::vasprintf(format, args) + ">\n";
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -881,7 +995,7 @@ void Xml::etag(int level, const char* format, ...)
         const QString s = "</" + QString::vasprintf(format, args) + ">\n";
         va_end(args);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -917,7 +1031,7 @@ void Xml::intTag(int level, const char* name, int val)
       {
         const QString s = QString("<%1>%2</%3>\n").arg(name).arg(val).arg(name);
         if(_destIODev)
-        _destIODev->write(s.toLatin1());
+        _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -934,7 +1048,7 @@ void Xml::uintTag(int level, const char* name, unsigned int val)
       {
         const QString s = QString("<%1>%2</%3>\n").arg(name).arg(val).arg(name);
         if(_destIODev)
-        _destIODev->write(s.toLatin1());
+        _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -951,7 +1065,7 @@ void Xml::floatTag(int level, const char* name, float val)
       {
         const QString s = QString("<%1>%2</%3>\n").arg(name).arg(val).arg(name);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -968,7 +1082,7 @@ void Xml::doubleTag(int level, const char* name, double val)
       {
         const QString s = QString("<%1>%2</%3>\n").arg(name).arg(val).arg(name);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -997,7 +1111,9 @@ void Xml::strTag(int level, const char* name, const char* val)
       }
       else
       {
-        QString s = QString("<%1>").arg(name);
+        // Bytes, a char appended to a QString would be taken as Latin-1.
+        QByteArray s("<");
+        s.append(name).append('>');
         if (val) {
               while (*val) {
                     switch(*val) {
@@ -1011,11 +1127,11 @@ void Xml::strTag(int level, const char* name, const char* val)
                     ++val;
                     }
               }
-        s.append(QString("</%1>\n").arg(name));
+        s.append("</").append(name).append(">\n");
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s);
         else if(_destStr)
-          _destStr->append(s);
+          _destStr->append(QString::fromUtf8(s));
       }
       }
 
@@ -1036,7 +1152,7 @@ void Xml::colorTag(int level, const char* name, const QColor& color)
         const QString s = QString("<%1 r=\"%2\" g=\"%3\" b=\"%4\"></%5>\n")
           .arg(name).arg(color.red()).arg(color.green()).arg(color.blue()).arg(name);
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -1044,7 +1160,7 @@ void Xml::colorTag(int level, const char* name, const QColor& color)
 
 void Xml::colorTag(int level, const QString& name, const QColor& color)
 {
-  colorTag(level, name.toLocal8Bit().constData(), color);
+  colorTag(level, name.toUtf8().constData(), color);
 }
 
 //---------------------------------------------------------
@@ -1075,7 +1191,7 @@ void Xml::qrectTag(int level, const char* name, const QRect& r)
            .arg(name).arg(r.x()).arg(r.y()).arg(r.width()).arg(r.height()).arg(name);
           
         if(_destIODev)
-          _destIODev->write(s.toLatin1());
+          _destIODev->write(s.toUtf8());
         else if(_destStr)
           _destStr->append(s);
       }
@@ -1087,12 +1203,12 @@ void Xml::qrectTag(int level, const char* name, const QRect& r)
 
 void Xml::strTag(int level, const char* name, const QString& val)
       {
-      strTag(level, name, val.toLocal8Bit().constData());
+      strTag(level, name, val.toUtf8().constData());
       }
 
 void Xml::strTag(int level, const QString& name, const QString& val)
 {
-  strTag(level, name.toLocal8Bit().constData(), val.toLocal8Bit().constData());
+  strTag(level, name.toUtf8().constData(), val.toUtf8().constData());
 }
       
 //---------------------------------------------------------
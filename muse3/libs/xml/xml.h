@@ -25,7 +25,9 @@
 #define __XML_H__
 
 #include <stdio.h>
+#include <vector>
 
+#include <QByteArray>
 #include <QString>
 #include <QColor>
 #include <QRect>
@@ -48,7 +50,13 @@ class Xml {
       QIODevice* _destIODev;
       int _line;
       int _col;
-      QString _s1, _s2, _tag;
+      // Raw bytes of the current tokens. _s1 and _s2 are only
+      //  decoded from them when asked for, see s1() and s2().
+      QByteArray _b1, _b2, _tag;
+      QString _s1, _s2;
+      bool _s1Valid, _s2Valid;
+      // Text of the element read by parseRaw1(), and its end tag.
+      QByteArray _text, _endTag;
       int level;
       bool inTag;
       bool inComment;
@@ -64,15 +72,22 @@ class Xml {
       int _majorVersion;                      // Currently loaded songfile major version
 
       int c;            // current char
-      char lbuffer[512];
-      // When constructed with a const char* parameter, this will be valid.
+      // File or device data, read in large blocks. Zero terminated.
+      std::vector<char> _rbuf;
+      // Next char in _rbuf, or in the char array when constructed
+      //  with a const char* parameter, and the end of the data.
       const char* bufptr;
+      const char* _rend;
 
+      void initRead();
+      bool fill();
       void next();
       void nextc();
-      void token(int);
+      void appendRun(QByteArray& b, int stops);
+      void token(QByteArray& b, int stops);
       void stoken();
-      QString strip(const QString& s);
+      const QByteArray& parseText(const QByteArray& tag);
+      const QByteArray& parseRaw1();
       void putLevel(int n);
 
    public:
@@ -108,8 +123,8 @@ class Xml {
       void unknown(const char*);
       int line() const    { return _line; }    // current line
       int col()  const    { return _col; }     // current col
-      const QString& s1() { return _s1; }
-      const QString& s2() { return _s2; }
+      const QString& s1();
+      const QString& s2();
       void dump(QString &dump);
 
       void header();
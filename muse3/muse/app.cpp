@@ -52,8 +52,13 @@
 #include "arranger.h"
 #include "arrangerview.h"
 #include "audio.h"
+#include "binsong.h"
 #include "audiodev.h"
 #include "audioprefetch.h"
+#include "audio_scheduler.h"
+#include "peakbuilder.h"
+#include "wavecache.h"
+#include "dspprofiler.h"
 #include "components/bigtime.h"
 #include "cliplist/cliplist.h"
 #include "conf.h"
@@ -223,6 +228,15 @@ bool MusE::seqStart()
       else
         fprintf(stderr, "seqStart(): audioPrefetch is NULL\n");
 
+      if(MusEGlobal::audioScheduler)
+      {
+        // Run the workers just below the audio thread.
+        int wprio = 0;
+        if(MusEGlobal::realTimeScheduling && MusEGlobal::realTimePriority - 1 >= 0)
+          wprio = MusEGlobal::realTimePriority - 1;
+        MusEGlobal::audioScheduler->start(MusEGlobal::config.audioWorkerThreads, wprio);
+      }
+
       if(MusEGlobal::midiSeq)
         MusEGlobal::midiSeq->start(0); // Prio unused, set in start.
 
@@ -244,6 +258,8 @@ void MusE::seqStop()
          MusEGlobal::midiSeq->stop(true);
       MusEGlobal::audio->stop(true);
       MusEGlobal::audioPrefetch->stop(true);
+      if(MusEGlobal::audioScheduler)
+        MusEGlobal::audioScheduler->stop();
       if (MusEGlobal::realTimeScheduling && watchdogThread)
             pthread_cancel(watchdogThread);
       }
@@ -1296,6 +1312,21 @@ void MusE::loadProjectFile1(const QString& name, bool songTemplate, bool doReadM
                         }
                   }
             }
+      else if (mex == "medb") {
+            //
+            //  read binary *.medb file
+            //
+            MusECore::BinSong bs;
+            if (!bs.open(fi.filePath())) {
+                  QMessageBox::critical(this, QString("MusE"),
+                     tr("File read error"));
+                  setUntitledProject();
+                  }
+            else {
+                  MusECore::Xml xml(bs.songText());
+                  read(xml, doReadMidiPorts, songTemplate);
+                  }
+            }
       else if (mex == "mid" || mex == "kar") {
             setConfigDefaults();
             if (!importMidi(name, false))
@@ -1513,6 +1544,9 @@ bool MusE::save(const QString& name, bool overwriteWarn, bool writeTopwins)
       {
 //       QString backupCommand;
 
+      if (QFileInfo(name).suffix() == "medb")
+            return saveBinary(name, overwriteWarn, writeTopwins);
+
       QFile currentName(name);
       if (QFile::exists(name)) {
             currentName.copy(name+".backup");
@@ -1550,6 +1584,41 @@ bool MusE::save(const QString& name, bool overwriteWarn, bool writeTopwins)
             }
       }
 
+//---------------------------------------------------------
+//   saveBinary
+//    Saving over a binary song only appends what changed
+//     and keeps the previous save intact until it commits,
+//     so no backup copy is made.
+//---------------------------------------------------------
+
+bool MusE::saveBinary(const QString& name, bool overwriteWarn, bool writeTopwins)
+      {
+      if (overwriteWarn && QFile::exists(name)) {
+            if (QMessageBox::warning(this, tr("MusE: write"),
+               tr("File\n%1\nexists. Overwrite?").arg(name),
+               QMessageBox::Save | QMessageBox::Cancel, QMessageBox::Save) != QMessageBox::Save)
+                  return false;
+            }
+      MusECore::BinSong bs;
+      bool ok = bs.create(name);
+      if (ok) {
+            MusECore::Xml xml(bs.songFile());
+            write(xml, writeTopwins);
+            ok = !ferror(bs.songFile()) && bs.commit();
+            }
+      if (!ok) {
+            QString s = "Write File\n" + name + "\nfailed: "
+               + QString(strerror(errno));
+            QMessageBox::critical(this,
+               tr("MusE: Write File failed"), s);
+            return false;
+            }
+      MusEGlobal::song->dirty = false;
+      setWindowTitle(projectTitle(project.absoluteFilePath()));
+      saveIncrement = 0;
+      return true;
+      }
+
 //---------------------------------------------------------
 //   quitDoc
 //---------------------------------------------------------
@@ -1606,22 +1675,25 @@ void MusE::closeEvent(QCloseEvent* event)
                   }
             }
 
-      QSettings settings("MusE", "MusE-qt");
-      settings.setValue("MusE/geometry", saveGeometry());
+      // A batch render leaves the configuration alone, other instances may be running.
+      if (MusEGlobal::batchRenderFile.isEmpty()) {
+            QSettings settings("MusE", "MusE-qt");
+            settings.setValue("MusE/geometry", saveGeometry());
 
-      writeGlobalConfiguration();
+            writeGlobalConfiguration();
 
-      // save "Open Recent" list
-      QString prjPath(MusEGlobal::configPath);
-      prjPath += "/projects";
-      QFile f(prjPath);
-      f.open(QIODevice::WriteOnly | QIODevice::Text);
-      if (f.exists()) {
-        QTextStream out(&f);
-        for (int i = 0; i < projectRecentList.size(); ++i) {
-           out << projectRecentList[i] << "\n";
-        }
-      }
+            // save "Open Recent" list
+            QString prjPath(MusEGlobal::configPath);
+            prjPath += "/projects";
+            QFile f(prjPath);
+            f.open(QIODevice::WriteOnly | QIODevice::Text);
+            if (f.exists()) {
+              QTextStream out(&f);
+              for (int i = 0; i < projectRecentList.size(); ++i) {
+                 out << projectRecentList[i] << "\n";
+              }
+            }
+            }
       if(MusEGlobal::debugMsg)
         printf("MusE: Exiting JackAudio\n");
       MusECore::exitJackAudio();
@@ -1637,6 +1709,10 @@ void MusE::closeEvent(QCloseEvent* event)
         printf("MusE: Exiting Metronome\n");
       MusECore::exitMetronome();
 
+      if(MusEGlobal::debugMsg)
+        printf("MusE: Stopping peak builder\n");
+      MusEGlobal::peakBuilder->stop();
+
       MusEGlobal::song->cleanupForQuit();
 
       // Give midi devices a chance to close first, above in cleanupForQuit.
@@ -1675,6 +1751,7 @@ void MusE::closeEvent(QCloseEvent* event)
       MusECore::exitOSC();
 
       delete MusEGlobal::audioPrefetch;
+      delete MusEGlobal::audioScheduler;
       delete MusEGlobal::audio;
 
       // Destroy the sequencer object if it exists.
@@ -1682,6 +1759,14 @@ void MusE::closeEvent(QCloseEvent* event)
 
       delete MusEGlobal::song;
 
+      delete MusEGlobal::peakBuilder;
+      MusEGlobal::peakBuilder = 0;
+      // After the song, its wave files drop their blocks on deletion.
+      delete MusEGlobal::waveCache;
+      MusEGlobal::waveCache = 0;
+      delete MusEGlobal::dspProfiler;
+      MusEGlobal::dspProfiler = 0;
+
       if(MusEGlobal::debugMsg)
         printf("MusE: Deleting icons\n");
       deleteIcons();
@@ -2837,6 +2922,15 @@ void MusE::bounceToFile(MusECore::AudioOutput* ao)
       if (sf == 0)
             return;
 
+      startBounceToFile(ao, sf);
+      }
+
+//---------------------------------------------------------
+//   startBounceToFile
+//---------------------------------------------------------
+
+bool MusE::startBounceToFile(MusECore::AudioOutput* ao, MusECore::SndFile* sf)
+      {
       MusEGlobal::song->setPos(0,MusEGlobal::song->lPos(),0,true,true);
       MusEGlobal::song->bounceOutput = ao;
       ao->setRecFile(sf);
@@ -2844,12 +2938,108 @@ void MusE::bounceToFile(MusECore::AudioOutput* ao)
         printf("ao->setRecFile %p\n", sf);
       MusEGlobal::song->setRecord(true, false);
       MusEGlobal::song->setRecordFlag(ao, true);
-      ao->prepareRecording();
+      if (!ao->prepareRecording()) {
+            // The file could not be created, prepareRecording() said so.
+            MusEGlobal::song->setRecordFlag(ao, false);
+            MusEGlobal::song->setRecord(false, false);
+            MusEGlobal::song->bounceOutput = 0;
+            return false;
+            }
       MusEGlobal::audio->msgBounce();
       MusEGlobal::song->setPlay(true);
+      return true;
       }
 
 
+//---------------------------------------------------------
+//   batchRender
+//    Bounces the whole project loaded from the command line
+//     without showing anything, see the -b option.
+//---------------------------------------------------------
+
+void MusE::batchRender()
+      {
+      MusECore::AudioOutput* ao = 0;
+      MusECore::OutputList* ol = MusEGlobal::song->outputs();
+      for (MusECore::iAudioOutput iao = ol->begin(); iao != ol->end(); ++iao) {
+            if (MusEGlobal::batchRenderOutput.isEmpty() || (*iao)->name() == MusEGlobal::batchRenderOutput) {
+                  ao = *iao;
+                  break;
+                  }
+            }
+      if (!ao) {
+            fprintf(stderr, "MusE: batch render: no output track <%s>\n",
+               MusEGlobal::batchRenderOutput.toLocal8Bit().constData());
+            finishBatchRender(1);
+            return;
+            }
+
+      if (!MusEGlobal::batchRenderTracks.isEmpty()) {
+            MusECore::PendingOperationList operations;
+            QStringList names = MusEGlobal::batchRenderTracks.split(',', QString::SkipEmptyParts);
+            for (int i = 0; i < names.size(); ++i) {
+                  MusECore::Track* t = MusEGlobal::song->findTrack(names[i]);
+                  if (!t) {
+                        fprintf(stderr, "MusE: batch render: no track <%s>\n", names[i].toLocal8Bit().constData());
+                        finishBatchRender(1);
+                        return;
+                        }
+                  operations.add(MusECore::PendingOperationItem(t, true, MusECore::PendingOperationItem::SetTrackSolo));
+                  }
+            MusEGlobal::audio->msgExecutePendingOperations(operations, true);
+            }
+
+      const unsigned len = MusEGlobal::song->len();
+      if (len == 0) {
+            fprintf(stderr, "MusE: batch render: the project is empty\n");
+            finishBatchRender(1);
+            return;
+            }
+      MusEGlobal::song->setPos(MusECore::Song::LPOS, MusECore::Pos(0, true));
+      MusEGlobal::song->setPos(MusECore::Song::RPOS, MusECore::Pos(len, true));
+
+      MusECore::SndFile* sf = new MusECore::SndFile(MusEGlobal::batchRenderFile);
+      sf->setFormat(SF_FORMAT_WAV | SF_FORMAT_FLOAT, ao->channels(), MusEGlobal::sampleRate);
+
+      connect(MusEGlobal::song, SIGNAL(playChanged(bool)), SLOT(batchRenderPlayChanged(bool)));
+      if (!startBounceToFile(ao, sf)) {
+            disconnect(MusEGlobal::song, SIGNAL(playChanged(bool)), this, SLOT(batchRenderPlayChanged(bool)));
+            fprintf(stderr, "MusE: batch render: cannot write <%s>\n",
+               MusEGlobal::batchRenderFile.toLocal8Bit().constData());
+            finishBatchRender(1);
+            }
+      }
+
+//---------------------------------------------------------
+//   batchRenderPlayChanged
+//    The bounce file is closed once the transport stops.
+//---------------------------------------------------------
+
+void MusE::batchRenderPlayChanged(bool playing)
+      {
+      if (playing || MusEGlobal::audio->bounce())
+            return;
+      disconnect(MusEGlobal::song, SIGNAL(playChanged(bool)), this, SLOT(batchRenderPlayChanged(bool)));
+      fprintf(stderr, "MusE: batch render: wrote <%s>\n", MusEGlobal::batchRenderFile.toLocal8Bit().constData());
+      // Errors on the way, like a missing plugin, may have left the render incomplete.
+      if (MusEGlobal::batchRenderErrors)
+            fprintf(stderr, "MusE: batch render: %d errors\n", MusEGlobal::batchRenderErrors);
+      finishBatchRender(MusEGlobal::batchRenderErrors ? 1 : 0);
+      }
+
+//---------------------------------------------------------
+//   finishBatchRender
+//    Quits without asking or saving anything, other
+//     instances may be sharing the configuration.
+//---------------------------------------------------------
+
+void MusE::finishBatchRender(int result)
+      {
+      MusEGlobal::song->dirty = false;
+      close();
+      qApp->exit(result);
+      }
+
 //---------------------------------------------------------
 //   checkRegionNotNull
 //    return true if (rPos - lPos) <= 0
@@ -3042,6 +3232,11 @@ void MusE::switchMixerAutomation()
       // Clear all pressed and touched and rec event lists.
       MusEGlobal::song->clearRecAutomation(true);
 
+      // Freeze files were rendered with or without the automation.
+      MusECore::TrackList* tl = MusEGlobal::song->tracks();
+      for (MusECore::iTrack i = tl->begin(); i != tl->end(); ++i)
+            MusEGlobal::song->freezeStale(*i);
+
       // If going to OFF mode, need to update current 'manual' values from the automation values at this time...
       if(!MusEGlobal::automation)
       {
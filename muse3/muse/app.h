@@ -230,6 +230,7 @@ class MusE : public QMainWindow
       // If clear_all is false, it will not touch things like midi ports.
       bool clearSong(bool clear_all = true);
       bool save(const QString&, bool overwriteWarn, bool writeTopwins);
+      bool saveBinary(const QString&, bool overwriteWarn, bool writeTopwins);
       void setUntitledProject();
       void setConfigDefaults();
 
@@ -242,6 +243,8 @@ class MusE : public QMainWindow
       MusECore::PartList* getMidiPartsToEdit();
       MusECore::Part* readPart(MusECore::Xml& xml);
       bool checkRegionNotNull();
+      bool startBounceToFile(MusECore::AudioOutput* ao, MusECore::SndFile* sf);
+      void finishBatchRender(int result);
       void loadProjectFile1(const QString&, bool songTemplate, bool doReadMidiPorts);
       void writeGlobalConfiguration(int level, MusECore::Xml&) const;
       void writeConfiguration(int level, MusECore::Xml&) const;
@@ -342,6 +345,8 @@ class MusE : public QMainWindow
    public slots:
       bool saveAs();
       void bounceToFile(MusECore::AudioOutput* ao = 0);
+      void batchRender();
+      void batchRenderPlayChanged(bool);
       void closeEvent(QCloseEvent*e);
       void loadProjectFile(const QString&);
       void loadProjectFile(const QString&, bool songTemplate, bool doReadMidiPorts);
@@ -832,7 +832,7 @@ void Arranger::songChanged(MusECore::SongChangedStruct_t type)
         // Try these:
         if(type._flags & (SC_PART_INSERTED | SC_PART_REMOVED | SC_PART_MODIFIED |
                    SC_EVENT_INSERTED | SC_EVENT_REMOVED | SC_EVENT_MODIFIED |
-                   SC_CLIP_MODIFIED))
+                   SC_CLIP_MODIFIED | SC_WAVE_PEAKS))
         canvas->redraw();
         
         // We must marshall song changed instead of connecting to the strip's song changed
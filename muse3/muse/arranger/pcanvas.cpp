@@ -990,6 +990,7 @@ bool PartCanvas::mousePress(QMouseEvent* event)
                       NPart* np = (NPart*) item;
                       MusECore::Part*  p = np->part();
                       p->setMute(!p->mute());
+                      MusEGlobal::song->freezeStale(p->track());
                       redraw();
                       break;
                       }
@@ -2841,7 +2842,7 @@ void PartCanvas::viewDropEvent(QDropEvent* event)
                         MusEGlobal::muse->importPartToTrack(text, tick, track);
                         }
             }
-            else if(text.endsWith(".med",Qt::CaseInsensitive))
+            else if(text.endsWith(".med",Qt::CaseInsensitive) || text.endsWith(".medb",Qt::CaseInsensitive))
             {
                 emit dropSongFile(text);
                 break; // we only support ONE drop of this kind
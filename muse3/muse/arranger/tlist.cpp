@@ -1972,6 +1972,16 @@ void TList::mousePressEvent(QMouseEvent* ev)
                            p->addAction(QIcon(*edit_track_delIcon), tr("Delete Selected Tracks"))->setData(1003);
                         }
                         p->addAction(QIcon(*track_commentIcon), tr("Track Comment"))->setData(1002);
+                        if (!t->isMidiTrack() && static_cast<MusECore::AudioTrack*>(t)->canFreeze())
+                        {
+                          MusECore::AudioTrack* at = static_cast<MusECore::AudioTrack*>(t);
+                          QAction* fact = p->addAction(tr("Freeze Track"));
+                          fact->setData(1020);
+                          fact->setCheckable(true);
+                          fact->setChecked(at->frozen());
+                          fact->setEnabled(at->frozen() ||
+                                           (!MusEGlobal::audio->isPlaying() && !at->recordFlag() && !MusEGlobal::song->freezingTrack));
+                        }
                         p->addSeparator();
                         
                         if (t->type()==MusECore::Track::NEW_DRUM)
@@ -2017,6 +2027,16 @@ void TList::mousePressEvent(QMouseEvent* ev)
                                           tc->show();
                                           }
                                           break;
+
+                                    case 1020:     // freeze or unfreeze track
+                                          {
+                                          MusECore::AudioTrack* at = static_cast<MusECore::AudioTrack*>(t);
+                                          if (at->frozen())
+                                                MusEGlobal::song->unfreezeTrack(at);
+                                          else
+                                                MusEGlobal::song->freezeTrack(at);
+                                          }
+                                          break;
                                     
                                     case 1010:
                                       saveTrackDrummap((MusECore::MidiTrack*)t, true);
@@ -36,6 +36,8 @@
 #include "alsamidi.h"
 #include "synth.h"
 #include "audioprefetch.h"
+#include "audio_scheduler.h"
+#include "dspprofiler.h"
 #include "plugin.h"
 #include "audio.h"
 #include "wave.h"
@@ -51,6 +53,7 @@
 #include "undo.h"
 #include "globals.h"
 #include "large_int.h"
+#include "memory.h"
 
 // Experimental for now - allow other Jack timebase masters to control our midi engine.
 // TODO: Be friendly to other apps and ask them to be kind to us by using jack_transport_reposition. 
@@ -112,6 +115,8 @@ const char* seqMsgList[] = {
       "AUDIO_ADD_AC_EVENT",
       "AUDIO_CHANGE_AC_EVENT",
       "AUDIO_SET_SEND_METRONOME", 
+      "AUDIO_SET_LATENCY_COMPENSATION",
+      "AUDIO_SET_FROZEN",
       "AUDIO_START_MIDI_LEARN",
       "MS_PROCESS", "MS_STOP", "MS_SET_RTC", "MS_UPDATE_POLL_FD",
       "SEQM_IDLE", "SEQM_SEEK",
@@ -136,6 +141,8 @@ Audio::Audio()
       idle          = false;
       _freewheel    = false;
       _bounce       = false;
+      _bounceStartFrame = 0;
+      _bounceFrames = 0;
       _loopFrame    = 0;
       _loopCount    = 0;
       m_Xruns       = 0;
@@ -169,7 +176,7 @@ Audio::Audio()
       syncFrame     = 0;
 
       state         = STOP;
-      msg           = 0;
+      _msgsDonePending = 0;
 
       startRecordPos.setType(Pos::FRAMES);  // Tim
       endRecordPos.setType(Pos::FRAMES);
@@ -592,18 +599,14 @@ void Audio::shutdown()
 
 void Audio::process(unsigned frames)
       {
+      // No heap allocations from here on, see RTArena.
+      RTArenaScope rtScope;
       _curCycleFrames = frames;
       if (!MusEGlobal::checkAudioDevice()) return;
-      if (msg) {
-            processMsg(msg);
-            int sn = msg->serialNo;
-            msg    = 0;    // don't process again
-            int rv = write(fromThreadFdw, &sn, sizeof(int));
-            if (rv != sizeof(int)) {
-                  fprintf(stderr, "audio: write(%d) pipe failed: %s\n",
-                     fromThreadFdw, strerror(errno));
-                  }
-            }
+      if (MusEGlobal::dspProfiler)
+            MusEGlobal::dspProfiler->beginCycle();
+      DspProfileScope profile(this, DspProfiler::CYCLE);
+      processMsgs();
 
       OutputList* ol = MusEGlobal::song->outputs();
       if (idle) {
@@ -628,8 +631,10 @@ void Audio::process(unsigned frames)
             _loopCount = 0;
             MusEGlobal::song->reenableTouchedControllers();
             startRolling();
-            if (_bounce)
+            if (_bounce) {
+                  _bounceStartFrame = _pos.frame();
                   write(sigFd, "f", 1);
+                  }
             }
       else if (state == LOOP2 && jackState == PLAY) {
             ++_loopCount;                  // Number of times we have looped so far
@@ -728,10 +733,14 @@ void Audio::process(unsigned frames)
       
       if (isPlaying()) {
             if (!freewheel())
-                  MusEGlobal::audioPrefetch->msgTick(isRecording(), true);
+                  MusEGlobal::audioPrefetch->msgTick(isRecording() || MusEGlobal::song->freezingTrack, true);
+            // The freeze file is written by the prefetch thread even when freewheeling.
+            else if (MusEGlobal::song->freezingTrack)
+                  MusEGlobal::audioPrefetch->msgTick(true, false);
 
             if (_bounce && _pos >= MusEGlobal::song->rPos()) {
                   _bounce = false;
+                  _bounceFrames = _pos.frame() - _bounceStartFrame;
                   write(sigFd, "F", 1);
                   return;
                   }
@@ -845,7 +854,10 @@ void Audio::process(unsigned frames)
 
 void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
       {
-      processMidi(frames);
+      {
+            DspProfileScope profile(this, DspProfiler::MIDI);
+            processMidi(frames);
+      }
 
       //
       // process not connected tracks
@@ -877,8 +889,13 @@ void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
       // Pre-process the metronome.
       ((AudioTrack*)metronome)->preProcessAlways();
       
+      // If enabled, process the whole track graph in parallel, outputs included.
+      // The serial passes below then only have to pick up anything it left.
+      const bool scheduled = MusEGlobal::audioScheduler &&
+                             MusEGlobal::audioScheduler->process(samplePos, offset, frames);
+      
       // Process Aux tracks first.
-      for(ciTrack it = tl->begin(); it != tl->end(); ++it)
+      for(ciTrack it = tl->begin(); !scheduled && it != tl->end(); ++it)
       {
         if((*it)->isMidiTrack())
           continue;
@@ -898,8 +915,11 @@ void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
       }
       
       OutputList* ol = MusEGlobal::song->outputs();
-      for (ciAudioOutput i = ol->begin(); i != ol->end(); ++i) 
-        (*i)->process(samplePos, offset, frames);
+      if(!scheduled)
+      {
+        for (ciAudioOutput i = ol->begin(); i != ol->end(); ++i) 
+          (*i)->process(samplePos, offset, frames);
+      }
             
       // Were ANY tracks unprocessed as a result of processing all the AudioOutputs, above? 
       // Not just unconnected ones, as previously done, but ones whose output path ultimately leads nowhere.
@@ -927,6 +947,36 @@ void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
       }      
     }
 
+//---------------------------------------------------------
+//   processMsgs
+//    Processes the queued messages, up to MAX_MSGS_PER_CYCLE
+//     of them so a flood cannot take the whole cycle.
+//---------------------------------------------------------
+
+void Audio::processMsgs()
+      {
+      const int MAX_MSGS_PER_CYCLE = 256;
+      bool done = false;
+      AudioMsgQueue::Item item;
+      for (int n = 0; n < MAX_MSGS_PER_CYCLE && _msgQueue.get(&item); ++n) {
+            processMsg(item.msg);
+            if (item.serialNo >= 0) {
+                  int sn = item.serialNo;
+                  int rv = write(fromThreadFdw, &sn, sizeof(int));
+                  if (rv != sizeof(int)) {
+                        fprintf(stderr, "audio: write(%d) pipe failed: %s\n",
+                           fromThreadFdw, strerror(errno));
+                        }
+                  }
+            if (item.done) {
+                  _msgDoneQueue.put(item);
+                  done = true;
+                  }
+            }
+      if (done)
+            sendMsgToGui('Q');
+      }
+
 //---------------------------------------------------------
 //   processMsg
 //---------------------------------------------------------
@@ -936,12 +986,18 @@ void Audio::processMsg(AudioMsg* msg)
       switch(msg->id) {
             case AUDIO_ROUTEADD:
                   addRoute(msg->sroute, msg->droute);
+                  if(MusEGlobal::audioScheduler)
+                    MusEGlobal::audioScheduler->invalidate();
                   break;
             case AUDIO_ROUTEREMOVE:
                   removeRoute(msg->sroute, msg->droute);
+                  if(MusEGlobal::audioScheduler)
+                    MusEGlobal::audioScheduler->invalidate();
                   break;
             case AUDIO_REMOVEROUTES:      
                   removeAllRoutes(msg->sroute, msg->droute);
+                  if(MusEGlobal::audioScheduler)
+                    MusEGlobal::audioScheduler->invalidate();
                   break;
             case SEQM_SET_AUX:
                   msg->snode->setAuxSend(msg->ival, msg->dval);
@@ -984,6 +1040,19 @@ void Audio::processMsg(AudioMsg* msg)
                   msg->snode->setSendMetronome((bool)msg->ival);
                   break;
             
+            case AUDIO_SET_LATENCY_COMPENSATION:
+                  // p1 is a new compensator or null to keep the current one. The replaced one
+                  //  is handed back in p2 for the gui thread to delete.
+                  msg->p2 = msg->snode->setLatencyCompensation(
+                              msg->p1 ? (LatencyCompensator*)msg->p1 : msg->snode->latencyCompensator(), msg->a, msg->b);
+                  break;
+            
+            case AUDIO_SET_FROZEN:
+                  msg->snode->setFrozen((bool)msg->ival);
+                  // Refill the prefetch fifos with or without the freeze file.
+                  MusEGlobal::audioPrefetch->msgSeek(_pos.frame(), true);
+                  break;
+            
             case AUDIO_START_MIDI_LEARN:
                   // Reset the values. The engine will fill these from driver events.
                   MusEGlobal::midiLearnPort = -1;
@@ -1133,6 +1202,10 @@ void Audio::writeTick()
             if (track->recordFlag())
                   track->record();
             }
+      // Read once, the gui clears it when the freeze is finished.
+      AudioTrack* freezing = MusEGlobal::song->freezingTrack;
+      if (freezing)
+            freezing->flushFreezeFifo();
       }
 
 //---------------------------------------------------------
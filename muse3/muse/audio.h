@@ -26,6 +26,7 @@
 #define __AUDIO_H__
 
 #include <stdint.h>
+#include <atomic>
 
 #include "type_defs.h"
 #include "thread.h"
@@ -33,6 +34,7 @@
 #include "mpevent.h"
 #include "route.h"
 #include "event.h"
+#include "audio_msg_queue.h"
 
 // An experiment to use true frames for time-stamping all recorded input. 
 // (All recorded data actually arrived in the previous period.)
@@ -43,6 +45,7 @@
 namespace MusECore {
 class AudioDevice;
 class AudioTrack;
+class LatencyCompensator;
 class Event;
 class Event;
 class EventList;
@@ -88,6 +91,8 @@ enum {
       AUDIO_ADD_AC_EVENT,
       AUDIO_CHANGE_AC_EVENT,
       AUDIO_SET_SEND_METRONOME,
+      AUDIO_SET_LATENCY_COMPENSATION,
+      AUDIO_SET_FROZEN,
       AUDIO_START_MIDI_LEARN,
       MS_PROCESS, MS_STOP, MS_SET_RTC, MS_UPDATE_POLL_FD,
       SEQM_IDLE, SEQM_SEEK,
@@ -139,6 +144,8 @@ class Audio {
       bool idle;              // do nothing in idle mode
       bool _freewheel;
       bool _bounce;
+      unsigned _bounceStartFrame;  // Where the bounce started rolling,
+      unsigned _bounceFrames;      //  and how many frames it rendered. Valid once 'F' is sent.
       unsigned _loopFrame;     // Startframe of loop if in LOOP mode. Not quite the same as left marker !
       int _loopCount;         // Number of times we have looped so far
 
@@ -186,7 +193,9 @@ class Audio {
 
       State state;
 
-      AudioMsg* msg;
+      AudioMsgQueue _msgQueue;           // Messages to the audio thread.
+      AudioMsgQueue _msgDoneQueue;       // Processed messages with a done function, back to the gui.
+      std::atomic<unsigned> _msgsDonePending;
       int fromThreadFdw, fromThreadFdr;  // message pipe
 
       int sigFd;              // pipe fd for messages to gui
@@ -210,6 +219,8 @@ class Audio {
 
       void panic();
       void processMsg(AudioMsg* msg);
+      void processMsgs();
+      void putMsg(const AudioMsgQueue::Item& item);
       void process1(unsigned samplePos, unsigned offset, unsigned samples);
 
       void collectEvents(MidiTrack*, unsigned int startTick, unsigned int endTick, unsigned int frames);
@@ -295,6 +306,12 @@ class Audio {
       void msgPanic();
       void sendMsg(AudioMsg*);
       bool sendMessage(AudioMsg* m, bool doUndo);
+      // Queues a message without waiting for it. It must stay valid until done is called.
+      void postMsg(AudioMsg*, AudioMsgDoneFunc done = 0, void* arg = 0);
+      // Calls the done functions of processed posted messages. Gui thread.
+      void processMsgsDone();
+      // True while posted messages wait to be processed, or for their done function.
+      bool postedMsgsPending() const { return _msgsDonePending.load() != 0; }
       void msgRemoveRoute(Route, Route);
       void msgRemoveRoute1(Route, Route); 
       void msgAddRoute(Route, Route);
@@ -320,6 +337,8 @@ class Audio {
       void msgSetHwCtrlStates(MidiPort*, int, int, int, int);
       void msgSetTrackAutomationType(Track*, int);
       void msgSetSendMetronome(AudioTrack*, bool);
+      void msgSetLatencyCompensation(AudioTrack*, LatencyCompensator*, unsigned long sendDelay, unsigned long outDelay);
+      void msgSetFrozen(AudioTrack*, bool);
       void msgStartMidiLearn();
       void msgPlayMidiEvent(const MidiPlayEvent* event);
       void msgSetMidiDevice(MidiPort* port, MidiDevice* device);
@@ -373,6 +392,7 @@ class Audio {
 
       void sendMsgToGui(char c);
       bool bounce() const { return _bounce; }
+      unsigned bounceFrames() const { return _bounceFrames; }
 
       long getXruns() { return m_Xruns; }
       void resetXruns() { m_Xruns = 0; }
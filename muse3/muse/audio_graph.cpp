@@ -0,0 +1,408 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_graph.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_graph.h"
+
+namespace MusECore {
+
+static uint64_t nowUS()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return uint64_t(t.tv_sec) * 1000000ULL + t.tv_nsec / 1000;
+      }
+
+static void semWait(sem_t* s)
+      {
+      while(sem_wait(s) == -1 && errno == EINTR)
+        ;
+      }
+
+//---------------------------------------------------------
+//   AudioGraph
+//---------------------------------------------------------
+
+AudioGraph::AudioGraph(unsigned serial)
+      {
+      _pending = 0;
+      _queue   = 0;
+      _serial  = serial;
+      _acyclic = false;
+      }
+
+AudioGraph::~AudioGraph()
+      {
+      delete[] _pending;
+      delete[] _queue;
+      }
+
+int AudioGraph::addNode(void* user)
+      {
+      Node nd;
+      nd.user      = user;
+      nd.deps      = 0;
+      nd.succStart = 0;
+      nd.succEnd   = 0;
+      _nodes.push_back(nd);
+      return _nodes.size() - 1;
+      }
+
+void AudioGraph::addEdge(int from, int to)
+      {
+      _edgeSrc.push_back(from);
+      _edgeDst.push_back(to);
+      }
+
+//---------------------------------------------------------
+//   finish
+//---------------------------------------------------------
+
+bool AudioGraph::finish()
+      {
+      const int n = _nodes.size();
+
+      // Lay the successor lists out flat, grouped by source node.
+      const int edges = _edgeSrc.size();
+      for(int e = 0; e < edges; ++e)
+      {
+        ++_nodes[_edgeSrc[e]].succEnd;
+        ++_nodes[_edgeDst[e]].deps;
+      }
+      int start = 0;
+      for(int i = 0; i < n; ++i)
+      {
+        const int cnt = _nodes[i].succEnd;
+        _nodes[i].succStart = start;
+        _nodes[i].succEnd   = start;
+        start += cnt;
+      }
+      _succ.resize(edges);
+      for(int e = 0; e < edges; ++e)
+        _succ[_nodes[_edgeSrc[e]].succEnd++] = _edgeDst[e];
+      std::vector<int>().swap(_edgeSrc);
+      std::vector<int>().swap(_edgeDst);
+
+      _pending = new std::atomic<int>[n > 0 ? n : 1];
+      _queue   = new std::atomic<int>[n > 0 ? n : 1];
+
+      // Topological sort, to make sure there are no cycles before handing
+      //  the graph to the workers, which would otherwise wait forever.
+      std::vector<int> left(n);
+      std::vector<int> order;
+      order.reserve(n);
+      for(int i = 0; i < n; ++i)
+      {
+        left[i] = _nodes[i].deps;
+        if(left[i] == 0)
+          order.push_back(i);
+      }
+      for(unsigned o = 0; o < order.size(); ++o)
+      {
+        const Node& nd = _nodes[order[o]];
+        for(int s = nd.succStart; s < nd.succEnd; ++s)
+        {
+          if(--left[_succ[s]] == 0)
+            order.push_back(_succ[s]);
+        }
+      }
+      _acyclic = (int)order.size() == n;
+      return _acyclic;
+      }
+
+//---------------------------------------------------------
+//   AudioGraphPool
+//---------------------------------------------------------
+
+AudioGraphPool::AudioGraphPool()
+      {
+      _threads       = 0;
+      _workers       = 0;
+      _threadCount   = 0;
+      _running       = false;
+      _graph         = 0;
+      _qHead         = 0;
+      _qLow          = 0;
+      _done          = 0;
+      _scratch       = 0;
+      _scratchFloats = 0;
+      sem_init(&_startSem, 0, 0);
+      sem_init(&_doneSem, 0, 0);
+      sem_init(&_readySem, 0, 0);
+      resetStats();
+      }
+
+AudioGraphPool::~AudioGraphPool()
+      {
+      // Derived classes must have stopped the pool, their processNode() being gone.
+      stop();
+      sem_destroy(&_startSem);
+      sem_destroy(&_doneSem);
+      sem_destroy(&_readySem);
+      delete[] _scratch;
+      }
+
+//---------------------------------------------------------
+//   resetStats
+//---------------------------------------------------------
+
+void AudioGraphPool::resetStats()
+      {
+      _cycles       = 0;
+      _lastCycleUS  = 0;
+      _maxCycleUS   = 0;
+      _totalCycleUS = 0;
+      }
+
+//---------------------------------------------------------
+//   start
+//---------------------------------------------------------
+
+void AudioGraphPool::start(int threads, int priority, size_t scratchFloats)
+      {
+      stop();
+
+      if(threads <= 0)
+      {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+      }
+      if(threads > MAX_AUDIO_WORKER_THREADS)
+        threads = MAX_AUDIO_WORKER_THREADS;
+
+      resetStats();
+      // The caller of run() does its share of the work, so it is not counted here.
+      if(threads <= 1)
+        return;
+
+      delete[] _scratch;
+      _scratchFloats = scratchFloats;
+      _scratch = new float[threads * scratchFloats];
+      memset(_scratch, 0, threads * scratchFloats * sizeof(float));
+
+      _running = true;
+      _threads = new pthread_t[threads - 1];
+      _workers = new Worker[threads - 1];
+      for(int i = 0; i < threads - 1; ++i)
+      {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        const bool rt = priority > 0;
+        if(rt)
+        {
+          struct sched_param rt_param;
+          memset(&rt_param, 0, sizeof(rt_param));
+          rt_param.sched_priority = priority;
+          if(pthread_attr_setschedpolicy(&attributes, SCHED_FIFO) ||
+             pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED) ||
+             pthread_attr_setschedparam(&attributes, &rt_param))
+            fprintf(stderr, "AudioGraphPool: cannot set realtime priority %d for worker thread\n", priority);
+        }
+
+        _workers[_threadCount].pool  = this;
+        _workers[_threadCount].index = _threadCount + 1;
+        int rv = pthread_create(&_threads[_threadCount], &attributes, workerThread, &_workers[_threadCount]);
+        // Same as Thread::start(): Try again without realtime attributes if that failed.
+        if(rv && rt)
+          rv = pthread_create(&_threads[_threadCount], NULL, workerThread, &_workers[_threadCount]);
+        pthread_attr_destroy(&attributes);
+
+        if(rv)
+        {
+          fprintf(stderr, "AudioGraphPool: creating worker thread failed: %s\n", strerror(rv));
+          break;
+        }
+        ++_threadCount;
+      }
+      }
+
+//---------------------------------------------------------
+//   stop
+//---------------------------------------------------------
+
+void AudioGraphPool::stop()
+      {
+      if(!_threads)
+        return;
+
+      _running = false;
+      for(int i = 0; i < _threadCount; ++i)
+        sem_post(&_startSem);
+      for(int i = 0; i < _threadCount; ++i)
+        pthread_join(_threads[i], 0);
+      delete[] _threads;
+      delete[] _workers;
+      _threads = 0;
+      _workers = 0;
+      _threadCount = 0;
+      }
+
+//---------------------------------------------------------
+//   workerThread
+//---------------------------------------------------------
+
+void* AudioGraphPool::workerThread(void* arg)
+      {
+      Worker* w = (Worker*)arg;
+      w->pool->workerMain(w->index);
+      return 0;
+      }
+
+void AudioGraphPool::workerMain(int worker)
+      {
+      for(;;)
+      {
+        semWait(&_startSem);
+        if(!_running)
+          break;
+        runJobs(worker);
+        sem_post(&_doneSem);
+      }
+      }
+
+//---------------------------------------------------------
+//   push
+//    Put a node whose inputs are all done on the ready
+//     queue, and wake one thread for it.
+//---------------------------------------------------------
+
+void AudioGraphPool::push(int node)
+      {
+      const int slot = _qHead.fetch_add(1, std::memory_order_relaxed);
+      _graph->_queue[slot].store(node, std::memory_order_release);
+      sem_post(&_readySem);
+      }
+
+//---------------------------------------------------------
+//   take
+//    Called after getting a count from _readySem. Each
+//     count was posted after its node was stored, and each
+//     node taken used up one count, so there is always a
+//     stored node left to take. This never waits on a
+//     slot, it just looks again if another thread was
+//     quicker.
+//---------------------------------------------------------
+
+int AudioGraphPool::take()
+      {
+      std::atomic<int>* q = _graph->_queue;
+      const int n = _graph->count();
+      for(;;)
+      {
+        const int low = _qLow.load(std::memory_order_relaxed);
+        for(int i = low; i < n; ++i)
+        {
+          int node = q[i].load(std::memory_order_acquire);
+          if(node >= 0 && q[i].compare_exchange_strong(node, -2, std::memory_order_acq_rel))
+          {
+            int expect = i;
+            _qLow.compare_exchange_strong(expect, i + 1, std::memory_order_relaxed);
+            return node;
+          }
+        }
+      }
+      }
+
+//---------------------------------------------------------
+//   runJobs
+//---------------------------------------------------------
+
+void AudioGraphPool::runJobs(int worker)
+      {
+      AudioGraph* g = _graph;
+      const int n = g->count();
+      for(;;)
+      {
+        semWait(&_readySem);
+        // Once all nodes are done, the counts left are the wakeups to quit.
+        if(_done.load(std::memory_order_acquire) == n)
+          break;
+
+        const int node = take();
+        processNode(g->_nodes[node].user, worker);
+
+        const AudioGraph::Node& nd = g->_nodes[node];
+        for(int s = nd.succStart; s < nd.succEnd; ++s)
+        {
+          const int succ = g->_succ[s];
+          if(g->_pending[succ].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            push(succ);
+        }
+
+        if(_done.fetch_add(1, std::memory_order_acq_rel) + 1 == n)
+        {
+          for(int i = 0; i <= _threadCount; ++i)
+            sem_post(&_readySem);
+        }
+      }
+      }
+
+//---------------------------------------------------------
+//   run
+//---------------------------------------------------------
+
+void AudioGraphPool::run(AudioGraph* graph)
+      {
+      const int n = graph->count();
+      if(n == 0)
+        return;
+
+      const uint64_t t0 = nowUS();
+
+      _graph = graph;
+      _qHead.store(0, std::memory_order_relaxed);
+      _qLow.store(0, std::memory_order_relaxed);
+      _done.store(0, std::memory_order_relaxed);
+      for(int i = 0; i < n; ++i)
+      {
+        graph->_queue[i].store(-1, std::memory_order_relaxed);
+        graph->_pending[i].store(graph->_nodes[i].deps, std::memory_order_relaxed);
+      }
+      for(int i = 0; i < n; ++i)
+        if(graph->_nodes[i].deps == 0)
+          push(i);
+
+      // Posting the semaphores publishes all of the above to the workers.
+      for(int i = 0; i < _threadCount; ++i)
+        sem_post(&_startSem);
+
+      runJobs(0);
+
+      // Join. Other threads may still be on their way out of runJobs().
+      for(int i = 0; i < _threadCount; ++i)
+        semWait(&_doneSem);
+
+      _lastCycleUS = nowUS() - t0;
+      if(_lastCycleUS > _maxCycleUS)
+        _maxCycleUS = _lastCycleUS;
+      _totalCycleUS += _lastCycleUS;
+      ++_cycles;
+      }
+
+} // namespace MusECore
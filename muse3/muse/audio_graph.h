@@ -0,0 +1,165 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_graph.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __AUDIO_GRAPH_H__
+#define __AUDIO_GRAPH_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace MusECore {
+
+// Upper limit for the configurable number of audio processing threads.
+const int MAX_AUDIO_WORKER_THREADS = 64;
+
+//---------------------------------------------------------
+//   AudioGraph
+//    A dependency graph of processing nodes. It is built
+//     and checked outside the audio thread, with everything
+//     a cycle needs allocated up front, and is not changed
+//     afterwards except for the per cycle counters.
+//---------------------------------------------------------
+
+class AudioGraph {
+      friend class AudioGraphPool;
+
+      struct Node {
+            void* user;
+            int deps;                // Number of nodes this one waits for.
+            int succStart;           // Index of first successor in _succ.
+            int succEnd;
+            };
+
+      std::vector<Node> _nodes;
+      std::vector<int> _succ;
+      std::vector<int> _edgeSrc;     // Only while building.
+      std::vector<int> _edgeDst;
+      std::atomic<int>* _pending;    // Per node remaining dependencies.
+      std::atomic<int>* _queue;      // Ready nodes. -1 not yet pushed, -2 taken.
+      unsigned _serial;
+      bool _acyclic;
+
+      AudioGraph(const AudioGraph&);
+      void operator=(const AudioGraph&);
+
+   public:
+      explicit AudioGraph(unsigned serial = 0);
+      ~AudioGraph();
+
+      int addNode(void* user);
+      void addEdge(int from, int to);
+      // Lays the graph out for running. Returns false if it has a cycle.
+      bool finish();
+
+      int count() const        { return _nodes.size(); }
+      int edges() const        { return _succ.size(); }
+      void* user(int i) const  { return _nodes[i].user; }
+      unsigned serial() const  { return _serial; }
+      bool acyclic() const     { return _acyclic; }
+      };
+
+//---------------------------------------------------------
+//   AudioGraphPool
+//    Runs an AudioGraph on a pool of worker threads, the
+//     thread calling run() being one of them.
+//    Nodes whose inputs are all done go on a ready queue,
+//     and a semaphore counts them. A thread waiting for
+//     work sleeps on it instead of spinning, so a worker
+//     never keeps a lower priority thread on the same core
+//     from finishing the node it waits for.
+//    Each thread has its own scratch buffer.
+//---------------------------------------------------------
+
+class AudioGraphPool {
+      struct Worker {
+            AudioGraphPool* pool;
+            int index;
+            };
+
+      pthread_t* _threads;
+      Worker* _workers;
+      int _threadCount;              // Worker threads, not counting the caller of run().
+      volatile bool _running;
+      sem_t _startSem;
+      sem_t _doneSem;
+      sem_t _readySem;               // Ready nodes, then one wakeup each when all are done.
+
+      AudioGraph* _graph;            // The graph being run.
+      std::atomic<int> _qHead;
+      std::atomic<int> _qLow;        // All slots below are taken.
+      std::atomic<int> _done;
+
+      float* _scratch;
+      size_t _scratchFloats;         // Per thread.
+
+      // Statistics, written by the thread calling run() only.
+      uint64_t _cycles;
+      uint64_t _lastCycleUS;
+      uint64_t _maxCycleUS;
+      uint64_t _totalCycleUS;
+
+      void push(int node);
+      int take();
+      void runJobs(int worker);
+      static void* workerThread(void*);
+
+   protected:
+      // Called by any of the threads, with its index. 0 is the caller of run().
+      virtual void processNode(void* user, int worker) = 0;
+      // The body of a worker thread. Overrides must call the base.
+      virtual void workerMain(int worker);
+
+   public:
+      AudioGraphPool();
+      virtual ~AudioGraphPool();
+
+      // Starts the worker pool. The calling thread counts as one of 'threads',
+      //  so 'threads' <= 1 means serial processing. Zero means one per CPU.
+      // Priority > 0 asks for SCHED_FIFO. Each thread gets a scratch
+      //  buffer of scratchFloats.
+      void start(int threads, int priority, size_t scratchFloats);
+      // Must not be called while run() is going on.
+      void stop();
+      bool isRunning() const { return _running && _threadCount > 0; }
+      int threads() const { return _threadCount + 1; }
+
+      float* scratch(int worker) const { return _scratch + worker * _scratchFloats; }
+      size_t scratchFloats() const     { return _scratchFloats; }
+
+      // Processes every node of the graph once. Realtime safe.
+      void run(AudioGraph* graph);
+
+      uint64_t cycles() const       { return _cycles; }
+      uint64_t lastCycleUS() const  { return _lastCycleUS; }
+      uint64_t maxCycleUS() const   { return _maxCycleUS; }
+      uint64_t avgCycleUS() const   { return _cycles ? _totalCycleUS / _cycles : 0; }
+      void resetStats();
+      };
+
+} // namespace MusECore
+
+#endif
@@ -0,0 +1,75 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_msg_queue.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include "audio_msg_queue.h"
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   AudioMsgQueue
+//    Each cell's sequence number tells whose turn it is:
+//     equal to the position when free for the putter of
+//     that position, one more when filled for the getter.
+//---------------------------------------------------------
+
+AudioMsgQueue::AudioMsgQueue()
+      {
+      for (unsigned i = 0; i < SIZE; ++i)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+      _head.store(0, std::memory_order_relaxed);
+      _tail = 0;
+      }
+
+bool AudioMsgQueue::put(const Item& item)
+      {
+      unsigned pos = _head.load(std::memory_order_relaxed);
+      Cell* c;
+      for (;;) {
+            c = &_cells[pos & (SIZE - 1)];
+            const int dif = int(c->seq.load(std::memory_order_acquire) - pos);
+            if (dif == 0) {
+                  if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                  }
+            else if (dif < 0)
+                  return false;
+            else
+                  pos = _head.load(std::memory_order_relaxed);
+            }
+      c->item = item;
+      c->seq.store(pos + 1, std::memory_order_release);
+      return true;
+      }
+
+bool AudioMsgQueue::get(Item* item)
+      {
+      Cell* c = &_cells[_tail & (SIZE - 1)];
+      if (int(c->seq.load(std::memory_order_acquire) - (_tail + 1)) < 0)
+            return false;
+      *item = c->item;
+      c->seq.store(_tail + SIZE, std::memory_order_release);
+      ++_tail;
+      return true;
+      }
+
+} // namespace MusECore
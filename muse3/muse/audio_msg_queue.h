@@ -0,0 +1,72 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_msg_queue.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __AUDIO_MSG_QUEUE_H__
+#define __AUDIO_MSG_QUEUE_H__
+
+#include <atomic>
+
+namespace MusECore {
+
+struct AudioMsg;
+
+// Called in the gui thread once a posted message has been processed.
+typedef void (*AudioMsgDoneFunc)(AudioMsg* msg, void* arg);
+
+//---------------------------------------------------------
+//   AudioMsgQueue
+//    Bounded lock-free queue of messages for the audio
+//     thread. Any number of threads may put() at the same
+//     time, only one thread may get(). Items come out in
+//     the order they were put.
+//---------------------------------------------------------
+
+class AudioMsgQueue {
+   public:
+      struct Item {
+            AudioMsg* msg;
+            AudioMsgDoneFunc done;
+            void* arg;
+            int serialNo;            // Written back to the waiting sender, -1 if none.
+            };
+      static const unsigned SIZE = 1024;   // Power of two.
+
+   private:
+      struct Cell {
+            std::atomic<unsigned> seq;
+            Item item;
+            };
+      Cell _cells[SIZE];
+      std::atomic<unsigned> _head;       // Next cell to put.
+      unsigned _tail;                    // Next cell to get.
+
+   public:
+      AudioMsgQueue();
+      // Returns false if the queue is full.
+      bool put(const Item& item);
+      bool get(Item* item);
+      };
+
+} // namespace MusECore
+
+#endif
@@ -0,0 +1,255 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_scheduler.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <map>
+
+#include "audio_scheduler.h"
+#include "globals.h"
+#include "song.h"
+#include "track.h"
+#include "route.h"
+#include "memory.h"
+
+// Turn on debugging messages
+//#define AUDIO_SCHEDULER_DEBUG
+
+namespace MusEGlobal {
+MusECore::AudioScheduler* audioScheduler = NULL;
+}
+
+namespace MusECore {
+
+void initAudioScheduler()
+{
+  MusEGlobal::audioScheduler = new AudioScheduler();
+}
+
+//---------------------------------------------------------
+//   AudioScheduler
+//---------------------------------------------------------
+
+AudioScheduler::AudioScheduler()
+      {
+      _serial        = 1;
+      _builtSerial   = 0;
+      _cycleReported = false;
+      _graph         = 0;
+      _next          = 0;
+      _retired       = 0;
+      _pos           = 0;
+      _offset        = 0;
+      _frames        = 0;
+      }
+
+AudioScheduler::~AudioScheduler()
+      {
+      stop();
+      delete _graph;
+      delete _next.load();
+      delete _retired.load();
+      }
+
+//---------------------------------------------------------
+//   start
+//---------------------------------------------------------
+
+void AudioScheduler::start(int threads, int priority)
+      {
+      // Room for one track's channels per thread. Bigger periods are processed serially.
+      AudioGraphPool::start(threads, MusEGlobal::realTimeScheduling ? priority : 0,
+                            MAX_CHANNELS * MusEGlobal::segmentSize);
+
+      if(MusEGlobal::debugMsg)
+        fprintf(stderr, "AudioScheduler: started %d worker threads, priority:%d\n", this->threads() - 1, priority);
+      }
+
+//---------------------------------------------------------
+//   stop
+//    Must not be called while the audio thread is processing.
+//---------------------------------------------------------
+
+void AudioScheduler::stop()
+      {
+      if(MusEGlobal::debugMsg && isRunning() && cycles())
+        fprintf(stderr, "AudioScheduler: %d threads, %lu cycles, DSP time per cycle avg:%luus max:%luus\n",
+                threads(), (unsigned long)cycles(), (unsigned long)avgCycleUS(), (unsigned long)maxCycleUS());
+      AudioGraphPool::stop();
+      }
+
+//---------------------------------------------------------
+//   workerMain
+//---------------------------------------------------------
+
+void AudioScheduler::workerMain(int worker)
+      {
+      RTArenaScope rtScope;
+      AudioGraphPool::workerMain(worker);
+      }
+
+//---------------------------------------------------------
+//   build
+//    Gui thread. Builds the dependency graph from the
+//     current tracks and routes.
+//---------------------------------------------------------
+
+AudioGraph* AudioScheduler::build(unsigned serial) const
+      {
+      TrackList* tl = MusEGlobal::song->tracks();
+      AudioGraph* g = new AudioGraph(serial);
+
+      std::map<const Track*, int> index;
+      std::vector<int> auxs;
+      std::vector<int> auxSenders;
+      for(ciTrack it = tl->begin(); it != tl->end(); ++it)
+      {
+        if((*it)->isMidiTrack())
+          continue;
+        AudioTrack* track = static_cast<AudioTrack*>(*it);
+        const int i = g->addNode(track);
+        index[track] = i;
+        if(track->type() == Track::AUDIO_AUX)
+          auxs.push_back(i);
+        if(track->hasAuxSend() && !track->auxRefCount())
+          auxSenders.push_back(i);
+      }
+
+      for(std::map<const Track*, int>::const_iterator it = index.begin(); it != index.end(); ++it)
+      {
+        const RouteList* rl = static_cast<const AudioTrack*>(it->first)->inRoutes();
+        for(ciRoute ir = rl->begin(); ir != rl->end(); ++ir)
+        {
+          if(ir->type != Route::TRACK_ROUTE || !ir->track || ir->track->isMidiTrack())
+            continue;
+          std::map<const Track*, int>::const_iterator src = index.find(ir->track);
+          if(src == index.end() || src->second == it->second)
+            continue;
+          g->addEdge(src->second, it->second);
+        }
+      }
+
+      // Aux tracks gather from all aux-sending tracks, see AudioAux::getData().
+      for(unsigned a = 0; a < auxs.size(); ++a)
+        for(unsigned s = 0; s < auxSenders.size(); ++s)
+          if(auxSenders[s] != auxs[a])
+            g->addEdge(auxSenders[s], auxs[a]);
+
+      g->finish();
+      return g;
+      }
+
+//---------------------------------------------------------
+//   update
+//    Gui thread.
+//---------------------------------------------------------
+
+void AudioScheduler::update()
+      {
+      delete _retired.exchange(0, std::memory_order_acq_rel);
+
+      const unsigned serial = _serial.load(std::memory_order_acquire);
+      if(serial == _builtSerial)
+        return;
+      _builtSerial = serial;
+
+      AudioGraph* g = build(serial);
+      if(!g->acyclic())
+      {
+        if(!_cycleReported)
+          fprintf(stderr, "AudioScheduler: route graph has a cycle, processing serially\n");
+        _cycleReported = true;
+      }
+      else
+        _cycleReported = false;
+
+      #ifdef AUDIO_SCHEDULER_DEBUG
+      fprintf(stderr, "AudioScheduler::update serial:%u nodes:%d edges:%d\n", serial, g->count(), g->edges());
+      #endif
+
+      // If the audio thread did not take the last one yet, it never will.
+      delete _next.exchange(g, std::memory_order_acq_rel);
+      }
+
+//---------------------------------------------------------
+//   processNode
+//---------------------------------------------------------
+
+void AudioScheduler::processNode(void* user, int worker)
+      {
+      AudioTrack* track = (AudioTrack*)user;
+
+      #ifdef AUDIO_SCHEDULER_DEBUG
+      fprintf(stderr, "AudioScheduler::processNode track:%s processed:%d\n", track->name().toLatin1().constData(), track->processed());
+      #endif
+
+      if(track->processed())
+        return;
+
+      if(track->type() == Track::AUDIO_OUTPUT)
+      {
+        static_cast<AudioOutput*>(track)->process(_pos, _offset, _frames);
+        return;
+      }
+
+      const int channels = track->channels();
+      // Just a dummy buffer. The data is cached in the track's outBuffers for whoever pulls it.
+      float* buffer[MAX_CHANNELS];
+      float* data = scratch(worker);
+      for(int i = 0; i < channels; ++i)
+        buffer[i] = data + i * _frames;
+      track->copyData(_pos, -1, channels, channels, -1, -1, _frames, buffer);
+      }
+
+//---------------------------------------------------------
+//   process
+//    Called from the audio thread after all tracks' preProcessAlways().
+//---------------------------------------------------------
+
+bool AudioScheduler::process(unsigned pos, unsigned offset, unsigned frames)
+      {
+      if(!isRunning())
+        return false;
+
+      // The replaced graph must be freed before another one can be taken.
+      if(!_retired.load(std::memory_order_acquire))
+      {
+        AudioGraph* g = _next.exchange(0, std::memory_order_acq_rel);
+        if(g)
+        {
+          _retired.store(_graph, std::memory_order_release);
+          _graph = g;
+        }
+      }
+
+      if(!_graph || _graph->serial() != _serial.load(std::memory_order_acquire) ||
+         !_graph->acyclic() || _graph->count() == 0 || frames * MAX_CHANNELS > scratchFloats())
+        return false;
+
+      _pos    = pos;
+      _offset = offset;
+      _frames = frames;
+      run(_graph);
+      return true;
+      }
+
+} // namespace MusECore
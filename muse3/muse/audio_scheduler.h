@@ -0,0 +1,97 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_scheduler.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __AUDIO_SCHEDULER_H__
+#define __AUDIO_SCHEDULER_H__
+
+#include <atomic>
+
+#include "audio_graph.h"
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   AudioScheduler
+//    Processes the audio track graph in parallel.
+//    The audio tracks are sorted by their audio routes
+//     (and aux sends) into an AudioGraph. Tracks whose
+//     inputs are all ready are handed out to a pool of
+//     realtime worker threads, the audio thread itself
+//     being one of them. A track's processed() flag and
+//     outBuffers cache are then picked up by whoever pulls
+//     from it later, so groups, auxs and outputs simply
+//     wait for their inputs and the rest of the pull model
+//     is unchanged.
+//    The graph is built by the gui thread in update(),
+//     never by the audio thread. Whatever changes tracks
+//     or routes in the audio thread calls invalidate(), and
+//     until update() has built a graph for the new state
+//     the audio thread processes serially. A new graph is
+//     handed over through _next, and the one it replaces
+//     comes back through _retired to be freed.
+//---------------------------------------------------------
+
+class AudioScheduler : public AudioGraphPool {
+      std::atomic<unsigned> _serial;          // Bumped when tracks or routes change.
+      unsigned _builtSerial;                  // Gui thread. Serial of the last graph built.
+      bool _cycleReported;                    // Gui thread.
+      AudioGraph* _graph;                     // Audio thread.
+      std::atomic<AudioGraph*> _next;
+      std::atomic<AudioGraph*> _retired;
+
+      unsigned _pos;
+      unsigned _offset;
+      unsigned _frames;
+
+      AudioGraph* build(unsigned serial) const;
+
+   protected:
+      virtual void processNode(void* user, int worker);
+      virtual void workerMain(int worker);
+
+   public:
+      AudioScheduler();
+      virtual ~AudioScheduler();
+
+      // Starts the worker pool, see AudioGraphPool::start().
+      void start(int threads, int priority);
+      void stop();
+
+      // Called from the audio thread, or with the audio thread idle,
+      //  after tracks or routes changed.
+      void invalidate() { _serial.fetch_add(1, std::memory_order_release); }
+      // Gui thread. Builds a new graph if anything changed, and frees replaced ones.
+      void update();
+
+      // Called from the audio thread. Processes all audio tracks, including outputs.
+      // Returns false if nothing was done and the caller must process serially.
+      bool process(unsigned pos, unsigned offset, unsigned frames);
+      };
+
+} // namespace MusECore
+
+namespace MusEGlobal {
+extern MusECore::AudioScheduler* audioScheduler;
+}
+
+#endif
@@ -148,8 +148,8 @@ off_t AudioConverter::readAudio(MusECore::SndFileR& f, unsigned offset, float**
   if(!resample)
   {
     // Sample rates are the same. Just a regular seek + read, no conversion.
-    _sfCurFrame = f.seek(frame, 0);
-    return _sfCurFrame + f.read(channel, buffer, n, overwrite);
+    _sfCurFrame = frame;
+    return _sfCurFrame + f.readAt(frame, channel, buffer, n, overwrite);
   }
   
   // Is a 'transport' seek requested? (Not to be requested with every read! Should only be for 'first read' seeks, or positional 'transport' seeks.)
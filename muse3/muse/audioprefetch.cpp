@@ -23,8 +23,13 @@
 
 #include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
 #include <unistd.h>
 #include <limits.h>
+#include <algorithm>
 
 #include "audioprefetch.h"
 #include "globals.h"
@@ -32,6 +37,9 @@
 #include "song.h"
 #include "audio.h"
 #include "sync.h"
+#include "gconfig.h"
+#include "globaldefs.h"
+#include "wavecache.h"
 
 namespace MusEGlobal {
 MusECore::AudioPrefetch* audioPrefetch;
@@ -39,8 +47,12 @@ MusECore::AudioPrefetch* audioPrefetch;
 
 namespace MusECore {
 
+extern uint64_t curTimeUS();
+
 void initAudioPrefetch()  
 {
+  // The prefetch fifo holds the largest look-ahead plus the block being read.
+  MusEGlobal::prefetchFifoLength = PREFETCH_WINDOW_BYTES / (sizeof(float) * MAX_CHANNELS * MusEGlobal::segmentSize) + 1;
   MusEGlobal::audioPrefetch = new AudioPrefetch("Prefetch");
 }
 
@@ -69,6 +81,14 @@ AudioPrefetch::AudioPrefetch(const char* name)
       seekPos  = ~0;
       writePos = ~0;
       seekCount = 0;
+      _io      = 0;
+      _ioCount = 0;
+      _ioQuit  = false;
+      _scratch = 0;
+      _nextJob = 0;
+      sem_init(&_ioStartSem, 0, 0);
+      sem_init(&_ioDoneSem, 0, 0);
+      resetStats();
       }
 
 //---------------------------------------------------------
@@ -89,15 +109,194 @@ void AudioPrefetch::start(int priority, void *)
       {
       clearPollFd();
       addPollFd(toThreadFdr, POLLIN, MusECore::readMsgP, this, 0);
+      startIO(priority);
       Thread::start(priority);
       }
 
+//---------------------------------------------------------
+//   stop
+//---------------------------------------------------------
+
+void AudioPrefetch::stop(bool force)
+      {
+      Thread::stop(force);
+      if(MusEGlobal::debugMsg && _reads)
+        fprintf(stderr, "AudioPrefetch: %d I/O threads, %lu reads, %lu kB, max read time:%luus, underruns:%u\n",
+                ioThreads(), (unsigned long)_reads, (unsigned long)(_bytesRead / 1024),
+                (unsigned long)_maxReadUS, underruns());
+      if(MusEGlobal::debugMsg && MusEGlobal::waveCache)
+        MusEGlobal::waveCache->printStats();
+      stopIO();
+      }
+
 //---------------------------------------------------------
 //   ~AudioPrefetch
 //---------------------------------------------------------
 
 AudioPrefetch::~AudioPrefetch()
       {
+      stopIO();
+      sem_destroy(&_ioStartSem);
+      sem_destroy(&_ioDoneSem);
+      }
+
+//---------------------------------------------------------
+//   allocScratch
+//    Big enough for one chunk of any track.
+//---------------------------------------------------------
+
+float* AudioPrefetch::allocScratch()
+      {
+      const size_t bytes = std::max((size_t)PREFETCH_CHUNK_BYTES,
+                                    sizeof(float) * MAX_CHANNELS * MusEGlobal::segmentSize);
+      float* p = 0;
+      if(posix_memalign((void**)&p, 16, bytes) != 0)
+        return 0;
+      return p;
+      }
+
+//---------------------------------------------------------
+//   startIO
+//    The prefetch thread counts as one of the configured threads.
+//---------------------------------------------------------
+
+void AudioPrefetch::startIO(int priority)
+      {
+      stopIO();
+
+      int threads = MusEGlobal::config.audioPrefetchThreads;
+      if(threads <= 0)
+      {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+      }
+      if(threads > MAX_PREFETCH_IO_THREADS)
+        threads = MAX_PREFETCH_IO_THREADS;
+
+      _scratch = allocScratch();
+      _ioQuit  = false;
+      resetStats();
+      if(threads <= 1)
+        return;
+
+      _io = new IOThread[threads - 1];
+      for(int i = 0; i < threads - 1; ++i)
+      {
+        IOThread* t = &_io[_ioCount];
+        t->prefetch = this;
+        t->scratch  = allocScratch();
+        if(!t->scratch)
+          break;
+
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        bool rt = MusEGlobal::realTimeScheduling && priority > 0;
+        if(rt)
+        {
+          struct sched_param rt_param;
+          memset(&rt_param, 0, sizeof(rt_param));
+          rt_param.sched_priority = priority;
+          if(pthread_attr_setschedpolicy(&attributes, SCHED_FIFO) ||
+             pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED) ||
+             pthread_attr_setschedparam(&attributes, &rt_param))
+            fprintf(stderr, "AudioPrefetch: cannot set realtime priority %d for I/O thread\n", priority);
+        }
+
+        int rv = pthread_create(&t->thread, &attributes, ioLoop, t);
+        // Same as Thread::start(): Try again without realtime attributes if that failed.
+        if(rv && rt)
+          rv = pthread_create(&t->thread, NULL, ioLoop, t);
+        pthread_attr_destroy(&attributes);
+
+        if(rv)
+        {
+          fprintf(stderr, "AudioPrefetch: creating I/O thread failed: %s\n", strerror(rv));
+          free(t->scratch);
+          break;
+        }
+        ++_ioCount;
+      }
+
+      if(MusEGlobal::debugMsg)
+        fprintf(stderr, "AudioPrefetch: started %d I/O threads, priority:%d\n", _ioCount, priority);
+      }
+
+//---------------------------------------------------------
+//   stopIO
+//    Must not be called while the prefetch thread is running.
+//---------------------------------------------------------
+
+void AudioPrefetch::stopIO()
+      {
+      if(_io)
+      {
+        _ioQuit = true;
+        for(int i = 0; i < _ioCount; ++i)
+          sem_post(&_ioStartSem);
+        for(int i = 0; i < _ioCount; ++i)
+        {
+          pthread_join(_io[i].thread, 0);
+          free(_io[i].scratch);
+        }
+        delete[] _io;
+        _io = 0;
+        _ioCount = 0;
+        // Drop any leftovers in case the prefetch thread was cancelled.
+        while(sem_trywait(&_ioStartSem) == 0)
+          ;
+        while(sem_trywait(&_ioDoneSem) == 0)
+          ;
+      }
+      if(_scratch)
+      {
+        free(_scratch);
+        _scratch = 0;
+      }
+      }
+
+//---------------------------------------------------------
+//   ioLoop
+//---------------------------------------------------------
+
+void* AudioPrefetch::ioLoop(void* arg)
+      {
+      IOThread* t = (IOThread*)arg;
+      AudioPrefetch* ap = t->prefetch;
+      for(;;)
+      {
+        while(sem_wait(&ap->_ioStartSem) == -1 && errno == EINTR)
+          ;
+        if(ap->_ioQuit)
+          break;
+        ap->runJobs(t->scratch);
+        sem_post(&ap->_ioDoneSem);
+      }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   resetStats
+//---------------------------------------------------------
+
+void AudioPrefetch::resetStats()
+      {
+      _reads     = 0;
+      _bytesRead = 0;
+      _maxReadUS = 0;
+      }
+
+//---------------------------------------------------------
+//   underruns
+//---------------------------------------------------------
+
+unsigned AudioPrefetch::underruns() const
+      {
+      unsigned n = 0;
+      TrackList* tl = MusEGlobal::song->tracks();
+      for (iTrack it = tl->begin(); it != tl->end(); ++it)
+            if (!(*it)->isMidiTrack())
+                  n += static_cast<AudioTrack*>(*it)->prefetchState().underruns;
+      return n;
       }
 
 //---------------------------------------------------------
@@ -183,43 +382,185 @@ void AudioPrefetch::msgSeek(unsigned samplePos, bool force)
       }
 
 //---------------------------------------------------------
-//   prefetch
+//   loopAdjust
+//    Returns where the fifo block following 'pos' really starts.
 //---------------------------------------------------------
 
-void AudioPrefetch::prefetch(bool doSeek)
+unsigned AudioPrefetch::loopAdjust(unsigned pos) const
       {
-      if (writePos == ~0U) {
-            fprintf(stderr, "AudioPrefetch::prefetch: invalid write position\n");
-            return;
-            }
       if (MusEGlobal::song->loop() && !MusEGlobal::audio->bounce() && !MusEGlobal::extSyncFlag.value()) {
             const Pos& loop = MusEGlobal::song->rPos();
-            unsigned n = loop.frame() - writePos;
+            unsigned n = loop.frame() - pos;
             if (n < MusEGlobal::segmentSize) {
                   unsigned lpos = MusEGlobal::song->lPos().frame();
                   // adjust loop start so we get exact loop len
                   if (n > lpos)
                         n = 0;
-                  writePos = lpos - n;
+                  return lpos - n;
                   }
             }
-      WaveTrackList* tl = MusEGlobal::song->waves();
-      for (iWaveTrack it = tl->begin(); it != tl->end(); ++it) {
-            WaveTrack* track = *it;
-            // Save time. Don't bother if track is off. Track On/Off not designed for rapid repeated response (but mute is). (p3.3.29)
-            if(track->off())
-              continue;
-            
-            int ch           = track->channels();
+      return pos;
+      }
+
+//---------------------------------------------------------
+//   refill
+//    Read chunks into the track's fifo until it holds
+//     the track's look-ahead. 'tracks' is the number of
+//     tracks being refilled this round.
+//---------------------------------------------------------
+
+void AudioPrefetch::refill(AudioTrack* track, float* scratch, int tracks)
+      {
+      PrefetchState& ps = track->prefetchState();
+      Fifo* fifo        = track->prefetchFifo();
+      const unsigned seg = MusEGlobal::segmentSize;
+      const int ch       = track->channels();
+      const int chunkBlocks = std::max(1U, PREFETCH_CHUNK_BYTES / unsigned(sizeof(float) * ch * seg));
+      // One block is kept free, as before.
+      const int maxBlocks   = fifo->capacity() - 1;
+
+      for (;;) {
+            const int count = fifo->getCount();
+            if (count >= maxBlocks || unsigned(count) * seg >= ps.target)
+                  break;
+
+            // Read as many blocks as fit, up to a loop jump.
+            const unsigned pos = loopAdjust(ps.writePos);
+            const int blocks   = std::min(chunkBlocks, maxBlocks - count);
+            int k = 1;
+            while (k < blocks && loopAdjust(pos + k * seg) == pos + k * seg)
+                  ++k;
+
             float* bp[ch];
-            if (track->prefetchFifo()->getWriteBuffer(ch, MusEGlobal::segmentSize, bp, writePos))
-                  continue;
+            for (int i = 0; i < ch; ++i)
+                  bp[i] = scratch + i * k * seg;
 
+            const uint64_t t0 = curTimeUS();
             // True = do overwrite.
-            track->fetchData(writePos, MusEGlobal::segmentSize, bp, doSeek, true);
-            
+            track->fetchData(pos, k * seg, bp, ps.doSeek, true);
+            const uint64_t dt = curTimeUS() - t0;
+            ps.doSeek = false;
+
+            for (int b = 0; b < k; ++b) {
+                  float* wb[ch];
+                  if (fifo->getWriteBuffer(ch, seg, wb, pos + b * seg))
+                        break;
+                  for (int i = 0; i < ch; ++i)
+                        memcpy(wb[i], bp[i] + b * seg, seg * sizeof(float));
+                  fifo->add();
+                  }
+            ps.writePos = pos + k * seg;
+
+            _reads++;
+            _bytesRead += uint64_t(k) * seg * ch * sizeof(float);
+            uint64_t mx = _maxReadUS;
+            while (dt > mx && !_maxReadUS.compare_exchange_weak(mx, dt))
+                  ;
+
+            const double chunkTime = double(dt) * 1.0e-6 * chunkBlocks / k;
+            ps.readTime = ps.readTime == 0.0 ? chunkTime : ps.readTime * 0.9 + chunkTime * 0.1;
+            ps.target = lookAhead(ps.readTime, tracks, ioThreads(), chunkBlocks * seg,
+                                  maxBlocks * seg, MusEGlobal::sampleRate);
+            }
+      }
+
+//---------------------------------------------------------
+//   runJobs
+//    Called by the prefetch thread and the I/O threads.
+//---------------------------------------------------------
+
+void AudioPrefetch::runJobs(float* scratch)
+      {
+      const int n = _jobs.size();
+      for (;;) {
+            const int i = _nextJob.fetch_add(1);
+            if (i >= n)
+                  break;
+            refill(_jobs[i], scratch, n);
+            }
+      }
+
+static bool fifoLess(AudioTrack* a, AudioTrack* b)
+      {
+      return a->prefetchFifo()->getCount() < b->prefetchFifo()->getCount();
+      }
+
+//---------------------------------------------------------
+//   isPrefetched
+//    Wave tracks, and frozen tracks playing their freeze file.
+//---------------------------------------------------------
+
+static bool isPrefetched(Track* t)
+      {
+      if (t->type() == Track::WAVE)
+            return true;
+      return !t->isMidiTrack() && static_cast<AudioTrack*>(t)->frozen();
+      }
+
+//---------------------------------------------------------
+//   prefetch
+//---------------------------------------------------------
+
+void AudioPrefetch::prefetch(bool doSeek)
+      {
+      if (writePos == ~0U) {
+            fprintf(stderr, "AudioPrefetch::prefetch: invalid write position\n");
+            return;
             }
-      writePos += MusEGlobal::segmentSize;
+      if (!_scratch)
+            return;
+
+      const unsigned seg = MusEGlobal::segmentSize;
+      _jobs.clear();
+      TrackList* tl = MusEGlobal::song->tracks();
+      for (iTrack it = tl->begin(); it != tl->end(); ++it) {
+            if (!isPrefetched(*it))
+                  continue;
+            AudioTrack* track = static_cast<AudioTrack*>(*it);
+            PrefetchState& ps = track->prefetchState();
+            // Save time. Don't bother if track is off. Track On/Off not designed for rapid repeated response (but mute is). (p3.3.29)
+            if(track->off())
+            {
+              // Start over where the song is when it is turned on again.
+              //  The audio thread does not read the fifo of a track which is off.
+              if(ps.writePos != ~0U)
+              {
+                track->clearPrefetchFifo();
+                ps.writePos = ~0U;
+              }
+              continue;
+            }
+            if (doSeek) {
+                  ps.writePos = writePos;
+                  ps.doSeek   = true;
+                  }
+            else if (ps.writePos == ~0U) {
+                  // A track added, unfrozen or turned on while playing joins in
+                  //  at the play position. writePos is only where the last seek
+                  //  went to. The audio thread drops the blocks it has passed.
+                  ps.writePos = MusEGlobal::audio->pos().frame();
+                  ps.doSeek   = true;
+                  }
+            if (ps.target == 0)
+                  ps.target = 2 * seg * std::max(1U, PREFETCH_CHUNK_BYTES / unsigned(sizeof(float) * track->channels() * seg));
+            if (unsigned(track->prefetchFifo()->getCount()) * seg < ps.target)
+                  _jobs.push_back(track);
+            }
+      if (_jobs.empty())
+            return;
+
+      // Emptiest fifos first.
+      if (_jobs.size() > 1)
+            std::sort(_jobs.begin(), _jobs.end(), fifoLess);
+
+      _nextJob = 0;
+      const int helpers = std::min(_ioCount, int(_jobs.size()) - 1);
+      for (int i = 0; i < helpers; ++i)
+            sem_post(&_ioStartSem);
+      runJobs(_scratch);
+      for (int i = 0; i < helpers; ++i)
+            while (sem_wait(&_ioDoneSem) == -1 && errno == EINTR)
+                  ;
       }
 
 //---------------------------------------------------------
@@ -249,28 +590,16 @@ void AudioPrefetch::seek(unsigned seekTo)
       }
       
       writePos = seekTo;
-      WaveTrackList* tl = MusEGlobal::song->waves();
-      for (iWaveTrack it = tl->begin(); it != tl->end(); ++it) {
-            WaveTrack* track = *it;
-            track->clearPrefetchFifo();
+      TrackList* tl = MusEGlobal::song->tracks();
+      for (iTrack it = tl->begin(); it != tl->end(); ++it) {
+            // All audio tracks, a track may just have been unfrozen.
+            if (!(*it)->isMidiTrack())
+                  static_cast<AudioTrack*>(*it)->clearPrefetchFifo();
             }
-      
-      bool isFirstPrefetch = true;
-      for (unsigned int i = 0; i < (MusEGlobal::fifoLength)-1; ++i)//prevent compiler warning: comparison of signed/unsigned
-      {      
-            // Indicate do a seek command before read, but only on the first pass. 
-            prefetch(isFirstPrefetch);
-            
-            isFirstPrefetch = false;
-            
-            // To help speed things up even more, check the count again. Return if more seek messages are pending. (p3.3.20)
-            if(seekCount > 1)
-            {
-              --seekCount;
-              return;
-            }  
-      }
-            
+
+      // Fill every track up to its look-ahead. Indicate do a seek command before the first read.
+      prefetch(true);
+
       seekPos  = seekTo;
       --seekCount;
       }
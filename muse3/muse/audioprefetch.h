@@ -24,21 +24,71 @@
 #ifndef __AUDIOPREFETCH_H__
 #define __AUDIOPREFETCH_H__
 
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "thread.h"
 
 namespace MusECore {
 
+class AudioTrack;
+
+// Upper limit for the number of threads reading wave files.
+const int MAX_PREFETCH_IO_THREADS = 16;
+// Size of one disk read per track, independent of the audio period.
+const unsigned PREFETCH_CHUNK_BYTES = 256 * 1024;
+// Largest look-ahead of a track, which sizes its prefetch fifo.
+const unsigned PREFETCH_WINDOW_BYTES = 4 * PREFETCH_CHUNK_BYTES;
+
 //---------------------------------------------------------
 //   AudioPrefetch
+//    Keeps the prefetch fifos of the wave tracks and the
+//     frozen tracks filled.
+//    Each track is refilled in large chunks once its fifo
+//     runs below a look-ahead which is sized from the time
+//     its reads take. Tracks needing a refill are spread
+//     over a pool of I/O threads, the prefetch thread itself
+//     being one of them.
 //---------------------------------------------------------
 
 class AudioPrefetch : public Thread {
       unsigned writePos;
       unsigned seekPos; // remember last seek to optimize seeks
 
+      // I/O thread pool.
+      struct IOThread {
+            AudioPrefetch* prefetch;
+            pthread_t thread;
+            float* scratch;
+            };
+      IOThread* _io;
+      int _ioCount;                  // Not counting the prefetch thread.
+      volatile bool _ioQuit;
+      sem_t _ioStartSem;
+      sem_t _ioDoneSem;
+      float* _scratch;               // Scratch buffer of the prefetch thread.
+      std::vector<AudioTrack*> _jobs;
+      std::atomic<int> _nextJob;
+
+      // Statistics.
+      std::atomic<uint64_t> _reads;
+      std::atomic<uint64_t> _bytesRead;
+      std::atomic<uint64_t> _maxReadUS;
+
       virtual void processMsg1(const void*);
       void prefetch(bool doSeek);
       void seek(unsigned pos);
+      unsigned loopAdjust(unsigned pos) const;
+      void refill(AudioTrack*, float* scratch, int tracks);
+      void runJobs(float* scratch);
+      void startIO(int threads);
+      void stopIO();
+      static void* ioLoop(void*);
+      static float* allocScratch();
 
       volatile int seekCount;
       
@@ -47,11 +97,34 @@ class AudioPrefetch : public Thread {
       
       ~AudioPrefetch();
       virtual void start(int, void* pty = NULL);
+      void stop(bool force);
 
       void msgTick(bool isRecTick, bool isPlayTick);
       void msgSeek(unsigned samplePos, bool force=false);
       
       bool seekDone() const { return seekCount == 0; }
+
+      int ioThreads() const { return _ioCount + 1; }
+      // Fifo underruns of all prefetched tracks, counted by the audio thread.
+      unsigned underruns() const;
+      uint64_t reads() const     { return _reads; }
+      uint64_t bytesRead() const { return _bytesRead; }
+      uint64_t maxReadUS() const { return _maxReadUS; }
+      void resetStats();
+
+      // Look-ahead in frames of a track whose chunk of 'chunkFrames' takes
+      //  'readTime' seconds to read: A track may have to wait for a read of
+      //  every other track sharing its thread, so keep enough for that plus
+      //  a margin. Never less than two chunks, never more than 'maxFrames'.
+      static unsigned lookAhead(double readTime, int tracks, int threads, unsigned chunkFrames,
+                                unsigned maxFrames, unsigned sampleRate)
+            {
+            const double waits = double((tracks + threads - 1) / threads + 1);
+            double target = chunkFrames + 2.0 * waits * readTime * sampleRate;
+            target = std::max(target, double(2 * chunkFrames));
+            target = std::min(target, double(maxFrames));
+            return unsigned(target);
+            }
       };
 
 } // namespace MusECore
@@ -45,6 +45,7 @@
 #include "controlfifo.h"
 #include "fastlog.h"
 #include "gconfig.h"
+#include "latency_compensator.h"
 
 namespace MusECore {
 
@@ -177,6 +178,16 @@ void AudioTrack::initBuffers()
       memset(_dataBuffers[i], 0, sizeof(float) * MusEGlobal::segmentSize);
   }
 
+  if(!_ctrlRenderBuffer)
+  {
+    int rv = posix_memalign((void**)&_ctrlRenderBuffer, 16, sizeof(float) * 2 * MusEGlobal::segmentSize);
+    if(rv != 0)
+    {
+      fprintf(stderr, "ERROR: AudioTrack::init_buffers: posix_memalign _ctrlRenderBuffer returned error:%d. Aborting!\n", rv);
+      abort();
+    }
+  }
+
   if(!audioInSilenceBuf)
   {
     int rv = posix_memalign((void**)&audioInSilenceBuf, 16, sizeof(float) * MusEGlobal::segmentSize);
@@ -239,7 +250,7 @@ void AudioTrack::initBuffers()
 //---------------------------------------------------------
 
 AudioTrack::AudioTrack(TrackType t)
-   : Track(t)
+   : Track(t), _prefetchFifo(MusEGlobal::prefetchFifoLength)
       {
       _processed = false;
       _haveData = false;
@@ -266,6 +277,15 @@ AudioTrack::AudioTrack(TrackType t)
       audioInSilenceBuf = 0;
       audioOutDummyBuf = 0;
       _dataBuffers = 0;
+      _ctrlRenderBuffer = 0;
+      _latencyComp = 0;
+      _sendLatencyDelay = 0;
+      _outLatencyDelay = 0;
+      _latencyCompPosted = 0;
+      _sendLatencyDelayPosted = 0;
+      _outLatencyDelayPosted = 0;
+      _frozen = false;
+      _ctrlGuiSerial.store(0);
 
       _totalOutChannels = MusECore::MAX_CHANNELS;
 
@@ -279,7 +299,7 @@ AudioTrack::AudioTrack(TrackType t)
       }
 
 AudioTrack::AudioTrack(const AudioTrack& t, int flags)
-  :  Track(t, flags)
+  :  Track(t, flags), _prefetchFifo(MusEGlobal::prefetchFifoLength)
       {
       _processed      = false;
       _haveData       = false;
@@ -302,6 +322,15 @@ AudioTrack::AudioTrack(const AudioTrack& t, int flags)
       audioInSilenceBuf = 0;
       audioOutDummyBuf = 0;
       _dataBuffers = 0;
+      _ctrlRenderBuffer = 0;
+      _latencyComp = 0;
+      _sendLatencyDelay = 0;
+      _outLatencyDelay = 0;
+      _latencyCompPosted = 0;
+      _sendLatencyDelayPosted = 0;
+      _outLatencyDelayPosted = 0;
+      _frozen = false;
+      _ctrlGuiSerial.store(0);
 
       _totalOutChannels = 0;
 
@@ -555,6 +584,12 @@ AudioTrack::~AudioTrack()
       if(audioOutDummyBuf)
         free(audioOutDummyBuf);
 
+      if(_ctrlRenderBuffer)
+        free(_ctrlRenderBuffer);
+
+      if(_latencyComp)
+        delete _latencyComp;
+
       if(_dataBuffers)
       {
         for(int i = 0; i < _totalOutChannels; ++i)
@@ -649,6 +684,7 @@ void AudioTrack::addPlugin(PluginI* plugin, int idx)
   }
   efxPipe()->insert(plugin, idx);
   setupPlugin(plugin, idx);
+  setFreezeStale();
 }
 
 //---------------------------------------------------------
@@ -713,6 +749,20 @@ void AudioTrack::addController(CtrlList* list)
       _controller.add(list);
       }
 
+//---------------------------------------------------------
+//   ctrlGuiSerial
+//    The lists' serials only ever grow, so their sum
+//     changes whenever one of them does.
+//---------------------------------------------------------
+
+unsigned AudioTrack::ctrlGuiSerial() const
+      {
+      unsigned serial = _ctrlGuiSerial.load(std::memory_order_acquire);
+      for (ciCtrlList icl = _controller.begin(); icl != _controller.end(); ++icl)
+            serial += icl->second->guiSerial();
+      return serial;
+      }
+
 //---------------------------------------------------------
 //   removeController
 //---------------------------------------------------------
@@ -809,6 +859,7 @@ void AudioTrack::swapControllerIDX(int idx1, int idx2)
       continue;
     imacm->second.setAudioCtrlId(actrl);
   }
+  setFreezeStale();
 }
 
 //---------------------------------------------------------
@@ -822,6 +873,7 @@ void AudioTrack::setAutomationType(AutomationType t)
 
   // Now set the type.
   _automationType = t;
+  setFreezeStale();
 }
 
 //---------------------------------------------------------
@@ -1121,6 +1173,71 @@ float AudioTrack::latency(int /*channel*/)
   return _efxPipe->latency();
 }
 
+//---------------------------------------------------------
+//   setLatencyCompensation
+//    Called from the audio thread. The compensator is only
+//     cleared when the delays change, so unchanged delays
+//     do not drop the audio already buffered.
+//---------------------------------------------------------
+
+LatencyCompensator* AudioTrack::setLatencyCompensation(LatencyCompensator* comp, unsigned long sendDelay, unsigned long outDelay)
+{
+  LatencyCompensator* old = 0;
+  if(comp != _latencyComp)
+  {
+    old = _latencyComp;
+    _latencyComp = comp;
+  }
+  if(!_latencyComp)
+  {
+    _sendLatencyDelay = 0;
+    _outLatencyDelay = 0;
+    return old;
+  }
+  if(old || sendDelay != _sendLatencyDelay || outDelay != _outLatencyDelay)
+  {
+    const unsigned long half = _latencyComp->channels() / 2;
+    for(unsigned long ch = 0; ch < half; ++ch)
+    {
+      _latencyComp->setDelay(ch, sendDelay);
+      _latencyComp->setDelay(half + ch, outDelay);
+    }
+    _latencyComp->clear();
+  }
+  _sendLatencyDelay = _latencyComp->delay(0);
+  _outLatencyDelay = _latencyComp->delay(_latencyComp->channels() / 2);
+  return old;
+}
+
+//---------------------------------------------------------
+//   requestLatencyCompensation
+//    A new compensator is only made when the current one
+//     is too short or has too few channels. Its size is
+//     rounded up to a power of two, as run() requires.
+//---------------------------------------------------------
+
+void AudioTrack::requestLatencyCompensation(unsigned long sendDelay, unsigned long outDelay)
+{
+  const unsigned long chans = totalProcessBuffers();
+  const unsigned long maxDelay = sendDelay > outDelay ? sendDelay : outDelay;
+  const bool fits = _latencyCompPosted && _latencyCompPosted->maxDelay() >= maxDelay &&
+                    _latencyCompPosted->channels() >= 2 * chans;
+  if(sendDelay == _sendLatencyDelayPosted && outDelay == _outLatencyDelayPosted && (!maxDelay || fits))
+    return;
+  LatencyCompensator* comp = 0;
+  if(maxDelay && !fits)
+  {
+    unsigned long size = 1024;
+    while(size <= maxDelay)
+      size <<= 1;
+    comp = new LatencyCompensator(2 * chans, size);
+    _latencyCompPosted = comp;
+  }
+  _sendLatencyDelayPosted = sendDelay;
+  _outLatencyDelayPosted = outDelay;
+  MusEGlobal::audio->msgSetLatencyCompensation(this, comp, sendDelay, outDelay);
+}
+
 //---------------------------------------------------------
 //   volume
 //---------------------------------------------------------
@@ -1186,6 +1303,7 @@ double AudioTrack::gain() const
 void AudioTrack::setGain(double val)
       {
         _gain = val;
+        touchCtrlGui();
       }
 
 //---------------------------------------------------------
@@ -1293,6 +1411,8 @@ bool AudioTrack::addScheduledControlEvent(int track_ctrl_id, double val, unsigne
 
 void AudioTrack::enableController(int track_ctrl_id, bool en)
 {
+  // What the controls show depends on it.
+  touchCtrlGui();
   if(track_ctrl_id < AC_PLUGIN_CTL_BASE)
   {
     if((unsigned long)track_ctrl_id < _controlPorts)
@@ -1360,6 +1480,7 @@ bool AudioTrack::controllerEnabled(int track_ctrl_id) const
 
 void AudioTrack::enableAllControllers()
 {
+    touchCtrlGui();
     // Enable track controllers:
     for(unsigned long i = 0; i < _controlPorts; ++i)
       _controls[i].enCtrl = true;
@@ -2152,6 +2273,7 @@ AudioAux::AudioAux()
    : AudioTrack(AUDIO_AUX)
 {
       _index = getNextAuxIndex();
+      _sendBufferLock.clear();
       for(int i = 0; i < MusECore::MAX_CHANNELS; ++i)
       {
         if(i < channels())
@@ -2179,6 +2301,7 @@ AudioAux::AudioAux(const AudioAux& t, int flags)
    : AudioTrack(t, flags)
 {
       _index = getNextAuxIndex();
+      _sendBufferLock.clear();
       for(int i = 0; i < MusECore::MAX_CHANNELS; ++i)
       {
         if(i < channels())
@@ -2426,6 +2549,7 @@ void AudioTrack::setAuxSend(int idx, double v)
             return;
             }
       _auxSend[idx] = v;
+      touchCtrlGui();
       }
 
 //---------------------------------------------------------
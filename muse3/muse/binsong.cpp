@@ -0,0 +1,620 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  binsong.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "binsong.h"
+#include "part.h"
+#include "event.h"
+#include "ctrl.h"
+
+namespace MusECore {
+
+BinSong* BinSong::_current = 0;
+
+static const char MAGIC[8] = { 'M', 'u', 's', 'E', 'B', 'i', 'n', 0 };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Unreferenced data allowed to pile up before compacting.
+static const uint64_t COMPACT_MIN = 1024 * 1024;
+
+//---------------------------------------------------------
+//   PackedEvent
+//    An event in an EVENTS chunk, followed by its data.
+//    The chunk starts with the number of events.
+//---------------------------------------------------------
+
+struct PackedEvent {
+      uint32_t tick;          // Relative to the part.
+      uint32_t len;
+      int32_t a;
+      int32_t b;
+      int32_t c;
+      uint16_t type;
+      uint16_t pad;
+      uint32_t dataLen;
+      };
+
+//---------------------------------------------------------
+//   readAt
+//   writeAt
+//---------------------------------------------------------
+
+static bool readAt(int fd, char* p, size_t n, uint64_t offset)
+      {
+      while (n) {
+            ssize_t r = pread(fd, p, n, offset);
+            if (r == -1 && errno == EINTR)
+                  continue;
+            if (r <= 0)
+                  return false;
+            p += r;
+            n -= r;
+            offset += r;
+            }
+      return true;
+      }
+
+static bool writeAt(int fd, const void* data, size_t n, uint64_t offset)
+      {
+      const char* p = (const char*)data;
+      while (n) {
+            ssize_t r = pwrite(fd, p, n, offset);
+            if (r == -1 && errno == EINTR)
+                  continue;
+            if (r <= 0)
+                  return false;
+            p += r;
+            n -= r;
+            offset += r;
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   BinSong
+//---------------------------------------------------------
+
+BinSong::BinSong()
+      {
+      _fd = -1;
+      _map = 0;
+      _mapSize = 0;
+      _writing = false;
+      _failed = false;
+      _end = 0;
+      _songFile = 0;
+      _songBuf = 0;
+      _songSize = 0;
+      }
+
+BinSong::~BinSong()
+      {
+      close();
+      }
+
+//---------------------------------------------------------
+//   hash
+//    FNV-1a
+//---------------------------------------------------------
+
+uint64_t BinSong::hash(const char* p, size_t n)
+      {
+      uint64_t h = 0xcbf29ce484222325ULL;
+      for (size_t i = 0; i < n; ++i) {
+            h ^= (unsigned char)p[i];
+            h *= 0x100000001b3ULL;
+            }
+      return h;
+      }
+
+//---------------------------------------------------------
+//   unmap
+//---------------------------------------------------------
+
+void BinSong::unmap()
+      {
+      if (_map)
+            munmap((void*)_map, _mapSize);
+      _map = 0;
+      _mapSize = 0;
+      _index.clear();
+      }
+
+//---------------------------------------------------------
+//   close
+//    Abandons a save which was not committed.
+//---------------------------------------------------------
+
+void BinSong::close()
+      {
+      if (_songFile)
+            fclose(_songFile);
+      _songFile = 0;
+      free(_songBuf);
+      _songBuf = 0;
+      _songSize = 0;
+      unmap();
+      if (_fd != -1)
+            ::close(_fd);
+      _fd = -1;
+      if (_writing && !_tmpPath.isEmpty())
+            unlink(_tmpPath.constData());
+      _tmpPath.clear();
+      _writing = false;
+      _newIndex.clear();
+      _oldByHash.clear();
+      _newByHash.clear();
+      _pack.clear();
+      if (_current == this)
+            _current = 0;
+      }
+
+//---------------------------------------------------------
+//   readIndex
+//    Checks the header and copies the index of the mapped
+//     file. Returns false if it is not a binary song of
+//     this version.
+//---------------------------------------------------------
+
+bool BinSong::readIndex()
+      {
+      _index.clear();
+      if (_mapSize < sizeof(Header))
+            return false;
+      Header h;
+      memcpy(&h, _map, sizeof(h));
+      if (memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION || h.byteOrder != BYTE_ORDER_MARK)
+            return false;
+      if (h.indexOffset < sizeof(Header) || h.indexOffset > _mapSize
+         || h.chunks > (_mapSize - h.indexOffset) / sizeof(IndexEntry))
+            return false;
+      _index.resize(h.chunks);
+      if (h.chunks)
+            memcpy(&_index[0], _map + h.indexOffset, h.chunks * sizeof(IndexEntry));
+      for (size_t i = 0; i < _index.size(); ++i) {
+            const IndexEntry& e = _index[i];
+            if (e.offset < sizeof(Header) || e.offset > h.indexOffset || e.size > h.indexOffset - e.offset) {
+                  _index.clear();
+                  return false;
+                  }
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   chunk
+//---------------------------------------------------------
+
+const char* BinSong::chunk(int n, ChunkType type, size_t* size) const
+      {
+      if (!_map || n < 0 || n >= (int)_index.size() || _index[n].type != (uint32_t)type)
+            return 0;
+      *size = _index[n].size;
+      return _map + _index[n].offset;
+      }
+
+//---------------------------------------------------------
+//   open
+//---------------------------------------------------------
+
+bool BinSong::open(const QString& path)
+      {
+      close();
+      _path = path;
+      _fd = ::open(path.toLocal8Bit().constData(), O_RDONLY);
+      if (_fd == -1) {
+            fprintf(stderr, "BinSong::open: cannot open %s: %s\n", path.toLocal8Bit().constData(), strerror(errno));
+            return false;
+            }
+      struct stat st;
+      if (fstat(_fd, &st) == -1 || st.st_size < (off_t)sizeof(Header)) {
+            fprintf(stderr, "BinSong::open: %s is not a binary song\n", path.toLocal8Bit().constData());
+            close();
+            return false;
+            }
+      void* m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+      if (m == MAP_FAILED) {
+            fprintf(stderr, "BinSong::open: cannot map %s: %s\n", path.toLocal8Bit().constData(), strerror(errno));
+            close();
+            return false;
+            }
+      _map = (const char*)m;
+      _mapSize = st.st_size;
+      if (!readIndex() || !songText()) {
+            fprintf(stderr, "BinSong::open: %s is not a binary song of version %u\n",
+               path.toLocal8Bit().constData(), VERSION);
+            close();
+            return false;
+            }
+      _current = this;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   songText
+//---------------------------------------------------------
+
+const char* BinSong::songText() const
+      {
+      for (int i = _index.size() - 1; i >= 0; --i) {
+            size_t size;
+            const char* p = chunk(i, SONG, &size);
+            if (p)
+                  return (size && p[size - 1] == 0) ? p : 0;
+            }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   create
+//---------------------------------------------------------
+
+bool BinSong::create(const QString& path)
+      {
+      close();
+      _path = path;
+      const QByteArray p = path.toLocal8Bit();
+
+      // Append to a binary song of this version, else write a new file.
+      int fd = ::open(p.constData(), O_RDWR);
+      if (fd != -1) {
+            struct stat st;
+            void* m = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header))
+                  m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (m != MAP_FAILED) {
+                  _map = (const char*)m;
+                  _mapSize = st.st_size;
+                  if (readIndex()) {
+                        _fd = fd;
+                        _end = st.st_size;
+                        }
+                  else
+                        unmap();
+                  }
+            if (_fd == -1)
+                  ::close(fd);
+            }
+      if (_fd == -1) {
+            _tmpPath = p + ".tmp";
+            _fd = ::open(_tmpPath.constData(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (_fd == -1) {
+                  fprintf(stderr, "BinSong::create: cannot create %s: %s\n", _tmpPath.constData(), strerror(errno));
+                  _tmpPath.clear();
+                  return false;
+                  }
+            _end = sizeof(Header);
+            }
+      for (size_t i = 0; i < _index.size(); ++i)
+            _oldByHash.insert(std::pair<uint64_t, size_t>(_index[i].hash, i));
+
+      _songFile = open_memstream(&_songBuf, &_songSize);
+      _writing = true;
+      if (!_songFile) {
+            fprintf(stderr, "BinSong::create: %s\n", strerror(errno));
+            close();
+            return false;
+            }
+      _failed = false;
+      _current = this;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   sameChunk
+//    Whether the chunk at e holds the n bytes at p. Chunks
+//     written in this save are past the map, they are read
+//     back from the file.
+//---------------------------------------------------------
+
+bool BinSong::sameChunk(const IndexEntry& e, const char* p, size_t n) const
+      {
+      if (e.size != n)
+            return false;
+      if (_map && e.offset + n <= _mapSize)
+            return memcmp(_map + e.offset, p, n) == 0;
+      char buf[4096];
+      for (size_t done = 0; done < n; ) {
+            const size_t k = n - done < sizeof(buf) ? n - done : sizeof(buf);
+            if (!readAt(_fd, buf, k, e.offset + done) || memcmp(buf, p + done, k) != 0)
+                  return false;
+            done += k;
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   addChunk
+//    Returns the number of an equal chunk in the new index,
+//     writing it first if the file does not have it yet.
+//---------------------------------------------------------
+
+int BinSong::addChunk(ChunkType type, const char* p, size_t n)
+      {
+      if (_failed)
+            return -1;
+      const uint64_t h = hash(p, n);
+
+      // Already added in this save, like empty or copied parts.
+      std::pair<std::multimap<uint64_t, size_t>::const_iterator, std::multimap<uint64_t, size_t>::const_iterator>
+         r = _newByHash.equal_range(h);
+      for (std::multimap<uint64_t, size_t>::const_iterator i = r.first; i != r.second; ++i) {
+            const IndexEntry& e = _newIndex[i->second];
+            if (e.type == (uint32_t)type && sameChunk(e, p, n))
+                  return i->second;
+            }
+
+      IndexEntry e;
+      e.type = type;
+      e.pad = 0;
+      e.size = n;
+      e.hash = h;
+      bool found = false;
+      r = _oldByHash.equal_range(h);
+      for (std::multimap<uint64_t, size_t>::const_iterator i = r.first; i != r.second; ++i) {
+            const IndexEntry& o = _index[i->second];
+            if (o.type == (uint32_t)type && sameChunk(o, p, n)) {
+                  e.offset = o.offset;
+                  found = true;
+                  break;
+                  }
+            }
+      if (!found) {
+            e.offset = _end;
+            if (!writeAt(_fd, p, n, _end)) {
+                  _failed = true;
+                  return -1;
+                  }
+            _end += n;
+            }
+      _newIndex.push_back(e);
+      _newByHash.insert(std::pair<uint64_t, size_t>(h, _newIndex.size() - 1));
+      return _newIndex.size() - 1;
+      }
+
+//---------------------------------------------------------
+//   writeIndex
+//    The header is written last, when all else is on disk,
+//     so a failed save leaves the previous one intact.
+//---------------------------------------------------------
+
+bool BinSong::writeIndex(int fd, const std::vector<IndexEntry>& index, uint64_t offset)
+      {
+      const size_t n = index.size() * sizeof(IndexEntry);
+      if (n && !writeAt(fd, &index[0], n, offset))
+            return false;
+      if (fdatasync(fd) == -1)
+            return false;
+
+      Header h;
+      memcpy(h.magic, MAGIC, sizeof(MAGIC));
+      h.version = VERSION;
+      h.byteOrder = BYTE_ORDER_MARK;
+      h.indexOffset = offset;
+      h.chunks = index.size();
+      if (!writeAt(fd, &h, sizeof(h), 0) || fdatasync(fd) == -1)
+            return false;
+      // Drop anything an earlier failed save left behind the index.
+      return ftruncate(fd, offset + n) == 0;
+      }
+
+//---------------------------------------------------------
+//   compact
+//    Copies the chunks of the new index to a new file.
+//---------------------------------------------------------
+
+bool BinSong::compact(uint64_t live)
+      {
+      const QByteArray p = _path.toLocal8Bit();
+      const QByteArray tmp = p + ".tmp";
+      int fd = ::open(tmp.constData(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (fd == -1)
+            return false;
+
+      std::vector<IndexEntry> index(_newIndex);
+      std::vector<char> buf;
+      uint64_t end = sizeof(Header);
+      bool ok = ftruncate(fd, live) == 0;
+      for (size_t i = 0; ok && i < index.size(); ++i) {
+            buf.resize(index[i].size);
+            ok = readAt(_fd, &buf[0], buf.size(), index[i].offset)
+                 && writeAt(fd, &buf[0], buf.size(), end);
+            index[i].offset = end;
+            end += buf.size();
+            }
+      ok = ok && writeIndex(fd, index, end);
+      ::close(fd);
+      if (ok && ::rename(tmp.constData(), p.constData()) == -1)
+            ok = false;
+      if (!ok)
+            unlink(tmp.constData());
+      return ok;
+      }
+
+//---------------------------------------------------------
+//   commit
+//---------------------------------------------------------
+
+bool BinSong::commit()
+      {
+      if (!_writing)
+            return false;
+      bool ok = !_failed && _songFile && fflush(_songFile) == 0 && !ferror(_songFile);
+      fclose(_songFile);
+      _songFile = 0;
+      // With the terminating zero open_memstream() keeps after the text.
+      if (ok)
+            ok = addChunk(SONG, _songBuf, _songSize + 1) >= 0;
+
+      if (ok) {
+            uint64_t live = sizeof(Header) + _newIndex.size() * sizeof(IndexEntry);
+            for (size_t i = 0; i < _newIndex.size(); ++i)
+                  live += _newIndex[i].size;
+            bool done = false;
+            if (_tmpPath.isEmpty() && _end > 2 * live && _end - live > COMPACT_MIN)
+                  done = compact(live);
+            if (!done)
+                  ok = writeIndex(_fd, _newIndex, _end);
+            if (ok && !done && !_tmpPath.isEmpty()
+               && ::rename(_tmpPath.constData(), _path.toLocal8Bit().constData()) == -1)
+                  ok = false;
+            }
+      if (ok)
+            _writing = false;
+      else
+            fprintf(stderr, "BinSong::commit: cannot write %s: %s\n", _path.toLocal8Bit().constData(), strerror(errno));
+      close();
+      return ok;
+      }
+
+//---------------------------------------------------------
+//   writeEvents
+//---------------------------------------------------------
+
+int BinSong::writeEvents(const Part* part)
+      {
+      const EventList& el = part->events();
+      const uint32_t count = el.size();
+      _pack.resize(sizeof(count));
+      memcpy(&_pack[0], &count, sizeof(count));
+      for (ciEvent ie = el.begin(); ie != el.end(); ++ie) {
+            const Event& e = ie->second;
+            PackedEvent pe;
+            pe.tick = e.tick();
+            pe.len = e.type() == Note ? e.lenTick() : 0;
+            pe.a = e.dataA();
+            pe.b = e.dataB();
+            pe.c = e.dataC();
+            pe.type = e.type();
+            pe.pad = 0;
+            pe.dataLen = e.dataLen();
+            const size_t pos = _pack.size();
+            _pack.resize(pos + sizeof(pe) + pe.dataLen);
+            memcpy(&_pack[pos], &pe, sizeof(pe));
+            if (pe.dataLen)
+                  memcpy(&_pack[pos + sizeof(pe)], e.data(), pe.dataLen);
+            }
+      return addChunk(EVENTS, &_pack[0], _pack.size());
+      }
+
+//---------------------------------------------------------
+//   readEvents
+//---------------------------------------------------------
+
+bool BinSong::readEvents(int n, Part* part) const
+      {
+      size_t size;
+      const char* p = chunk(n, EVENTS, &size);
+      uint32_t count;
+      if (!p || size < sizeof(count))
+            return false;
+      const char* end = p + size;
+      memcpy(&count, p, sizeof(count));
+      p += sizeof(count);
+      for (uint32_t i = 0; i < count; ++i) {
+            PackedEvent pe;
+            if (size_t(end - p) < sizeof(pe))
+                  return false;
+            memcpy(&pe, p, sizeof(pe));
+            p += sizeof(pe);
+            if (size_t(end - p) < pe.dataLen)
+                  return false;
+            if (pe.type != Note && pe.type != Controller && pe.type != Sysex && pe.type != Meta)
+                  return false;
+            Event e(EventType(pe.type));
+            e.setTick(pe.tick);
+            if (pe.type == Note)
+                  e.setLenTick(pe.len);
+            e.setA(pe.a);
+            e.setB(pe.b);
+            e.setC(pe.c);
+            if (pe.dataLen)
+                  e.setData((const unsigned char*)p, pe.dataLen);
+            p += pe.dataLen;
+            part->addEvent(e);
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   writeCtrl
+//    Number of points, padding, the frames, then the values.
+//---------------------------------------------------------
+
+int BinSong::writeCtrl(const CtrlList* cl)
+      {
+      const uint32_t count = cl->size();
+      _pack.resize(2 * sizeof(uint32_t) + count * (sizeof(int32_t) + sizeof(double)));
+      char* p = &_pack[0];
+      memcpy(p, &count, sizeof(count));
+      memset(p + sizeof(count), 0, sizeof(uint32_t));
+      char* fp = p + 2 * sizeof(uint32_t);
+      char* vp = fp + count * sizeof(int32_t);
+      for (ciCtrl ic = cl->begin(); ic != cl->end(); ++ic) {
+            const int32_t frame = ic->second.frame;
+            const double val = ic->second.val;
+            memcpy(fp, &frame, sizeof(frame));
+            memcpy(vp, &val, sizeof(val));
+            fp += sizeof(frame);
+            vp += sizeof(val);
+            }
+      return addChunk(CTRL, p, _pack.size());
+      }
+
+//---------------------------------------------------------
+//   readCtrl
+//---------------------------------------------------------
+
+bool BinSong::readCtrl(int n, CtrlList* cl) const
+      {
+      size_t size;
+      const char* p = chunk(n, CTRL, &size);
+      uint32_t count;
+      if (!p || size < 2 * sizeof(uint32_t))
+            return false;
+      memcpy(&count, p, sizeof(count));
+      if (size != 2 * sizeof(uint32_t) + uint64_t(count) * (sizeof(int32_t) + sizeof(double)))
+            return false;
+      const char* fp = p + 2 * sizeof(uint32_t);
+      const char* vp = fp + count * sizeof(int32_t);
+      for (uint32_t i = 0; i < count; ++i) {
+            int32_t frame;
+            double val;
+            memcpy(&frame, fp, sizeof(frame));
+            memcpy(&val, vp, sizeof(val));
+            fp += sizeof(frame);
+            vp += sizeof(val);
+            // Stored in order, so each goes at the end.
+            cl->insert(cl->end(), std::pair<int, CtrlVal>(frame, CtrlVal(frame, val)));
+            }
+      return true;
+      }
+
+} // namespace MusECore
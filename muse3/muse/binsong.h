@@ -0,0 +1,138 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  binsong.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __BINSONG_H__
+#define __BINSONG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+namespace MusECore {
+
+class Part;
+class CtrlList;
+
+//---------------------------------------------------------
+//   BinSong
+//    Binary project file (*.medb).
+//    A header, the chunks, and an index of the chunks at
+//     the end. The song is the usual xml text in one chunk,
+//     except that the events of midi parts and automation
+//     lists are packed arrays in chunks of their own, which
+//     the xml refers to by number.
+//    Saving over an existing file only appends the chunks
+//     which are not in it yet and a new index, then commits
+//     by rewriting the header. Chunks are found by content,
+//     so unchanged parts are not written again. A file with
+//     more unreferenced than referenced data is compacted
+//     into a new one instead.
+//    While a song is read or written, current() is the file
+//     for the part and automation readers and writers.
+//---------------------------------------------------------
+
+class BinSong {
+   public:
+      enum ChunkType { SONG = 1, EVENTS = 2, CTRL = 3 };
+      static const uint32_t VERSION = 1;
+
+   private:
+      struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrder;
+            uint64_t indexOffset;
+            uint64_t chunks;
+            };
+      struct IndexEntry {
+            uint32_t type;
+            uint32_t pad;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t hash;
+            };
+
+      static BinSong* _current;
+
+      QString _path;
+      QByteArray _tmpPath;          // Writing a new file, renamed on commit.
+      int _fd;
+      const char* _map;
+      size_t _mapSize;
+      std::vector<IndexEntry> _index;     // Chunks of the file as opened.
+
+      // Writing.
+      bool _writing;
+      bool _failed;
+      uint64_t _end;                      // Where the next chunk goes.
+      std::vector<IndexEntry> _newIndex;
+      std::multimap<uint64_t, size_t> _oldByHash;   // Into _index.
+      std::multimap<uint64_t, size_t> _newByHash;   // Into _newIndex.
+      FILE* _songFile;
+      char* _songBuf;
+      size_t _songSize;
+      std::vector<char> _pack;
+
+      static uint64_t hash(const char* p, size_t n);
+      bool readIndex();
+      const char* chunk(int n, ChunkType type, size_t* size) const;
+      int addChunk(ChunkType type, const char* p, size_t n);
+      bool sameChunk(const IndexEntry& e, const char* p, size_t n) const;
+      bool writeIndex(int fd, const std::vector<IndexEntry>& index, uint64_t offset);
+      bool compact(uint64_t live);
+      void unmap();
+
+   public:
+      BinSong();
+      ~BinSong();
+
+      static BinSong* current()         { return _current; }
+
+      // Maps the file for reading. songText() is the zero terminated
+      //  song xml until close().
+      bool open(const QString& path);
+      const char* songText() const;
+
+      // Starts saving to path. The song xml goes to songFile(),
+      //  then commit() writes it and the index.
+      bool create(const QString& path);
+      FILE* songFile() const            { return _songFile; }
+      bool writing() const              { return _writing; }
+      bool commit();
+      void close();
+
+      // Return the chunk number, or -1 on error.
+      int writeEvents(const Part* part);
+      int writeCtrl(const CtrlList* cl);
+      bool readEvents(int n, Part* part) const;
+      bool readCtrl(int n, CtrlList* cl) const;
+      };
+
+} // namespace MusECore
+
+#endif
@@ -265,7 +265,10 @@ void MidiTrackInfo::heartBeat()
     _blockHeartbeatCount = 0;
   }
   
-  if(_blockHeartbeatCount > 0 || !isVisible() || !isEnabled() || !selected)
+  // The controller states are set by posted messages. Wait for them, or the
+  //  controls would flick back to the old values for a moment.
+  if(_blockHeartbeatCount > 0 || MusEGlobal::audio->postedMsgsPending() ||
+     !isVisible() || !isEnabled() || !selected)
     return;
   switch(selected->type()) 
   {
@@ -992,6 +995,7 @@ void MidiTrackInfo::iTranspChanged(int val)
         return;
       MusECore::MidiTrack* track = (MusECore::MidiTrack*)selected;
       track->transposition = val;
+      MusEGlobal::song->freezeStale(track);
       }
 
 //---------------------------------------------------------
@@ -1004,6 +1008,7 @@ void MidiTrackInfo::iAnschlChanged(int val)
         return;
       MusECore::MidiTrack* track = (MusECore::MidiTrack*)selected;
       track->velocity = val;
+      MusEGlobal::song->freezeStale(track);
       }
 
 //---------------------------------------------------------
@@ -1016,6 +1021,7 @@ void MidiTrackInfo::iVerzChanged(int val)
         return;
       MusECore::MidiTrack* track = (MusECore::MidiTrack*)selected;
       track->delay = val;
+      MusEGlobal::song->freezeStale(track);
       }
 
 //---------------------------------------------------------
@@ -1028,6 +1034,7 @@ void MidiTrackInfo::iLenChanged(int val)
         return;
       MusECore::MidiTrack* track = (MusECore::MidiTrack*)selected;
       track->len = val;
+      MusEGlobal::song->freezeStale(track);
       }
 
 //---------------------------------------------------------
@@ -1040,6 +1047,7 @@ void MidiTrackInfo::iKomprChanged(int val)
         return;
       MusECore::MidiTrack* track = (MusECore::MidiTrack*)selected;
       track->compression = val;
+      MusEGlobal::song->freezeStale(track);
       }
 
 //---------------------------------------------------------
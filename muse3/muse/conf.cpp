@@ -1099,6 +1099,24 @@ void readConfiguration(Xml& xml, bool doReadMidiPortConfig, bool doReadGlobalCon
 
                         else if (tag == "minControlProcessPeriod")
                               MusEGlobal::config.minControlProcessPeriod = xml.parseUInt();
+                        else if (tag == "audioWorkerThreads")
+                              MusEGlobal::config.audioWorkerThreads = xml.parseInt();
+                        else if (tag == "audioPrefetchThreads")
+                              MusEGlobal::config.audioPrefetchThreads = xml.parseInt();
+                        else if (tag == "waveCacheSize")
+                              MusEGlobal::config.waveCacheSize = xml.parseInt();
+                        else if (tag == "latencyCompensation")
+                              MusEGlobal::config.latencyCompensation = xml.parseInt();
+                        else if (tag == "undoMemoryLimit")
+                              MusEGlobal::config.undoMemoryLimit = xml.parseInt();
+                        else if (tag == "rtAllocFailSafe")
+                              MusEGlobal::config.rtAllocFailSafe = xml.parseInt();
+                        else if (tag == "pluginShareInstances")
+                              MusEGlobal::config.pluginShareInstances = xml.parseInt();
+                        else if (tag == "pluginSilenceSkip")
+                              MusEGlobal::config.pluginSilenceSkip = xml.parseInt();
+                        else if (tag == "pluginSilenceTail")
+                              MusEGlobal::config.pluginSilenceTail = xml.parseInt();
                         else if (tag == "guiRefresh")
                               MusEGlobal::config.guiRefresh = xml.parseInt();
                         else if (tag == "userInstrumentsDir")                        // Obsolete
@@ -1654,6 +1672,15 @@ void MusE::writeGlobalConfiguration(int level, MusECore::Xml& xml) const
 
 
       xml.uintTag(level, "minControlProcessPeriod", MusEGlobal::config.minControlProcessPeriod);
+      xml.intTag(level, "audioWorkerThreads", MusEGlobal::config.audioWorkerThreads);
+      xml.intTag(level, "audioPrefetchThreads", MusEGlobal::config.audioPrefetchThreads);
+      xml.intTag(level, "waveCacheSize", MusEGlobal::config.waveCacheSize);
+      xml.intTag(level, "latencyCompensation", MusEGlobal::config.latencyCompensation);
+      xml.intTag(level, "undoMemoryLimit", MusEGlobal::config.undoMemoryLimit);
+      xml.intTag(level, "rtAllocFailSafe", MusEGlobal::config.rtAllocFailSafe);
+      xml.intTag(level, "pluginShareInstances", MusEGlobal::config.pluginShareInstances);
+      xml.intTag(level, "pluginSilenceSkip", MusEGlobal::config.pluginSilenceSkip);
+      xml.intTag(level, "pluginSilenceTail", MusEGlobal::config.pluginSilenceTail);
       xml.intTag(level, "guiRefresh", MusEGlobal::config.guiRefresh);
       
       xml.intTag(level, "extendedMidi", MusEGlobal::config.extendedMidi);
@@ -30,15 +30,19 @@
 #include <QLocale>
 #include <QColor>
 #include <map>
+#include <algorithm>
+#include <iterator>
 
 #include <math.h>
 
+#include "al/dsp.h"
 #include "gconfig.h"
 #include "fastlog.h"
 #include "globals.h"
 #include "ctrl.h"
 #include "midictrl.h"
 #include "xml.h"
+#include "binsong.h"
 
 namespace MusECore {
 
@@ -328,6 +332,7 @@ CtrlList::CtrlList(bool dontShow)
       _dontShow = dontShow;
       _visible = false;
       _guiUpdatePending = false;
+      _guiSerial.store(0);
       initColor(0);
       }
 
@@ -340,6 +345,7 @@ CtrlList::CtrlList(int id, bool dontShow)
       _dontShow = dontShow;
       _visible = false;
       _guiUpdatePending = false;
+      _guiSerial.store(0);
       initColor(id);
       }
 
@@ -356,6 +362,7 @@ CtrlList::CtrlList(int id, QString name, double min, double max, CtrlValueType v
       _dontShow = dontShow;
       _visible = false;
       _guiUpdatePending = false;
+      _guiSerial.store(0);
       initColor(id);
 }
 
@@ -363,6 +370,8 @@ CtrlList::CtrlList(const CtrlList& l, int flags)
 {
   _id        = l._id;
   _valueType = l._valueType;
+  _guiUpdatePending = false;
+  _guiSerial.store(0);
   assign(l, flags | ASSIGN_PROPERTIES);
 }
 
@@ -388,7 +397,7 @@ void CtrlList::assign(const CtrlList& l, int flags)
   if(flags & ASSIGN_VALUES)
   {
     std::map<int, CtrlVal, std::less<int> >::operator=(l); // Let map copy the items.
-    _guiUpdatePending = true;
+    setGuiUpdatePending(true);
   }
 }
 
@@ -515,6 +524,93 @@ double CtrlList::interpolate(int frame, const CtrlInterpolate& interp)
   return val1;
 }
 
+//---------------------------------------------------------
+//   render
+//   Writes the values of n frames starting at frame into dst.
+//   Gives the same values as getInterpolation() followed by
+//    interpolate() for each frame, but walks the list only once.
+//   Linear ramps are computed directly and log ramps with a
+//    constant factor per frame, so no log or exp per frame.
+//    Both are done by the AL::Dsp ramp routines.
+//---------------------------------------------------------
+
+void CtrlList::render(int frame, unsigned n, float* dst, bool cur_val_only) const
+{
+  const bool is_log = _valueType == VAL_LOG;
+  const double min_val = is_log ? exp10(MusEGlobal::config.minSlider / 20.0) : 0.0;
+
+  if(cur_val_only || empty())
+  {
+    double v = _curVal;
+    if(is_log && v < min_val)
+      v = min_val;
+    std::fill(dst, dst + n, (float)v);
+    return;
+  }
+
+  ciCtrl i = upper_bound(frame);
+  unsigned k = 0;
+  while(k < n)
+  {
+    if(i == end())   // Past all items. Hold the last value.
+    {
+      double v = (--i)->second.val;
+      if(is_log && v < min_val)
+        v = min_val;
+      std::fill(dst + k, dst + n, (float)v);
+      return;
+    }
+
+    const int f = frame + k;
+    const int f2 = i->second.frame;
+    const unsigned run = ((unsigned)(f2 - frame) < n ? (unsigned)(f2 - frame) : n) - k;
+    float* d = dst + k;
+
+    int f1 = 0;
+    double v1 = i->second.val;
+    double v2 = v1;
+    if(i != begin())
+    {
+      ciCtrl p = std::prev(i);
+      f1 = p->second.frame;
+      v1 = p->second.val;
+      v2 = (_mode == DISCRETE) ? v1 : i->second.val;
+    }
+
+    unsigned j = 0;
+    if(f == f1)     // interpolate() returns the start value as is.
+      d[j++] = (is_log && v1 < min_val) ? min_val : v1;
+
+    if(is_log)
+    {
+      // Same dB conversion and clamping as interpolate().
+      v1 = 20.0*fast_log10(v1);
+      if(v1 < MusEGlobal::config.minSlider)
+        v1 = MusEGlobal::config.minSlider;
+      v2 = 20.0*fast_log10(v2);
+      if(v2 < MusEGlobal::config.minSlider)
+        v2 = MusEGlobal::config.minSlider;
+      if(v1 == v2)
+        std::fill(d + j, d + run, (float)exp10(v1 / 20.0));
+      else
+      {
+        const double slope = (v2 - v1) / double(f2 - f1);
+        AL::dsp->expRamp(d + j, run - j, exp10((v1 + double(f + (int)j - f1) * slope) / 20.0), exp10(slope / 20.0));
+      }
+    }
+    else if(v1 == v2)
+      std::fill(d + j, d + run, (float)v1);
+    else
+    {
+      const double slope = (v2 - v1) / double(f2 - f1);
+      AL::dsp->linearRamp(d + j, run - j, v1 + double(f + (int)j - f1) * slope, slope);
+    }
+
+    k += run;
+    ++i;
+  }
+}
+
 //---------------------------------------------------------
 //   value
 //   Returns value at frame.
@@ -621,10 +717,12 @@ void CtrlList::setCurVal(double val)
   
   bool upd = (val != _curVal);
   _curVal = val;
+  if(upd)
+    touchGui();
   // If empty, any controller graphs etc. will be displaying this value.
   // Otherwise they'll be displaying the list, so update is not required.
   if(empty() && upd)     
-    _guiUpdatePending = true;
+    setGuiUpdatePending(true);
 }
 
 //---------------------------------------------------------
@@ -652,7 +750,7 @@ CtrlList& CtrlList::operator=(const CtrlList& cl)
   
   // Let map copy the items.
   std::map<int, CtrlVal, std::less<int> >::operator=(cl);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
   return *this;
 }
 
@@ -663,7 +761,7 @@ void CtrlList::swap(CtrlList& cl)
 #endif
   std::map<int, CtrlVal, std::less<int> >::swap(cl);
   cl.setGuiUpdatePending(true);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
 }
 
 std::pair<iCtrl, bool> CtrlList::insert(const std::pair<int, CtrlVal>& p)
@@ -672,7 +770,7 @@ std::pair<iCtrl, bool> CtrlList::insert(const std::pair<int, CtrlVal>& p)
   printf("CtrlList::insert frame:%d val:%f\n", p.first, p.second.val);  
 #endif
   std::pair<iCtrl, bool> res = std::map<int, CtrlVal, std::less<int> >::insert(p);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
   return res;
 }
 
@@ -682,7 +780,7 @@ iCtrl CtrlList::insert(iCtrl ic, const std::pair<int, CtrlVal>& p)
   printf("CtrlList::insert2 frame:%d val:%f\n", p.first, p.second.val); 
 #endif
   iCtrl res = std::map<int, CtrlVal, std::less<int> >::insert(ic, p);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
   return res;
 }
 
@@ -692,7 +790,7 @@ void CtrlList::insert(iCtrl first, iCtrl last)
   printf("CtrlList::insert3 first frame:%d last frame:%d\n", first->first, last->first); 
 #endif
   std::map<int, CtrlVal, std::less<int> >::insert(first, last);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
 }
 
 void CtrlList::erase(iCtrl ictl)
@@ -701,7 +799,7 @@ void CtrlList::erase(iCtrl ictl)
   printf("CtrlList::erase iCtrl frame:%d val:%f\n", ictl->second.frame, ictl->second.val);  
 #endif
   std::map<int, CtrlVal, std::less<int> >::erase(ictl);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
 }
 
 std::map<int, CtrlVal, std::less<int> >::size_type CtrlList::erase(int frame)
@@ -710,7 +808,7 @@ std::map<int, CtrlVal, std::less<int> >::size_type CtrlList::erase(int frame)
   printf("CtrlList::erase frame:%d\n", frame);  
 #endif
   size_type res = std::map<int, CtrlVal, std::less<int> >::erase(frame);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
   return res;
 }
 
@@ -722,7 +820,7 @@ void CtrlList::erase(iCtrl first, iCtrl last)
          last->second.frame, last->second.val);  
 #endif
   std::map<int, CtrlVal, std::less<int> >::erase(first, last);
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
 }
 
 void CtrlList::clear()
@@ -731,7 +829,7 @@ void CtrlList::clear()
   printf("CtrlList::clear\n");  
 #endif
   std::map<int, CtrlVal, std::less<int> >::clear();
-  _guiUpdatePending = true;
+  setGuiUpdatePending(true);
 }
 
 //---------------------------------------------------------
@@ -750,7 +848,7 @@ void CtrlList::add(int frame, double val)
             printf("CtrlList::add frame:%d val:%f\n", frame, val);  
 #endif
             if(upd)
-              _guiUpdatePending = true;
+              setGuiUpdatePending(true);
       }
       else
             insert(std::pair<const int, CtrlVal> (frame, CtrlVal(frame, val)));
@@ -783,7 +881,7 @@ void CtrlList::updateCurValue(int frame)
   // If empty, any controller graphs etc. will be displaying this value.
   // Otherwise they'll be displaying the list, so update is not required.
   if(empty() && upd)     
-    _guiUpdatePending = true;
+    setGuiUpdatePending(true);
 }
       
 //---------------------------------------------------------
@@ -831,6 +929,14 @@ void CtrlList::read(Xml& xml)
 #endif
                               _displayColor.setNamedColor(xml.s2());
                         }
+                        else if (tag == "chunk")
+                        {
+                              // Points packed in a chunk of a binary song file.
+                              const int chunk = loc.toInt(xml.s2(), &ok);
+                              BinSong* bs = BinSong::current();
+                              if(!ok || !bs || !bs->readCtrl(chunk, this))
+                                printf("CtrlList::read failed reading chunk: %s\n", xml.s2().toLatin1().constData());
+                        }
                         else
                               printf("unknown tag %s\n", tag.toLatin1().constData());
                         break;
@@ -957,6 +1063,11 @@ void CtrlListList::write(int level, Xml& xml) const
 
         QString s= QString("controller id=\"%1\" cur=\"%2\"").arg(cl->id()).arg(cl->curVal());
         s += QString(" color=\"%1\" visible=\"%2\"").arg(cl->color().name()).arg(cl->isVisible());
+        BinSong* bs = BinSong::current();
+        if (bs && bs->writing() && !cl->empty()) {
+              xml.tag(level, "%s chunk=\"%d\" /", s.toLatin1().constData(), bs->writeCtrl(cl));
+              continue;
+              }
         xml.tag(level++, s.toLatin1().constData());
         int i = 0;
         for (ciCtrl ic = cl->begin(); ic != cl->end(); ++ic) {
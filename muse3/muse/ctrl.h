@@ -30,6 +30,7 @@
 #include <map>
 #include <list>
 #include <vector>
+#include <atomic>
 #include <qcolor.h>
 
 #ifdef OSC_SUPPORT
@@ -185,6 +186,7 @@ class CtrlList : public std::map<int, CtrlVal, std::less<int> > {
       bool _visible;
       bool _dontShow; // when this is true the control exists but is not compatible with viewing in the arranger
       volatile bool _guiUpdatePending; // Gui heartbeat routines read this. Checked and cleared in Song::beat().
+      std::atomic<unsigned> _guiSerial; // Bumped on every change to this list or its current value.
       void initColor(int i);
 
    public:
@@ -228,6 +230,8 @@ class CtrlList : public std::map<int, CtrlVal, std::less<int> > {
       void setValueType(CtrlValueType t) { _valueType = t; }
       void getInterpolation(int frame, bool cur_val_only, CtrlInterpolate* interp);
       double interpolate(int frame, const CtrlInterpolate& interp);
+      // Renders n frames of the lane starting at frame into dst, in one pass.
+      void render(int frame, unsigned n, float* dst, bool cur_val_only = false) const;
       
       double value(int frame, bool cur_val_only = false, int* nextFrame = NULL) const;  
       void add(int frame, double value);
@@ -240,7 +244,15 @@ class CtrlList : public std::map<int, CtrlVal, std::less<int> > {
       bool isVisible() const { return _visible; }
       bool dontShow() const { return _dontShow; }
       bool guiUpdatePending() const { return _guiUpdatePending; }
-      void setGuiUpdatePending(bool v) { _guiUpdatePending = v; }
+      void setGuiUpdatePending(bool v) {
+            _guiUpdatePending = v;
+            if(v)
+              _guiSerial.fetch_add(1, std::memory_order_release);
+            }
+      // Changes whenever the list or its current value changes, in any thread.
+      // The gui need not refresh controls on it while it stays the same.
+      unsigned guiSerial() const { return _guiSerial.load(std::memory_order_acquire); }
+      void touchGui()            { _guiSerial.fetch_add(1, std::memory_order_release); }
       };
 
 //---------------------------------------------------------
@@ -29,6 +29,8 @@
 #include <sys/poll.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <sched.h>
+#include <atomic>
 
 #include "config.h"
 #include "audio.h"
@@ -62,6 +64,8 @@ class DummyAudioDevice : public AudioDevice {
       uint64_t _timeUSAtCycleStart[2];
       unsigned _frameCounter[2];
       unsigned _criticalVariablesIdx;
+      // Run cycles back to back instead of in realtime.
+      std::atomic<bool> _freewheel;
       
    public:
       // Time in microseconds at which the driver was created.
@@ -108,6 +112,9 @@ class DummyAudioDevice : public AudioDevice {
       virtual unsigned framesAtCycleStart() const { return _framesAtCycleStart[_criticalVariablesIdx]; }
       virtual unsigned framesSinceCycleStart() const 
       { 
+        // Wall time has nothing to do with the position when freewheeling.
+        if(_freewheel.load(std::memory_order_relaxed))
+          return 0;
         const uint64_t ct = systemTimeUS();
         DEBUG_DUMMY(stderr, "DummyAudioDevice::framesSinceCycleStart systemTimeUS:%lu timeUSAtCycleStart:%lu\n", 
                 ct, _timeUSAtCycleStart[_criticalVariablesIdx]);
@@ -176,7 +183,12 @@ class DummyAudioDevice : public AudioDevice {
       //virtual int realtimePriority() const { return 40; }
       virtual int realtimePriority() const { return _realTimePriority; }
 
-      virtual void setFreewheel(bool) {}
+      virtual void setFreewheel(bool f)
+      {
+        _freewheel = f;
+        MusEGlobal::audio->setFreewheel(f);
+      }
+      bool freewheel() const { return _freewheel.load(std::memory_order_relaxed); }
       virtual int setMaster(bool) { return 1; }
       };
 
@@ -203,6 +215,7 @@ DummyAudioDevice::DummyAudioDevice() : AudioDevice()
         memset(buffer, 0, sizeof(float) * MusEGlobal::segmentSize);
 
       dummyThread = 0;
+      _freewheel = false;
       _start_timeUS = systemTimeUS();
       _criticalVariablesIdx = 0;
       for(unsigned x = 0; x < 2; ++x)
@@ -270,15 +283,39 @@ std::list<QString> DummyAudioDevice::inputPorts(bool midi, int /*aliases*/)
 
 //---------------------------------------------------------
 //   dummyLoop
+//    While a bounce is freewheeling the cycles run back to
+//     back, as fast as the cpu allows. The thread leaves
+//     realtime scheduling for that time so that it cannot
+//     lock out the rest of the system.
 //---------------------------------------------------------
 
 static void* dummyLoop(void* ptr)
       {
 
       DummyAudioDevice *drvPtr = (DummyAudioDevice *)ptr;
+      bool freewheeling = false;
+      int rtPolicy = SCHED_OTHER;
+      struct sched_param rtParam;
+      memset(&rtParam, 0, sizeof(rtParam));
       
       for(;;) 
       {
+        // Stop as soon as the bounce reaches its end, not when the gui gets to it.
+        const bool fw = drvPtr->freewheel() && MusEGlobal::audio->bounce();
+        if(fw != freewheeling)
+        {
+          if(fw)
+          {
+            pthread_getschedparam(pthread_self(), &rtPolicy, &rtParam);
+            struct sched_param p;
+            memset(&p, 0, sizeof(p));
+            pthread_setschedparam(pthread_self(), SCHED_OTHER, &p);
+          }
+          else
+            pthread_setschedparam(pthread_self(), rtPolicy, &rtParam);
+          freewheeling = fw;
+        }
+
         drvPtr->setCriticalVariables(MusEGlobal::segmentSize);
   
         if(MusEGlobal::audio->isRunning()) {
@@ -288,7 +325,10 @@ static void* dummyLoop(void* ptr)
           drvPtr->processTransport(MusEGlobal::segmentSize);
         }
 
-        usleep(MusEGlobal::segmentSize*1000000/MusEGlobal::sampleRate);
+        if(freewheeling)
+          pthread_testcancel();
+        else
+          usleep(MusEGlobal::segmentSize*1000000/MusEGlobal::sampleRate);
       }
       pthread_exit(0);
       }
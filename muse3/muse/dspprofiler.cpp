@@ -0,0 +1,269 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  dspprofiler.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <algorithm>
+
+#include <QFile>
+#include <QString>
+#include <QTextStream>
+
+#include "dspprofiler.h"
+#include "globals.h"
+
+namespace MusEGlobal {
+MusECore::DspProfiler* dspProfiler = NULL;
+}
+
+namespace MusECore {
+
+// Time spent in scopes nested in the current one, per thread.
+static thread_local uint64_t childNS = 0;
+
+void initDspProfiler()
+{
+  MusEGlobal::dspProfiler = new DspProfiler();
+}
+
+//---------------------------------------------------------
+//   DspProfiler
+//---------------------------------------------------------
+
+DspProfiler::DspProfiler()
+      {
+      _slots = new Slot[MAX_SLOTS];
+      _enabled = false;
+      _resetRequest = 0;
+      _resetDone = 0;
+      _dropped = 0;
+      clear();
+      }
+
+DspProfiler::~DspProfiler()
+      {
+      delete[] _slots;
+      }
+
+//---------------------------------------------------------
+//   clear
+//---------------------------------------------------------
+
+void DspProfiler::clear()
+      {
+      for (int i = 0; i < MAX_SLOTS; ++i) {
+            _slots[i].count.store(0, std::memory_order_relaxed);
+            _slots[i].key.store(0, std::memory_order_release);
+            }
+      _dropped = 0;
+      }
+
+//---------------------------------------------------------
+//   setEnabled
+//---------------------------------------------------------
+
+void DspProfiler::setEnabled(bool v)
+      {
+      if (v && !enabled())
+            reset();
+      _enabled.store(v);
+      }
+
+//---------------------------------------------------------
+//   beginCycle
+//    No scope is running now, so the table can be cleared.
+//---------------------------------------------------------
+
+void DspProfiler::beginCycle()
+      {
+      const unsigned r = _resetRequest.load(std::memory_order_acquire);
+      if (r != _resetDone) {
+            clear();
+            _resetDone = r;
+            }
+      }
+
+//---------------------------------------------------------
+//   slot
+//    Linear probing from the hash of the key. New keys
+//     claim a free slot, slots are only freed by clear().
+//---------------------------------------------------------
+
+DspProfiler::Slot* DspProfiler::slot(uintptr_t key, bool create)
+      {
+      unsigned h = unsigned((uint64_t(key) * 0x9e3779b97f4a7c15ULL) >> 32) % MAX_SLOTS;
+      for (int n = 0; n < MAX_SLOTS; ++n) {
+            Slot* s = &_slots[h];
+            uintptr_t k = s->key.load(std::memory_order_acquire);
+            if (k == key)
+                  return s;
+            if (k == 0) {
+                  if (!create)
+                        return 0;
+                  if (s->key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+                        return s;
+                  if (k == key)       // Another thread claimed it for the same node.
+                        return s;
+                  }
+            if (++h == MAX_SLOTS)
+                  h = 0;
+            }
+      return 0;
+      }
+
+const DspProfiler::Slot* DspProfiler::slot(uintptr_t key) const
+      {
+      return const_cast<DspProfiler*>(this)->slot(key, false);
+      }
+
+//---------------------------------------------------------
+//   record
+//    Only one thread runs a given node in a cycle.
+//---------------------------------------------------------
+
+void DspProfiler::record(const void* owner, Kind kind, uint64_t ns)
+      {
+      Slot* s = slot(makeKey(owner, kind), true);
+      if (!s) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+            }
+      const unsigned c = s->count.load(std::memory_order_relaxed);
+      s->ns[c % HISTORY].store(ns > 0xffffffffULL ? 0xffffffffU : uint32_t(ns), std::memory_order_relaxed);
+      s->count.store(c + 1, std::memory_order_release);
+      }
+
+//---------------------------------------------------------
+//   stats
+//    Returns false if the node has no samples.
+//---------------------------------------------------------
+
+bool DspProfiler::stats(const void* owner, Kind kind, DspStats* st) const
+      {
+      const Slot* s = slot(makeKey(owner, kind));
+      if (!s)
+            return false;
+      const unsigned c = s->count.load(std::memory_order_acquire);
+      const unsigned n = c < (unsigned)HISTORY ? c : HISTORY;
+      if (n == 0)
+            return false;
+
+      uint32_t v[HISTORY];
+      uint64_t sum = 0;
+      for (unsigned i = 0; i < n; ++i) {
+            v[i] = s->ns[i].load(std::memory_order_relaxed);
+            sum += v[i];
+            }
+      std::sort(v, v + n);
+
+      st->count = c;
+      st->min = v[0] / 1000.0;
+      st->max = v[n - 1] / 1000.0;
+      st->avg = double(sum) / n / 1000.0;
+      st->p50 = v[(n - 1) * 50 / 100] / 1000.0;
+      st->p95 = v[(n - 1) * 95 / 100] / 1000.0;
+      st->p99 = v[(n - 1) * 99 / 100] / 1000.0;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   cycleUS
+//---------------------------------------------------------
+
+double DspProfiler::cycleUS()
+      {
+      if (MusEGlobal::sampleRate <= 0)
+            return 0.0;
+      return double(MusEGlobal::segmentSize) * 1000000.0 / double(MusEGlobal::sampleRate);
+      }
+
+//---------------------------------------------------------
+//   writeCsv
+//---------------------------------------------------------
+
+bool DspProfiler::writeCsv(const QString& path, const std::vector<DspCsvRow>& rows) const
+      {
+      QFile f(path);
+      if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            fprintf(stderr, "DspProfiler: cannot write <%s>\n", path.toLocal8Bit().constData());
+            return false;
+            }
+      QTextStream out(&f);
+      out << "kind,name,count,min_us,avg_us,p50_us,p95_us,p99_us,max_us,load_pct,instances,shared,heap_kb_estimate,run_cycles,skipped_cycles\n";
+
+      const double cyc = cycleUS();
+      uint64_t runCycles = 0, skippedCycles = 0;
+      for (std::vector<DspCsvRow>::const_iterator r = rows.begin(); r != rows.end(); ++r) {
+            if (r->hasCycles) {
+                  runCycles     += r->runCycles;
+                  skippedCycles += r->skippedCycles;
+                  }
+            DspStats st;
+            if (!stats(r->owner, Kind(r->kind), &st))
+                  continue;
+            QString n = r->name;
+            n.replace('"', "\"\"");
+            out << r->kindName << ",\"" << n << "\"," << st.count << ','
+                << st.min << ',' << st.avg << ',' << st.p50 << ',' << st.p95 << ','
+                << st.p99 << ',' << st.max << ',' << (cyc > 0.0 ? 100.0 * st.avg / cyc : 0.0) << ',';
+            if (r->hasInstances)
+                  out << r->instances << ',' << r->shared << ',' << (r->heapBytes + 512) / 1024;
+            else
+                  out << ",,";
+            out << ',';
+            if (r->hasCycles)
+                  out << r->runCycles << ',' << r->skippedCycles;
+            else
+                  out << ',';
+            out << '\n';
+            }
+      out << "# " << skippedCycles << " of " << runCycles << " plugin and synth cycles skipped for silence\n";
+      if (dropped())
+            out << "# " << dropped() << " samples dropped, table full\n";
+      return true;
+      }
+
+//---------------------------------------------------------
+//   DspProfileScope
+//---------------------------------------------------------
+
+DspProfileScope::DspProfileScope(const void* owner, DspProfiler::Kind kind)
+      : _owner(owner), _kind(kind), _start(0), _outerChild(0)
+      {
+      if (!MusEGlobal::dspProfiler || !MusEGlobal::dspProfiler->enabled())
+            return;
+      _outerChild = childNS;
+      childNS = 0;
+      _start = DspProfiler::now();
+      }
+
+DspProfileScope::~DspProfileScope()
+      {
+      if (!_start)
+            return;
+      const uint64_t dt = DspProfiler::now() - _start;
+      const uint64_t self = (_kind == DspProfiler::CYCLE || childNS > dt) ? dt : dt - childNS;
+      childNS = _outerChild + dt;
+      MusEGlobal::dspProfiler->record(_owner, _kind, self);
+      }
+
+} // namespace MusECore
@@ -0,0 +1,167 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  dspprofiler.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __DSPPROFILER_H__
+#define __DSPPROFILER_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <vector>
+
+#include <QString>
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   DspStats
+//    Times in microseconds over the recorded history.
+//---------------------------------------------------------
+
+struct DspStats {
+      unsigned count;
+      double min;
+      double avg;
+      double p50;
+      double p95;
+      double p99;
+      double max;
+      };
+
+//---------------------------------------------------------
+//   DspCsvRow
+//    A node to write a CSV line for. Plugins also get their
+//     number of instances and roughly the heap those took,
+//     plugins and synths the cycles they were run for and
+//     skipped for silence since created.
+//---------------------------------------------------------
+
+struct DspCsvRow {
+      const void* owner;
+      int kind;                  // DspProfiler::Kind
+      const char* kindName;
+      QString name;
+      bool hasInstances;
+      int instances;
+      bool shared;
+      size_t heapBytes;
+      bool hasCycles;
+      uint64_t runCycles;
+      uint64_t skippedCycles;
+
+      DspCsvRow(const void* o, int k, const char* kn, const QString& n)
+         : owner(o), kind(k), kindName(kn), name(n), hasInstances(false), instances(0), shared(false),
+           heapBytes(0), hasCycles(false), runCycles(0), skippedCycles(0) {}
+      };
+
+//---------------------------------------------------------
+//   DspProfiler
+//    Per cycle timing of the audio process, each track,
+//     plugin, synth and meter and the midi processing.
+//    Each node is timed with a DspProfileScope by whatever
+//     thread runs it. The time spent in nested scopes is
+//     subtracted, so a track does not include its plugins
+//     or the tracks it pulls from. Only the cycle itself
+//     is recorded including everything.
+//    The samples go into a fixed ring per node, found by
+//     owner and kind in an open addressed table. Nothing
+//     is locked or allocated in the audio threads, the
+//     gui thread just reads the rings.
+//---------------------------------------------------------
+
+class DspProfiler {
+   public:
+      enum Kind { CYCLE = 0, TRACK, PLUGIN, SYNTH, METER, MIDI };
+      static const int MAX_SLOTS = 512;
+      static const int HISTORY   = 512;   // Samples kept per slot.
+
+   private:
+      struct Slot {
+            std::atomic<uintptr_t> key;   // Owner pointer or'ed with kind, zero if free.
+            std::atomic<unsigned> count;  // Samples written so far.
+            std::atomic<uint32_t> ns[HISTORY];
+            };
+
+      Slot* _slots;
+      std::atomic<bool> _enabled;
+      std::atomic<unsigned> _resetRequest;
+      unsigned _resetDone;
+      std::atomic<unsigned> _dropped;     // Samples with no free slot.
+
+      static uintptr_t makeKey(const void* owner, Kind kind) { return (uintptr_t)owner | (uintptr_t)kind; }
+      Slot* slot(uintptr_t key, bool create);
+      const Slot* slot(uintptr_t key) const;
+      void clear();
+
+   public:
+      DspProfiler();
+      ~DspProfiler();
+
+      static uint64_t now() {
+            struct timespec t;
+            clock_gettime(CLOCK_MONOTONIC, &t);
+            return uint64_t(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+            }
+
+      bool enabled() const        { return _enabled.load(std::memory_order_relaxed); }
+      void setEnabled(bool v);
+      // Asks the audio thread to forget all samples at the start of the next cycle.
+      void reset()                { _resetRequest.fetch_add(1); }
+
+      // Called by the audio thread before anything else in the cycle.
+      void beginCycle();
+      void record(const void* owner, Kind kind, uint64_t ns);
+
+      // Gui thread.
+      bool stats(const void* owner, Kind kind, DspStats* st) const;
+      // Samples not recorded because the table was full.
+      unsigned dropped() const    { return _dropped.load(); }
+      // Length of one cycle in microseconds, for load percentages.
+      static double cycleUS();
+      // One line per row which has samples, in the order given.
+      bool writeCsv(const QString& path, const std::vector<DspCsvRow>& rows) const;
+      };
+
+//---------------------------------------------------------
+//   DspProfileScope
+//    Times the enclosing block, if profiling is enabled.
+//---------------------------------------------------------
+
+class DspProfileScope {
+      const void* _owner;
+      DspProfiler::Kind _kind;
+      uint64_t _start;
+      uint64_t _outerChild;
+
+   public:
+      DspProfileScope(const void* owner, DspProfiler::Kind kind);
+      ~DspProfileScope();
+      };
+
+} // namespace MusECore
+
+namespace MusEGlobal {
+extern MusECore::DspProfiler* dspProfiler;
+}
+
+#endif
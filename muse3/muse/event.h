@@ -32,6 +32,7 @@
 #include "evdata.h"
 #include "mpevent.h"
 #include "wave.h" // for SndFileR
+#include "event_chunk_list.h"
 
 class QString;
 
@@ -142,7 +143,7 @@ class Event {
       void setPos(const Pos& p);
       };
 
-typedef std::multimap <unsigned, Event, std::less<unsigned> > EL;
+typedef EventChunkList<Event> EL;
 typedef EL::iterator iEvent;
 typedef EL::reverse_iterator riEvent;
 typedef EL::const_iterator ciEvent;
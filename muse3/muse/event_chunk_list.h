@@ -0,0 +1,560 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  event_chunk_list.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __EVENT_CHUNK_LIST_H__
+#define __EVENT_CHUNK_LIST_H__
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   EventChunkList
+//    Sorted multimap from tick to E, the base of EventList.
+//    The entries are linked nodes allocated in blocks, so
+//     like std::multimap an insert or erase leaves iterators
+//     and pointers to all other entries valid, while a list
+//     loaded in order is iterated in consecutive memory.
+//    Searches go through an index of (key, node) pairs kept
+//     in chunks of up to CHUNK, with the last key of every
+//     chunk in a separate array for the binary search.
+//     An insert or erase only moves index entries of one
+//     chunk.
+//    Equal keys keep insertion order like std::multimap.
+//---------------------------------------------------------
+
+template <class E> class EventChunkList {
+   public:
+      typedef unsigned key_type;
+      typedef E mapped_type;
+      // The key is const like in std::multimap, changing it through an
+      //  iterator would break the order of the list and its index.
+      typedef std::pair<const unsigned, E> value_type;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      static const size_t CHUNK      = 256;   // Index entries per chunk, at most.
+      static const size_t MIN_BLOCK  = 8;     // Nodes of the first block of an empty list.
+      static const size_t NODE_BLOCK = 256;   // Nodes per block once a list has grown.
+
+   private:
+      struct Node {
+            Node* prev;
+            Node* next;
+            value_type v;
+            };
+      struct Entry {
+            unsigned key;
+            Node* node;
+            };
+      struct Chunk {
+            size_t n;
+            size_t cap;
+            Entry* e;
+            };
+
+      Node* _head;                       // Sentinel, the end().
+      Node* _free;                       // Free nodes, linked by next.
+      std::vector<Node*> _blocks;
+      size_t _nodes;                     // Nodes in all blocks.
+      size_t _nextBlock;                 // Nodes of the next block.
+      std::vector<Chunk> _chunks;
+      std::vector<unsigned> _lastKey;    // Key of the last entry of each chunk.
+      size_t _size;
+
+      static bool entryLess(const Entry& e, unsigned key) { return e.key < key; }
+      static bool keyLess(unsigned key, const Entry& e)   { return key < e.key; }
+
+      void init();
+      void addBlock(size_t n);
+      Node* newNode(const value_type& v);
+      void freeNode(Node* n);
+      void addChunk(size_t c, size_t cap);
+      void removeChunk(size_t c);
+      void growChunk(size_t c, size_t cap);
+      void updateKey(size_t c) { _lastKey[c] = _chunks[c].e[_chunks[c].n - 1].key; }
+      Node* nodeAt(size_t c, size_t i) const { return c < _chunks.size() ? _chunks[c].e[i].node : _head; }
+      void lowerPos(unsigned key, size_t* c, size_t* i) const;
+      void upperPos(unsigned key, size_t* c, size_t* i) const;
+      void findPos(const Node* n, size_t* c, size_t* i) const;
+      Node* insertAt(size_t c, size_t i, Node* before, const value_type& v);
+      void copyFrom(const EventChunkList&);
+
+   public:
+      //---------------------------------------------------
+      //   Iter
+      //---------------------------------------------------
+
+      template <class V, class N> class Iter {
+            N* _node;
+            friend class EventChunkList;
+            template <class V2, class N2> friend class Iter;
+
+            explicit Iter(N* n) : _node(n) {}
+
+         public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef V value_type;
+            typedef ptrdiff_t difference_type;
+            typedef V* pointer;
+            typedef V& reference;
+
+            Iter() : _node(0) {}
+            // iterator to const_iterator
+            template <class V2, class N2> Iter(const Iter<V2, N2>& o) : _node(o._node) {}
+
+            V& operator*() const  { return _node->v; }
+            V* operator->() const { return &_node->v; }
+            Iter& operator++()    { _node = _node->next; return *this; }
+            Iter& operator--()    { _node = _node->prev; return *this; }
+            Iter operator++(int)  { Iter t(*this); _node = _node->next; return t; }
+            Iter operator--(int)  { Iter t(*this); _node = _node->prev; return t; }
+
+            template <class V2, class N2> bool operator==(const Iter<V2, N2>& o) const { return _node == o._node; }
+            template <class V2, class N2> bool operator!=(const Iter<V2, N2>& o) const { return _node != o._node; }
+            };
+
+      typedef Iter<value_type, Node> iterator;
+      typedef Iter<const value_type, const Node> const_iterator;
+      typedef std::reverse_iterator<iterator> reverse_iterator;
+      typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+      EventChunkList() { init(); }
+      EventChunkList(const EventChunkList& o) { init(); copyFrom(o); }
+      EventChunkList& operator=(const EventChunkList& o);
+      ~EventChunkList() { clear(); delete _head; }
+
+      iterator begin()                       { return iterator(_head->next); }
+      iterator end()                         { return iterator(_head); }
+      const_iterator begin() const           { return const_iterator(_head->next); }
+      const_iterator end() const             { return const_iterator(_head); }
+      const_iterator cbegin() const          { return begin(); }
+      const_iterator cend() const            { return end(); }
+      reverse_iterator rbegin()              { return reverse_iterator(end()); }
+      reverse_iterator rend()                { return reverse_iterator(begin()); }
+      const_reverse_iterator rbegin() const  { return const_reverse_iterator(end()); }
+      const_reverse_iterator rend() const    { return const_reverse_iterator(begin()); }
+
+      bool empty() const  { return _size == 0; }
+      size_t size() const { return _size; }
+      // Bytes used by nodes and index, for statistics.
+      size_t memoryUsage() const;
+      void clear();
+      void swap(EventChunkList& o);
+      // Sizes the first allocations of an empty list for 'n' entries.
+      void reserve(size_t n);
+
+      iterator lower_bound(unsigned key)             { size_t c, i; lowerPos(key, &c, &i); return iterator(nodeAt(c, i)); }
+      iterator upper_bound(unsigned key)             { size_t c, i; upperPos(key, &c, &i); return iterator(nodeAt(c, i)); }
+      const_iterator lower_bound(unsigned key) const { size_t c, i; lowerPos(key, &c, &i); return const_iterator(nodeAt(c, i)); }
+      const_iterator upper_bound(unsigned key) const { size_t c, i; upperPos(key, &c, &i); return const_iterator(nodeAt(c, i)); }
+      std::pair<iterator, iterator> equal_range(unsigned key) {
+            return std::pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+            }
+      std::pair<const_iterator, const_iterator> equal_range(unsigned key) const {
+            return std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+            }
+      iterator find(unsigned key) {
+            iterator i = lower_bound(key);
+            return (i != end() && i->first == key) ? i : end();
+            }
+      const_iterator find(unsigned key) const {
+            const_iterator i = lower_bound(key);
+            return (i != end() && i->first == key) ? i : end();
+            }
+      size_t count(unsigned key) const {
+            return std::distance(lower_bound(key), upper_bound(key));
+            }
+
+      // Inserts after all entries with the same key.
+      iterator insert(const value_type& v);
+      // Inserts as close before 'hint' as the order allows, like std::multimap.
+      iterator insert(const_iterator hint, const value_type& v);
+      iterator erase(const_iterator pos);
+      iterator erase(const_iterator first, const_iterator last);
+      size_t erase(unsigned key);
+      };
+
+template <class E> const size_t EventChunkList<E>::CHUNK;
+template <class E> const size_t EventChunkList<E>::MIN_BLOCK;
+template <class E> const size_t EventChunkList<E>::NODE_BLOCK;
+
+//---------------------------------------------------------
+//   init / clear / copy
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::init()
+      {
+      _head = new Node;
+      _head->prev = _head->next = _head;
+      _free      = 0;
+      _nodes     = 0;
+      _nextBlock = MIN_BLOCK;
+      _size      = 0;
+      }
+
+template <class E> void EventChunkList<E>::clear()
+      {
+      for (size_t c = 0; c < _chunks.size(); ++c)
+            delete[] _chunks[c].e;
+      _chunks.clear();
+      _lastKey.clear();
+      for (size_t b = 0; b < _blocks.size(); ++b)
+            delete[] _blocks[b];
+      _blocks.clear();
+      _head->prev = _head->next = _head;
+      _free      = 0;
+      _nodes     = 0;
+      _nextBlock = MIN_BLOCK;
+      _size      = 0;
+      }
+
+template <class E> EventChunkList<E>& EventChunkList<E>::operator=(const EventChunkList& o)
+      {
+      if (&o != this) {
+            clear();
+            copyFrom(o);
+            }
+      return *this;
+      }
+
+template <class E> void EventChunkList<E>::swap(EventChunkList& o)
+      {
+      std::swap(_head, o._head);
+      std::swap(_free, o._free);
+      _blocks.swap(o._blocks);
+      std::swap(_nodes, o._nodes);
+      std::swap(_nextBlock, o._nextBlock);
+      _chunks.swap(o._chunks);
+      _lastKey.swap(o._lastKey);
+      std::swap(_size, o._size);
+      }
+
+template <class E> void EventChunkList<E>::reserve(size_t n)
+      {
+      if (_size == 0 && _blocks.empty() && n > 0)
+            _nextBlock = n;
+      }
+
+//---------------------------------------------------------
+//   copyFrom
+//    The copy gets one block of nodes and full chunks,
+//     the first of them no bigger than the list.
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::copyFrom(const EventChunkList& o)
+      {
+      if (o._size == 0)
+            return;
+      addBlock(o._size);
+      _chunks.reserve((o._size + CHUNK - 1) / CHUNK);
+      _lastKey.reserve(_chunks.capacity());
+      for (const_iterator i = o.begin(); i != o.end(); ++i) {
+            if (_chunks.empty() || _chunks.back().n == CHUNK)
+                  addChunk(_chunks.size(), std::min(CHUNK, o._size - _size));
+            insertAt(_chunks.size() - 1, _chunks.back().n, _head, *i);
+            }
+      }
+
+template <class E> size_t EventChunkList<E>::memoryUsage() const
+      {
+      size_t bytes = sizeof(*this) + sizeof(Node) * (_nodes + 1)
+         + _blocks.capacity() * sizeof(Node*)
+         + _chunks.capacity() * sizeof(Chunk) + _lastKey.capacity() * sizeof(unsigned);
+      for (size_t c = 0; c < _chunks.size(); ++c)
+            bytes += _chunks[c].cap * sizeof(Entry);
+      return bytes;
+      }
+
+//---------------------------------------------------------
+//   nodes
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::addBlock(size_t n)
+      {
+      Node* b = new Node[n];
+      _blocks.push_back(b);
+      _nodes += n;
+      // Hand them out in address order.
+      for (size_t k = n; k > 0; --k) {
+            b[k - 1].next = _free;
+            _free = &b[k - 1];
+            }
+      _nextBlock = std::min(2 * n, NODE_BLOCK);
+      if (_nextBlock < MIN_BLOCK)
+            _nextBlock = MIN_BLOCK;
+      }
+
+template <class E> typename EventChunkList<E>::Node* EventChunkList<E>::newNode(const value_type& v)
+      {
+      if (!_free)
+            addBlock(_nextBlock);
+      Node* n = _free;
+      _free = n->next;
+      // The key is const, so the value is built again rather than assigned.
+      n->v.~value_type();
+      new (&n->v) value_type(v);
+      return n;
+      }
+
+template <class E> void EventChunkList<E>::freeNode(Node* n)
+      {
+      n->v.~value_type();          // Release the event.
+      new (&n->v) value_type();
+      n->prev = 0;
+      n->next = _free;
+      _free = n;
+      }
+
+//---------------------------------------------------------
+//   chunks
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::addChunk(size_t c, size_t cap)
+      {
+      Chunk ch;
+      ch.n   = 0;
+      ch.cap = cap;
+      ch.e   = new Entry[cap];
+      _chunks.insert(_chunks.begin() + c, ch);
+      _lastKey.insert(_lastKey.begin() + c, 0);
+      }
+
+template <class E> void EventChunkList<E>::removeChunk(size_t c)
+      {
+      delete[] _chunks[c].e;
+      _chunks.erase(_chunks.begin() + c);
+      _lastKey.erase(_lastKey.begin() + c);
+      }
+
+template <class E> void EventChunkList<E>::growChunk(size_t c, size_t cap)
+      {
+      Chunk& ch = _chunks[c];
+      Entry* e = new Entry[cap];
+      std::copy(ch.e, ch.e + ch.n, e);
+      delete[] ch.e;
+      ch.e   = e;
+      ch.cap = cap;
+      }
+
+//---------------------------------------------------------
+//   lowerPos / upperPos
+//    Binary search over the chunks' last keys, then
+//     within the one chunk.
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::lowerPos(unsigned key, size_t* c, size_t* i) const
+      {
+      *c = std::lower_bound(_lastKey.begin(), _lastKey.end(), key) - _lastKey.begin();
+      *i = 0;
+      if (*c < _chunks.size()) {
+            const Chunk& ch = _chunks[*c];
+            *i = std::lower_bound(ch.e, ch.e + ch.n, key, entryLess) - ch.e;
+            }
+      }
+
+template <class E> void EventChunkList<E>::upperPos(unsigned key, size_t* c, size_t* i) const
+      {
+      *c = std::upper_bound(_lastKey.begin(), _lastKey.end(), key) - _lastKey.begin();
+      *i = 0;
+      if (*c < _chunks.size()) {
+            const Chunk& ch = _chunks[*c];
+            *i = std::upper_bound(ch.e, ch.e + ch.n, key, keyLess) - ch.e;
+            }
+      }
+
+//---------------------------------------------------------
+//   findPos
+//    Index position of node 'n', which must be in the list.
+//---------------------------------------------------------
+
+template <class E> void EventChunkList<E>::findPos(const Node* n, size_t* c, size_t* i) const
+      {
+      lowerPos(n->v.first, c, i);
+      while (_chunks[*c].e[*i].node != n) {
+            if (++*i == _chunks[*c].n) {
+                  ++*c;
+                  *i = 0;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   insertAt
+//    Links a new node before 'before', and its index
+//     entry at index position c, i.
+//---------------------------------------------------------
+
+template <class E> typename EventChunkList<E>::Node* EventChunkList<E>::insertAt(size_t c, size_t i, Node* before, const value_type& v)
+      {
+      // An empty list's first chunk is sized like its first block of nodes.
+      const size_t firstCap = std::min(CHUNK, std::max(_nextBlock, MIN_BLOCK));
+      Node* n = newNode(v);
+      n->next = before;
+      n->prev = before->prev;
+      before->prev->next = n;
+      before->prev = n;
+
+      if (_chunks.empty()) {
+            addChunk(0, firstCap);
+            c = 0;
+            i = 0;
+            }
+      else if (c == _chunks.size()) {
+            // Append. Start a new chunk rather than splitting a full one,
+            //  so lists loaded in order end up with full chunks.
+            c = _chunks.size() - 1;
+            i = _chunks[c].n;
+            if (i == CHUNK) {
+                  addChunk(++c, CHUNK);
+                  i = 0;
+                  }
+            }
+
+      if (_chunks[c].n == _chunks[c].cap) {
+            if (_chunks[c].cap < CHUNK)
+                  growChunk(c, std::min(2 * _chunks[c].cap, CHUNK));
+            else {
+                  // Split in halves.
+                  const size_t half = CHUNK / 2;
+                  addChunk(c + 1, CHUNK);
+                  Chunk& ch  = _chunks[c];
+                  Chunk& nch = _chunks[c + 1];
+                  std::copy(ch.e + half, ch.e + CHUNK, nch.e);
+                  nch.n = CHUNK - half;
+                  ch.n  = half;
+                  updateKey(c);
+                  updateKey(c + 1);
+                  if (i > half) {
+                        ++c;
+                        i -= half;
+                        }
+                  }
+            }
+
+      Chunk& ch = _chunks[c];
+      std::copy_backward(ch.e + i, ch.e + ch.n, ch.e + ch.n + 1);
+      ch.e[i].key  = v.first;
+      ch.e[i].node = n;
+      ++ch.n;
+      updateKey(c);
+      ++_size;
+      return n;
+      }
+
+//---------------------------------------------------------
+//   insert
+//---------------------------------------------------------
+
+template <class E> typename EventChunkList<E>::iterator EventChunkList<E>::insert(const value_type& v)
+      {
+      size_t c, i;
+      upperPos(v.first, &c, &i);
+      return iterator(insertAt(c, i, nodeAt(c, i), v));
+      }
+
+template <class E> typename EventChunkList<E>::iterator EventChunkList<E>::insert(const_iterator hint, const value_type& v)
+      {
+      // Where std::multimap puts it, for the same order of equal keys.
+      Node* h = const_cast<Node*>(hint._node);
+      Node* before;
+      size_t c, i;
+      if (h == _head || !(h->v.first < v.first)) {
+            if (h->prev != _head && v.first < h->prev->v.first)
+                  return insert(v);
+            before = h;
+            }
+      else if (h->next == _head || !(h->next->v.first < v.first))
+            before = h->next;
+      else {
+            lowerPos(v.first, &c, &i);
+            return iterator(insertAt(c, i, nodeAt(c, i), v));
+            }
+      c = _chunks.size();
+      i = 0;
+      if (before != _head)
+            findPos(before, &c, &i);
+      return iterator(insertAt(c, i, before, v));
+      }
+
+//---------------------------------------------------------
+//   erase
+//---------------------------------------------------------
+
+template <class E> typename EventChunkList<E>::iterator EventChunkList<E>::erase(const_iterator pos)
+      {
+      Node* n = const_cast<Node*>(pos._node);
+      size_t c, i;
+      findPos(n, &c, &i);
+
+      Chunk& ch = _chunks[c];
+      std::copy(ch.e + i + 1, ch.e + ch.n, ch.e + i);
+      --ch.n;
+      if (ch.n == 0)
+            removeChunk(c);
+      else {
+            // Merge a small chunk with its successor.
+            if (c + 1 < _chunks.size() && ch.n + _chunks[c + 1].n <= CHUNK / 2) {
+                  const size_t m = ch.n + _chunks[c + 1].n;
+                  if (m > ch.cap)
+                        growChunk(c, CHUNK);
+                  Chunk& mch        = _chunks[c];
+                  const Chunk& next = _chunks[c + 1];
+                  std::copy(next.e, next.e + next.n, mch.e + mch.n);
+                  mch.n = m;
+                  removeChunk(c + 1);
+                  }
+            updateKey(c);
+            }
+
+      Node* next = n->next;
+      n->prev->next = next;
+      next->prev = n->prev;
+      freeNode(n);
+      --_size;
+      return iterator(next);
+      }
+
+template <class E> typename EventChunkList<E>::iterator EventChunkList<E>::erase(const_iterator first, const_iterator last)
+      {
+      iterator i(const_cast<Node*>(first._node));
+      while (i != last)
+            i = erase(i);
+      return i;
+      }
+
+template <class E> size_t EventChunkList<E>::erase(unsigned key)
+      {
+      const size_t n = count(key);
+      erase(lower_bound(key), upper_bound(key));
+      return n;
+      }
+
+} // namespace MusECore
+
+#endif
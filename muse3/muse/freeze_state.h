@@ -0,0 +1,81 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  freeze_state.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __FREEZE_STATE_H__
+#define __FREEZE_STATE_H__
+
+#include <stdint.h>
+#include <atomic>
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   FreezeState
+//    The state of a track's freeze file. While it is
+//     rendered the audio thread counts the blocks it puts
+//     into the freeze fifo and the prefetch thread those
+//     it writes to the file. Anything the file was
+//     rendered from marks it stale, from any thread.
+//---------------------------------------------------------
+
+class FreezeState {
+      std::atomic<unsigned> _blocksPut;
+      std::atomic<unsigned> _blocksWritten;
+      std::atomic<bool> _overrun;   // A block was dropped, the file is incomplete.
+      std::atomic<bool> _stale;     // Something the file was rendered from changed.
+
+   public:
+      // The longest the gui waits for the prefetch thread to
+      //  write the last blocks, before the freeze is given up.
+      static const unsigned FLUSH_TIMEOUT_MS = 5000;
+
+      FreezeState() { reset(); }
+
+      // For a new freeze file.
+      void reset() {
+            _blocksPut.store(0);
+            _blocksWritten.store(0);
+            _overrun.store(false);
+            _stale.store(false);
+            }
+      // Audio thread.
+      void blockPut()              { ++_blocksPut; }
+      void setOverrun()            { _overrun.store(true); }
+      // Prefetch thread.
+      void blockWritten()          { ++_blocksWritten; }
+
+      // Whether all the blocks put so far are in the file.
+      bool flushed() const         { return _blocksWritten.load() == _blocksPut.load(); }
+      bool overrun() const         { return _overrun.load(); }
+      void setStale()              { _stale.store(true); }
+      bool stale() const           { return _stale.load(); }
+
+      // Whether a flush started at startUS has taken too long at nowUS.
+      static bool flushTimedOut(uint64_t startUS, uint64_t nowUS) {
+            return nowUS - startUS > uint64_t(FLUSH_TIMEOUT_MS) * 1000;
+            }
+      };
+
+} // namespace MusECore
+
+#endif
@@ -310,6 +310,15 @@ GlobalConfigValues config = {
       2,                            // routerGroupingChannels
       "",                           // mixdownPath
       true,                         // showNoteNamesInPianoRoll
+      1,                            // audioWorkerThreads 1 = serial processing, 0 = one per CPU
+      0,                            // audioPrefetchThreads 0 = one per CPU, up to MAX_PREFETCH_IO_THREADS
+      128,                          // waveCacheSize MB, 0 = off
+      true,                         // latencyCompensation
+      1024,                         // undoMemoryLimit MB, 0 = unlimited
+      true,                         // rtAllocFailSafe
+      false,                        // pluginShareInstances
+      false,                        // pluginSilenceSkip
+      2000,                         // pluginSilenceTail ms
 
     };
 
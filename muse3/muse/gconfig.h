@@ -315,6 +315,21 @@ struct GlobalConfigValues {
       int routerGroupingChannels;
       QString mixdownPath;
       bool showNoteNamesInPianoRoll;
+      int audioWorkerThreads; // Number of threads processing the audio tracks, including the audio thread.
+                              // 1 = serial processing, 0 = one per CPU.
+      int audioPrefetchThreads; // Number of threads reading wave files, including the prefetch thread.
+                                // 0 = one per CPU, up to MAX_PREFETCH_IO_THREADS.
+      int waveCacheSize;        // Decoded wave block cache, in MB. 0 = off.
+      bool latencyCompensation; // Delay lower latency paths to line up with plugin latencies.
+      int undoMemoryLimit;      // Memory the undo list may keep alive, in MB. The oldest steps
+                                //  are dropped beyond it. 0 = unlimited.
+      bool rtAllocFailSafe;     // Drop midi events and sysex data rather than allocate from
+                                //  the heap in the audio threads when the realtime arena is out.
+      bool pluginShareInstances; // Let one instance of a mono LADSPA/DSSI effect do all channels of
+                                 //  a track in turn, if a probe finds it keeps no state between runs.
+      bool pluginSilenceSkip;   // Stop running effects and synths whose input and output have been
+                                //  silent for longer than their tail, until signal or events arrive.
+      int pluginSilenceTail;    // Tail in ms for plugins which report none and have none set of their own.
       };
 
 
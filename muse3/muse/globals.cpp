@@ -40,6 +40,7 @@ int sampleRate   = 44100;
 unsigned segmentSize  = 1024U;    // segmentSize in frames (set by JACK)
 unsigned fifoLength =  128;       // 131072/segmentSize
                                   // 131072 - magic number that gives a sufficient buffer size
+unsigned prefetchFifoLength = 129; // Set by initAudioPrefetch() from the prefetch window.
 int segmentCount = 2;
 
 // denormal bias value used to eliminate the manifestation of denormals by
@@ -134,6 +135,10 @@ bool useLASH = true;
 bool useAlsaWithJack = false;
 bool noAutoStartJack = false;
 bool populateMidiPortsOnStart = true;
+QString batchRenderFile;
+QString batchRenderOutput;
+QString batchRenderTracks;
+int batchRenderErrors = 0;
 
 const char* midi_file_pattern[] = {
       QT_TRANSLATE_NOOP("file_patterns", "Midi/Kar (*.mid *.MID *.kar *.KAR *.mid.gz *.mid.bz2)"),
@@ -157,11 +162,12 @@ const char* midi_file_save_pattern[] = {
       };
 
 const char* med_file_pattern[] = {
-      QT_TRANSLATE_NOOP("file_patterns", "all known files (*.med *.med.gz *.med.bz2 *.mid *.midi *.kar)"),
+      QT_TRANSLATE_NOOP("file_patterns", "all known files (*.med *.med.gz *.med.bz2 *.medb *.mid *.midi *.kar)"),
       QT_TRANSLATE_NOOP("file_patterns", "med Files (*.med *.med.gz *.med.bz2)"),
       QT_TRANSLATE_NOOP("file_patterns", "Uncompressed med Files (*.med)"),
       QT_TRANSLATE_NOOP("file_patterns", "gzip compressed med Files (*.med.gz)"),
       QT_TRANSLATE_NOOP("file_patterns", "bzip2 compressed med Files (*.med.bz2)"),
+      QT_TRANSLATE_NOOP("file_patterns", "Binary med Files (*.medb)"),
       QT_TRANSLATE_NOOP("file_patterns", "mid Files (*.mid *.midi *.kar *.MID *.MIDI *.KAR)"),
       QT_TRANSLATE_NOOP("file_patterns", "All Files (*)"),
       0
@@ -170,6 +176,7 @@ const char* med_file_save_pattern[] = {
       QT_TRANSLATE_NOOP("file_patterns", "Uncompressed med Files (*.med)"),
       QT_TRANSLATE_NOOP("file_patterns", "gzip compressed med Files (*.med.gz)"),
       QT_TRANSLATE_NOOP("file_patterns", "bzip2 compressed med Files (*.med.bz2)"),
+      QT_TRANSLATE_NOOP("file_patterns", "Binary med Files (*.medb)"),
       QT_TRANSLATE_NOOP("file_patterns", "All Files (*)"),
       0
       };
@@ -177,6 +184,7 @@ const char* project_create_file_save_pattern[] = {
       QT_TRANSLATE_NOOP("file_patterns", "Uncompressed med Files (*.med)"),
       QT_TRANSLATE_NOOP("file_patterns", "gzip compressed med Files (*.med.gz)"),
       QT_TRANSLATE_NOOP("file_patterns", "bzip2 compressed med Files (*.med.bz2)"),
+      QT_TRANSLATE_NOOP("file_patterns", "Binary med Files (*.medb)"),
       0
       };
 
@@ -54,6 +54,7 @@ extern const float denormalBias;
 extern int sampleRate;
 extern unsigned segmentSize;
 extern unsigned fifoLength; // inversely proportional to segmentSize
+extern unsigned prefetchFifoLength; // wave track prefetch, inversely proportional to segmentSize
 extern int segmentCount;
 
 extern bool overrideAudioOutput;
@@ -111,6 +112,14 @@ extern bool loadLV2;
 extern bool useAlsaWithJack;
 extern bool noAutoStartJack;
 extern bool populateMidiPortsOnStart;
+// Batch render: if batchRenderFile is set the project is bounced to
+//  it through batchRenderOutput (empty = first output), with the
+//  comma separated batchRenderTracks soloed, and MusE quits.
+extern QString batchRenderFile;
+extern QString batchRenderOutput;
+extern QString batchRenderTracks;
+// Number of error and warning messages put out during a batch render.
+extern int batchRenderErrors;
 
 extern bool realTimeScheduling;
 extern int realTimePriority;
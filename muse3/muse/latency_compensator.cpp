@@ -30,13 +30,13 @@
 namespace MusECore {
 
 LatencyCompensator::LatencyCompensator(unsigned long channels, unsigned long bufferSize)
-  : _channels(channels), _bufferSize(bufferSize)
+  : _channels(channels), _bufferSize(bufferSize), _clean(true)
 {
   _buffer = new float*[channels];
   _delays = new unsigned long[channels];
   _writePointers = new unsigned long[channels];
 
-  for(int i = 0; i < _channels; ++i)
+  for(unsigned long i = 0; i < _channels; ++i)
   {
     _buffer[i] = new float[_bufferSize];
     memset(_buffer[i],  0, sizeof(float) * _bufferSize);
@@ -47,7 +47,7 @@ LatencyCompensator::LatencyCompensator(unsigned long channels, unsigned long buf
 
 LatencyCompensator::~LatencyCompensator()
 {
-  for(int i = 0; i < _channels; ++i)
+  for(unsigned long i = 0; i < _channels; ++i)
     delete [] _buffer[i];
   delete [] _buffer;
   delete [] _delays;
@@ -56,43 +56,67 @@ LatencyCompensator::~LatencyCompensator()
 
 void LatencyCompensator::clear()
 {
-  for(int i = 0; i < _channels; ++i)
+  if(_clean)
+    return;
+  for(unsigned long i = 0; i < _channels; ++i)
     memset(_buffer[i],  0, sizeof(float) * _bufferSize);
+  _clean = true;
+}
+
+void LatencyCompensator::setDelay(unsigned long delay)
+{
+  if(delay > maxDelay())
+    delay = maxDelay();
+  for(unsigned long i = 0; i < _channels; ++i)
+    _delays[i] = delay;
+}
+
+void LatencyCompensator::setDelay(unsigned long channel, unsigned long delay)
+{
+  if(channel >= _channels)
+    return;
+  _delays[channel] = delay > maxDelay() ? maxDelay() : delay;
 }
 
 void LatencyCompensator::setBufferSize(unsigned long size)
 {
   _bufferSize = size;
-  for(int i = 0; i < _channels; ++i)
+  for(unsigned long i = 0; i < _channels; ++i)
   {
     delete [] _buffer[i];
     _buffer[i] = new float[_bufferSize];
     memset(_buffer[i],  0, sizeof(float) * _bufferSize);
+    _writePointers[i] = 0;
+    if(_delays[i] > maxDelay())
+      _delays[i] = maxDelay();
   }
+  _clean = true;
 }
 
 void LatencyCompensator::setChannels(unsigned long channels)
 {
-  for(int i = 0; i < _channels; ++i)
+  for(unsigned long i = 0; i < _channels; ++i)
     delete [] _buffer[i];
   delete [] _buffer;
   delete [] _delays;
   delete [] _writePointers;
 
+  _channels = channels;
   _buffer = new float*[channels];
   _delays = new unsigned long[channels];
   _writePointers = new unsigned long[channels];
 
-  for(int i = 0; i < _channels; ++i)
+  for(unsigned long i = 0; i < _channels; ++i)
   {
     _buffer[i] = new float[_bufferSize];
     memset(_buffer[i],  0, sizeof(float) * _bufferSize);
     _delays[i] = 0;
     _writePointers[i] = 0;
   }
+  _clean = true;
 }
 
-void LatencyCompensator::run(unsigned long SampleCount, float** data)
+void LatencyCompensator::run(unsigned long SampleCount, float** data, long channels, unsigned long startChannel)
 {
   float inputSample;
   unsigned long readOffset;
@@ -106,10 +130,18 @@ void LatencyCompensator::run(unsigned long SampleCount, float** data)
   float* output;
   float* buf;
   
-  for(int ch = 0; ch < _channels; ++ch)
+  if(startChannel >= _channels)
+    return;
+  unsigned long chans = _channels - startChannel;
+  if(channels >= 0 && (unsigned long)channels < chans)
+    chans = channels;
+  for(unsigned long ch = startChannel; ch < startChannel + chans; ++ch)
   {
-    input = data[ch];
-    output = data[ch];
+    if(_delays[ch] == 0)
+      continue;
+    _clean = false;
+    input = data[ch - startChannel];
+    output = data[ch - startChannel];
     buf = _buffer[ch];
 
     writeOffset = _writePointers[ch];
@@ -131,4 +163,63 @@ void LatencyCompensator::run(unsigned long SampleCount, float** data)
   }
 }
   
+//---------------------------------------------------------
+//   computeLatencyDelays
+//    The input latency of a node is its longest path from
+//     any source, every source is delayed by the difference
+//     to where it is mixed. A node has one delay for its aux
+//     sends and a longer one for its routes, so a dry signal
+//     can wait for the return of an aux it feeds. A node
+//     feeding several mix points of different latency by the
+//     same kind of path is aligned to the latest one.
+//---------------------------------------------------------
+
+void computeLatencyDelays(const std::vector<unsigned long>& own, const std::vector<LatencyEdge>& edges,
+                          const std::vector<bool>& isOutput,
+                          std::vector<unsigned long>* sendDelay, std::vector<unsigned long>* routeDelay)
+{
+  const size_t n = own.size();
+  sendDelay->assign(n, 0);
+  routeDelay->assign(n, 0);
+
+  // Longest path. Routes are acyclic, the limit is only a guard.
+  std::vector<unsigned long> in(n, 0);
+  for(size_t iter = 0; iter <= n; ++iter)
+  {
+    bool changed = false;
+    for(size_t e = 0; e < edges.size(); ++e)
+    {
+      const int src = edges[e].src;
+      const int dst = edges[e].dst;
+      if(in[src] + own[src] > in[dst])
+      {
+        in[dst] = in[src] + own[src];
+        changed = true;
+      }
+    }
+    if(!changed)
+      break;
+  }
+
+  for(size_t e = 0; e < edges.size(); ++e)
+  {
+    const int src = edges[e].src;
+    const unsigned long out = in[src] + own[src];
+    const unsigned long arrive = in[edges[e].dst];
+    std::vector<unsigned long>& v = edges[e].aux ? *sendDelay : *routeDelay;
+    if(arrive > out + v[src])
+      v[src] = arrive - out;
+  }
+
+  // The outputs leave together. They have no sends or routes of
+  //  their own, so their delay goes before both.
+  unsigned long latest = 0;
+  for(size_t i = 0; i < n; ++i)
+    if(isOutput[i] && in[i] + own[i] > latest)
+      latest = in[i] + own[i];
+  for(size_t i = 0; i < n; ++i)
+    if(isOutput[i])
+      (*sendDelay)[i] = (*routeDelay)[i] = latest - in[i] - own[i];
+}
+
 } // namespace MusECore
@@ -24,6 +24,8 @@
 #ifndef __LATENCY_COMPENSATOR_H__
 #define __LATENCY_COMPENSATOR_H__
 
+#include <vector>
+
 namespace MusECore {
 
 class LatencyCompensator
@@ -36,17 +38,50 @@ class LatencyCompensator
     float** _input;
     float** _output;
     float** _buffer;
+    bool _clean; // Nothing was run since the buffers were zeroed.
 
   public:
     LatencyCompensator(unsigned long channels = 1, unsigned long bufferSize = 16384);
     virtual ~LatencyCompensator();
     
+    unsigned long channels() const { return _channels; }
+    unsigned long bufferSize() const { return _bufferSize; }
+    // Largest delay the buffer can hold.
+    unsigned long maxDelay() const { return _bufferSize - 1; }
+    unsigned long delay(unsigned long channel = 0) const { return channel < _channels ? _delays[channel] : 0; }
+    // Sets the delay of all channels, or of one channel, limited to maxDelay().
+    void setDelay(unsigned long delay);
+    void setDelay(unsigned long channel, unsigned long delay);
+
+    // Silences the delay lines, so nothing that went in before comes out.
+    // Costs nothing if nothing was run since the last clear.
     void clear();
     void setBufferSize(unsigned long size);
     void setChannels(unsigned long channels);
-    void run(unsigned long SampleCount, float** data);
+    // Delays data in place. If channels is given, only that many channels are run,
+    //  data[0] going through channel startChannel.
+    void run(unsigned long SampleCount, float** data, long channels = -1, unsigned long startChannel = 0);
 };
 
+//---------------------------------------------------------
+//   LatencyEdge
+//    A track route or an aux send from node src to dst.
+//---------------------------------------------------------
+
+struct LatencyEdge {
+      int src;
+      int dst;
+      bool aux;
+      };
+
+// Works out the compensation delays of nodes with the given own latencies,
+//  joined by edges. sendDelay is applied before the aux sends, routeDelay
+//  is the total delay of the routed outputs. The nodes marked in isOutput
+//  are delayed so that they all leave at the same time.
+void computeLatencyDelays(const std::vector<unsigned long>& own, const std::vector<LatencyEdge>& edges,
+                          const std::vector<bool>& isOutput,
+                          std::vector<unsigned long>* sendDelay, std::vector<unsigned long>* routeDelay);
+
 } // namespace MusECore
 
 #endif
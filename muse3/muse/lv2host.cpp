@@ -69,6 +69,7 @@
 #include "components/popupmenu.h"
 #include "widgets/menutitleitem.h"
 #include "icons.h"
+#include "memory.h"
 #include <ladspa.h>
 
 #include <cmath>
@@ -78,6 +79,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
 #include <sord/sord.h>
 
 
@@ -230,6 +233,33 @@ LV2_Feature lv2Features [] =
 
 std::vector<LV2Synth *> synthsToFree;
 
+// Created with the first plugin that has a worker interface.
+static LV2WorkerPool *lv2WorkerPool = NULL;
+
+LV2UridBiMap LV2Synth::uridBiMap;
+
+// Mapped by initLV2(), so that plugins find them without
+//  the map taking its lock in run().
+static const char *lv2KnownUris [] =
+{
+   LV2_ATOM__Atom, LV2_ATOM__AtomPort, LV2_ATOM__Blank, LV2_ATOM__Bool,
+   LV2_ATOM__Chunk, LV2_ATOM__Double, LV2_ATOM__Event, LV2_ATOM__Float,
+   LV2_ATOM__Int, LV2_ATOM__Literal, LV2_ATOM__Long, LV2_ATOM__Number,
+   LV2_ATOM__Object, LV2_ATOM__Path, LV2_ATOM__Property, LV2_ATOM__Resource,
+   LV2_ATOM__Sequence, LV2_ATOM__Sound, LV2_ATOM__String, LV2_ATOM__Tuple,
+   LV2_ATOM__URI, LV2_ATOM__URID, LV2_ATOM__Vector, LV2_ATOM__atomTransfer,
+   LV2_ATOM__beatTime, LV2_ATOM__eventTransfer, LV2_ATOM__frameTime,
+   LV2_MIDI__MidiEvent,
+   LV2_TIME__Position, LV2_TIME__bar, LV2_TIME__barBeat, LV2_TIME__beat,
+   LV2_TIME__beatUnit, LV2_TIME__beatsPerBar, LV2_TIME__beatsPerMinute,
+   LV2_TIME__frame, LV2_TIME__framesPerSecond, LV2_TIME__speed,
+   LV2_PATCH__Get, LV2_PATCH__Put, LV2_PATCH__Set, LV2_PATCH__body,
+   LV2_PATCH__property, LV2_PATCH__subject, LV2_PATCH__value,
+   LV2_LOG__Entry, LV2_LOG__Error, LV2_LOG__Note, LV2_LOG__Trace, LV2_LOG__Warning,
+   LV2_P_SAMPLE_RATE, LV2_P_MIN_BLKLEN, LV2_P_MAX_BLKLEN, LV2_P_SEQ_SIZE,
+   LV2_CORE__sampleRate, LV2_F_STATE_CHANGED
+};
+
 #define SIZEOF_ARRAY(x) sizeof(x)/sizeof(x[0])
 
 void initLV2()
@@ -240,6 +270,9 @@ void initLV2()
   //----------------- 
   MusEGui::lv2Gtk2Helper_init();
 #endif
+
+  for(size_t i = 0; i < SIZEOF_ARRAY(lv2KnownUris); i++)
+    LV2Synth::uridBiMap.map(lv2KnownUris [i]);
     
   std::set<std::string> supportedFeatures;
   uint32_t i = 0;
@@ -445,6 +478,12 @@ void deinitLV2()
    }
    synthsToFree.clear();
 
+   if(lv2WorkerPool != NULL)
+   {
+      delete lv2WorkerPool;
+      lv2WorkerPool = NULL;
+   }
+
    for(LilvNode **n = (LilvNode **)&lv2CacheNodes; *n; ++n)
    {
       lilv_node_free(*n);
@@ -587,7 +626,6 @@ void LV2Synth::lv2state_FillFeatures(LV2PluginWrapper_State *state)
    state->wrkSched.handle = (LV2_Worker_Schedule_Handle)state;
    state->wrkSched.schedule_work = LV2Synth::lv2wrk_scheduleWork;
    state->wrkIface = NULL;
-   state->wrkThread = new LV2PluginWrapper_Worker(state);
 
    state->extHost.plugin_human_id = state->human_id = NULL;
    state->extHost.ui_closed = LV2Synth::lv2ui_ExtUi_Closed;
@@ -780,7 +818,19 @@ void LV2Synth::lv2state_PostInstantiate(LV2PluginWrapper_State *state)
 
    LV2Synth::lv2prg_updatePrograms(state);
 
-   state->wrkThread->start(QThread::LowPriority);
+   if(state->wrkIface != NULL && state->wrkIface->work != NULL)
+   {
+      if(lv2WorkerPool == NULL)
+      {
+         long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+         lv2WorkerPool = new LV2WorkerPool(cpus < 1 ? 1 : std::min(cpus, long(LV2_WORKER_MAX_THREADS)),
+                                           LV2Synth::lv2wrk_work, LV2_WORKER_RING_SIZE);
+      }
+      state->wrkRequests = new LV2WorkerRing(LV2_WORKER_RING_SIZE);
+      state->wrkResponses = new LV2WorkerRing(LV2_WORKER_RING_SIZE);
+      state->wrkRequestBuf = new char [state->wrkRequests->maxSize()];
+      state->wrkResponseBuf = new char [state->wrkResponses->maxSize()];
+   }
 
 }
 
@@ -810,9 +860,24 @@ void LV2Synth::lv2state_FreeState(LV2PluginWrapper_State *state)
 {
    assert(state != NULL);
 
-   state->wrkThread->setClosing();
-   state->wrkThread->wait();
-   delete state->wrkThread;
+   if(state->wrkRequests != NULL)
+   {
+      //wait for the pool to finish with this plugin, and keep it from taking it again
+      if(!LV2WorkerPool::claim(state, LV2_WORKER_CLAIM_TIMEOUT_MS))
+      {
+         //a pool thread is stuck in the plugin's work(). Freeing the plugin
+         // would pull it out from under that thread, so it is left as it is
+         fprintf(stderr, "LV2: %s: worker busy for more than %d ms, plugin not freed\n",
+                 state->human_id != NULL ? state->human_id : "plugin", LV2_WORKER_CLAIM_TIMEOUT_MS);
+         return;
+      }
+      delete state->wrkRequests;
+      delete state->wrkResponses;
+      delete [] state->wrkRequestBuf;
+      delete [] state->wrkResponseBuf;
+      state->wrkRequests = state->wrkResponses = NULL;
+      state->wrkRequestBuf = state->wrkResponseBuf = NULL;
+   }
 
    if(state->human_id != NULL)
       free(state->human_id);
@@ -1530,16 +1595,39 @@ LV2_Worker_Status LV2Synth::lv2wrk_scheduleWork(LV2_Worker_Schedule_Handle handl
 #endif
    LV2PluginWrapper_State *state = (LV2PluginWrapper_State *)handle;
 
-   //assert(state->wrkEndWork != true);
-   if(state->wrkEndWork != false)
+   if(state->wrkRequests == NULL)
       return LV2_WORKER_ERR_UNKNOWN;
 
-   state->wrkDataSize = size;
-   state->wrkDataBuffer = data;
+   if(!RTArena::inRealtime())
+   {
+      //not called from run(), e.g. while restoring state. The request ring
+      // belongs to the run context, so do the work here once the pool is
+      // done with this plugin
+      if(!LV2WorkerPool::claim(state, LV2_WORKER_CLAIM_TIMEOUT_MS))
+      {
+         fprintf(stderr, "LV2: %s: worker busy for more than %d ms, request dropped\n",
+                 state->human_id != NULL ? state->human_id : "plugin", LV2_WORKER_CLAIM_TIMEOUT_MS);
+         return LV2_WORKER_ERR_UNKNOWN;
+      }
+      LV2_Worker_Status rv = state->wrkIface->work(lilv_instance_get_handle(state->handle),
+                                                   LV2Synth::lv2wrk_respond,
+                                                   state,
+                                                   size,
+                                                   data);
+      lv2WorkerPool->release(state);
+      return rv;
+   }
+
+   if(!state->wrkRequests->put(size, data))
+      return LV2_WORKER_ERR_NO_SPACE;
+
+   if(state->wrkBusy.exchange(true))  //already queued, the pool will see this request
+      return LV2_WORKER_SUCCESS;
+
    if(MusEGlobal::audio->freewheel()) //don't wait for a thread. Do it now
-      state->wrkThread->makeWork();
+      lv2WorkerPool->process(state, state->wrkRequestBuf);
    else
-      return state->wrkThread->scheduleWork();
+      lv2WorkerPool->push(state);
 
    return LV2_WORKER_SUCCESS;
 }
@@ -1548,13 +1636,42 @@ LV2_Worker_Status LV2Synth::lv2wrk_respond(LV2_Worker_Respond_Handle handle, uin
 {
    LV2PluginWrapper_State *state = (LV2PluginWrapper_State *)handle;
 
-   state->wrkDataSize = size;
-   state->wrkDataBuffer = data;
-   state->wrkEndWork = true;
+   if(!state->wrkResponses->put(size, data))
+      return LV2_WORKER_ERR_NO_SPACE;
 
    return LV2_WORKER_SUCCESS;
 }
 
+//---------------------------------------------------------
+//   lv2wrk_work
+//    Does one request, for LV2WorkerPool.
+//---------------------------------------------------------
+
+void LV2Synth::lv2wrk_work(LV2WorkerClient *client, uint32_t size, const void *data)
+{
+   LV2PluginWrapper_State *state = static_cast<LV2PluginWrapper_State *>(client);
+   state->wrkIface->work(lilv_instance_get_handle(state->handle),
+                         LV2Synth::lv2wrk_respond,
+                         state,
+                         size,
+                         data);
+}
+
+//---------------------------------------------------------
+//   lv2wrk_emitResponses
+//    Passes the finished work to the plugin, in run context
+//     after run() and before end_run().
+//---------------------------------------------------------
+
+void LV2Synth::lv2wrk_emitResponses(LV2PluginWrapper_State *state)
+{
+   if(state->wrkResponses == NULL || state->wrkIface->work_response == NULL)
+      return;
+   uint32_t size;
+   while(state->wrkResponses->get(&size, state->wrkResponseBuf))
+      state->wrkIface->work_response(lilv_instance_get_handle(state->handle), size, state->wrkResponseBuf);
+}
+
 void LV2Synth::lv2conf_write(LV2PluginWrapper_State *state, int level, Xml &xml)
 {
    state->iStateValues.clear();
@@ -4071,17 +4188,11 @@ bool LV2SynthIF::getData(MidiPort *, unsigned int pos, int ports, unsigned int n
 #endif
 
             lilv_instance_run(_handle, nsamp);
+            //notify worker about processed data (if any)
+            LV2Synth::lv2wrk_emitResponses(_state);
             //notify worker that this run() finished
             if(_state->wrkIface && _state->wrkIface->end_run)
                _state->wrkIface->end_run(lilv_instance_get_handle(_handle));
-            //notify worker about processed data (if any)
-            if(_state->wrkIface && _state->wrkIface->work_response && _state->wrkEndWork)
-            {
-               _state->wrkIface->work_response(lilv_instance_get_handle(_handle), _state->wrkDataSize, _state->wrkDataBuffer);
-               _state->wrkDataSize = 0;
-               _state->wrkDataBuffer = NULL;
-               _state->wrkEndWork = false;
-            }
 
             LV2Synth::lv2audio_postProcessMidiPorts(_state, nsamp);
 
@@ -4989,17 +5100,11 @@ void LV2PluginWrapper::apply(LADSPA_Handle handle, unsigned long n)
 
 
    lilv_instance_run(state->handle, n);
+   //notify worker about processed data (if any)
+   LV2Synth::lv2wrk_emitResponses(state);
    //notify worker that this run() finished
    if(state->wrkIface && state->wrkIface->end_run)
       state->wrkIface->end_run(lilv_instance_get_handle(state->handle));
-   //notify worker about processes data (if any)
-   if(state->wrkIface && state->wrkIface->work_response && state->wrkEndWork)
-   {
-      state->wrkEndWork = false;
-      state->wrkIface->work_response(lilv_instance_get_handle(state->handle), state->wrkDataSize, state->wrkDataBuffer);
-      state->wrkDataSize = 0;
-      state->wrkDataBuffer = NULL;
-   }
 
    LV2Synth::lv2audio_postProcessMidiPorts(state, n);
 }
@@ -5163,53 +5268,6 @@ void LV2PluginWrapper::applyPreset(PluginI *p, void *preset)
 
 }
 
-void LV2PluginWrapper_Worker::run()
-{
-   while(true)
-   {
-      _mSem.acquire(1);
-      if(_closing)
-         break;
-      makeWork();
-
-   }
-
-}
-
-LV2_Worker_Status LV2PluginWrapper_Worker::scheduleWork()
-{
-   if(_mSem.available() != 0)
-      return LV2_WORKER_ERR_NO_SPACE;
-   _mSem.release(1);
-   return LV2_WORKER_SUCCESS;
-
-}
-
-void LV2PluginWrapper_Worker::makeWork()
-{
-#ifdef DEBUG_LV2
-   std::cerr << "LV2PluginWrapper_Worker::makeWork" << std::endl;
-#endif
-   if(_state->wrkIface && _state->wrkIface->work)
-   {
-      const void *dataBuffer = _state->wrkDataBuffer;
-      uint32_t dataSize = _state->wrkDataSize;
-      _state->wrkDataBuffer = NULL;
-      _state->wrkDataSize = 0;
-      if(_state->wrkIface->work(lilv_instance_get_handle(_state->handle),
-                                LV2Synth::lv2wrk_respond,
-                                _state,
-                                dataSize,
-                                dataBuffer) != LV2_WORKER_SUCCESS)
-      {
-         _state->wrkEndWork = false;
-         _state->wrkDataBuffer = NULL;
-         _state->wrkDataSize = 0;
-      }
-   }
-
-}
-
 LV2EvBuf::LV2EvBuf(bool isInput, bool oldApi, LV2_URID atomTypeSequence, LV2_URID atomTypeChunk)
    :_isInput(isInput), _oldApi(oldApi), _uAtomTypeSequence(atomTypeSequence), _uAtomTypeChunk(atomTypeChunk)
 {
@@ -5518,48 +5576,6 @@ bool LV2SimpleRTFifo::get(uint32_t *port_index, size_t *szOut, char *data_out)
    return true;
 }
 
-LV2UridBiMap::LV2UridBiMap() : nextId ( 1 ) {_map.clear(); _rmap.clear();}
-
-LV2UridBiMap::~LV2UridBiMap()
-{
-   LV2_SYNTH_URID_MAP::iterator it = _map.begin();
-   for(;it != _map.end(); ++it)
-   {
-      free((void*)(*it).first);
-   }
-}
-
-LV2_URID LV2UridBiMap::map(const char *uri)
-{
-   std::pair<LV2_SYNTH_URID_MAP::iterator, bool> p;
-   uint32_t id;
-   idLock.lock();
-   LV2_SYNTH_URID_MAP::iterator it = _map.find(uri);
-   if(it == _map.end())
-   {
-      const char *mUri = strdup(uri);
-      p = _map.insert ( std::make_pair ( mUri, nextId ) );
-      _rmap.insert ( std::make_pair ( nextId, mUri ) );
-      nextId++;
-      id = p.first->second;
-   }
-   else
-      id = it->second;
-   idLock.unlock();
-   return id;
-
-}
-
-const char *LV2UridBiMap::unmap(uint32_t id)
-{
-   LV2_SYNTH_URID_RMAP::iterator it = _rmap.find ( id );
-   if ( it != _rmap.end() ) {
-      return it->second;
-   }
-
-   return NULL;
-}
-
 }
 
 #else //LV2_SUPPORT
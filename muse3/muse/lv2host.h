@@ -79,6 +79,9 @@
 #include <set>
 #include <string>
 #include <utility>
+#include <atomic>
+#include <pthread.h>
+#include <semaphore.h>
 #include <QMutex>
 #include <QSemaphore>
 #include <QThread>
@@ -95,6 +98,8 @@
 
 #include "plugin.h"
 #include "plugin_list.h"
+#include "lv2urid.h"
+#include "lv2worker.h"
 
 #endif
 
@@ -111,6 +116,10 @@ class LV2Synth;
 #define LV2_RT_FIFO_SIZE 128
 #define LV2_RT_FIFO_ITEM_SIZE (std::max(size_t(4096 * 16), size_t(MusEGlobal::segmentSize * 16)))
 #define LV2_EVBUF_SIZE (2*LV2_RT_FIFO_ITEM_SIZE)
+#define LV2_WORKER_RING_SIZE 8192
+#define LV2_WORKER_MAX_THREADS 4
+// The longest the gui waits for the worker pool to finish with a plugin.
+#define LV2_WORKER_CLAIM_TIMEOUT_MS 2000
 
 struct LV2MidiEvent
 {
@@ -237,33 +246,9 @@ struct LV2AudioPort
     QString name;
 };
 
-struct cmp_str
-{
-    bool operator() ( char const *a, char const *b ) const
-    {
-        return std::strcmp ( a, b ) < 0;
-    }
-};
-
 typedef std::vector<LV2MidiPort> LV2_MIDI_PORTS;
 typedef std::vector<LV2ControlPort> LV2_CONTROL_PORTS;
 typedef std::vector<LV2AudioPort> LV2_AUDIO_PORTS;
-typedef std::map<const char *, uint32_t, cmp_str> LV2_SYNTH_URID_MAP;
-typedef std::map<uint32_t, const char *> LV2_SYNTH_URID_RMAP;
-
-class LV2UridBiMap
-{
-private:
-    LV2_SYNTH_URID_MAP _map;
-    LV2_SYNTH_URID_RMAP _rmap;
-    uint32_t nextId;
-    QMutex idLock;
-public:
-    LV2UridBiMap();
-    ~LV2UridBiMap();
-    LV2_URID map ( const char *uri );
-    const char *unmap ( uint32_t id );
-};
 
 class LV2SynthIF;
 struct LV2PluginWrapper_State;
@@ -274,7 +259,7 @@ class LV2Synth : public Synth
 {
 private:
     const LilvPlugin *_handle;
-    LV2UridBiMap uridBiMap;
+    static LV2UridBiMap uridBiMap;   // Shared by all plugins.
     LV2_Feature *_features;
     LV2_Feature **_ppfeatures;
     LV2_Options_Option *_options;
@@ -374,6 +359,8 @@ public:
     static LV2_State_Status lv2state_stateStore ( LV2_State_Handle handle, uint32_t key, const void *value, size_t size, uint32_t type, uint32_t flags );
     static LV2_Worker_Status lv2wrk_scheduleWork(LV2_Worker_Schedule_Handle handle, uint32_t size, const void *data);
     static LV2_Worker_Status lv2wrk_respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data);    
+    static void lv2wrk_work(LV2WorkerClient *client, uint32_t size, const void *data);
+    static void lv2wrk_emitResponses(LV2PluginWrapper_State *state);
     static void lv2conf_write(LV2PluginWrapper_State *state, int level, Xml &xml);
     static void lv2conf_set(LV2PluginWrapper_State *state, const std::vector<QString> & customParams);
     static unsigned lv2ui_IsSupported (const char *, const char *ui_type_uri);
@@ -392,6 +379,7 @@ public:
     friend class LV2SynthIF;
     friend class LV2PluginWrapper;
     friend class LV2SynthIF_Timer;
+    friend void initLV2();
 
 
 };
@@ -496,7 +484,6 @@ public:
 
 
 class LV2PluginWrapper;
-class LV2PluginWrapper_Worker;
 class LV2PluginWrapper_Window;
 
 typedef struct _lv2ExtProgram
@@ -529,7 +516,7 @@ typedef struct _lv2ExtProgram
 
 } lv2ExtProgram;
 
-struct LV2PluginWrapper_State {
+struct LV2PluginWrapper_State : public LV2WorkerClient {
    LV2PluginWrapper_State():
       _ifeatures(NULL),
       _ppifeatures(NULL),
@@ -549,10 +536,8 @@ struct LV2PluginWrapper_State {
       iState(NULL),
       tmpValues(NULL),
       numStateValues(0),
-      wrkDataSize(0),
-      wrkDataBuffer(0),
-      wrkThread(NULL),
-      wrkEndWork(false),
+      wrkRequestBuf(NULL),
+      wrkResponseBuf(NULL),
       controlTimers(NULL),
       deleteLater(false),
       hasGui(false),
@@ -621,11 +606,9 @@ struct LV2PluginWrapper_State {
     QMap<QString, QPair<QString, QVariant> > iStateValues;
     char **tmpValues;
     size_t numStateValues;
-    uint32_t wrkDataSize;
-    const void *wrkDataBuffer;
-    LV2PluginWrapper_Worker *wrkThread;
+    char *wrkRequestBuf;             // For work done in run context, in freewheel mode.
+    char *wrkResponseBuf;            // For work_response(), run context only.
     LV2_Worker_Interface *wrkIface;
-    bool wrkEndWork;
     int *controlTimers;
     bool deleteLater;
     LV2_Atom_Forge atomForge;
@@ -668,27 +651,6 @@ struct LV2PluginWrapper_State {
 };
 
 
-class LV2PluginWrapper_Worker :public QThread
-{
-private:
-    LV2PluginWrapper_State *_state;
-    QSemaphore _mSem;
-    bool _closing;
-public:
-    explicit LV2PluginWrapper_Worker ( LV2PluginWrapper_State *s ) : QThread(),
-       _state ( s ),
-       _mSem(0),
-       _closing(false)
-    {}
-
-    void run();
-    LV2_Worker_Status scheduleWork();
-    void makeWork();
-    void setClosing() {_closing = true; _mSem.release();}
-
-};
-
-
 #ifdef LV2_GUI_USE_QWIDGET
 class LV2PluginWrapper_Window : public QWidget
 #else
@@ -0,0 +1,199 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2urid.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "lv2urid.h"
+
+namespace MusECore
+{
+
+LV2UridBiMap::LV2UridBiMap(uint32_t size)
+   : _nextId(1)
+{
+   uint32_t n = 16;
+   while(n < size * 2)
+      n <<= 1;
+   _table.store(newTable(n));
+   for(uint32_t i = 0; i < MAX_ID_BLOCKS; ++i)
+      _ids [i] = NULL;
+   pthread_mutex_init(&_lock, NULL);
+}
+
+LV2UridBiMap::~LV2UridBiMap()
+{
+   const uint32_t n = _nextId.load();
+   for(uint32_t id = 1; id < n; ++id)
+      free(_ids [id / ID_BLOCK_SIZE] [id % ID_BLOCK_SIZE]);
+   for(uint32_t i = 0; i < MAX_ID_BLOCKS; ++i)
+      delete [] _ids [i];
+   Table *t = _table.load();
+   while(t != NULL)
+   {
+      Table *prev = t->prev;
+      delete [] t->slots;
+      delete t;
+      t = prev;
+   }
+   pthread_mutex_destroy(&_lock);
+}
+
+//---------------------------------------------------------
+//   hash
+//    FNV-1a.
+//---------------------------------------------------------
+
+uint32_t LV2UridBiMap::hash(const char *uri)
+{
+   uint32_t h = 2166136261U;
+   for(const unsigned char *p = (const unsigned char *)uri; *p; ++p)
+   {
+      h ^= *p;
+      h *= 16777619U;
+   }
+   return h;
+}
+
+LV2UridBiMap::Table *LV2UridBiMap::newTable(uint32_t size)
+{
+   Table *t = new Table;
+   t->mask = size - 1;
+   t->used = 0;
+   t->prev = NULL;
+   t->slots = new std::atomic<Entry *> [size];
+   for(uint32_t i = 0; i < size; ++i)
+      t->slots [i].store(NULL, std::memory_order_relaxed);
+   return t;
+}
+
+//---------------------------------------------------------
+//   find
+//    Linear probing. Returns 0 if not found.
+//---------------------------------------------------------
+
+uint32_t LV2UridBiMap::find(const Table *t, const char *uri, uint32_t h)
+{
+   for(uint32_t i = h & t->mask; ; i = (i + 1) & t->mask)
+   {
+      const Entry *e = t->slots [i].load(std::memory_order_acquire);
+      if(e == NULL)
+         return 0;
+      if(e->hash == h && strcmp(e->uri, uri) == 0)
+         return e->id;
+   }
+}
+
+void LV2UridBiMap::put(Table *t, Entry *e)
+{
+   uint32_t i = e->hash & t->mask;
+   while(t->slots [i].load(std::memory_order_relaxed) != NULL)
+      i = (i + 1) & t->mask;
+   t->slots [i].store(e, std::memory_order_release);
+   ++t->used;
+}
+
+//---------------------------------------------------------
+//   insert
+//    Adds the uri unless another thread has done so
+//     meanwhile. The id is in _ids before the uri can be
+//     found in the table.
+//---------------------------------------------------------
+
+uint32_t LV2UridBiMap::insert(const char *uri, uint32_t h)
+{
+   pthread_mutex_lock(&_lock);
+   Table *t = _table.load(std::memory_order_relaxed);
+   uint32_t id = find(t, uri, h);
+   if(id != 0)
+   {
+      pthread_mutex_unlock(&_lock);
+      return id;
+   }
+
+   id = _nextId.load(std::memory_order_relaxed);
+   const uint32_t block = id / ID_BLOCK_SIZE;
+   if(block >= MAX_ID_BLOCKS)
+   {
+      pthread_mutex_unlock(&_lock);
+      return 0;
+   }
+   if(_ids [block] == NULL)
+      _ids [block] = new Entry * [ID_BLOCK_SIZE];
+
+   const size_t len = strlen(uri);
+   Entry *e = (Entry *)malloc(offsetof(Entry, uri) + len + 1);
+   e->hash = h;
+   e->id = id;
+   memcpy(e->uri, uri, len + 1);
+   _ids [block] [id % ID_BLOCK_SIZE] = e;
+   _nextId.store(id + 1, std::memory_order_release);
+
+   if((t->used + 1) * 2 > t->mask + 1)
+   {
+      Table *nt = newTable((t->mask + 1) * 2);
+      for(uint32_t i = 0; i <= t->mask; ++i)
+      {
+         Entry *o = t->slots [i].load(std::memory_order_relaxed);
+         if(o != NULL)
+            put(nt, o);
+      }
+      nt->prev = t;
+      put(nt, e);
+      _table.store(nt, std::memory_order_release);
+   }
+   else
+      put(t, e);
+
+   pthread_mutex_unlock(&_lock);
+   return id;
+}
+
+//---------------------------------------------------------
+//   map
+//---------------------------------------------------------
+
+uint32_t LV2UridBiMap::map(const char *uri)
+{
+   if(uri == NULL)
+      return 0;
+   const uint32_t h = hash(uri);
+   const uint32_t id = find(_table.load(std::memory_order_acquire), uri, h);
+   if(id != 0)
+      return id;
+   return insert(uri, h);
+}
+
+//---------------------------------------------------------
+//   unmap
+//---------------------------------------------------------
+
+const char *LV2UridBiMap::unmap(uint32_t id) const
+{
+   if(id == 0 || id >= _nextId.load(std::memory_order_acquire))
+      return NULL;
+   return _ids [id / ID_BLOCK_SIZE] [id % ID_BLOCK_SIZE]->uri;
+}
+
+} // namespace MusECore
@@ -0,0 +1,95 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2urid.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __LV2URID_H__
+#define __LV2URID_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+
+namespace MusECore
+{
+
+//---------------------------------------------------------
+//   LV2UridBiMap
+//    Uri to id map shared by all LV2 plugins. Plugins map
+//     uris in run(), so looking up a known uri takes no
+//     lock: the uris are in an open addressed hash table,
+//     which is only ever added to, and replaced by a copy
+//     twice the size when half full. The old tables are
+//     kept until the map is deleted, as a reader may still
+//     be in one. Adding a uri takes a lock, so the uris the
+//     host knows of are added up front (see initLV2()).
+//    Ids are handed out in order from 1, and unmap() finds
+//     the uri in an array of fixed size blocks indexed by id.
+//---------------------------------------------------------
+
+class LV2UridBiMap
+{
+public:
+   static const uint32_t ID_BLOCK_SIZE = 1024;
+   static const uint32_t MAX_ID_BLOCKS = 1024;
+
+private:
+   struct Entry
+   {
+      uint32_t hash;
+      uint32_t id;
+      char uri [1];     // Allocated to length.
+   };
+   struct Table
+   {
+      uint32_t mask;
+      uint32_t used;
+      Table *prev;      // The smaller table this one replaced.
+      std::atomic<Entry *> *slots;
+   };
+
+   std::atomic<Table *> _table;
+   Entry **_ids [MAX_ID_BLOCKS];          // Blocks of ID_BLOCK_SIZE.
+   std::atomic<uint32_t> _nextId;         // Ids below are in _ids.
+   pthread_mutex_t _lock;
+
+   LV2UridBiMap(const LV2UridBiMap&);
+   void operator=(const LV2UridBiMap&);
+
+   static uint32_t hash(const char *uri);
+   static Table *newTable(uint32_t size);
+   static uint32_t find(const Table *t, const char *uri, uint32_t h);
+   static void put(Table *t, Entry *e);
+   uint32_t insert(const char *uri, uint32_t h);
+
+public:
+   explicit LV2UridBiMap(uint32_t size = 1024);
+   ~LV2UridBiMap();
+   // Returns 0 if the uri is null or no more ids are left.
+   uint32_t map(const char *uri);
+   // Returns NULL for unknown ids.
+   const char *unmap(uint32_t id) const;
+   uint32_t size() const { return _nextId.load(std::memory_order_acquire) - 1; }
+};
+
+} // namespace MusECore
+
+#endif
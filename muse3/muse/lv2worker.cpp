@@ -0,0 +1,240 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2worker.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <algorithm>
+
+#include "lv2worker.h"
+
+namespace MusECore
+{
+
+//---------------------------------------------------------
+//   LV2WorkerRing
+//---------------------------------------------------------
+
+LV2WorkerRing::LV2WorkerRing(uint32_t size)
+   : _size(size), _wPos(0), _rPos(0)
+{
+   assert(size > sizeof(uint32_t) && (size & (size - 1)) == 0);
+   _buf = new char [_size];
+}
+
+LV2WorkerRing::~LV2WorkerRing()
+{
+   delete [] _buf;
+}
+
+void LV2WorkerRing::copyIn(uint32_t pos, const void *data, uint32_t n)
+{
+   uint32_t i = pos & (_size - 1);
+   uint32_t first = std::min(n, _size - i);
+   memcpy(_buf + i, data, first);
+   memcpy(_buf, (const char *)data + first, n - first);
+}
+
+void LV2WorkerRing::copyOut(uint32_t pos, void *data, uint32_t n) const
+{
+   uint32_t i = pos & (_size - 1);
+   uint32_t first = std::min(n, _size - i);
+   memcpy(data, _buf + i, first);
+   memcpy((char *)data + first, _buf, n - first);
+}
+
+bool LV2WorkerRing::put(uint32_t size, const void *data)
+{
+   uint32_t w = _wPos.load(std::memory_order_relaxed);
+   uint32_t r = _rPos.load(std::memory_order_acquire);
+   if(size > maxSize() || _size - (w - r) < sizeof(uint32_t) + size)
+      return false;
+   copyIn(w, &size, sizeof(uint32_t));
+   copyIn(w + sizeof(uint32_t), data, size);
+   _wPos.store(w + sizeof(uint32_t) + size, std::memory_order_release);
+   return true;
+}
+
+bool LV2WorkerRing::get(uint32_t *size, void *data)
+{
+   uint32_t r = _rPos.load(std::memory_order_relaxed);
+   uint32_t w = _wPos.load(std::memory_order_acquire);
+   if(r == w)
+      return false;
+   copyOut(r, size, sizeof(uint32_t));
+   copyOut(r + sizeof(uint32_t), data, *size);
+   _rPos.store(r + sizeof(uint32_t) + *size, std::memory_order_release);
+   return true;
+}
+
+bool LV2WorkerRing::empty() const
+{
+   return _rPos.load(std::memory_order_acquire) == _wPos.load(std::memory_order_acquire);
+}
+
+//---------------------------------------------------------
+//   LV2WorkerPool
+//---------------------------------------------------------
+
+LV2WorkerPool::LV2WorkerPool(int threads, Work work, uint32_t bufSize)
+   : _threads(NULL), _threadCount(0), _running(true), _pushed(NULL), _ready(NULL),
+     _work(work), _bufSize(bufSize)
+{
+   sem_init(&_sem, 0, 0);
+   pthread_mutex_init(&_lock, NULL);
+   _threads = new pthread_t [threads];
+   for(int i = 0; i < threads; ++i)
+   {
+      int rv = pthread_create(&_threads [_threadCount], NULL, workerLoop, this);
+      if(rv)
+      {
+         fprintf(stderr, "LV2WorkerPool: creating thread failed: %s\n", strerror(rv));
+         break;
+      }
+      ++_threadCount;
+   }
+#ifdef DEBUG_LV2
+   fprintf(stderr, "LV2WorkerPool: started %d threads\n", _threadCount);
+#endif
+}
+
+LV2WorkerPool::~LV2WorkerPool()
+{
+   _running.store(false);
+   for(int i = 0; i < _threadCount; ++i)
+      sem_post(&_sem);
+   for(int i = 0; i < _threadCount; ++i)
+      pthread_join(_threads [i], NULL);
+   delete [] _threads;
+   pthread_mutex_destroy(&_lock);
+   sem_destroy(&_sem);
+}
+
+//---------------------------------------------------------
+//   push
+//    Called from the run context.
+//---------------------------------------------------------
+
+void LV2WorkerPool::push(LV2WorkerClient *client)
+{
+   LV2WorkerClient *head = _pushed.load(std::memory_order_relaxed);
+   do
+   {
+      client->wrkNext = head;
+   }
+   while(!_pushed.compare_exchange_weak(head, client, std::memory_order_release, std::memory_order_relaxed));
+   sem_post(&_sem);
+}
+
+//---------------------------------------------------------
+//   take
+//    Moves everything pushed so far to the ready list, in
+//     the order it was pushed, when that is empty.
+//---------------------------------------------------------
+
+LV2WorkerClient *LV2WorkerPool::take()
+{
+   pthread_mutex_lock(&_lock);
+   if(_ready == NULL)
+   {
+      LV2WorkerClient *c = _pushed.exchange(NULL, std::memory_order_acquire);
+      while(c != NULL)
+      {
+         LV2WorkerClient *next = c->wrkNext;
+         c->wrkNext = _ready;
+         _ready = c;
+         c = next;
+      }
+   }
+   LV2WorkerClient *client = _ready;
+   if(client != NULL)
+      _ready = client->wrkNext;
+   pthread_mutex_unlock(&_lock);
+   return client;
+}
+
+//---------------------------------------------------------
+//   process
+//---------------------------------------------------------
+
+void LV2WorkerPool::process(LV2WorkerClient *client, char *buf)
+{
+   do
+   {
+      uint32_t size;
+      while(client->wrkRequests->get(&size, buf))
+         _work(client, size, buf);
+      client->wrkBusy.store(false);
+      //a request put after the ring was found empty, but while
+      // still busy, was not queued by the run context
+   }
+   while(!client->wrkRequests->empty() && !client->wrkBusy.exchange(true));
+}
+
+//---------------------------------------------------------
+//   claim
+//---------------------------------------------------------
+
+bool LV2WorkerPool::claim(LV2WorkerClient *client, unsigned timeoutMs)
+{
+   for(unsigned ms = 0; client->wrkBusy.exchange(true); ++ms)
+   {
+      if(ms >= timeoutMs)
+         return false;
+      usleep(1000);
+   }
+   return true;
+}
+
+//---------------------------------------------------------
+//   release
+//---------------------------------------------------------
+
+void LV2WorkerPool::release(LV2WorkerClient *client)
+{
+   client->wrkBusy.store(false);
+   if(!client->wrkRequests->empty() && !client->wrkBusy.exchange(true))
+      push(client);
+}
+
+void *LV2WorkerPool::workerLoop(void *arg)
+{
+   LV2WorkerPool *pool = (LV2WorkerPool *)arg;
+   char *buf = new char [pool->_bufSize];
+   while(true)
+   {
+      while(sem_wait(&pool->_sem) == -1 && errno == EINTR)
+         ;
+      if(!pool->_running.load())
+         break;
+      LV2WorkerClient *client = pool->take();
+      if(client != NULL)
+         pool->process(client, buf);
+   }
+   delete [] buf;
+   return NULL;
+}
+
+} // namespace MusECore
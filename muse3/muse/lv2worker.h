@@ -0,0 +1,135 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2worker.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __LV2WORKER_H__
+#define __LV2WORKER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+
+namespace MusECore
+{
+
+//---------------------------------------------------------
+//   LV2WorkerRing
+//    Single reader, single writer queue of variable sized
+//     worker messages. Each message is its size followed
+//     by the data. The worker requests of a plugin are only
+//     written by its run context, and read by whoever holds
+//     the plugin's wrkBusy flag. The responses are written
+//     by the holder of the flag and read by the run context.
+//---------------------------------------------------------
+
+class LV2WorkerRing
+{
+private:
+   char *_buf;
+   uint32_t _size;                  // Power of two.
+   std::atomic<uint32_t> _wPos;     // Free running positions.
+   std::atomic<uint32_t> _rPos;
+   void copyIn(uint32_t pos, const void *data, uint32_t n);
+   void copyOut(uint32_t pos, void *data, uint32_t n) const;
+public:
+   // size must be a power of two.
+   explicit LV2WorkerRing(uint32_t size);
+   ~LV2WorkerRing();
+   // The largest message that fits in an empty ring.
+   uint32_t maxSize() const { return _size - sizeof(uint32_t); }
+   bool put(uint32_t size, const void *data);
+   // data must have room for maxSize() bytes.
+   bool get(uint32_t *size, void *data);
+   bool empty() const;
+};
+
+//---------------------------------------------------------
+//   LV2WorkerClient
+//    The worker side of a plugin instance.
+//---------------------------------------------------------
+
+struct LV2WorkerClient
+{
+   LV2WorkerClient() : wrkRequests(NULL), wrkResponses(NULL), wrkBusy(false), wrkNext(NULL) {}
+   LV2WorkerRing *wrkRequests;      // Run context to the worker pool.
+   LV2WorkerRing *wrkResponses;     // Worker pool to run context.
+   std::atomic<bool> wrkBusy;       // Queued in the pool or being worked on.
+   LV2WorkerClient *wrkNext;        // Link in the pool queue.
+};
+
+//---------------------------------------------------------
+//   LV2WorkerPool
+//    A few threads doing the scheduled work of all the
+//     LV2 plugins, instead of one thread per instance.
+//    A plugin with pending requests is queued once until
+//     a thread has emptied its request ring, so the work
+//     of one instance is never done by two threads at once,
+//     as the worker extension requires. The queue is a lock
+//     free stack for the run context to push on, which the
+//     threads take from in turns.
+//---------------------------------------------------------
+
+class LV2WorkerPool
+{
+public:
+   // Does one request of the plugin.
+   typedef void (*Work)(LV2WorkerClient *client, uint32_t size, const void *data);
+
+private:
+   pthread_t *_threads;
+   int _threadCount;
+   std::atomic<bool> _running;
+   sem_t _sem;
+   std::atomic<LV2WorkerClient *> _pushed;   // Newest first.
+   LV2WorkerClient *_ready;                  // Oldest first, under _lock.
+   pthread_mutex_t _lock;
+   Work _work;
+   uint32_t _bufSize;
+
+   LV2WorkerClient *take();
+   static void *workerLoop(void *arg);
+public:
+   // bufSize is the largest request.
+   LV2WorkerPool(int threads, Work work, uint32_t bufSize);
+   ~LV2WorkerPool();
+   int threads() const { return _threadCount; }
+   // Queues the plugin, which the caller has set wrkBusy of.
+   void push(LV2WorkerClient *client);
+   // Does all pending requests of the plugin. The caller has
+   //  set wrkBusy, which is cleared when done. buf must have
+   //  room for bufSize bytes.
+   void process(LV2WorkerClient *client, char *buf);
+   // Waits at most timeoutMs for the pool to finish with the
+   //  plugin, then sets wrkBusy. Not for the realtime threads.
+   //  Returns false if the pool is still busy with it, which
+   //  only a plugin stuck in work() should cause.
+   static bool claim(LV2WorkerClient *client, unsigned timeoutMs);
+   // Clears wrkBusy set by claim(), and queues the plugin if
+   //  requests came in meanwhile.
+   void release(LV2WorkerClient *client);
+};
+
+} // namespace MusECore
+
+#endif
@@ -21,6 +21,7 @@
 //
 //=========================================================
 
+#include <QAbstractButton>
 #include <QApplication>
 #include <QDir>
 #include <QFile>
@@ -67,6 +68,7 @@
 #include "plugin.h"
 #include "wavepreview.h"
 #include "plugin_cache_writer.h"
+#include "memory.h"
 #include "pluglist.h"
 
 #ifdef HAVE_LASH
@@ -96,6 +98,10 @@ extern void initMidiSequencer();
 extern void exitMidiSequencer();
 extern void initAudio();
 extern void initAudioPrefetch();   
+extern void initAudioScheduler();
+extern void initPeakBuilder();
+extern void initWaveCache();
+extern void initDspProfiler();
 extern void initMidiSynth();
 
 #ifdef ALSA_SUPPORT
@@ -136,6 +142,30 @@ static void printVersion(const char* prog)
             fprintf(stderr, "%s: Linux Music Editor; Version %s\n", prog, VERSION);
       }
 
+//---------------------------------------------------------
+//   batchRenderMessage
+//    Puts the text of a message box out on stderr, and
+//     answers it with its escape button as if closed.
+//     Errors and warnings fail the batch render.
+//---------------------------------------------------------
+
+static void batchRenderMessage(QMessageBox* box)
+      {
+      const bool error = box->icon() == QMessageBox::Critical || box->icon() == QMessageBox::Warning;
+      if (error)
+            ++MusEGlobal::batchRenderErrors;
+      QString text = box->text();
+      if (!box->informativeText().isEmpty())
+            text += "\n" + box->informativeText();
+      fprintf(stderr, "MusE: batch render: %s: %s: %s\n", error ? "error" : "message",
+         box->windowTitle().toLocal8Bit().constData(), text.toLocal8Bit().constData());
+      // Queued, the box is not running its event loop yet.
+      if (QAbstractButton* b = box->escapeButton())
+            QMetaObject::invokeMethod(b, "click", Qt::QueuedConnection);
+      else
+            QMetaObject::invokeMethod(box, "reject", Qt::QueuedConnection);
+      }
+
 //---------------------------------------------------------
 //   MuseApplication
 //---------------------------------------------------------
@@ -163,6 +193,12 @@ class MuseApplication : public QApplication {
 
       bool notify(QObject* receiver, QEvent* event) {
          bool flag = QApplication::notify(receiver, event);
+         // No one can answer a message box in a batch render. Its show
+         //  event has set up its escape button by now.
+         if (event->type() == QEvent::Show && !MusEGlobal::batchRenderFile.isEmpty()) {
+            if (QMessageBox* box = qobject_cast<QMessageBox*>(receiver))
+               batchRenderMessage(box);
+         }
          if (event->type() == QEvent::KeyPress) {
 #if QT_VERSION >= 0x050000
             const QMetaObject * mo = receiver->metaObject();
@@ -257,6 +293,11 @@ static void usage(const char* prog, const char* txt)
       fprintf(stderr, "                        (Dummy only, default 40. Else fixed by Jack.)\n");
       fprintf(stderr, "   -Y  n    Force midi real time priority to n (default: audio driver prio -1)\n");
       fprintf(stderr, "\n");
+      fprintf(stderr, "   -b  file Batch render: bounce the whole project to a wave file and quit.\n");
+      fprintf(stderr, "            No window is shown and the dummy audio driver is used.\n");
+      fprintf(stderr, "   -o  name Batch render: output track to bounce (default: first output)\n");
+      fprintf(stderr, "   -T  list Batch render: comma separated tracks to solo, for stems\n");
+      fprintf(stderr, "\n");
       fprintf(stderr, "   -R       Force plugin cache re-scan. (Automatic if any plugin path directories changed.)\n");
       fprintf(stderr, "   -p       Don't load LADSPA plugins\n");
       fprintf(stderr, "   -S       Don't load MESS plugins\n");
@@ -339,6 +380,36 @@ void fallbackDummy() {
   MusECore::initDummyAudio();
 }
 
+//---------------------------------------------------------
+//   batchRenderRequested
+//    Looks for the -b option the way getopt() will find it
+//     later, also as "-bfile" or grouped like "-db file".
+//     Needed before the application is made.
+//---------------------------------------------------------
+
+static bool batchRenderRequested(int argc, char** argv, const char* optstr)
+      {
+      for (int k = 1; k < argc; ++k) {
+            const char* a = argv[k];
+            if (!a || a[0] != '-' || a[1] == 0)
+                  continue;
+            if (strcmp(a, "--") == 0)
+                  break;
+            for (int j = 1; a[j]; ++j) {
+                  if (a[j] == 'b')
+                        return true;
+                  const char* o = strchr(optstr, a[j]);
+                  if (o && o[1] == ':') {
+                        // The rest of the word or the next word is its argument.
+                        if (a[j + 1] == 0)
+                              ++k;
+                        break;
+                        }
+                  }
+            }
+      return false;
+      }
+
 //---------------------------------------------------------
 //   main
 //---------------------------------------------------------
@@ -526,21 +597,7 @@ int main(int argc, char* argv[])
         lash_args = lash_extract_args (&argc_copy, &argv_copy);
   #endif
 
-        // Now create the application, and let Qt remove recognized arguments.
-        MuseApplication app(argc_copy, argv_copy);
-        if(QStyle* def_style = app.style())
-        {
-          const QString appStyleObjName = def_style->objectName();
-          MusEGui::Appearance::getSetDefaultStyle(&appStyleObjName);
-        }
-        
-        // NOTE: Set the stylesheet and style as early as possible!
-        // Any later invites trouble - typically the colours may be off, 
-        //  but currently with Breeze or Oxygen, MDI sub windows  may be frozen!
-        // Working with Breeze maintainer to fix problem... 2017/06/06 Tim.
-        MusEGui::updateThemeAndStyle();
-
-        QString optstr("aJjFAhvdDumMsP:Y:l:pRSy");
+        QString optstr("aJjFAhvdDumMsP:Y:l:pRSyb:o:T:");
   #ifdef VST_SUPPORT
         optstr += QString("V");
   #endif
@@ -560,6 +617,24 @@ int main(int argc, char* argv[])
         optstr += QString("t");
   #endif
 
+        // A batch render needs no display, unless a platform was asked for.
+        if(batchRenderRequested(argc_copy, argv_copy, optstr.toLatin1().constData()))
+          setenv("QT_QPA_PLATFORM", "offscreen", 0);
+
+        // Now create the application, and let Qt remove recognized arguments.
+        MuseApplication app(argc_copy, argv_copy);
+        if(QStyle* def_style = app.style())
+        {
+          const QString appStyleObjName = def_style->objectName();
+          MusEGui::Appearance::getSetDefaultStyle(&appStyleObjName);
+        }
+        
+        // NOTE: Set the stylesheet and style as early as possible!
+        // Any later invites trouble - typically the colours may be off, 
+        //  but currently with Breeze or Oxygen, MDI sub windows  may be frozen!
+        // Working with Breeze maintainer to fix problem... 2017/06/06 Tim.
+        MusEGui::updateThemeAndStyle();
+
         AudioDriverSelect audioType = DriverConfigSetting;
         bool force_plugin_rescan = false;
         int i;
@@ -617,6 +692,9 @@ int main(int argc, char* argv[])
                     case '2': MusEGlobal::loadLV2 = false; break;
                     case 'y': MusEGlobal::usePythonBridge = true; break;
                     case 'l': locale_override = QString(optarg); break;
+                    case 'b': MusEGlobal::batchRenderFile = QString(optarg); break;
+                    case 'o': MusEGlobal::batchRenderOutput = QString(optarg); break;
+                    case 'T': MusEGlobal::batchRenderTracks = QString(optarg); break;
                     case 'h': usage(argv_copy[0], argv_copy[1]);
   #ifdef HAVE_LASH
                           if(lash_args) lash_args_destroy(lash_args);
@@ -630,6 +708,22 @@ int main(int argc, char* argv[])
                     }
               }
 
+        if(!MusEGlobal::batchRenderFile.isEmpty())
+        {
+          if(optind >= argc_copy)
+          {
+            usage(argv_copy[0], "batch render needs a project file");
+  #ifdef HAVE_LASH
+            if(lash_args) lash_args_destroy(lash_args);
+  #endif
+            return -1;
+          }
+          // Nothing shared with other instances: no server, no device ports.
+          audioType = DummyAudioOverride;
+          MusEGlobal::populateMidiPortsOnStart = false;
+          MusEGlobal::useLASH = false;
+        }
+
         // Set some AL library namespace debug flags as well.
         // Make sure the AL namespace variables mirror our variables.
         AL::debugMsg = MusEGlobal::debugMsg;
@@ -744,7 +838,7 @@ int main(int argc, char* argv[])
 
         QString splash_prefix;
         QSplashScreen* muse_splash = NULL;
-        if (MusEGlobal::config.showSplashScreen) {
+        if (MusEGlobal::config.showSplashScreen && MusEGlobal::batchRenderFile.isEmpty()) {
             QPixmap splsh(MusEGlobal::museGlobalShare + "/splash.png");
 
             if (!splsh.isNull()) {
@@ -991,6 +1085,11 @@ int main(int argc, char* argv[])
         // setup the prefetch fifo length now that the segmentSize is known
         MusEGlobal::fifoLength = 131072 / MusEGlobal::segmentSize;
         MusECore::initAudioPrefetch();
+        MusECore::initAudioScheduler();
+        MusECore::initPeakBuilder();
+        MusECore::initWaveCache();
+        MusECore::initDspProfiler();
+        rtArena().setFailSafe(MusEGlobal::config.rtAllocFailSafe);
 
         if(muse_splash)
         {
@@ -1084,7 +1183,8 @@ int main(int argc, char* argv[])
 
         MusEGlobal::muse->populateAddTrack(); // could possibly be done in a thread.
 
-        MusEGlobal::muse->show();
+        if(MusEGlobal::batchRenderFile.isEmpty())
+          MusEGlobal::muse->show();
 
         // Let the configuration settings take effect. Do not save.
         MusEGlobal::muse->changeConfig(false);
@@ -1132,7 +1232,10 @@ int main(int argc, char* argv[])
         //--------------------------------------------------
         MusEGlobal::muse->loadDefaultSong(argc_copy, &argv_copy[optind]);
 
-        QTimer::singleShot(100, MusEGlobal::muse, SLOT(showDidYouKnowDialog()));
+        if(MusEGlobal::batchRenderFile.isEmpty())
+          QTimer::singleShot(100, MusEGlobal::muse, SLOT(showDidYouKnowDialog()));
+        else
+          QTimer::singleShot(0, MusEGlobal::muse, SLOT(batchRender()));
 
         //--------------------------------------------------
         // Start the application...
@@ -1164,6 +1267,9 @@ int main(int argc, char* argv[])
         // In case the sequencer object is still alive, make sure to destroy it now.
         MusECore::exitMidiSequencer();
 
+        if(MusEGlobal::debugMsg)
+          rtArena().dump(stderr);
+
         // Grab the restart flag before deleting muse.
         is_restarting = MusEGlobal::muse->restartingApp();
 
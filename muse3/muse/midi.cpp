@@ -1318,6 +1318,8 @@ void Audio::collectEvents(MusECore::MidiTrack* track, unsigned int cts, unsigned
             //  our tempo map is not frame-accurate, only tick-accurate.
             ciEvent ie   = events.lower_bound(stick);
             ciEvent iend = events.upper_bound(etick);
+            // Events come in tick order, so the tempo lookups can follow along.
+            TempoCursor tempoCursor;
 
             DEBUG_MIDI_TIMING(stderr, "Audio::collectEvents: part events stick:%u etick:%u\n", stick, etick);
             
@@ -1360,7 +1362,7 @@ void Audio::collectEvents(MusECore::MidiTrack* track, unsigned int cts, unsigned
                   {
                     // If external sync is off, look up the scheduling frame from our tempo list
                     //  ie. normal playback.
-                    const unsigned int fr = MusEGlobal::tempomap.tick2frame(tick);
+                    const unsigned int fr = MusEGlobal::tempomap.tick2frame(tick, tempoCursor);
                     
                     DEBUG_MIDI_TIMING(stderr, "Audio::collectEvents: event: frame:%u\n", fr);
                       
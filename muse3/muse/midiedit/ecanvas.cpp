@@ -170,7 +170,7 @@ bool EventCanvas::stuckNoteExists(int port, int channel, int pitch) const
 
 void EventCanvas::songChanged(MusECore::SongChangedStruct_t flags)
       {
-      if (flags._flags & ~(SC_SELECTION | SC_PART_SELECTION | SC_TRACK_SELECTION)) {
+      if (flags._flags & ~(SC_SELECTION | SC_PART_SELECTION | SC_TRACK_SELECTION | SC_WAVE_PEAKS)) {
             // TODO FIXME: don't we actually only want SC_PART_*, and maybe SC_TRACK_DELETED?
             //             (same in waveview.cpp)
             bool curItemNeedsRestore=false;
@@ -196,14 +196,17 @@ void MidiEventBase::read(Xml& xml)
                         {
                         QByteArray ba    = tag.toLatin1();
                         const char*s     = ba.constData();
-                        edata.data       = new unsigned char[dataLen];
-                        edata.dataLen    = dataLen;
-                        unsigned char* d = edata.data;
+                        if (dataLen <= 0)
+                              break;
+                        unsigned char* buf = new unsigned char[dataLen];
+                        unsigned char* d = buf;
                         for (int i = 0; i < dataLen; ++i) {
                               char* endp;
                               *d++ = strtol(s, &endp, 16);
                               s = endp;
                               }
+                        edata.setData(buf, dataLen);
+                        delete[] buf;
                         }
                         break;
                   case Xml::Attribut:
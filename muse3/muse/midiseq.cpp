@@ -51,6 +51,7 @@
 #include "gconfig.h"
 #include "warn_bad_timing.h"
 #include "large_int.h"
+#include "memory.h"
 
 namespace MusEGlobal {
 MusECore::MidiSeq* midiSeq = NULL;
@@ -502,6 +503,7 @@ void MidiSeq::checkAndReportTimingResolution()
 void MidiSeq::midiTick(void* p, void*)
       {
       MidiSeq* at = (MidiSeq*)p;
+      RTArenaScope rtScope;
       at->processTimerTick();
       if (TIMER_DEBUG)
       {
@@ -34,6 +34,9 @@
 #include <QActionGroup>
 #include <QAction>
 #include <QThread>
+#include <QDir>
+#include <QFileDialog>
+#include <QMessageBox>
 
 #include "app.h"
 #include "helper.h"
@@ -41,6 +44,9 @@
 #include "amixer.h"
 #include "song.h"
 #include "audio.h"
+#include "dspprofiler.h"
+#include "plugin.h"
+#include "synth.h"
 
 #include "astrip.h"
 #include "mstrip.h"
@@ -192,6 +198,13 @@ AudioMixerApp::AudioMixerApp(QWidget* parent, MusEGlobal::MixerConfig* c)
       routingId = menuView->addAction(tr("Routing"), this, SLOT(toggleRouteDialog()));
       routingId->setCheckable(true);
 
+      showDspLoadId = menuView->addAction(tr("Show DSP Load"));
+      showDspLoadId->setCheckable(true);
+      showDspLoadId->setChecked(MusEGlobal::dspProfiler && MusEGlobal::dspProfiler->enabled());
+      connect(showDspLoadId, SIGNAL(triggered(bool)), SLOT(showDspLoadChanged(bool)));
+      menuView->addAction(tr("Reset DSP Load"), this, SLOT(resetDspLoad()));
+      menuView->addAction(tr("Save DSP Load..."), this, SLOT(saveDspLoad()));
+
       menuView->addSeparator();
 
       QActionGroup* actionItems = new QActionGroup(this);
@@ -941,6 +954,99 @@ void AudioMixerApp::routingDialogClosed()
       routingId->setChecked(false);
 }
 
+//---------------------------------------------------------
+//   showDspLoadChanged
+//    The strips show the load of their track while
+//     the profiler is enabled.
+//---------------------------------------------------------
+
+void AudioMixerApp::showDspLoadChanged(bool v)
+{
+      if(MusEGlobal::dspProfiler)
+        MusEGlobal::dspProfiler->setEnabled(v);
+}
+
+//---------------------------------------------------------
+//   resetDspLoad
+//---------------------------------------------------------
+
+void AudioMixerApp::resetDspLoad()
+{
+      if(MusEGlobal::dspProfiler)
+        MusEGlobal::dspProfiler->reset();
+}
+
+//---------------------------------------------------------
+//   dspLoadRows
+//    All nodes in track list order.
+//---------------------------------------------------------
+
+static std::vector<MusECore::DspCsvRow> dspLoadRows()
+{
+      using MusECore::DspCsvRow;
+      using MusECore::DspProfiler;
+      std::vector<DspCsvRow> rows;
+      rows.push_back(DspCsvRow(MusEGlobal::audio, DspProfiler::CYCLE, "cycle", QString("process")));
+      rows.push_back(DspCsvRow(MusEGlobal::audio, DspProfiler::MIDI, "midi", QString("midi")));
+
+      MusECore::TrackList* tl = MusEGlobal::song->tracks();
+      for (MusECore::ciTrack it = tl->begin(); it != tl->end(); ++it)
+      {
+        if ((*it)->isMidiTrack())
+          continue;
+        MusECore::AudioTrack* t = (MusECore::AudioTrack*)(*it);
+        rows.push_back(DspCsvRow(t, DspProfiler::TRACK, "track", t->name()));
+        if (t->isSynthTrack() && ((MusECore::SynthI*)t)->sif())
+        {
+          const MusECore::SynthIF* sif = ((MusECore::SynthI*)t)->sif();
+          DspCsvRow r(t, DspProfiler::SYNTH, "synth", t->name());
+          r.hasCycles     = true;
+          r.runCycles     = sif->runCycles();
+          r.skippedCycles = sif->skippedCycles();
+          rows.push_back(r);
+        }
+        MusECore::Pipeline* pl = t->efxPipe();
+        if (pl)
+        {
+          for (MusECore::ciPluginI ip = pl->begin(); ip != pl->end(); ++ip)
+          {
+            if (!*ip)
+              continue;
+            DspCsvRow r(*ip, DspProfiler::PLUGIN, "plugin", t->name() + "/" + (*ip)->name());
+            r.hasInstances  = true;
+            r.instances     = (*ip)->instanceCount();
+            r.shared        = (*ip)->sharedInstance();
+            r.heapBytes     = (*ip)->instanceBytes();
+            r.hasCycles     = true;
+            r.runCycles     = (*ip)->runCycles();
+            r.skippedCycles = (*ip)->skippedCycles();
+            rows.push_back(r);
+          }
+        }
+        rows.push_back(DspCsvRow(t, DspProfiler::METER, "meter", t->name()));
+      }
+      return rows;
+}
+
+//---------------------------------------------------------
+//   saveDspLoad
+//    Writes the statistics of all nodes as CSV.
+//---------------------------------------------------------
+
+void AudioMixerApp::saveDspLoad()
+{
+      if(!MusEGlobal::dspProfiler)
+        return;
+      QString fname = QFileDialog::getSaveFileName(this,
+                                                   tr("Save DSP load"),
+                                                   QDir::homePath() + "/dspload.csv",
+                                                   tr("CSV files (*.csv);;All files (*)"));
+      if(fname.isEmpty())
+        return;
+      if(!MusEGlobal::dspProfiler->writeCsv(fname, dspLoadRows()))
+        QMessageBox::critical(this, tr("MusE: Save DSP load"), tr("Cannot write file:\n%1").arg(fname));
+}
+
 //---------------------------------------------------------
 //   show hide track groups
 //---------------------------------------------------------
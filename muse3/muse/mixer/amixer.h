@@ -101,6 +101,7 @@ class AudioMixerApp : public QMainWindow {
       QMenu* menuStrips;
       MusEGui::RouteDialog* routingDialog;
       QAction* routingId;
+      QAction* showDspLoadId;
       int oldAuxsSize;
 
       QAction* showMidiTracksId;
@@ -148,6 +149,9 @@ class AudioMixerApp : public QMainWindow {
       void setSizing();
       void toggleRouteDialog();
       void routingDialogClosed();
+      void showDspLoadChanged(bool);
+      void resetDspLoad();
+      void saveDspLoad();
       void showMidiTracksChanged(bool);
       void showDrumTracksChanged(bool);
       void showNewDrumTracksChanged(bool);
@@ -68,6 +68,8 @@
 #include "utils.h"
 #include "muse_math.h"
 #include "operations.h"
+#include "plugin.h"
+#include "dspprofiler.h"
 
 // For debugging output: Uncomment the fprintf section.
 #define DEBUG_AUDIO_STRIP(dev, format, args...)  //fprintf(dev, format, ##args);
@@ -784,21 +786,40 @@ void AudioComponentRack::setComponentColors()
 
 void AudioStrip::heartBeat()
 {
-   const int tch = track->channels();
-   for (int ch = 0; ch < tch; ++ch) {
-      if (meter[ch]) {
-         meter[ch]->setVal(track->meter(ch), track->peak(ch), false);
-      }
-      if(_clipperLabel[ch])
-      {
-        _clipperLabel[ch]->setVal(track->peak(ch));
-        _clipperLabel[ch]->setClipped(track->isClipped(ch));
-      }
+   MusECore::AudioTrack* t = static_cast<MusECore::AudioTrack*>(track);
+   const bool full = ++_fullUpdateCounter >= FULL_UPDATE_BEATS;
+   if(full)
+     _fullUpdateCounter = 0;
+
+   const unsigned meterSerial = track->meterSerial();
+   if(full || meterSerial != _meterSerial)
+   {
+     _meterSerial = meterSerial;
+     const int tch = track->channels();
+     for (int ch = 0; ch < tch; ++ch) {
+        if (meter[ch]) {
+           meter[ch]->setVal(track->meter(ch), track->peak(ch), false);
+        }
+        if(_clipperLabel[ch])
+        {
+          _clipperLabel[ch]->setVal(track->peak(ch));
+          _clipperLabel[ch]->setClipped(track->isClipped(ch));
+        }
+     }
+   }
+
+   // Automation being played changes the values without anything being set.
+   const unsigned ctrlSerial = t->ctrlGuiSerial();
+   if(full || ctrlSerial != _ctrlSerial ||
+      (MusEGlobal::automation && t->automationType() != MusECore::AUTO_OFF && MusEGlobal::audio->isPlaying()))
+   {
+     _ctrlSerial = ctrlSerial;
+     updateVolume();
+     _upperRack->updateComponents();
+     _infoRack->updateComponents();
+     _lowerRack->updateComponents();
    }
-   updateVolume();
-   _upperRack->updateComponents();
-   _infoRack->updateComponents();
-   _lowerRack->updateComponents();
+   updateDspLoad();
 
 //    if(_recMonitor && _recMonitor->isChecked() && MusEGlobal::blinkTimerPhase != _recMonitor->blinkPhase())
 //      _recMonitor->setBlinkPhase(MusEGlobal::blinkTimerPhase);
@@ -806,6 +827,78 @@ void AudioStrip::heartBeat()
    Strip::heartBeat();
 }
 
+//---------------------------------------------------------
+//   updateDspLoad
+//    Average time of the track, its synth, plugins and
+//     meters as a share of the cycle. Details in the tooltip.
+//---------------------------------------------------------
+
+static void addDspLoadLine(QString* tip, double* avg, const void* owner,
+                           MusECore::DspProfiler::Kind kind, const QString& name,
+                           const MusECore::PluginIBase* counts = 0)
+{
+  MusECore::DspStats st;
+  if(!MusEGlobal::dspProfiler->stats(owner, kind, &st))
+    return;
+  *avg += st.avg;
+  tip->append(QString("\n%1: avg %2 us, p99 %3 us, max %4 us")
+    .arg(name).arg(st.avg, 0, 'f', 1).arg(st.p99, 0, 'f', 1).arg(st.max, 0, 'f', 1));
+  // Cycles not run because of silence.
+  if(counts && counts->runCycles() != 0)
+    tip->append(QString(", %1% idle").arg(100.0 * counts->skippedCycles() / counts->runCycles(), 0, 'f', 0));
+}
+
+void AudioStrip::updateDspLoad()
+{
+  if(!slider || !MusEGlobal::dspProfiler || !MusEGlobal::dspProfiler->enabled())
+  {
+    if(_dspLoadLabel)
+      _dspLoadLabel->hide();
+    return;
+  }
+  // The statistics are sorted for the percentiles. No need to do that every beat.
+  if(_dspLoadLabel && _dspLoadLabel->isVisible() && ++_dspLoadCounter < 10)
+    return;
+  _dspLoadCounter = 0;
+
+  if(!_dspLoadLabel)
+  {
+    _dspLoadLabel = new QLabel(this);
+    _dspLoadLabel->setAlignment(Qt::AlignCenter);
+    _dspLoadLabel->setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 160); color: white; }");
+  }
+
+  MusECore::AudioTrack* t = static_cast<MusECore::AudioTrack*>(track);
+  double avg = 0.0;
+  QString tip = t->name();
+  addDspLoadLine(&tip, &avg, t, MusECore::DspProfiler::TRACK, tr("Track"));
+  addDspLoadLine(&tip, &avg, t, MusECore::DspProfiler::SYNTH, tr("Synth"),
+                 t->isSynthTrack() ? static_cast<MusECore::SynthI*>(t)->sif() : 0);
+  MusECore::Pipeline* pl = t->efxPipe();
+  if(pl)
+  {
+    for(MusECore::ciPluginI ip = pl->begin(); ip != pl->end(); ++ip)
+    {
+      if(!*ip)
+        continue;
+      addDspLoadLine(&tip, &avg, *ip, MusECore::DspProfiler::PLUGIN, (*ip)->name(), *ip);
+      tip.append(tr("\n  %n instance(s)%1, heap about %2 KiB (estimate)", "", (*ip)->instanceCount())
+        .arg((*ip)->sharedInstance() ? tr(", shared") : QString())
+        .arg(((*ip)->instanceBytes() + 512) / 1024));
+    }
+  }
+  addDspLoadLine(&tip, &avg, t, MusECore::DspProfiler::METER, tr("Meter"));
+
+  const double cyc = MusECore::DspProfiler::cycleUS();
+  _dspLoadLabel->setText(QString("%1%").arg(cyc > 0.0 ? 100.0 * avg / cyc : 0.0, 0, 'f', 1));
+  _dspLoadLabel->setToolTip(tip);
+
+  const QPoint p = slider->mapTo(this, QPoint(0, 0));
+  _dspLoadLabel->setGeometry(0, p.y(), width(), _dspLoadLabel->sizeHint().height());
+  _dspLoadLabel->raise();
+  _dspLoadLabel->show();
+}
+
 void AudioStrip::updateRackSizes(bool upper, bool lower)
 {
 //   const QFontMetrics fm = fontMetrics();
@@ -1350,6 +1443,11 @@ AudioStrip::AudioStrip(QWidget* parent, MusECore::AudioTrack* at, bool hasHandle
       sl            = 0;
       off           = 0;
       _recMonitor   = 0;
+      _dspLoadLabel = 0;
+      _dspLoadCounter = 0;
+      _meterSerial  = 0;
+      _ctrlSerial   = 0;
+      _fullUpdateCounter = FULL_UPDATE_BEATS;   // Everything on the first beat.
 
       // Start the layout in mode A (normal, racks on left).
       _isExpanded = false;
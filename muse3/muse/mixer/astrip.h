@@ -30,6 +30,7 @@
 #include "clipper_label.h"
 
 class QButton;
+class QLabel;
 class QHBoxLayout;
 class QVBoxLayout;
 class QColor;
@@ -122,6 +123,8 @@ class AudioStrip : public Strip {
   public:      
       // ID numbers for each rack in this strip.
       enum AStripRacks { aStripUpperRack = 0, aStripInfoRack = 1, aStripLowerRack = 2 };
+      // Heartbeats between refreshes of everything, changed or not.
+      static const int FULL_UPDATE_BEATS = 16;
       
   private:
       GridPosStruct _preScrollAreaPos_A;
@@ -173,7 +176,18 @@ class AudioStrip : public Strip {
       ClipperLabel* _clipperLabel[MusECore::MAX_CHANNELS];
       QHBoxLayout* _clipperLayout;
 
+      // DSP load shown over the slider while profiling. Created on demand.
+      QLabel* _dspLoadLabel;
+      int _dspLoadCounter;
+
+      // Meters and controls are only refreshed when these change,
+      //  or after FULL_UPDATE_BEATS as a catch-all.
+      unsigned _meterSerial;
+      unsigned _ctrlSerial;
+      int _fullUpdateCounter;
+
       void setClipperTooltip(int ch);
+      void updateDspLoad();
       
       void updateOffState();
       void updateVolume();
@@ -1114,6 +1114,7 @@ void MidiComponentRack::propertyChanged(double val, bool off, int id, int scroll
       _track->compression = ival;
     break;
   }
+  MusEGlobal::song->freezeStale(_track);
 
   emit componentChanged(propertyComponent, val, off, id, scrollMode);
 }
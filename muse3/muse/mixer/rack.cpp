@@ -26,6 +26,7 @@
 #include <QDrag>
 #include <QDragEnterEvent>
 #include <QDropEvent>
+#include <QInputDialog>
 #include <QMenu>
 #include <QMessageBox>
 #include <QMimeData>
@@ -305,7 +306,7 @@ void EffectRack::menuRequested(QListWidgetItem* it)
             }
 
       //enum { NEW, CHANGE, UP, DOWN, REMOVE, BYPASS, SHOW, SAVE };
-      enum { NEW, CHANGE, UP, DOWN, REMOVE, BYPASS, SHOW, SHOW_NATIVE, SAVE };
+      enum { NEW, CHANGE, UP, DOWN, REMOVE, BYPASS, SHOW, SHOW_NATIVE, SAVE, TAIL };
       QMenu* menu = new QMenu;
       QAction* newAction = menu->addAction(tr("new"));
       QAction* changeAction = menu->addAction(tr("change"));
@@ -316,6 +317,7 @@ void EffectRack::menuRequested(QListWidgetItem* it)
       QAction* showGuiAction = menu->addAction(tr("show gui"));//,  SHOW, SHOW);
       QAction* showNativeGuiAction = menu->addAction(tr("show native gui"));//,  SHOW_NATIVE, SHOW_NATIVE);
       QAction* saveAction = menu->addAction(tr("save preset"));
+      QAction* tailAction = menu->addAction(tr("silence tail..."));
 
       newAction->setData(NEW);
       changeAction->setData(CHANGE);
@@ -326,6 +328,7 @@ void EffectRack::menuRequested(QListWidgetItem* it)
       showGuiAction->setData(SHOW);
       showNativeGuiAction->setData(SHOW_NATIVE);
       saveAction->setData(SAVE);
+      tailAction->setData(TAIL);
 
       bypassAction->setCheckable(true);
       showGuiAction->setCheckable(true);
@@ -342,6 +345,7 @@ void EffectRack::menuRequested(QListWidgetItem* it)
       if (pipe->empty(idx)) {
             menu->removeAction(changeAction);
             menu->removeAction(saveAction);
+            menu->removeAction(tailAction);
             upAction->setEnabled(false);
             downAction->setEnabled(false);
             removeAction->setEnabled(false);
@@ -453,6 +457,22 @@ void EffectRack::menuRequested(QListWidgetItem* it)
             case SAVE:
                   savePreset(idx);
                   break;
+            case TAIL:
+                  {
+                  MusECore::PluginI* p = pipe->at(idx);
+                  bool ok;
+                  const int ms = QInputDialog::getInt(this, tr("Silence tail"),
+                     tr("Milliseconds %1 goes on running after its input and output\n"
+                        "have fallen silent, when plugins are stopped in silence.\n"
+                        "Set it to the longest delay or reverb time of the plugin.\n"
+                        "-1 uses the tail the plugin reports, or else the global one.").arg(p->name()),
+                     p->silenceTailMs(), -1, 3600000, 100, &ok);
+                  if (ok && ms != p->silenceTailMs()) {
+                        p->setSilenceTailMs(ms);
+                        MusEGlobal::song->setDirty();
+                        }
+                  break;
+                  }
             }
       updateContents();
       MusEGlobal::song->update(SC_RACK);
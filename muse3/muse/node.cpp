@@ -23,9 +23,11 @@
 //=========================================================
 
 #include <cmath>
+#include <algorithm>
 #include <sndfile.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <QString>
 
@@ -42,6 +44,8 @@
 #include "utils.h"      //debug
 #include "ticksynth.h"  // metronome
 #include "wavepreview.h"
+#include "dspprofiler.h"
+#include "latency_compensator.h"
 #include "al/dsp.h"
 
 // REMOVE Tim. Persistent routes. Added. Make this permanent later if it works OK and makes good sense.
@@ -334,6 +338,39 @@ void AudioTrack::updateSoloStates(bool noDec)
   _nodeTraversed = false; // Reset.
 }
 
+//---------------------------------------------------------
+//   fillCtrlSlice
+//   Fills buf[sample, sample + nsamp) with the values of a
+//    track controller while playing.
+//   If the controller follows its automation lane, the lane
+//    is rendered for the whole cycle the first time it is
+//    needed, so the remaining slices cost nothing. Ramps
+//    towards control FIFO values are filled in per slice.
+//---------------------------------------------------------
+
+static void fillCtrlSlice(CtrlList* cl, const CtrlInterpolate& interp, unsigned pos, unsigned nframes,
+                          unsigned long sample, unsigned long nsamp, float* buf, bool* rendered)
+{
+  if(interp.doInterp && !interp.eStop)
+  {
+    if(!*rendered)
+    {
+      cl->render(pos, nframes, buf);
+      *rendered = true;
+    }
+    return;
+  }
+
+  float* d = buf + sample;
+  if(!interp.eStop)   // Not interpolating. Same as when stopped.
+  {
+    std::fill(d, d + nsamp, (float)interp.sVal);
+    return;
+  }
+  for(unsigned long k = 0; k < nsamp; ++k)
+    d[k] = cl->interpolate(pos + sample + k, interp);
+}
+
 //---------------------------------------------------------
 //   processTrackCtrls
 //   If trackChans is 0, just process controllers only, not audio (do not 'run').
@@ -361,6 +398,12 @@ void AudioTrack::processTrackCtrls(unsigned pos, int trackChans, unsigned nframe
     pan_ctrl = icl->second;
   }
 
+  // Volume and pan values for this cycle, see fillCtrlSlice().
+  float* vol_buf = _ctrlRenderBuffer;
+  float* pan_buf = _ctrlRenderBuffer + MusEGlobal::segmentSize;
+  bool vol_rendered = false;
+  bool pan_rendered = false;
+
   int cur_slice = 0;
   while(sample < nframes)
   {
@@ -536,9 +579,10 @@ void AudioTrack::processTrackCtrls(unsigned pos, int trackChans, unsigned nframe
           k = 0;
           if(vol_interp.doInterp && MusEGlobal::audio->isPlaying())
           {
+            fillCtrlSlice(vol_ctrl, vol_interp, pos, nframes, sample, nsamp, vol_buf, &vol_rendered);
             for( ; k < nsamp; ++k)
             {
-              _volume = vol_ctrl->interpolate(slice_frame + k, vol_interp);
+              _volume = vol_buf[sample + k];
               v = _volume * _gain;
               if(v > _curVolume)
               {
@@ -605,11 +649,11 @@ void AudioTrack::processTrackCtrls(unsigned pos, int trackChans, unsigned nframe
               }
             }
 
-            const unsigned long next_smp = sample + nsamp;
-            for(unsigned long smp = sample + k; smp < next_smp; ++smp)
+            if(k < nsamp)
             {
+              const unsigned long smp = sample + k;
               for(int ch = start_ch; ch < trackChans; ++ch)
-                *(outBuffers[ch] + smp) = *(buffer[ch] + smp) * _curVolume;
+                AL::dsp->cpyWithGain(outBuffers[ch] + smp, buffer[ch] + smp, nsamp - k, _curVolume);
             }
           }
         }
@@ -617,11 +661,13 @@ void AudioTrack::processTrackCtrls(unsigned pos, int trackChans, unsigned nframe
         k = 0;
         if((vol_interp.doInterp || pan_interp.doInterp) && MusEGlobal::audio->isPlaying())
         {
+          fillCtrlSlice(vol_ctrl, vol_interp, pos, nframes, sample, nsamp, vol_buf, &vol_rendered);
+          fillCtrlSlice(pan_ctrl, pan_interp, pos, nframes, sample, nsamp, pan_buf, &pan_rendered);
           for( ; k < nsamp; ++k)
           {
-            _volume = vol_ctrl->interpolate(slice_frame + k, vol_interp);
+            _volume = vol_buf[sample + k];
             v = _volume * _gain;
-            _pan = pan_ctrl->interpolate(slice_frame + k, pan_interp);
+            _pan = pan_buf[sample + k];
             v1 = v * (1.0 - _pan);
             v2 = v * (1.0 + _pan);
             if(v1 > _curVol1)
@@ -680,74 +726,82 @@ void AudioTrack::processTrackCtrls(unsigned pos, int trackChans, unsigned nframe
           v = _volume * _gain;
           v1  = v * (1.0 - _pan);
           v2  = v * (1.0 + _pan);
-          if(v1 > _curVol1)
+          if(v1 == _curVol1 && v2 == _curVol2)
           {
-            //fprintf(stderr, "C %f %f \n", v1, _curVol1);
-            if(_curVol1 == 0.0)
-              _curVol1 = 0.001;  // Kick-start it from zero at -30dB.
-            for( ; k < nsamp; ++k)
+            // Settled. Both channels in one pass.
+            AL::dsp->panGain(dp1, dp2, sp1, sp2, nsamp, _curVol1, _curVol2);
+          }
+          else
+          {
+            if(v1 > _curVol1)
             {
-              _curVol1 *= up_fact;
-              if(_curVol1 >= v1)
+              //fprintf(stderr, "C %f %f \n", v1, _curVol1);
+              if(_curVol1 == 0.0)
+                _curVol1 = 0.001;  // Kick-start it from zero at -30dB.
+              for( ; k < nsamp; ++k)
               {
-                _curVol1 = v1;
-                break;
+                _curVol1 *= up_fact;
+                if(_curVol1 >= v1)
+                {
+                  _curVol1 = v1;
+                  break;
+                }
+                *dp1++ = *sp1++ * _curVol1;
               }
-              *dp1++ = *sp1++ * _curVol1;
             }
-          }
-          else
-          if(v1 < _curVol1)
-          {
-            //fprintf(stderr, "D %f %f \n", v1, _curVol1);
-            for( ; k < nsamp; ++k)
+            else
+            if(v1 < _curVol1)
             {
-              _curVol1 *= down_fact;
-              if(_curVol1 <= v1 || _curVol1 <= 0.001)  // Or if less than -30dB.
+              //fprintf(stderr, "D %f %f \n", v1, _curVol1);
+              for( ; k < nsamp; ++k)
               {
-                _curVol1 = v1;
-                break;
+                _curVol1 *= down_fact;
+                if(_curVol1 <= v1 || _curVol1 <= 0.001)  // Or if less than -30dB.
+                {
+                  _curVol1 = v1;
+                  break;
+                }
+                *dp1++ = *sp1++ * _curVol1;
               }
-              *dp1++ = *sp1++ * _curVol1;
             }
-          }
-          for( ; k < nsamp; ++k)
-            *dp1++ = *sp1++ * _curVol1;
+            if(k < nsamp)
+              AL::dsp->cpyWithGain(dp1, sp1, nsamp - k, _curVol1);
 
-          k = 0;
-          if(v2 > _curVol2)
-          {
-            //fprintf(stderr, "E %f %f \n", v2, _curVol2);
-            if(_curVol2 == 0.0)
-              _curVol2 = 0.001;  // Kick-start it from zero at -30dB.
-            for( ; k < nsamp; ++k)
+            k = 0;
+            if(v2 > _curVol2)
             {
-              _curVol2 *= up_fact;
-              if(_curVol2 >= v2)
+              //fprintf(stderr, "E %f %f \n", v2, _curVol2);
+              if(_curVol2 == 0.0)
+                _curVol2 = 0.001;  // Kick-start it from zero at -30dB.
+              for( ; k < nsamp; ++k)
               {
-                _curVol2 = v2;
-                break;
+                _curVol2 *= up_fact;
+                if(_curVol2 >= v2)
+                {
+                  _curVol2 = v2;
+                  break;
+                }
+                *dp2++ = *sp2++ * _curVol2;
               }
-              *dp2++ = *sp2++ * _curVol2;
             }
-          }
-          else
-          if(v2 < _curVol2)
-          {
-            //fprintf(stderr, "F %f %f \n", v2, _curVol2);
-            for( ; k < nsamp; ++k)
+            else
+            if(v2 < _curVol2)
             {
-              _curVol2 *= down_fact;
-              if(_curVol2 <= v2 || _curVol2 <= 0.001)   // Or if less than -30dB.
+              //fprintf(stderr, "F %f %f \n", v2, _curVol2);
+              for( ; k < nsamp; ++k)
               {
-                _curVol2 = v2;
-                break;
+                _curVol2 *= down_fact;
+                if(_curVol2 <= v2 || _curVol2 <= 0.001)   // Or if less than -30dB.
+                {
+                  _curVol2 = v2;
+                  break;
+                }
+                *dp2++ = *sp2++ * _curVol2;
               }
-              *dp2++ = *sp2++ * _curVol2;
             }
+            if(k < nsamp)
+              AL::dsp->cpyWithGain(dp2, sp2, nsamp - k, _curVol2);
           }
-          for( ; k < nsamp; ++k)
-            *dp2++ = *sp2++ * _curVol2;
         }
       }
 
@@ -853,8 +907,7 @@ void AudioTrack::copyData(unsigned pos,
             float* dp = dstBuffer[c + dstStartChan];
             if(addArray ? addArray[c + dstStartChan] : add)
             {
-              for(unsigned k = 0; k < nframes; ++k)
-                *dp++ += *sp++;
+              AL::dsp->mix(dp, sp, nframes);
             }
             else
               AL::dsp->cpy(dp, sp, nframes);
@@ -885,8 +938,7 @@ void AudioTrack::copyData(unsigned pos,
             float* dp = dstBuffer[dstStartChan];
             if((addArray ? addArray[dstStartChan] : add) || sch != 0)
             {
-              for(unsigned k = 0; k < nframes; ++k)
-                *dp++ += *sp++;
+              AL::dsp->mix(dp, sp, nframes);
             }
             else
               AL::dsp->cpy(dp, sp, nframes);
@@ -913,8 +965,7 @@ void AudioTrack::copyData(unsigned pos,
           float* dp = dstBuffer[c + dstStartChan];
           if(addArray ? addArray[c + dstStartChan] : add)
           {
-            for(unsigned k = 0; k < nframes; ++k)
-              *dp++ += *sp++;
+            AL::dsp->mix(dp, sp, nframes);
           }
           else
             AL::dsp->cpy(dp, sp, nframes);
@@ -957,6 +1008,7 @@ void AudioTrack::copyData(unsigned pos,
   else
   {
     // First time here during this process cycle.
+    DspProfileScope profile(this, DspProfiler::TRACK);
 
     _haveData = false;  // Reset.
     _processed = true;  // Set this now.
@@ -988,8 +1040,13 @@ void AudioTrack::copyData(unsigned pos,
       _efxPipe->apply(pos, 0, nframes, 0);  // Just process controls only, not audio (do not 'run').
       processTrackCtrls(pos, 0, nframes, 0);
 
+      // Forget what is in the delay lines, or it would be heard once the track is on again.
+      if(_latencyComp)
+        _latencyComp->clear();
+
       //for(i = 0; i < trackChans; ++i)
       //  _meter[i] = 0.0;
+      publishMeter(trackChans);
 
       return;
     }
@@ -998,21 +1055,26 @@ void AudioTrack::copyData(unsigned pos,
     for(i = 0; i < srcTotalOutChans; ++i)
         buffer[i] = _dataBuffers[i];
 
+    // A frozen track plays its freeze file, which already has the plugins applied.
+    // Any channels beyond the track's own are silent.
+    const int dataChans = _frozen ? std::min(trackChans, srcTotalOutChans) : srcTotalOutChans;
+    bool haveData = false;
+
     // getData can use the supplied buffers, or change buffer to point to its own local buffers or Jack buffers etc.
     // For ex. if this is an audio input, Jack will set the pointers for us in AudioInput::getData!
     // Don't do any processing at all if off. Whereas, mute needs to be ready for action at all times,
     //  so still call getData before it. Off is NOT meant to be toggled rapidly, but mute is !
     // Since the meters are cleared above, getData can contribute (add) to them directly and return HaveMeterDataOnly
     //  if it does not want to pass the audio for listening.
-    if(!getData(pos, srcTotalOutChans, nframes, buffer))
-    {
-      #ifdef NODE_DEBUG_PROCESS
-      fprintf(stderr, "MusE: AudioTrack::copyData name:%s srcTotalOutChans:%d zeroing buffers\n", name().toLatin1().constData(), srcTotalOutChans);
-      #endif
+    if(_frozen)
+      haveData = getFrozenData(pos, dataChans, nframes, buffer);
+    else
+      haveData = getData(pos, srcTotalOutChans, nframes, buffer);
 
-      // No data was available. Track is not off. Zero the working buffers and continue on.
+    {
+      // Zero the working buffers without data and continue on.
       unsigned int q;
-      for(i = 0; i < srcTotalOutChans; ++i)
+      for(i = haveData ? dataChans : 0; i < srcTotalOutChans; ++i)
       {
         if(MusEGlobal::config.useDenormalBias)
         {
@@ -1028,8 +1090,34 @@ void AudioTrack::copyData(unsigned pos,
     // apply plugin chain
     //---------------------------------------------------
 
-    // Allow it to process even if muted so that when mute is turned off, left-over buffers (reverb tails etc) can die away.
-    _efxPipe->apply(pos, trackChans, nframes, buffer);
+    if(_frozen)
+    {
+      _efxPipe->apply(pos, 0, nframes, 0);  // Just process controls only, not audio (do not 'run').
+    }
+    else
+    {
+      // Allow it to process even if muted so that when mute is turned off, left-over buffers (reverb tails etc) can die away.
+      _efxPipe->apply(pos, trackChans, nframes, buffer);
+
+      // Rendering the freeze file?
+      if(MusEGlobal::song->freezingTrack == this && MusEGlobal::audio->bounce() && MusEGlobal::audio->isPlaying())
+        putFreezeData(trackChans, nframes, buffer);
+    }
+
+    //---------------------------------------------------
+    // delay compensation, before anything is sent on
+    //---------------------------------------------------
+
+// REMOVE Tim. monitor. Changed.
+//    if(isMute())
+    // Are both playback and input are muted? Then nothing is sent on below.
+    const bool muted = isMute() && !isRecMonitored();
+
+    // The compensator holds the send and the output channels, one half each.
+    const long latencyCompChans = _latencyComp ?
+      std::min((long)srcTotalOutChans, (long)(_latencyComp->channels() / 2)) : 0;
+    if(_sendLatencyDelay && latencyCompChans && !muted)
+      _latencyComp->run(nframes, buffer, latencyCompChans);
 
     //---------------------------------------------------
     // apply volume, pan
@@ -1043,31 +1131,31 @@ void AudioTrack::copyData(unsigned pos,
     //    metering
     //---------------------------------------------------
 
-    // FIXME TODO Need multichannel changes here?
-    for(int c = 0; c < trackChans; ++c)
     {
-      meter[c] = 0.0;
-      float* sp = (c >= valid_out_bufs) ? buffer[c] : outBuffers[c]; // Optimize: Don't all valid outBuffers just for meters
-      for(unsigned k = 0; k < nframes; ++k)
+      DspProfileScope meter_profile(this, DspProfiler::METER);
+      // FIXME TODO Need multichannel changes here?
+      for(int c = 0; c < trackChans; ++c)
       {
-        const double f = fabs(*sp++); // If the track is mono pan has no effect on meters.
-        if(f > meter[c])
-          meter[c] = f;
-      }
-      if(meter[c] > _meter[c])
-        _meter[c] = meter[c];
-      if(_meter[c] > _peak[c])
-        _peak[c] = _meter[c];
+        float* sp = (c >= valid_out_bufs) ? buffer[c] : outBuffers[c]; // Optimize: Don't all valid outBuffers just for meters
+        meter[c] = AL::dsp->peak(sp, nframes, 0.0f); // If the track is mono pan has no effect on meters.
+        if(meter[c] > _meter[c])
+          _meter[c] = meter[c];
+        if(_meter[c] > _peak[c])
+          _peak[c] = _meter[c];
 
-      if(_meter [c] > 1.0)
-         _isClipped[c] = true;
+        if(_meter [c] > 1.0)
+           _isClipped[c] = true;
+      }
+      publishMeter(trackChans);
     }
 
-// REMOVE Tim. monitor. Changed.
-//    if(isMute())
-    // Are both playback and input are muted?
-    if(isMute() && !isRecMonitored())
+    if(muted)
     {
+      // Forget what is in the delay lines, or it would be heard once unmuted.
+      // Not running them while muted keeps the clear a one time cost.
+      if(_latencyComp)
+        _latencyComp->clear();
+
       // Nothing to do. Zero the supplied buffers.
       for(i = dstStartChan; i < (dstStartChan + availDstChannels); ++i)
       {
@@ -1108,14 +1196,14 @@ void AudioTrack::copyData(unsigned pos,
         AudioAux* a = (AudioAux*)((*al)[k]);
         float** dst = a->sendBuffer();
         int auxChannels = a->channels();
+        // Other tracks may be mixing into the same aux right now.
+        a->lockSendBuffer();
         if((availableSrcChans ==1 && auxChannels==1) || availableSrcChans == 2)
         {
           for(int ch = 0; ch < availableSrcChans; ++ch)
           {
             float* db = dst[ch % a->channels()]; // no matter whether there's one or two dst buffers
-            float* sb = outBuffers[ch];
-            for(unsigned f = 0; f < nframes; ++f)
-              *db++ += (*sb++ * m);   // add to mix
+            AL::dsp->mixWithGain(db, outBuffers[ch], nframes, m);   // add to mix
           }
         }
         else if(availableSrcChans==1 && auxChannels==2)  // copy mono to both channels
@@ -1123,14 +1211,17 @@ void AudioTrack::copyData(unsigned pos,
           for(int ch = 0; ch < auxChannels; ++ch)
           {
             float* db = dst[ch % a->channels()];
-            float* sb = outBuffers[0];
-            for(unsigned f = 0; f < nframes; ++f)
-              *db++ += (*sb++ * m);   // add to mix
+            AL::dsp->mixWithGain(db, outBuffers[0], nframes, m);   // add to mix
           }
         }
+        a->unlockSendBuffer();
       }
     }
 
+    // Further delay for the outputs only, once the aux sends have their copy.
+    if(_outLatencyDelay && latencyCompChans)
+      _latencyComp->run(nframes, outBuffers, latencyCompChans, _latencyComp->channels() / 2);
+
     //---------------------------------------------------
     //    copy to destination buffers
     //---------------------------------------------------
@@ -1170,8 +1261,7 @@ void AudioTrack::copyData(unsigned pos,
           float* dp = dstBuffer[c + dstStartChan];
           if(addArray ? addArray[c + dstStartChan] : add)
           {
-            for(unsigned k = 0; k < nframes; ++k)
-              *dp++ += *sp++;
+            AL::dsp->mix(dp, sp, nframes);
           }
           else
             AL::dsp->cpy(dp, sp, nframes);
@@ -1202,8 +1292,7 @@ void AudioTrack::copyData(unsigned pos,
           float* dp = dstBuffer[dstStartChan];
           if((addArray ? addArray[dstStartChan] : add) || sch != 0)
           {
-            for(unsigned k = 0; k < nframes; ++k)
-              *dp++ += *sp++;
+            AL::dsp->mix(dp, sp, nframes);
           }
           else
             AL::dsp->cpy(dp, sp, nframes);
@@ -1230,8 +1319,7 @@ void AudioTrack::copyData(unsigned pos,
         float* dp = dstBuffer[c + dstStartChan];
         if(addArray ? addArray[c + dstStartChan] : add)
         {
-          for(unsigned k = 0; k < nframes; ++k)
-            *dp++ += *sp++;
+          AL::dsp->mix(dp, sp, nframes);
         }
         else
           AL::dsp->cpy(dp, sp, nframes);
@@ -1299,6 +1387,7 @@ void Track::setChannels(int n)
             _meter[i] = 0.0;
             _peak[i]  = 0.0;
             }
+      touchMeter();
       }
 
 
@@ -1479,6 +1568,25 @@ void Track::resetMeter()
       {
       for (int i = 0; i < _channels; ++i)
             _meter[i] = 0.0;
+      touchMeter();
+      }
+
+//---------------------------------------------------------
+//   publishMeter
+//---------------------------------------------------------
+
+void Track::publishMeter(int channels)
+      {
+      bool active = false;
+      for (int i = 0; i < channels; ++i) {
+            if (_meter[i] != 0.0) {
+                  active = true;
+                  break;
+                  }
+            }
+      if (active || _meterActive)
+            touchMeter();
+      _meterActive = active;
       }
 
 //---------------------------------------------------------
@@ -1491,6 +1599,7 @@ void Track::resetPeaks()
             _peak[i] = 0.0;
       }
             _lastActivity = 0;
+      touchMeter();
       }
 
 //---------------------------------------------------------
@@ -1658,6 +1767,103 @@ void AudioTrack::record()
             }
       }
 
+//---------------------------------------------------------
+//   setFreezeFile
+//---------------------------------------------------------
+
+void AudioTrack::setFreezeFile(SndFileR sf)
+      {
+      _freezeFile = sf;
+      _freezeFifo.clear();
+      _freezeState.reset();
+      }
+
+//---------------------------------------------------------
+//   putFreezeData
+//    While the freeze file is rendered. The data goes
+//     through the freeze fifo, emptied by the prefetch
+//     thread, which alone writes the file. Freewheeling
+//     the cycles have no deadline, so a full fifo is
+//     waited on for a while before a block is dropped.
+//---------------------------------------------------------
+
+void AudioTrack::putFreezeData(int channels, unsigned n, float** bp)
+      {
+      if (MusEGlobal::audio->freewheel()) {
+            for (int i = 0; i < 2000 && _freezeFifo.getCount() == _freezeFifo.capacity(); ++i)
+                  usleep(1000);
+            }
+      if (_freezeFifo.put(channels, n, bp, MusEGlobal::audio->pos().frame())) {
+            _freezeState.setOverrun();
+            fprintf(stderr, "AudioTrack::putFreezeData(%s): fifo overrun\n", name().toLocal8Bit().constData());
+            return;
+            }
+      _freezeState.blockPut();
+      }
+
+//---------------------------------------------------------
+//   flushFreezeFifo
+//---------------------------------------------------------
+
+void AudioTrack::flushFreezeFifo()
+      {
+      unsigned pos = 0;
+      float* buffer[_channels];
+      while (_freezeFifo.getCount()) {
+            if (_freezeFifo.get(_channels, MusEGlobal::segmentSize, buffer, &pos))
+                  break;
+            _freezeFile.seek(pos, 0);
+            _freezeFile.write(_channels, buffer, MusEGlobal::segmentSize);
+            _freezeState.blockWritten();
+            }
+      }
+
+//---------------------------------------------------------
+//   fetchData
+//    Reads the freeze file.
+//---------------------------------------------------------
+
+void AudioTrack::fetchData(unsigned pos, unsigned frames, float** bp, bool /*doSeek*/, bool overwrite)
+      {
+      if (overwrite)
+            for (int i = 0; i < channels(); ++i)
+                  memset(bp[i], 0, frames * sizeof(float));
+      if (!off())
+            _freezeFile.readAt(pos, channels(), bp, frames, overwrite);
+      }
+
+//---------------------------------------------------------
+//   getFrozenData
+//    Plays the freeze file, from the prefetch fifo like a
+//     wave track. Returns false if there is no data.
+//---------------------------------------------------------
+
+bool AudioTrack::getFrozenData(unsigned pos, int channels, unsigned nframes, float** bp)
+      {
+      if (!MusEGlobal::audio->isPlaying())
+            return false;
+
+      if (MusEGlobal::audio->freewheel()) {
+            // When freewheeling, read data direct from file.
+            fetchData(pos, nframes, bp, false, true);
+            return true;
+            }
+
+      float* pf_buf[channels];
+      unsigned fpos;
+      do {
+            if (_prefetchFifo.get(channels, nframes, pf_buf, &fpos)) {
+                  ++_prefetchState.underruns;
+                  fprintf(stderr, "AudioTrack::getFrozenData(%s) fifo underrun\n", name().toLocal8Bit().constData());
+                  return false;
+                  }
+            } while (fpos < pos);
+
+      for (int i = 0; i < channels; ++i)
+            AL::dsp->cpy(bp[i], pf_buf[i], nframes, MusEGlobal::config.useDenormalBias);
+      return true;
+      }
+
 //---------------------------------------------------------
 //   processInit
 //---------------------------------------------------------
@@ -1769,10 +1975,10 @@ void AudioOutput::setName(const QString& s)
 //   Fifo
 //---------------------------------------------------------
 
-Fifo::Fifo()
+Fifo::Fifo(int length)
       {
       muse_atomic_init(&count);
-      nbuffer = MusEGlobal::fifoLength;
+      nbuffer = length > 0 ? length : MusEGlobal::fifoLength;
       buffer  = new FifoBuffer*[nbuffer];
       for (int i = 0; i < nbuffer; ++i)
             buffer[i]  = new FifoBuffer;
@@ -1994,6 +2200,7 @@ void AudioTrack::setChannels(int n)
       Track::setChannels(n);
       if (_efxPipe)
             _efxPipe->setChannels(n);
+      setFreezeStale();
       }
 
 //---------------------------------------------------------
@@ -54,7 +54,8 @@ class Fifo {
       FifoBuffer** buffer;
 
    public:
-      Fifo();
+      // Length in blocks, zero for MusEGlobal::fifoLength.
+      Fifo(int length = 0);
       ~Fifo();
       void clear();
       bool put(int, unsigned long, float** buffer, unsigned pos);
@@ -63,6 +64,7 @@ class Fifo {
       bool get(int, unsigned long, float** buffer, unsigned* pos);
       void remove();
       int getCount();
+      int capacity() const { return nbuffer; }
       bool isEmpty();
       };
 
@@ -22,6 +22,7 @@
 
 #include "operations.h"
 #include "song.h"
+#include "audio_scheduler.h"
 
 // Enable for debugging:
 //#define _PENDING_OPS_DEBUG_
@@ -1401,6 +1402,9 @@ SongChangedStruct_t PendingOperationList::executeRTStage()
   {
     MusEGlobal::song->updateSoloStates();
     _sc_flags |= SC_SOLO;
+    // The parallel processing graph must be rebuilt.
+    if(MusEGlobal::audioScheduler)
+      MusEGlobal::audioScheduler->invalidate();
   } 
   
   return _sc_flags;
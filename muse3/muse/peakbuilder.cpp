@@ -0,0 +1,198 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  peakbuilder.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "peakbuilder.h"
+#include "peakfile.h"
+#include "globals.h"
+
+namespace MusEGlobal {
+MusECore::PeakBuilder* peakBuilder = NULL;
+}
+
+namespace MusECore {
+
+void initPeakBuilder()
+{
+  MusEGlobal::peakBuilder = new PeakBuilder();
+  MusEGlobal::peakBuilder->start();
+}
+
+//---------------------------------------------------------
+//   PeakBuilder
+//---------------------------------------------------------
+
+PeakBuilder::PeakBuilder()
+      {
+      pthread_mutex_init(&_lock, 0);
+      pthread_cond_init(&_jobCond, 0);
+      pthread_cond_init(&_doneCond, 0);
+      _workers     = 0;
+      _workerCount = 0;
+      _quit        = false;
+      _updated     = false;
+      }
+
+PeakBuilder::~PeakBuilder()
+      {
+      stop();
+      pthread_cond_destroy(&_doneCond);
+      pthread_cond_destroy(&_jobCond);
+      pthread_mutex_destroy(&_lock);
+      }
+
+//---------------------------------------------------------
+//   start
+//---------------------------------------------------------
+
+void PeakBuilder::start(int threads)
+      {
+      stop();
+      if (threads <= 0) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = cpus > 0 ? int(cpus) : 1;
+            }
+      threads = std::min(threads, MAX_PEAK_BUILDER_THREADS);
+
+      _quit    = false;
+      _workers = new Worker[threads];
+      for (int i = 0; i < threads; ++i) {
+            Worker* w  = &_workers[i];
+            w->builder = this;
+            w->job     = 0;
+            w->cancel  = false;
+            int rv = pthread_create(&w->thread, NULL, workerLoop, w);
+            if (rv) {
+                  fprintf(stderr, "PeakBuilder: creating thread failed: %s\n", strerror(rv));
+                  break;
+                  }
+            ++_workerCount;
+            }
+      if (MusEGlobal::debugMsg)
+            fprintf(stderr, "PeakBuilder: started %d threads\n", _workerCount);
+      }
+
+//---------------------------------------------------------
+//   stop
+//    Queued files are dropped, they stay partially built
+//     and are rebuilt when next read.
+//---------------------------------------------------------
+
+void PeakBuilder::stop()
+      {
+      if (!_workers)
+            return;
+      pthread_mutex_lock(&_lock);
+      _quit = true;
+      for (std::list<PeakFile*>::iterator i = _queue.begin(); i != _queue.end(); ++i)
+            (*i)->abort();
+      _queue.clear();
+      for (int i = 0; i < _workerCount; ++i)
+            _workers[i].cancel = true;
+      pthread_cond_broadcast(&_jobCond);
+      pthread_mutex_unlock(&_lock);
+      for (int i = 0; i < _workerCount; ++i)
+            pthread_join(_workers[i].thread, 0);
+      delete[] _workers;
+      _workers     = 0;
+      _workerCount = 0;
+      }
+
+//---------------------------------------------------------
+//   add
+//---------------------------------------------------------
+
+void PeakBuilder::add(PeakFile* pf)
+      {
+      pthread_mutex_lock(&_lock);
+      _queue.push_back(pf);
+      pthread_cond_signal(&_jobCond);
+      pthread_mutex_unlock(&_lock);
+      }
+
+//---------------------------------------------------------
+//   cancel
+//---------------------------------------------------------
+
+void PeakBuilder::cancel(PeakFile* pf)
+      {
+      pthread_mutex_lock(&_lock);
+      _queue.remove(pf);
+      for (int i = 0; i < _workerCount; ++i) {
+            Worker* w = &_workers[i];
+            if (w->job != pf)
+                  continue;
+            w->cancel = true;
+            while (w->job == pf)
+                  pthread_cond_wait(&_doneCond, &_lock);
+            }
+      pthread_mutex_unlock(&_lock);
+      }
+
+//---------------------------------------------------------
+//   progress
+//---------------------------------------------------------
+
+bool PeakBuilder::progress(void* arg, sf_count_t, sf_count_t)
+      {
+      Worker* w = (Worker*)arg;
+      w->builder->_updated = true;
+      return !w->cancel;
+      }
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+void* PeakBuilder::workerLoop(void* arg)
+      {
+      Worker* w       = (Worker*)arg;
+      PeakBuilder* pb = w->builder;
+      pthread_mutex_lock(&pb->_lock);
+      for (;;) {
+            while (!pb->_quit && pb->_queue.empty())
+                  pthread_cond_wait(&pb->_jobCond, &pb->_lock);
+            if (pb->_quit)
+                  break;
+            PeakFile* pf = pb->_queue.front();
+            pb->_queue.pop_front();
+            w->job    = pf;
+            w->cancel = false;
+            pthread_mutex_unlock(&pb->_lock);
+
+            pf->fill(progress, w);
+
+            pthread_mutex_lock(&pb->_lock);
+            w->job      = 0;
+            pb->_updated = true;
+            pthread_cond_broadcast(&pb->_doneCond);
+            }
+      pthread_mutex_unlock(&pb->_lock);
+      return 0;
+      }
+
+} // namespace MusECore
@@ -0,0 +1,90 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  peakbuilder.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __PEAKBUILDER_H__
+#define __PEAKBUILDER_H__
+
+#include <pthread.h>
+#include <atomic>
+#include <list>
+#include <sndfile.h>
+
+namespace MusECore {
+
+class PeakFile;
+
+// Upper limit for the number of peak builder threads. Building is
+//  mostly disk bound, more threads than this do not help.
+const int MAX_PEAK_BUILDER_THREADS = 4;
+
+//---------------------------------------------------------
+//   PeakBuilder
+//    Pool of threads filling in peak files prepared
+//     with PeakFile::create(), several at a time.
+//    The GUI draws whatever part is done and is told
+//     to redraw through Song::beat().
+//---------------------------------------------------------
+
+class PeakBuilder {
+      struct Worker {
+            PeakBuilder* builder;
+            pthread_t thread;
+            PeakFile* job;             // File being filled, or zero.
+            std::atomic<bool> cancel;
+            };
+
+      pthread_mutex_t _lock;
+      pthread_cond_t _jobCond;       // Signalled when jobs are added or on quit.
+      pthread_cond_t _doneCond;      // Signalled when a worker finishes a job.
+      std::list<PeakFile*> _queue;
+      Worker* _workers;
+      int _workerCount;
+      bool _quit;
+      std::atomic<bool> _updated;
+
+      static void* workerLoop(void*);
+      static bool progress(void* arg, sf_count_t done, sf_count_t total);
+
+   public:
+      PeakBuilder();
+      ~PeakBuilder();
+
+      // Zero threads means one per CPU, up to MAX_PEAK_BUILDER_THREADS.
+      void start(int threads = 0);
+      void stop();
+      bool isRunning() const { return _workerCount > 0; }
+
+      void add(PeakFile*);
+      // Removes a queued file, or aborts and waits for it if being filled.
+      void cancel(PeakFile*);
+      // True if any file has progressed since the last call. GUI thread.
+      bool takeUpdate() { return _updated.exchange(false); }
+      };
+
+} // namespace MusECore
+
+namespace MusEGlobal {
+extern MusECore::PeakBuilder* peakBuilder;
+}
+
+#endif
@@ -0,0 +1,580 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  peakfile.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <algorithm>
+
+#include "peakfile.h"
+#include "wave.h"
+
+namespace MusECore {
+
+static const char peakMagic[8] = { 'M', 'u', 's', 'E', 'P', 'e', 'a', 'k' };
+
+// Frames read from the wave file at a time while building.
+static const sf_count_t buildChunk = PeakFile::BASE_MAG * 2048;
+
+static inline int16_t toPeak(float v)
+      {
+      if (v > 1.0f)
+            v = 1.0f;
+      else if (v < -1.0f)
+            v = -1.0f;
+      return int16_t(lrintf(v * 32767.0f));
+      }
+
+static inline uint16_t toRms(float v)
+      {
+      if (v > 1.0f)
+            v = 1.0f;
+      return uint16_t(lrintf(v * 65535.0f));
+      }
+
+//---------------------------------------------------------
+//   makeBin
+//    src is interleaved with 'stride' channels
+//---------------------------------------------------------
+
+static void makeBin(const float* src, unsigned stride, int n, PeakBin* b)
+      {
+      float mn = src[0];
+      float mx = src[0];
+      float sq = 0.0f;
+      for (int i = 0; i < n; ++i) {
+            const float v = src[i * stride];
+            if (v < mn)
+                  mn = v;
+            if (v > mx)
+                  mx = v;
+            sq += v * v;
+            }
+      b->min = toPeak(mn);
+      b->max = toPeak(mx);
+      b->rms = toRms(sqrtf(sq / n));
+      }
+
+//---------------------------------------------------------
+//   PeakFile
+//---------------------------------------------------------
+
+PeakFile::PeakFile()
+      {
+      _map         = 0;
+      _mapSize     = 0;
+      _channels    = 0;
+      _levels      = 0;
+      _livePartial = false;
+      _accCount    = 0;
+      _src         = 0;
+      _onDisk      = false;
+      _readyBins.store(0);
+      _readyLevels.store(0);
+      _building.store(false);
+      for (int l = 0; l < MAX_LEVELS; ++l) {
+            _level[l] = 0;
+            _bins[l]  = 0;
+            }
+      }
+
+PeakFile::~PeakFile()
+      {
+      close();
+      }
+
+//---------------------------------------------------------
+//   unmap
+//---------------------------------------------------------
+
+void PeakFile::unmap()
+      {
+      if (_map)
+            munmap(_map, _mapSize);
+      _map     = 0;
+      _mapSize = 0;
+      for (int l = 0; l < MAX_LEVELS; ++l) {
+            _level[l] = 0;
+            _bins[l]  = 0;
+            }
+      }
+
+//---------------------------------------------------------
+//   abort
+//---------------------------------------------------------
+
+void PeakFile::abort()
+      {
+      if (_src) {
+            sf_close(_src);
+            _src = 0;
+            if (_onDisk)
+                  ::unlink(_tmpPath.constData());
+            }
+      _building.store(false, std::memory_order_release);
+      }
+
+//---------------------------------------------------------
+//   close
+//---------------------------------------------------------
+
+void PeakFile::close()
+      {
+      abort();
+      unmap();
+      _live.clear();
+      _livePartial = false;
+      _accCount    = 0;
+      _channels    = 0;
+      _levels      = 0;
+      }
+
+//---------------------------------------------------------
+//   sourceStat
+//---------------------------------------------------------
+
+bool PeakFile::sourceStat(const QString& srcPath, int64_t* size, int64_t* mtime)
+      {
+      struct stat st;
+      if (stat(srcPath.toLocal8Bit().constData(), &st) == -1)
+            return false;
+      *size  = st.st_size;
+      *mtime = int64_t(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   layout
+//    Fills in the header for a file of 'frames' frames.
+//    Returns the total file size.
+//---------------------------------------------------------
+
+size_t PeakFile::layout(Header* h, unsigned channels, sf_count_t frames)
+      {
+      memset(h, 0, sizeof(Header));
+      memcpy(h->magic, peakMagic, sizeof(peakMagic));
+      h->version   = VERSION;
+      h->channels  = channels;
+      h->baseMag   = BASE_MAG;
+      h->srcFrames = frames;
+
+      size_t off      = (sizeof(Header) + 7) & ~size_t(7);
+      sf_count_t bins = (frames + BASE_MAG - 1) / BASE_MAG;
+      int l = 0;
+      while (l < MAX_LEVELS && bins > 0) {
+            h->levelOffset[l] = off;
+            h->levelBins[l]   = bins;
+            off += (bins * channels * sizeof(PeakBin) + 7) & ~size_t(7);
+            ++l;
+            if (bins == 1)
+                  break;
+            bins = (bins + (1 << LEVEL_SHIFT) - 1) >> LEVEL_SHIFT;
+            }
+      h->levels = l;
+      return off;
+      }
+
+//---------------------------------------------------------
+//   open
+//---------------------------------------------------------
+
+bool PeakFile::open(const QString& path, const QString& srcPath, unsigned channels, sf_count_t frames)
+      {
+      close();
+      if (frames <= 0 || channels == 0)
+            return false;
+      int64_t srcSize, srcMtime;
+      if (!sourceStat(srcPath, &srcSize, &srcMtime))
+            return false;
+
+      int fd = ::open(path.toLocal8Bit().constData(), O_RDONLY);
+      if (fd == -1)
+            return false;
+      struct stat st;
+      if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(Header)) {
+            ::close(fd);
+            return false;
+            }
+      void* m = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (m == MAP_FAILED)
+            return false;
+
+      // Anything not matching exactly, including the headerless
+      //  peak files of older versions, is simply rebuilt.
+      const Header* h = (const Header*)m;
+      Header expect;
+      const size_t size = layout(&expect, channels, frames);
+      if (memcmp(h->magic, peakMagic, sizeof(peakMagic)) != 0
+         || h->version != VERSION
+         || h->channels != channels
+         || h->baseMag != uint32_t(BASE_MAG)
+         || h->srcFrames != frames
+         || h->srcSize != srcSize
+         || h->srcMtime != srcMtime
+         || h->levels != expect.levels
+         || memcmp(h->levelOffset, expect.levelOffset, sizeof(expect.levelOffset)) != 0
+         || memcmp(h->levelBins, expect.levelBins, sizeof(expect.levelBins)) != 0
+         || size_t(st.st_size) < size) {
+            munmap(m, st.st_size);
+            return false;
+            }
+
+      _map      = m;
+      _mapSize  = st.st_size;
+      _channels = channels;
+      _levels   = h->levels;
+      for (int l = 0; l < _levels; ++l) {
+            _level[l] = (const PeakBin*)((const char*)m + h->levelOffset[l]);
+            _bins[l]  = h->levelBins[l];
+            }
+      _readyBins.store(_bins[0], std::memory_order_release);
+      _readyLevels.store(_levels, std::memory_order_release);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   create
+//    Sets up an empty mapping for the wave file. The bins
+//     are filled in by fill(), and may be read while that
+//     is in progress.
+//---------------------------------------------------------
+
+bool PeakFile::create(const QString& path, const QString& srcPath)
+      {
+      close();
+      const QByteArray src = srcPath.toLocal8Bit();
+      int sfd = ::open(src.constData(), O_RDONLY);
+      if (sfd == -1)
+            return false;
+      // The whole file is read front to back.
+      posix_fadvise(sfd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      SF_INFO info;
+      info.format = 0;
+      _src = sf_open_fd(sfd, SFM_READ, &info, SF_TRUE);
+      if (_src == 0) {
+            ::close(sfd);
+            return false;
+            }
+      if (info.frames <= 0 || info.channels <= 0) {
+            sf_close(_src);
+            _src = 0;
+            return false;
+            }
+
+      Header& h = _buildHeader;
+      const size_t size = layout(&h, info.channels, info.frames);
+      sourceStat(srcPath, &h.srcSize, &h.srcMtime);
+
+      // Write to a temporary file which is renamed when complete,
+      //  so an interrupted build never leaves a valid looking file.
+      // The name is unique, another instance may be building the same file.
+      _path    = path;
+      _tmpPath = (path + ".XXXXXX").toLocal8Bit();
+      _onDisk  = false;
+      void* m  = MAP_FAILED;
+      int fd = mkstemp(_tmpPath.data());
+      if (fd != -1) {
+            fchmod(fd, 0644);   // mkstemp() makes it private.
+            if (ftruncate(fd, size) == 0) {
+                  m = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                  _onDisk = (m != MAP_FAILED);
+                  }
+            ::close(fd);
+            if (!_onDisk)
+                  ::unlink(_tmpPath.constData());
+            }
+      if (!_onDisk) {
+            // Read-only directory, for example. Keep the peaks in memory.
+            m = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (m == MAP_FAILED) {
+                  sf_close(_src);
+                  _src = 0;
+                  return false;
+                  }
+            }
+
+      _map      = m;
+      _mapSize  = size;
+      _channels = h.channels;
+      _levels   = h.levels;
+      for (int l = 0; l < _levels; ++l) {
+            _level[l] = (const PeakBin*)((const char*)m + h.levelOffset[l]);
+            _bins[l]  = h.levelBins[l];
+            }
+      _readyBins.store(0, std::memory_order_release);
+      _readyLevels.store(0, std::memory_order_release);
+      _building.store(true, std::memory_order_release);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   fill
+//    Scans the wave file opened by create(). Level 0 is
+//     published chunk by chunk as it is read.
+//---------------------------------------------------------
+
+bool PeakFile::fill(ProgressFunc progress, void* progressArg)
+      {
+      if (!_src)
+            return false;
+      const Header& h         = _buildHeader;
+      const unsigned channels = h.channels;
+      const sf_count_t frames = h.srcFrames;
+      char* base              = (char*)_map;
+
+      //
+      // level 0 from the wave file
+      //
+      bool ok      = true;
+      PeakBin* dst = (PeakBin*)(base + h.levelOffset[0]);
+      float* buffer = new float[buildChunk * channels];
+      for (sf_count_t pos = 0; pos < frames; pos += buildChunk) {
+            if (progress && !progress(progressArg, pos, frames)) {
+                  ok = false;
+                  break;
+                  }
+            const sf_count_t n = std::min(buildChunk, frames - pos);
+            sf_count_t rn = sf_readf_float(_src, buffer, n);
+            if (rn < 0)
+                  rn = 0;
+            if (rn < n)
+                  memset(buffer + rn * channels, 0, (n - rn) * channels * sizeof(float));
+            for (sf_count_t f = 0; f < n; f += BASE_MAG) {
+                  const int cnt = std::min(sf_count_t(BASE_MAG), n - f);
+                  for (unsigned ch = 0; ch < channels; ++ch)
+                        makeBin(buffer + f * channels + ch, channels, cnt, dst++);
+                  }
+            _readyBins.store((pos + n + BASE_MAG - 1) / BASE_MAG, std::memory_order_release);
+            }
+      delete[] buffer;
+      sf_close(_src);
+      _src = 0;
+
+      if (!ok) {
+            if (_onDisk)
+                  ::unlink(_tmpPath.constData());
+            _building.store(false, std::memory_order_release);
+            return false;
+            }
+      _readyLevels.store(1, std::memory_order_release);
+
+      //
+      // coarser levels from the previous one
+      //
+      const int fan = 1 << LEVEL_SHIFT;
+      for (unsigned l = 1; l < h.levels; ++l) {
+            const PeakBin* src = (const PeakBin*)(base + h.levelOffset[l-1]);
+            const sf_count_t srcBins = h.levelBins[l-1];
+            PeakBin* d = (PeakBin*)(base + h.levelOffset[l]);
+            for (sf_count_t i = 0; i < sf_count_t(h.levelBins[l]); ++i) {
+                  const sf_count_t first = i << LEVEL_SHIFT;
+                  const sf_count_t last  = std::min(first + fan, srcBins);
+                  for (unsigned ch = 0; ch < channels; ++ch, ++d) {
+                        int16_t mn = 32767;
+                        int16_t mx = -32767;
+                        float sq   = 0.0f;
+                        for (sf_count_t j = first; j < last; ++j) {
+                              const PeakBin& b = src[j * channels + ch];
+                              if (b.min < mn)
+                                    mn = b.min;
+                              if (b.max > mx)
+                                    mx = b.max;
+                              const float r = b.rms / 65535.0f;
+                              sq += r * r;
+                              }
+                        d->min = mn;
+                        d->max = mx;
+                        d->rms = toRms(sqrtf(sq / (last - first)));
+                        }
+                  }
+            _readyLevels.store(l + 1, std::memory_order_release);
+            }
+
+      memcpy(base, &h, sizeof(Header));
+      mprotect(_map, _mapSize, PROT_READ);
+      if (_onDisk && ::rename(_tmpPath.constData(), _path.toLocal8Bit().constData()) == -1) {
+            fprintf(stderr, "PeakFile::fill: cannot rename %s: %s\n", _tmpPath.constData(), strerror(errno));
+            ::unlink(_tmpPath.constData());
+            }
+      _building.store(false, std::memory_order_release);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   build
+//---------------------------------------------------------
+
+bool PeakFile::build(const QString& path, const QString& srcPath,
+   ProgressFunc progress, void* progressArg)
+      {
+      if (!create(path, srcPath))
+            return false;
+      if (!fill(progress, progressArg)) {
+            close();
+            return false;
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   detach
+//    Copy level 0 to memory so it can grow.
+//---------------------------------------------------------
+
+void PeakFile::detach()
+      {
+      if (!_map)
+            return;
+      _live.assign(_level[0], _level[0] + _readyBins.load(std::memory_order_acquire) * _channels);
+      _livePartial = false;
+      unmap();
+      _levels = 1;
+      }
+
+//---------------------------------------------------------
+//   flushAcc
+//---------------------------------------------------------
+
+void PeakFile::flushAcc(bool reset)
+      {
+      for (unsigned ch = 0; ch < _channels; ++ch) {
+            PeakBin b;
+            b.min = toPeak(_accMin[ch]);
+            b.max = toPeak(_accMax[ch]);
+            b.rms = toRms(sqrtf(_accSq[ch] / _accCount));
+            _live.push_back(b);
+            }
+      if (reset) {
+            _accCount = 0;
+            std::fill(_accSq.begin(), _accSq.end(), 0.0f);
+            }
+      }
+
+//---------------------------------------------------------
+//   appendLive
+//    Add recorded frames to the in-memory level 0.
+//---------------------------------------------------------
+
+void PeakFile::appendLive(const float* interleaved, unsigned channels, size_t frames)
+      {
+      detach();
+      if (channels != _channels) {
+            _live.clear();
+            _livePartial = false;
+            _accCount    = 0;
+            _channels    = channels;
+            }
+      if (_accMin.size() != channels) {
+            _accMin.assign(channels, 0.0f);
+            _accMax.assign(channels, 0.0f);
+            _accSq.assign(channels, 0.0f);
+            }
+      if (_livePartial) {
+            _live.resize(_live.size() - _channels);
+            _livePartial = false;
+            }
+
+      for (size_t f = 0; f < frames; ++f) {
+            const float* sp = interleaved + f * channels;
+            for (unsigned ch = 0; ch < channels; ++ch) {
+                  const float v = sp[ch];
+                  if (_accCount == 0 || v < _accMin[ch])
+                        _accMin[ch] = v;
+                  if (_accCount == 0 || v > _accMax[ch])
+                        _accMax[ch] = v;
+                  _accSq[ch] += v * v;
+                  }
+            if (++_accCount == BASE_MAG)
+                  flushAcc(true);
+            }
+      if (_accCount) {
+            flushAcc(false);
+            _livePartial = true;
+            }
+      _levels = 1;
+      }
+
+//---------------------------------------------------------
+//   read
+//---------------------------------------------------------
+
+void PeakFile::read(SampleV* s, unsigned channels, int mag, sf_count_t pos, bool overwrite) const
+      {
+      const PeakBin* bins;
+      sf_count_t nbins;
+      int levelMag = BASE_MAG;
+      if (_map) {
+            // While building only the levels done so far can be used,
+            //  and of level 0 only what has been read yet.
+            const int levels = _readyLevels.load(std::memory_order_acquire);
+            int l = 0;
+            while (l + 1 < levels && (levelMag << LEVEL_SHIFT) <= mag) {
+                  ++l;
+                  levelMag <<= LEVEL_SHIFT;
+                  }
+            bins  = _level[l];
+            nbins = levels ? _bins[l] : _readyBins.load(std::memory_order_acquire);
+            }
+      else if (!_live.empty()) {
+            bins  = &_live[0];
+            nbins = _live.size() / _channels;
+            }
+      else
+            return;
+
+      const sf_count_t first = pos / levelMag;
+      const int count = std::max(1, mag / levelMag);
+      const sf_count_t end = std::min(first + count, nbins);
+      // Near the end, or while building, fewer bins may be there.
+      const int got = end > first ? int(end - first) : 1;
+      if (channels > _channels)
+            channels = _channels;
+
+      for (unsigned ch = 0; ch < channels; ++ch) {
+            int peak = 0;
+            int rms  = 0;
+            for (sf_count_t i = first; i < end; ++i) {
+                  const PeakBin& b = bins[i * _channels + ch];
+                  const int p = std::max(int(b.max), -int(b.min));
+                  if (p > peak)
+                        peak = p;
+                  rms += b.rms >> 8;
+                  }
+            peak = peak * 255 / 32767;
+            if (s[ch].peak < peak)
+                  s[ch].peak = peak;
+            if (overwrite)
+                  s[ch].rms = rms / got;
+            else
+                  s[ch].rms = std::min(255, s[ch].rms + rms / got);
+            }
+      }
+
+} // namespace MusECore
@@ -0,0 +1,151 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  peakfile.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __PEAKFILE_H__
+#define __PEAKFILE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <sndfile.h>
+
+#include <QByteArray>
+#include <QString>
+
+namespace MusECore {
+
+struct SampleV;
+
+//---------------------------------------------------------
+//   PeakBin
+//    min/max/rms of one channel over one bin
+//---------------------------------------------------------
+
+struct PeakBin {
+      int16_t min;
+      int16_t max;
+      uint16_t rms;
+      };
+
+//---------------------------------------------------------
+//   PeakFile
+//    Multi-resolution peak data (.wca file) of a wave file.
+//    Level 0 holds one bin per BASE_MAG frames, each further
+//     level is (1 << LEVEL_SHIFT) times coarser. Bins of all
+//     channels are interleaved per level.
+//    The file is mmap'ed, so only the pages actually drawn
+//     are paged in. While recording the peaks are kept in
+//     memory instead and grown with appendLive().
+//---------------------------------------------------------
+
+class PeakFile {
+   public:
+      static const int BASE_MAG    = 128;
+      static const int LEVEL_SHIFT = 2;
+      static const int MAX_LEVELS  = 8;
+      static const uint32_t VERSION = 1;
+
+      // Called while building. Return false to abort.
+      typedef bool (*ProgressFunc)(void* arg, sf_count_t done, sf_count_t total);
+
+   private:
+      struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t channels;
+            uint32_t baseMag;
+            uint32_t levels;
+            int64_t srcFrames;
+            int64_t srcSize;                 // Size and modification time of the
+            int64_t srcMtime;                //  wave file the peaks were made from.
+            uint64_t levelOffset[MAX_LEVELS];
+            uint64_t levelBins[MAX_LEVELS];
+            };
+
+      void* _map;
+      size_t _mapSize;
+      unsigned _channels;
+      int _levels;
+      const PeakBin* _level[MAX_LEVELS];
+      sf_count_t _bins[MAX_LEVELS];
+      std::atomic<sf_count_t> _readyBins;   // Level 0 bins filled in so far.
+      std::atomic<int> _readyLevels;        // Levels completely filled in.
+      std::atomic<bool> _building;          // From create() until fill() is done or gives up.
+
+      // Build state, between create() and the end of fill().
+      SNDFILE* _src;
+      Header _buildHeader;
+      QString _path;
+      QByteArray _tmpPath;
+      bool _onDisk;
+
+      // In-memory level 0 used while recording.
+      std::vector<PeakBin> _live;
+      bool _livePartial;               // Last bin in _live is still being filled.
+      int _accCount;
+      std::vector<float> _accMin;
+      std::vector<float> _accMax;
+      std::vector<float> _accSq;
+
+      void unmap();
+      void detach();
+      void flushAcc(bool reset);
+      static bool sourceStat(const QString& srcPath, int64_t* size, int64_t* mtime);
+      static size_t layout(Header* h, unsigned channels, sf_count_t frames);
+
+   public:
+      PeakFile();
+      ~PeakFile();
+
+      // Maps an existing peak file. Returns false if it is missing,
+      //  of an older format or out of date with respect to srcPath.
+      bool open(const QString& path, const QString& srcPath, unsigned channels, sf_count_t frames);
+      // Opens the wave file and maps a new, empty peak file for it.
+      // If the file cannot be written the peaks are kept in anonymous memory.
+      bool create(const QString& path, const QString& srcPath);
+      // Scans the wave file. Safe to call from another thread, read()
+      //  returns whatever part is done. Returns false if aborted.
+      bool fill(ProgressFunc progress = 0, void* progressArg = 0);
+      // create() and fill() in one go.
+      bool build(const QString& path, const QString& srcPath,
+                 ProgressFunc progress = 0, void* progressArg = 0);
+      // Gives up a build prepared by create() that fill() will not be called for.
+      // What was filled in so far can still be read.
+      void abort();
+      void close();
+
+      bool isValid() const         { return _levels > 0; }
+      bool isBuilding() const      { return _building.load(); }
+      int levels() const           { return _levels; }
+      unsigned channels() const    { return _channels; }
+
+      void appendLive(const float* interleaved, unsigned channels, size_t frames);
+
+      // Reads 'mag' frames starting at 'pos' from the nearest level.
+      void read(SampleV* s, unsigned channels, int mag, sf_count_t pos, bool overwrite) const;
+      };
+
+} // namespace MusECore
+
+#endif
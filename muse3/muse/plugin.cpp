@@ -28,7 +28,10 @@
 #include <cmath>
 #include <string>
 #include <math.h>
+#include <string.h>
+#include <malloc.h>
 #include <sys/stat.h>
+#include <vector>
 
 #include <QGridLayout>
 #include <QLabel>
@@ -70,6 +73,7 @@
 #endif
 
 #include "audio.h"
+#include "dspprofiler.h"
 #include "al/dsp.h"
 
 #include "muse_math.h"
@@ -634,6 +638,7 @@ Plugin::Plugin(QFileInfo* f, const LADSPA_Descriptor* d, bool isDssi, bool isDss
   _isVstNativePlugin = false;
   _isVstNativeSynth = false;
   _requiredFeatures = reqFeatures;
+  _stateless = StatelessUnknown;
 
   #ifdef DSSI_SUPPORT
   dssi_descr = NULL;
@@ -694,6 +699,7 @@ Plugin::Plugin(const MusEPlugin::PluginScanInfoStruct& info)
   _isVstNativePlugin = false;
   _isVstNativeSynth = false;
   _requiredFeatures = info._requiredFeatures;
+  _stateless = StatelessUnknown;
   
   switch(info._type)
   {
@@ -963,6 +969,127 @@ CtrlList::Mode Plugin::ctrlMode(unsigned long i) const
       return ladspaCtrlMode(plugin, i);
       }
 
+//---------------------------------------------------------
+//   isStateless
+//---------------------------------------------------------
+
+bool Plugin::isStateless()
+      {
+      if (_stateless == StatelessUnknown)
+            _stateless = probeStateless() ? StatelessYes : StatelessNo;
+      return _stateless == StatelessYes;
+      }
+
+//---------------------------------------------------------
+//   probeStateless
+//    Runs PROBES instances on different lengths of noise
+//     with different control values, then all of them on
+//     the same blocks with the default controls. Equal
+//     outputs mean the result only depends on the block
+//     being run, so a single instance can take the channels
+//     of a track in turn. Filters, delays, envelopes,
+//     smoothed controls and anything counting samples all
+//     remember the earlier runs.
+//    The library must be loaded (incReferences()).
+//---------------------------------------------------------
+
+bool Plugin::probeStateless()
+      {
+      if (!plugin || !plugin->run || _isDssiSynth || _isDssiVst || _isLV2Plugin || _isVstNativePlugin
+          || _inports == 0 || _outports == 0)
+            return false;
+
+      const int PROBES = 3;
+      const unsigned long FRAMES = 256;
+      const unsigned long warmup[PROBES] = { 0, 61, 150 };
+      const float ctrlPos[PROBES]        = { 0.0f, 0.25f, 0.75f };
+
+      std::vector<float> ctrls(PROBES * _portCount, 0.0f);
+      std::vector<float> audio(PROBES * _portCount * FRAMES, 0.0f);
+      LADSPA_Handle h[PROBES];
+      int n = 0;
+      for (; n < PROBES; ++n) {
+            h[n] = plugin->instantiate(plugin, MusEGlobal::sampleRate);
+            if (!h[n])
+                  break;
+            }
+
+      bool stateless = n == PROBES;
+      if (stateless) {
+            for (int i = 0; i < PROBES; ++i) {
+                  for (unsigned long k = 0; k < _portCount; ++k) {
+                        if (plugin->PortDescriptors[k] & LADSPA_PORT_AUDIO)
+                              plugin->connect_port(h[i], k, &audio[(i * _portCount + k) * FRAMES]);
+                        else
+                              plugin->connect_port(h[i], k, &ctrls[i * _portCount + k]);
+                        }
+                  if (plugin->activate)
+                        plugin->activate(h[i]);
+                  }
+
+            unsigned seed = 1;
+            for (int pass = 0; pass < 3; ++pass) {
+                  for (int i = 0; i < PROBES; ++i) {
+                        unsigned long frames = FRAMES;
+                        if (pass == 0) {
+                              frames = warmup[i];
+                              if (frames == 0)
+                                    continue;
+                              }
+                        else
+                              seed = 1000 * pass;     // The same blocks for all.
+                        for (unsigned long k = 0; k < _portCount; ++k) {
+                              const LADSPA_PortDescriptor pd = plugin->PortDescriptors[k];
+                              if (!(pd & LADSPA_PORT_INPUT))
+                                    continue;
+                              if (pd & LADSPA_PORT_AUDIO) {
+                                    float* buf = &audio[(i * _portCount + k) * FRAMES];
+                                    for (unsigned long f = 0; f < frames; ++f) {
+                                          seed = seed * 1103515245 + 12345;
+                                          buf[f] = float((seed >> 8) & 0xffff) / 65536.0f - 0.5f;
+                                          }
+                                    }
+                              else {
+                                    float val, min, max;
+                                    ladspaDefaultValue(plugin, k, &val);
+                                    if (pass == 0) {
+                                          ladspaControlRange(plugin, k, &min, &max);
+                                          val = min + (max - min) * ctrlPos[i];
+                                          if (LADSPA_IS_HINT_INTEGER(plugin->PortRangeHints[k].HintDescriptor)
+                                              || LADSPA_IS_HINT_TOGGLED(plugin->PortRangeHints[k].HintDescriptor))
+                                                val = rintf(val);
+                                          }
+                                    ctrls[i * _portCount + k] = val;
+                                    }
+                              }
+                        plugin->run(h[i], frames);
+                        }
+                  if (pass == 0)
+                        continue;
+                  for (unsigned long k = 0; k < _portCount && stateless; ++k) {
+                        const LADSPA_PortDescriptor pd = plugin->PortDescriptors[k];
+                        if (!(pd & LADSPA_PORT_OUTPUT) || !(pd & LADSPA_PORT_AUDIO))
+                              continue;
+                        for (int i = 1; i < PROBES && stateless; ++i)
+                              stateless = memcmp(&audio[k * FRAMES], &audio[(i * _portCount + k) * FRAMES],
+                                                 FRAMES * sizeof(float)) == 0;
+                        }
+                  }
+            }
+
+      for (int i = 0; i < n; ++i) {
+            if (n == PROBES && plugin->deactivate)
+                  plugin->deactivate(h[i]);
+            if (plugin->cleanup)
+                  plugin->cleanup(h[i]);
+            }
+
+      if (MusEGlobal::debugMsg)
+            fprintf(stderr, "Plugin::probeStateless %s: %s\n", _label.toLatin1().constData(),
+                    stateless ? "stateless, instances may be shared" : "keeps state");
+      return stateless;
+      }
+
 void PluginGroups::shift_left(int first, int last)
 {
   for (int i=first; i<=last; i++)
@@ -1597,6 +1724,7 @@ void Pipeline::apply(unsigned pos, unsigned long ports, unsigned long nframes, f
 
             if(p)
             {
+              DspProfileScope profile(p, DspProfiler::PLUGIN);
               if (p->on())
               {
                 if (!(p->requiredFeatures() & PluginNoInPlaceProcessing))
@@ -1633,6 +1761,7 @@ void Pipeline::apply(unsigned pos, unsigned long ports, unsigned long nframes, f
 //---------------------------------------------------------
 
 PluginIBase::PluginIBase()
+   : _runCycles(0), _skippedCycles(0), _silenceTailMs(-1)
 {
   _gui = 0;
 }
@@ -1643,6 +1772,46 @@ PluginIBase::~PluginIBase()
     delete _gui;
 }
 
+//---------------------------------------------------------
+//   silenceTail
+//    How long input and output must stay silent before
+//     the plugin is no longer run: the tail set for it,
+//     else the one it reports, else the global one.
+//    LADSPA and DSSI cannot report how long their delays
+//     are, so long delays and reverbs need a tail set.
+//---------------------------------------------------------
+
+unsigned long PluginIBase::silenceTail()
+{
+  return SilenceGate::tailFrames(silenceTailMs(), tailFrames(), MusEGlobal::config.pluginSilenceTail,
+                                 latency(), MusEGlobal::sampleRate);
+}
+
+//---------------------------------------------------------
+//   silenceIdle
+//    True if running the plugin this cycle can be skipped:
+//     input and output have been silent for at least one
+//     cycle and the tail, and no control changes wait.
+//     The caller must still check that the input is silent
+//     now, and for synths that no events are due.
+//---------------------------------------------------------
+
+bool PluginIBase::silenceIdle()
+{
+  return MusEGlobal::config.pluginSilenceSkip && _silence.idle(silenceTail()) && _controlFifo.isEmpty();
+}
+
+//---------------------------------------------------------
+//   countQuiet
+//    Called after each run with whether input and output
+//     were both silent.
+//---------------------------------------------------------
+
+void PluginIBase::countQuiet(bool quiet, unsigned long n)
+{
+  _silence.count(quiet, n);
+}
+
 //---------------------------------------------------------
 //   showGui
 //---------------------------------------------------------
@@ -1844,6 +2013,9 @@ bool PluginIBase::addScheduledControlEvent(unsigned long i, double val, unsigned
     fprintf(stderr, "PluginIBase::addScheduledControlEvent: fifo overflow: in control number:%lu\n", i);
     return true;
   }
+  // The rack is rendered into the freeze file. Synth controls are moved by the midi it plays anyway.
+  if(id() != MAX_PLUGINS && track())
+    track()->setFreezeStale();
   return false;
 }
 
@@ -1920,6 +2092,9 @@ void PluginI::init()
       {
       _plugin           = 0;
       instances         = 0;
+      _groups           = 0;
+      _shared           = false;
+      _instanceBytes    = 0;
       handle            = 0;
       controls          = 0;
       controlsOut       = 0;
@@ -1930,6 +2105,7 @@ void PluginI::init()
       _audioOutDummyBuf  = 0;
       _hasLatencyOutPort = false;
       _latencyOutPort = 0;
+      _reportedLatency = 0.0;
       _on               = true;
       initControlValues = false;
       _showNativeGuiPending = false;
@@ -1982,6 +2158,17 @@ void PluginI::setID(int i)
   _id = i;
 }
 
+//---------------------------------------------------------
+//   setOn
+//---------------------------------------------------------
+
+void PluginI::setOn(bool val)
+{
+  _on = val;
+  if(_track)
+    _track->setFreezeStale();
+}
+
 //---------------------------------------------------------
 //   updateControllers
 //---------------------------------------------------------
@@ -1996,13 +2183,33 @@ void PluginI::updateControllers()
 }
 
 //---------------------------------------------------------
-//   setChannel
+//   heapInUse
+//    For a rough idea of what plugin instances take.
 //---------------------------------------------------------
 
-void PluginI::setChannels(int c)
+static size_t heapInUse()
 {
-      channel = c;
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+      struct mallinfo2 mi = mallinfo2();
+      return mi.uordblks + mi.hblkhd;
+#else
+      struct mallinfo mi = mallinfo();
+      return size_t(unsigned(mi.uordblks)) + size_t(unsigned(mi.hblkhd));
+#endif
+#else
+      return 0;
+#endif
+}
 
+//---------------------------------------------------------
+//   channelGroups
+//    How many times the plugin's audio ports go into
+//     the channels.
+//---------------------------------------------------------
+
+int PluginI::channelGroups(int c) const
+{
       unsigned long ins = _plugin->inports();
       unsigned long outs = _plugin->outports();
       int ni = 1;
@@ -2014,10 +2221,39 @@ void PluginI::setChannels(int c)
 
       if(ni < 1)
         ni = 1;
+      return ni;
+}
+
+//---------------------------------------------------------
+//   shareInstance
+//---------------------------------------------------------
+
+bool PluginI::shareInstance(int groups)
+{
+      // setChannels() may be called from the audio thread, so never probe here.
+      //  initPluginInstance() has done that already.
+      return groups > 1 && MusEGlobal::config.pluginShareInstances && _plugin->knownStateless();
+}
+
+//---------------------------------------------------------
+//   setChannel
+//---------------------------------------------------------
+
+void PluginI::setChannels(int c)
+{
+      channel = c;
+
+      _groups = channelGroups(c);
+      _shared = shareInstance(_groups);
+      int ni = _shared ? 1 : _groups;
 
       if (ni == instances)
             return;
 
+      // Not measured here, this may be the audio thread.
+      if(instances > 0)
+        _instanceBytes = _instanceBytes / instances * ni;
+
       LADSPA_Handle* handles = new LADSPA_Handle[ni];
 
       if(ni > instances)
@@ -2211,28 +2447,20 @@ bool PluginI::initPluginInstance(Plugin* plug, int c)
       _name  = _plugin->name() + inst;
       _label = _plugin->label() + inst;
 
-      unsigned long ins = plug->inports();
-      unsigned long outs = plug->outports();
-      if(outs)
-      {
-        instances = channel / outs;
-        if(instances < 1)
-          instances = 1;
-      }
-      else
-      if(ins)
-      {
-        instances = channel / ins;
-        if(instances < 1)
-          instances = 1;
-      }
-      else
-        instances = 1;
+      // Probed here in the gui thread, even for a single group, so that
+      //  setChannels() can share the instance later on without probing.
+      if(MusEGlobal::config.pluginShareInstances)
+        _plugin->isStateless();
+
+      _groups = channelGroups(channel);
+      _shared = shareInstance(_groups);
+      instances = _shared ? 1 : _groups;
 
       handle = new LADSPA_Handle[instances];
       for(int i = 0; i < instances; ++i)
         handle[i]=NULL;
 
+      size_t heap = heapInUse();
       for(int i = 0; i < instances; ++i)
       {
         #ifdef PLUGIN_DEBUGIN
@@ -2243,6 +2471,8 @@ bool PluginI::initPluginInstance(Plugin* plug, int c)
         if(handle[i] == NULL)
           return true;
       }
+      size_t used = heapInUse();
+      _instanceBytes = used > heap ? used - heap : 0;
 
       unsigned long ports = _plugin->ports();
 
@@ -2336,7 +2566,11 @@ bool PluginI::initPluginInstance(Plugin* plug, int c)
           abort();
       }
 
+      heap = heapInUse();
       activate();
+      used = heapInUse();
+      if(used > heap)
+        _instanceBytes += used - heap;
       return false;
       }
 
@@ -2346,30 +2580,37 @@ bool PluginI::initPluginInstance(Plugin* plug, int c)
 
 void PluginI::connect(unsigned long ports, unsigned long offset, float** src, float** dst)
       {
-      unsigned long port = 0;
-      for (int i = 0; i < instances; ++i) {
-            for (unsigned long k = 0; k < _plugin->ports(); ++k) {
-                  if (isAudioIn(k)) {
-                        if(port < ports)
-                          _plugin->connectPort(handle[i], k, src[port] + offset);
-                        else
-                          // Connect to an input silence buffer.
-                          _plugin->connectPort(handle[i], k, _audioInSilenceBuf + offset);
-                        ++port;
-                        }
+      for (int i = 0; i < instances; ++i)
+            connectInstance(handle[i], i, ports, offset, src, dst);
+      }
+
+//---------------------------------------------------------
+//   connectInstance
+//    Connects the instance to the channels of the group.
+//---------------------------------------------------------
+
+void PluginI::connectInstance(LADSPA_Handle h, int group, unsigned long ports, unsigned long offset, float** src, float** dst)
+      {
+      unsigned long port = group * _plugin->inports();
+      for (unsigned long k = 0; k < _plugin->ports(); ++k) {
+            if (isAudioIn(k)) {
+                  if(port < ports)
+                    _plugin->connectPort(h, k, src[port] + offset);
+                  else
+                    // Connect to an input silence buffer.
+                    _plugin->connectPort(h, k, _audioInSilenceBuf + offset);
+                  ++port;
                   }
             }
-      port = 0;
-      for (int i = 0; i < instances; ++i) {
-            for (unsigned long k = 0; k < _plugin->ports(); ++k) {
-                  if (isAudioOut(k)) {
-                        if(port < ports)
-                          _plugin->connectPort(handle[i], k, dst[port] + offset);
-                        else
-                          // Connect to a dummy buffer.
-                          _plugin->connectPort(handle[i], k, _audioOutDummyBuf + offset);
-                        ++port;
-                        }
+      port = group * _plugin->outports();
+      for (unsigned long k = 0; k < _plugin->ports(); ++k) {
+            if (isAudioOut(k)) {
+                  if(port < ports)
+                    _plugin->connectPort(h, k, dst[port] + offset);
+                  else
+                    // Connect to a dummy buffer.
+                    _plugin->connectPort(h, k, _audioOutDummyBuf + offset);
+                  ++port;
                   }
             }
       }
@@ -2475,6 +2716,8 @@ void PluginI::writeConfiguration(int level, Xml& xml)
             }
       if (_on == false)
             xml.intTag(level, "on", _on);
+      if (silenceTailMs() >= 0)
+            xml.intTag(level, "silenceTail", silenceTailMs());
       if(guiVisible())
         xml.intTag(level, "gui", 1);
       int x, y, w, h;
@@ -2596,6 +2839,11 @@ bool PluginI::readConfiguration(Xml& xml, bool readPreset)
                               if (!readPreset)
                                     _on = flag;
                               }
+                        else if (tag == "silenceTail") {
+                              int ms = xml.parseInt();
+                              if (!readPreset)
+                                    setSilenceTailMs(ms);
+                              }
                         else if (tag == "gui") {
                               bool flag = xml.parseInt();
                               if (_plugin)
@@ -2850,6 +3098,27 @@ void PluginI::apply(unsigned pos, unsigned long n, unsigned long ports, float**
   const unsigned long min_per = (usefixedrate || MusEGlobal::config.minControlProcessPeriod > n) ? n : MusEGlobal::config.minControlProcessPeriod;
   const unsigned long min_per_mask = min_per-1;   // min_per must be power of 2
 
+  // Once input and output have stayed silent for the tail, only process controls
+  //  until the input is no longer silent. Plugins without audio inputs always run.
+  bool quietIn = false;
+  if(ports == 0)
+    _silence.reset();   // Off or frozen, start over when running again.
+  else
+  {
+    _runCycles.fetch_add(1, std::memory_order_relaxed);
+    quietIn = MusEGlobal::config.pluginSilenceSkip && _plugin->inports() != 0 && SilenceGate::isSilent(ports, n, bufIn);
+    if(quietIn && silenceIdle())
+    {
+      if(bufOut != bufIn)
+      {
+        for(unsigned long i = 0; i < ports; ++i)
+          AL::dsp->cpy(bufOut[i], bufIn[i], n);
+      }
+      _skippedCycles.fetch_add(1, std::memory_order_relaxed);
+      ports = 0;
+    }
+  }
+
   AutomationType at = AUTO_OFF;
   CtrlListList* cll = NULL;
   ciCtrlList icl_first;
@@ -3063,10 +3332,22 @@ void PluginI::apply(unsigned pos, unsigned long n, unsigned long ports, float**
     {
       if(ports != 0)     // Don't bother if not 'running'.
       {
-        connect(ports, sample, bufIn, bufOut);
+        if(_shared)
+        {
+          // One instance doing the channel groups in turn, see Plugin::probeStateless().
+          for(int g = 0; g < _groups; ++g)
+          {
+            connectInstance(handle[0], g, ports, sample, bufIn, bufOut);
+            _plugin->apply(handle[0], nsamp);
+          }
+        }
+        else
+        {
+          connect(ports, sample, bufIn, bufOut);
 
-        for(int i = 0; i < instances; ++i)
-          _plugin->apply(handle[i], nsamp);
+          for(int i = 0; i < instances; ++i)
+            _plugin->apply(handle[i], nsamp);
+        }
       }
 
       sample += nsamp;
@@ -3074,6 +3355,26 @@ void PluginI::apply(unsigned pos, unsigned long n, unsigned long ports, float**
 
     ++cur_slice; // Slice is done. Moving on to any next slice now...
   }
+
+  if(ports != 0)
+    countQuiet(quietIn && SilenceGate::isSilent(ports, n, bufOut), n);
+
+  // Plugins set their latency port when they run. Have the song work out
+  //  the latency compensation again when it changes.
+  if(_hasLatencyOutPort && controlsOut[_latencyOutPort].val != _reportedLatency)
+  {
+    _reportedLatency = controlsOut[_latencyOutPort].val;
+    MusEGlobal::audio->sendMsgToGui('L');
+  }
+}
+
+//---------------------------------------------------------
+//   tailFrames
+//---------------------------------------------------------
+
+long PluginI::tailFrames() const
+{
+  return instances != 0 ? _plugin->tailFrames(handle[0]) : -1;
 }
 
 //---------------------------------------------------------
@@ -27,6 +27,7 @@
 
 #include <list>
 #include <vector>
+#include <atomic>
 #include <QSet>
 #include <QMap>
 #include <QPair>
@@ -44,6 +45,7 @@
 #include "globals.h"
 #include "ctrl.h"
 #include "controlfifo.h"
+#include "silence_gate.h"
 #include "plugin_list.h"
 
 #include "config.h"
@@ -132,8 +134,12 @@ class Plugin {
 
       PluginFeatures_t _requiredFeatures;
 
+      enum StatelessState { StatelessUnknown = 0, StatelessYes, StatelessNo };
+      StatelessState _stateless;
+      bool probeStateless();
+
    public:
-      Plugin() {} //empty constructor for LV2PluginWrapper
+      Plugin() : _stateless(StatelessNo) {} //empty constructor for LV2PluginWrapper
       Plugin(QFileInfo* f, const LADSPA_Descriptor* d, 
              bool isDssi = false, bool isDssiSynth = false, bool isDssiVst = false,
              PluginFeatures_t reqFeatures = PluginNoFeatures);
@@ -182,6 +188,8 @@ class Plugin {
             if(plugin)
               plugin->run(handle, n);
             }
+      // Frames the output may go on for after the input falls silent, -1 if not known.
+      virtual long tailFrames(LADSPA_Handle) const { return -1; }
 
       #ifdef OSC_SUPPORT
       int oscConfigure(LADSPA_Handle handle, const char* key, const char* value);
@@ -214,6 +222,14 @@ class Plugin {
       unsigned long controlOutPorts() const { return _controlOutPorts; }
 
       const std::vector<unsigned long>* getRpIdx() { return &rpIdx; }
+
+      // Whether one instance can process several channels in turn,
+      //  probed on the first call. Only for LADSPA and DSSI effects.
+      // The probe runs the plugin on thousands of frames: gui thread only.
+      bool isStateless();
+      // The answer of an earlier isStateless(), false if not probed yet.
+      //  For the audio thread.
+      bool knownStateless() const { return _stateless == StatelessYes; }
       };
 
 typedef std::list<Plugin *>::iterator iPlugin;
@@ -295,7 +311,15 @@ class PluginIBase
       QRect _guiGeometry;
       QRect _nativeGuiGeometry;
 
+      SilenceGate _silence;                   // Audio thread only. See silenceIdle().
+      std::atomic<unsigned> _runCycles;       // Cycles processed while running audio,
+      std::atomic<unsigned> _skippedCycles;   //  and those of them not run for silence.
+      std::atomic<int> _silenceTailMs;        // Set by the user, -1 for none.
+
       void makeGui();
+      unsigned long silenceTail();
+      bool silenceIdle();
+      void countQuiet(bool quiet, unsigned long n);
 
    public:
       PluginIBase();
@@ -338,6 +362,14 @@ class PluginIBase
       virtual LADSPA_PortRangeHint rangeOut(unsigned long i) = 0;
 
       virtual float latency() = 0;
+      // Frames the output may go on for after the input falls silent, -1 if not known.
+      virtual long tailFrames() const { return -1; }
+      unsigned runCycles() const     { return _runCycles.load(std::memory_order_relaxed); }
+      unsigned skippedCycles() const { return _skippedCycles.load(std::memory_order_relaxed); }
+      // Tail in ms before the plugin stops running in silence, overriding
+      //  the one it reports and the global one. -1 for none.
+      int silenceTailMs() const      { return _silenceTailMs.load(std::memory_order_relaxed); }
+      void setSilenceTailMs(int ms)  { _silenceTailMs.store(ms < 0 ? -1 : ms, std::memory_order_relaxed); }
       
       virtual void setCustomData(const std::vector<QString> &) {/* Do nothing by default */}
       virtual CtrlValueType ctrlValueType(unsigned long i) const = 0;
@@ -394,6 +426,9 @@ class PluginI : public PluginIBase {
       Plugin* _plugin;
       int channel;
       int instances;
+      int _groups;                   // Channel groups, one per instance unless shared.
+      bool _shared;                  // One instance does all groups in turn.
+      size_t _instanceBytes;         // Estimated heap taken by the instances, see instanceBytes().
       AudioTrack* _track;
       int _id;
 
@@ -407,6 +442,7 @@ class PluginI : public PluginIBase {
       
       bool          _hasLatencyOutPort;
       unsigned long _latencyOutPort;
+      float         _reportedLatency;      // Last latency the gui was told about. Audio thread.
 
       float *_audioInSilenceBuf; // Just all zeros all the time, so we don't have to clear for silence.
       float *_audioOutDummyBuf;  // A place to connect unused outputs.
@@ -422,6 +458,9 @@ class PluginI : public PluginIBase {
       bool _showNativeGuiPending;
 
       void init();
+      int channelGroups(int channels) const;
+      bool shareInstance(int groups);
+      void connectInstance(LADSPA_Handle h, int group, unsigned long ports, unsigned long offset, float** src, float** dst);
 
    public:
       PluginI();
@@ -432,7 +471,7 @@ class PluginI : public PluginIBase {
       virtual PluginFeatures_t requiredFeatures() const { return _plugin->requiredFeatures(); }
       
       bool on() const        { return _on; }
-      void setOn(bool val)   { _on = val; }
+      void setOn(bool val);
 
       void setTrack(AudioTrack* t)  { _track = t; }
       AudioTrack* track()           { return _track; }
@@ -443,6 +482,13 @@ class PluginI : public PluginIBase {
 
       bool initPluginInstance(Plugin*, int channels);
       void setChannels(int);
+      int instanceCount() const     { return instances; }
+      bool sharedInstance() const   { return _shared; }
+      // An estimate: the growth of the process heap while instantiating,
+      //  which other threads allocating at the same time distort, and
+      //  scaled rather than measured when the channels change.
+      size_t instanceBytes() const  { return _instanceBytes; }
+      virtual long tailFrames() const;
       void connect(unsigned long ports, unsigned long offset, float** src, float** dst);
       void apply(unsigned pos, unsigned long n, unsigned long ports, float** bufIn, float** bufOut);
 
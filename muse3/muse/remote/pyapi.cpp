@@ -538,6 +538,7 @@ PyObject* setMidiTrackParameter(PyObject*, PyObject* args)
             }
 
       if (changed) {
+            MusEGlobal::song->freezeStale(mt);
             QPybridgeEvent* pyevent = new QPybridgeEvent(QPybridgeEvent::SONG_UPDATE, SC_TRACK_MODIFIED);
             QApplication::postEvent(MusEGlobal::song, pyevent);
             }
@@ -22,6 +22,7 @@
 //=========================================================
 
 #include <stdio.h>
+#include <unistd.h>
 
 #include "song.h"
 #include "midiseq.h"
@@ -44,9 +45,71 @@
 #include "gconfig.h"
 #include "operations.h"
 #include "ctrl.h"
+#include "latency_compensator.h"
 
 namespace MusECore {
 
+//---------------------------------------------------------
+//   putMsg
+//    Waits for room if the audio thread is behind.
+//---------------------------------------------------------
+
+void Audio::putMsg(const AudioMsgQueue::Item& item)
+      {
+      while (!_msgQueue.put(item))
+            usleep(1000);
+      }
+
+//---------------------------------------------------------
+//   postMsg
+//    Queues a message and returns at once. Many messages
+//     can be processed in one cycle, in the order they were
+//     sent, posted or not. Once processed, done is called
+//     from the gui thread with arg, and may delete the message.
+//---------------------------------------------------------
+
+void Audio::postMsg(AudioMsg* m, AudioMsgDoneFunc done, void* arg)
+      {
+      if (!_running) {
+            processMsg(m);
+            if (done)
+                  done(m, arg);
+            return;
+            }
+      if (done) {
+            // Keep the done queue from overflowing in the audio thread.
+            while (_msgsDonePending.load() >= AudioMsgQueue::SIZE) {
+                  processMsgsDone();
+                  usleep(1000);
+                  }
+            ++_msgsDonePending;
+            }
+      AudioMsgQueue::Item item;
+      item.msg      = m;
+      item.done     = done;
+      item.arg      = arg;
+      item.serialNo = -1;
+      putMsg(item);
+      }
+
+//---------------------------------------------------------
+//   processMsgsDone
+//---------------------------------------------------------
+
+void Audio::processMsgsDone()
+      {
+      AudioMsgQueue::Item item;
+      while (_msgDoneQueue.get(&item)) {
+            --_msgsDonePending;
+            item.done(item.msg, item.arg);
+            }
+      }
+
+static void deleteMsg(AudioMsg* m, void*)
+      {
+      delete m;
+      }
+
 //---------------------------------------------------------
 //   sendMsg
 //---------------------------------------------------------
@@ -58,8 +121,12 @@ void Audio::sendMsg(AudioMsg* m)
 
       if (_running) {
             m->serialNo = sno++;
-            //DEBUG:
-            msg = m;
+            AudioMsgQueue::Item item;
+            item.msg      = m;
+            item.done     = 0;
+            item.arg      = 0;
+            item.serialNo = m->serialNo;
+            putMsg(item);
             // wait for next audio "process" call to finish operation
             int no = -1;
             int rv = read(fromThreadFdr, &no, sizeof(int));
@@ -443,15 +510,15 @@ void Audio::msgAddACEvent(AudioTrack* node, int acid, int frame, double val)
 
 void Audio::msgChangeACEvent(AudioTrack* node, int acid, int frame, int newFrame, double val)
 {
-      AudioMsg msg;
-      
-      msg.id     = AUDIO_CHANGE_AC_EVENT;
-      msg.snode  = node;
-      msg.ival   = acid;
-      msg.a      = frame; 
-      msg.b      = newFrame; 
-      msg.dval   = val;
-      sendMsg(&msg);
+      // Sent for each point of a bulk move. No need to wait for it.
+      AudioMsg* msg = new AudioMsg;
+      msg->id     = AUDIO_CHANGE_AC_EVENT;
+      msg->snode  = node;
+      msg->ival   = acid;
+      msg->a      = frame; 
+      msg->b      = newFrame; 
+      msg->dval   = val;
+      postMsg(msg, deleteMsg);
 }
 
 //---------------------------------------------------------
@@ -878,24 +945,33 @@ void Audio::msgUpdateSoloStates()
 
 void Audio::msgSetAux(AudioTrack* track, int idx, double val)
       {
-      AudioMsg msg;
-      msg.id    = SEQM_SET_AUX;
-      msg.snode = track;
-      msg.ival  = idx;
-      msg.dval  = val;
-      sendMessage(&msg, false);
+      // Sent for every move of an aux knob. No need to wait for it.
+      AudioMsg* msg = new AudioMsg;
+      msg->id    = SEQM_SET_AUX;
+      msg->snode = track;
+      msg->ival  = idx;
+      msg->dval  = val;
+      postMsg(msg, deleteMsg);
       }
 
 //---------------------------------------------------------
 //   msgPlayMidiEvent
 //---------------------------------------------------------
 
+static void deletePlayMidiEventMsg(AudioMsg* m, void*)
+      {
+      delete (const MidiPlayEvent*)m->p1;
+      delete m;
+      }
+
 void Audio::msgPlayMidiEvent(const MidiPlayEvent* event)
       {
-      AudioMsg msg;
-      msg.id = SEQM_PLAY_MIDI_EVENT;
-      msg.p1 = event;
-      sendMessage(&msg, false);
+      // Sent in a row when changing patches, and by scripts.
+      //  The event is copied, the caller's may be gone before it is played.
+      AudioMsg* msg = new AudioMsg;
+      msg->id = SEQM_PLAY_MIDI_EVENT;
+      msg->p1 = new MidiPlayEvent(*event);
+      postMsg(msg, deletePlayMidiEventMsg);
       }
 
 //---------------------------------------------------------
@@ -904,13 +980,13 @@ void Audio::msgPlayMidiEvent(const MidiPlayEvent* event)
 
 void Audio::msgSetHwCtrlState(MidiPort* port, int ch, int ctrl, int val)
       {
-      AudioMsg msg;
-      msg.id = SEQM_SET_HW_CTRL_STATE;
-      msg.p1 = port;
-      msg.a = ch;
-      msg.b = ctrl;
-      msg.c = val;
-      sendMessage(&msg, false);
+      AudioMsg* msg = new AudioMsg;
+      msg->id = SEQM_SET_HW_CTRL_STATE;
+      msg->p1 = port;
+      msg->a = ch;
+      msg->b = ctrl;
+      msg->c = val;
+      postMsg(msg, deleteMsg);
       }
 
 //---------------------------------------------------------
@@ -919,14 +995,14 @@ void Audio::msgSetHwCtrlState(MidiPort* port, int ch, int ctrl, int val)
 
 void Audio::msgSetHwCtrlStates(MidiPort* port, int ch, int ctrl, int val, int lastval)
       {
-      AudioMsg msg;
-      msg.id = SEQM_SET_HW_CTRL_STATES;
-      msg.p1 = port;
-      msg.a = ch;
-      msg.b = ctrl;
-      msg.c = val;
-      msg.ival = lastval;
-      sendMessage(&msg, false);
+      AudioMsg* msg = new AudioMsg;
+      msg->id = SEQM_SET_HW_CTRL_STATES;
+      msg->p1 = port;
+      msg->a = ch;
+      msg->b = ctrl;
+      msg->c = val;
+      msg->ival = lastval;
+      postMsg(msg, deleteMsg);
       }
 
 //---------------------------------------------------------
@@ -947,12 +1023,50 @@ void Audio::msgSetTrackAutomationType(Track* track, int type)
 //---------------------------------------------------------
 
 void Audio::msgSetSendMetronome(AudioTrack* track, bool b)
+{
+      // Sent for each output in a row. No need to wait for it.
+      AudioMsg* msg = new AudioMsg;
+      msg->id    = AUDIO_SET_SEND_METRONOME;
+      msg->snode = track;
+      msg->ival  = (int)b;
+      postMsg(msg, deleteMsg);
+}
+
+//---------------------------------------------------------
+//   msgSetLatencyCompensation
+//    comp is the new compensator, or null to keep the
+//     current one and just change its delays.
+//---------------------------------------------------------
+
+static void deleteLatencyCompMsg(AudioMsg* m, void*)
+      {
+      delete (LatencyCompensator*)m->p2;
+      delete m;
+      }
+
+void Audio::msgSetLatencyCompensation(AudioTrack* track, LatencyCompensator* comp, unsigned long sendDelay, unsigned long outDelay)
+{
+      AudioMsg* msg = new AudioMsg;
+      msg->id    = AUDIO_SET_LATENCY_COMPENSATION;
+      msg->snode = track;
+      msg->p1    = comp;
+      msg->p2    = 0;
+      msg->a     = sendDelay;
+      msg->b     = outDelay;
+      postMsg(msg, deleteLatencyCompMsg);
+}
+
+//---------------------------------------------------------
+//   msgSetFrozen
+//---------------------------------------------------------
+
+void Audio::msgSetFrozen(AudioTrack* track, bool frozen)
 {
       AudioMsg msg;
-      msg.id    = AUDIO_SET_SEND_METRONOME;
+      msg.id    = AUDIO_SET_FROZEN;
       msg.snode = track;
-      msg.ival  = (int)b;
-      sendMessage(&msg, false);
+      msg.ival  = frozen;
+      sendMsg(&msg);
 }
 
 //---------------------------------------------------------
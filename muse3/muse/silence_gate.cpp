@@ -0,0 +1,78 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  silence_gate.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include "silence_gate.h"
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   isSilent
+//---------------------------------------------------------
+
+bool SilenceGate::isSilent(unsigned long ports, unsigned long n, float** buf)
+{
+  const float level = 0.000001f;
+  for(unsigned long i = 0; i < ports; ++i)
+  {
+    const float* b = buf[i];
+    for(unsigned long k = 0; k < n; ++k)
+    {
+      if(b[k] > level || b[k] < -level)
+        return false;
+    }
+  }
+  return true;
+}
+
+//---------------------------------------------------------
+//   tailFrames
+//---------------------------------------------------------
+
+unsigned long SilenceGate::tailFrames(int tailMs, long reported, int defaultMs,
+                                      float latency, unsigned sampleRate)
+{
+  unsigned long tail;
+  if(tailMs >= 0)
+    tail = (unsigned long)tailMs * sampleRate / 1000;
+  else if(reported >= 0)
+    tail = reported;
+  else
+    tail = (unsigned long)defaultMs * sampleRate / 1000;
+  if(latency > 0.0f && (unsigned long)latency > tail)
+    tail = (unsigned long)latency;
+  return tail;
+}
+
+//---------------------------------------------------------
+//   count
+//---------------------------------------------------------
+
+void SilenceGate::count(bool quiet, unsigned long n)
+{
+  if(!quiet)
+    _quietFrames = 0;
+  else if(_quietFrames < 0x7fffffffUL)
+    _quietFrames += n;
+}
+
+} // namespace MusECore
@@ -0,0 +1,67 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  silence_gate.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __SILENCE_GATE_H__
+#define __SILENCE_GATE_H__
+
+namespace MusECore {
+
+//---------------------------------------------------------
+//   SilenceGate
+//    Tells when an effect or synth need not be run: its
+//     input is silent now, and input and output have both
+//     been silent for at least one cycle and its tail.
+//    One per plugin, audio thread only.
+//    The tail must be as long as the plugin rings on. The
+//     global default tail is lossy: a delay or reverb that
+//     rings longer is cut off, and its late echoes are lost.
+//     Only a tail per plugin, reported or set in its
+//     silenceTail, is correct for every effect.
+//---------------------------------------------------------
+
+class SilenceGate {
+      unsigned long _quietFrames;   // Frames in a row with silent input and output.
+
+   public:
+      SilenceGate() : _quietFrames(0) {}
+
+      // Whether all samples are below -120 dB. This also
+      //  takes the denormal bias as silence.
+      static bool isSilent(unsigned long ports, unsigned long n, float** buf);
+      // The tail in frames: tailMs if not negative, else the
+      //  reported frames if not negative, else defaultMs. Never
+      //  less than the latency, the output comes that much later.
+      static unsigned long tailFrames(int tailMs, long reported, int defaultMs,
+                                      float latency, unsigned sampleRate);
+
+      // Whether a run with silent input may be skipped.
+      bool idle(unsigned long tail) const { return _quietFrames != 0 && _quietFrames >= tail; }
+      // Called after each run with whether input and output
+      //  were both silent.
+      void count(bool quiet, unsigned long n);
+      void reset() { _quietFrames = 0; }
+      };
+
+} // namespace MusECore
+
+#endif
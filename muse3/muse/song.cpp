@@ -24,7 +24,11 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <math.h>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 #include <QAction>
 #include <QDir>
@@ -38,6 +42,7 @@
 #include <QByteArray>
 #include <QProgressDialog>
 #include <QList>
+#include <QTimer>
 
 #include "app.h"
 #include "driver/jackmidi.h"
@@ -61,6 +66,8 @@
 #include "midictrl.h"
 #include "menutitleitem.h"
 #include "midi_audio_control.h"
+#include "utils.h"
+#include "memory.h"
 #include "tracks_duplicate.h"
 #include "midi.h"
 #include "sig.h"
@@ -69,6 +76,10 @@
 #include "tempo.h"
 #include "route.h"
 #include "strntcpy.h"
+#include "peakbuilder.h"
+#include "audio_scheduler.h"
+#include "latency_compensator.h"
+#include "audioprefetch.h"
 
 // Undefine if and when multiple output routes are added to midi tracks.
 #define _USE_MIDI_TRACK_SINGLE_OUT_PORT_CHAN_
@@ -85,6 +96,9 @@ LockFreeMPSCRingBuffer<MidiPlayEvent> *Song::_ipcInEventBuffers =
 extern void clearMidiTransforms();
 extern void clearMidiInputTransforms();
 
+// Rendered past the end of the song when freezing a track.
+static const unsigned FREEZE_TAIL_SECONDS = 2;
+
 //---------------------------------------------------------
 //   Song
 //---------------------------------------------------------
@@ -97,6 +111,12 @@ Song::Song(const char* name)
       _fCpuLoad = 0.0;
       _fDspLoad = 0.0;
       _xRunsCount = 0;
+      _bounceStartUS = 0;
+      _bounceSpeed = 0.0;
+      freezingTrack = 0;
+      _freezeDone = false;
+      _freezeFlushStartUS = 0;
+      _latencyCompPending = true;
       
       _arrangerRaster     = 0; // Set to measure, the same as Arranger initial value. Arranger snap combo will set this.
       noteFifoSize   = 0;
@@ -111,6 +131,8 @@ Song::Song(const char* name)
       showSongInfo=true;
       clearDrumMap(); // One-time only early init
       clear(false);
+      connect(this, SIGNAL(songChanged(MusECore::SongChangedStruct_t)),
+              SLOT(latencyGraphChanged(MusECore::SongChangedStruct_t)));
       }
 
 //---------------------------------------------------------
@@ -1350,6 +1372,14 @@ void Song::update(MusECore::SongChangedStruct_t flags, bool allowRecursion)
             return;
             }
       ++level;
+      // Pick up track and route changes for parallel processing.
+      if (MusEGlobal::audioScheduler)
+            MusEGlobal::audioScheduler->update();
+      // Synths play their midi at the tempo of the map.
+      if (flags & (SC_TEMPO | SC_MASTER))
+            freezeStaleSynths();
+      if (checkFrozenTracks())
+            flags |= SC_TRACK_MODIFIED;
       emit songChanged(flags);
       --level;
       }
@@ -1637,6 +1667,337 @@ void Song::normalizeWaveParts(Part *partCursor)
    }
 }
 
+//---------------------------------------------------------
+//   updateLatencyCompensation
+//    Collects the audio tracks, their latencies and the
+//     paths between them, see computeLatencyDelays().
+//     Aux sends count whatever their level, so turning
+//     a send up from zero does not change the delays.
+//---------------------------------------------------------
+
+void Song::updateLatencyCompensation()
+      {
+      std::vector<AudioTrack*> tracks;
+      std::map<const Track*, int> index;
+      for (ciTrack it = _tracks.begin(); it != _tracks.end(); ++it) {
+            if ((*it)->isMidiTrack())
+                  continue;
+            index[*it] = tracks.size();
+            tracks.push_back(static_cast<AudioTrack*>(*it));
+            }
+      const int n = tracks.size();
+      if (n == 0)
+            return;
+
+      std::vector<unsigned long> sendDelay(n, 0);
+      std::vector<unsigned long> routeDelay(n, 0);
+
+      if (MusEGlobal::config.latencyCompensation) {
+            std::vector<LatencyEdge> edges;
+            std::vector<unsigned long> own(n);
+            std::vector<bool> isOutput(n);
+            for (int i = 0; i < n; ++i) {
+                  AudioTrack* t = tracks[i];
+                  // The capture latency of an input is the same for every
+                  //  path and is left to the recording code.
+                  const float l = t->type() == Track::AUDIO_INPUT ? t->AudioTrack::latency(0) : t->latency(0);
+                  own[i] = l > 0.0f ? (unsigned long)lrintf(l) : 0;
+                  isOutput[i] = t->type() == Track::AUDIO_OUTPUT;
+
+                  const RouteList* rl = t->inRoutes();
+                  for (ciRoute ir = rl->begin(); ir != rl->end(); ++ir) {
+                        if (ir->type != Route::TRACK_ROUTE || !ir->track || ir->track->isMidiTrack())
+                              continue;
+                        std::map<const Track*, int>::const_iterator is = index.find(ir->track);
+                        if (is != index.end()) {
+                              LatencyEdge e = { is->second, i, false };
+                              edges.push_back(e);
+                              }
+                        }
+                  if (t->hasAuxSend()) {
+                        for (ciAudioAux ia = _auxs.begin(); ia != _auxs.end(); ++ia) {
+                              std::map<const Track*, int>::const_iterator id = index.find(*ia);
+                              if (id != index.end() && id->second != i) {
+                                    LatencyEdge e = { i, id->second, true };
+                                    edges.push_back(e);
+                                    }
+                              }
+                        }
+                  }
+            computeLatencyDelays(own, edges, isOutput, &sendDelay, &routeDelay);
+            }
+
+      for (int i = 0; i < n; ++i)
+            tracks[i]->requestLatencyCompensation(sendDelay[i],
+                        routeDelay[i] > sendDelay[i] ? routeDelay[i] - sendDelay[i] : 0);
+      }
+
+//---------------------------------------------------------
+//   latencyGraphChanged
+//    Plugins, routes and tracks set the latencies. The
+//     delays are worked out again on the next heartbeat,
+//     once for any number of changes.
+//---------------------------------------------------------
+
+void Song::latencyGraphChanged(MusECore::SongChangedStruct_t flags)
+      {
+      if (flags._flags & (SC_TRACK_INSERTED | SC_TRACK_REMOVED | SC_ROUTE | SC_CHANNELS |
+                          SC_CONFIG | SC_AUX | SC_RACK))
+            _latencyCompPending = true;
+      }
+
+//---------------------------------------------------------
+//   freezeTrack
+//    Bounces the whole song while the track writes its
+//     post-rack output to a temporary file, which it then
+//     plays in place of its synth and plugins. See also
+//     finishFreeze().
+//---------------------------------------------------------
+
+bool Song::freezeTrack(AudioTrack* t)
+      {
+      if (!t->canFreeze() || t->recordFlag() || freezingTrack || record()
+         || MusEGlobal::audio->isPlaying() || MusEGlobal::audio->bounce()
+         || !MusEGlobal::checkAudioDevice())
+            return false;
+
+      if (t->frozen())
+            unfreezeTrack(t);
+
+      QString path;
+      if (!MusEGlobal::getUniqueTmpfileName("tmp_musewav", ".wav", path))
+            return false;
+      SndFile* sf = new SndFile(path);
+      sf->setFormat(SF_FORMAT_WAV | SF_FORMAT_FLOAT, t->channels(), MusEGlobal::sampleRate);
+      if (sf->openWrite()) {
+            fprintf(stderr, "MusE: cannot create freeze file <%s>\n", path.toLocal8Bit().constData());
+            delete sf;
+            return false;
+            }
+      // Not part of the project, removed on exit.
+      temporaryWavFiles.push_back(path);
+      // Anything changed while rendering makes the file out of date right away.
+      t->setFreezeFile(SndFileR(sf));
+
+      // Render the whole song plus a tail for releases and reverbs.
+      _freezeLPos = lPos();
+      _freezeRPos = rPos();
+      _freezeDone = false;
+      freezingTrack = t;
+      const unsigned end = MusEGlobal::tempomap.tick2frame(len()) + FREEZE_TAIL_SECONDS * MusEGlobal::sampleRate;
+      setPos(LPOS, Pos(0, false));
+      setPos(RPOS, Pos(end, false));
+      setPos(CPOS, lPos(), false, true, true);
+      MusEGlobal::audio->msgBounce();
+      setPlay(true);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   finishFreeze
+//    Called when the freeze bounce stopped rolling.
+//     The prefetch thread still has to write what is
+//     left in the freeze fifo, see flushFreeze().
+//---------------------------------------------------------
+
+void Song::finishFreeze()
+      {
+      setPos(LPOS, _freezeLPos);
+      setPos(RPOS, _freezeRPos);
+      _freezeFlushStartUS = curTimeUS();
+      flushFreeze();
+      }
+
+//---------------------------------------------------------
+//   flushFreeze
+//    Polled from a timer until the prefetch thread wrote
+//     the whole freeze file, then plays the track from it.
+//     Gives up after FreezeState::FLUSH_TIMEOUT_MS.
+//     freezingTrack stays set until then, so no other
+//     freeze can start.
+//---------------------------------------------------------
+
+void Song::flushFreeze()
+      {
+      AudioTrack* t = freezingTrack;
+      if (!t)
+            return;
+      // Deleted while rendering?
+      if (std::find(_tracks.begin(), _tracks.end(), t) == _tracks.end()) {
+            freezingTrack = 0;
+            return;
+            }
+
+      if (!t->freezeFlushed()) {
+            if (!FreezeState::flushTimedOut(_freezeFlushStartUS, curTimeUS())) {
+                  MusEGlobal::audioPrefetch->msgTick(true, false);
+                  QTimer::singleShot(10, this, SLOT(flushFreeze()));
+                  return;
+                  }
+            // The prefetch thread may still be writing the file, so it is
+            //  left alone. The track is not frozen and does not read it,
+            //  and it is a temporary wave file, removed on exit.
+            fprintf(stderr, "MusE: freezing <%s> failed, the freeze file was not written in time\n",
+                    t->name().toLocal8Bit().constData());
+            freezingTrack = 0;
+            return;
+            }
+      freezingTrack = 0;
+
+      SndFileR sf = t->freezeFile();
+      sf.close();
+      if (!_freezeDone || t->freezeOverrun()) {
+            fprintf(stderr, "MusE: freezing <%s> %s\n", t->name().toLocal8Bit().constData(),
+                    _freezeDone ? "dropped data, try again" : "aborted");
+            sf.remove();
+            t->setFreezeFile(SndFileR());
+            return;
+            }
+      if (sf.openRead(false)) {
+            fprintf(stderr, "MusE: cannot read freeze file <%s>\n", sf.path().toLocal8Bit().constData());
+            t->setFreezeFile(SndFileR());
+            return;
+            }
+      MusEGlobal::audio->msgSetFrozen(t, true);
+      update(SC_TRACK_MODIFIED);
+      }
+
+//---------------------------------------------------------
+//   unfreezeTrack
+//    The freeze file is kept until the track is frozen
+//     again, the prefetch thread may still be reading it.
+//---------------------------------------------------------
+
+void Song::unfreezeTrack(AudioTrack* t)
+      {
+      if (!t->frozen())
+            return;
+      MusEGlobal::audio->msgSetFrozen(t, false);
+      update(SC_TRACK_MODIFIED);
+      }
+
+//---------------------------------------------------------
+//   freezeStale
+//    Marks the freeze file of the track out of date. For
+//     a midi track, those of the synths it plays.
+//---------------------------------------------------------
+
+void Song::freezeStale(Track* t)
+      {
+      if (!t)
+            return;
+      if (!t->isMidiTrack()) {
+            static_cast<AudioTrack*>(t)->setFreezeStale();
+            return;
+            }
+      const int port = static_cast<MidiTrack*>(t)->outPort();
+      if (port == -1)
+            return;
+      for (iSynthI is = _synthIs.begin(); is != _synthIs.end(); ++is)
+            if ((*is)->midiPort() == port)
+                  (*is)->setFreezeStale();
+      }
+
+void Song::freezeStaleSynths()
+      {
+      for (iSynthI is = _synthIs.begin(); is != _synthIs.end(); ++is)
+            (*is)->setFreezeStale();
+      }
+
+//---------------------------------------------------------
+//   freezeStale
+//    Marks the freeze files the operations change out of
+//     date. Volume, pan and mute are applied after the file.
+//---------------------------------------------------------
+
+void Song::freezeStale(const Undo& operations)
+      {
+      for (ciUndoOp i = operations.begin(); i != operations.end(); ++i) {
+            switch (i->type) {
+                  case UndoOp::AddPart:
+                  case UndoOp::DeletePart:
+                  case UndoOp::ModifyPartLength:
+                  case UndoOp::AddEvent:
+                  case UndoOp::DeleteEvent:
+                  case UndoOp::ModifyEvent:
+                        freezeStale(i->part->track());
+                        break;
+                  case UndoOp::MovePart:
+                        freezeStale(const_cast<Track*>(i->track));
+                        freezeStale(const_cast<Track*>(i->oldTrack));
+                        break;
+                  case UndoOp::AddAudioCtrlVal:
+                  case UndoOp::DeleteAudioCtrlVal:
+                  case UndoOp::ModifyAudioCtrlVal:
+                        if (i->_audioCtrlID >= AC_PLUGIN_CTL_BASE)
+                              freezeStale(const_cast<Track*>(i->track));
+                        break;
+                  case UndoOp::ModifyAudioCtrlValList:
+                        {
+                        const CtrlList* cl = i->_eraseCtrlList ? i->_eraseCtrlList : i->_addCtrlList;
+                        if (cl->id() < AC_PLUGIN_CTL_BASE)
+                              break;
+                        for (iTrack it = _tracks.begin(); it != _tracks.end(); ++it)
+                              if (!(*it)->isMidiTrack() && static_cast<AudioTrack*>(*it)->controller() == i->_ctrlListList)
+                                    freezeStale(*it);
+                        }
+                        break;
+                  case UndoOp::AddTrack:
+                  case UndoOp::DeleteTrack:
+                  case UndoOp::SetTrackMute:
+                  case UndoOp::SetTrackOff:
+                        if (i->track->isMidiTrack())
+                              freezeStale(const_cast<Track*>(i->track));
+                        break;
+                  case UndoOp::ModifyTrackChannel:
+                        freezeStale(const_cast<Track*>(i->track));
+                        break;
+                  case UndoOp::ModifyClip:
+                        for (iWaveTrack it = _waves.begin(); it != _waves.end(); ++it)
+                              (*it)->setFreezeStale();
+                        break;
+                  default:
+                        break;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   checkFrozenTracks
+//    Unfreezes the tracks whose freeze file is out of date.
+//    Returns true if any was unfrozen.
+//---------------------------------------------------------
+
+bool Song::checkFrozenTracks()
+      {
+      bool changed = false;
+      for (ciTrack it = _tracks.begin(); it != _tracks.end(); ++it) {
+            if ((*it)->isMidiTrack())
+                  continue;
+            AudioTrack* t = static_cast<AudioTrack*>(*it);
+            if (!t->frozen() || !t->freezeStale())
+                  continue;
+            if (MusEGlobal::debugMsg)
+                  fprintf(stderr, "MusE: <%s> changed, unfreezing\n", t->name().toLocal8Bit().constData());
+            MusEGlobal::audio->msgSetFrozen(t, false);
+            changed = true;
+            }
+      return changed;
+      }
+
+//---------------------------------------------------------
+//   bounceFreewheel
+//    Whether a bounce runs faster than realtime. The dummy
+//     driver has nobody else to keep in time with, Jack
+//     freewheels all its clients so it is left to the user.
+//---------------------------------------------------------
+
+static bool bounceFreewheel()
+      {
+      return MusEGlobal::config.freewheelMode ||
+             MusEGlobal::audioDevice->deviceType() == AudioDevice::DUMMY_AUDIO;
+      }
+
 //---------------------------------------------------------
 //   beat
 //---------------------------------------------------------
@@ -1668,9 +2029,19 @@ void Song::beat()
         _fDspLoad = MusEGlobal::audioDevice->getDSP_Load();
       _xRunsCount = MusEGlobal::audio->getXruns();
 
+      // Top up the realtime arena before the audio threads run out,
+      //  and free what they could not.
+      rtArena().maintain();
+
+      // Hand a new processing graph to the audio thread if routes changed,
+      //  and free the one it replaced.
+      if (MusEGlobal::audioScheduler)
+            MusEGlobal::audioScheduler->update();
+
       // Keep the sync detectors running... 
+      const uint64_t now = curTimeUS();
       for(int port = 0; port < MusECore::MIDI_PORTS; ++port)
-          MusEGlobal::midiPorts[port].syncInfo().setTime();
+          MusEGlobal::midiPorts[port].syncInfo().setTime(now);
       
       
       if (MusEGlobal::audio->isPlaying())
@@ -1699,6 +2070,19 @@ void Song::beat()
       // Update synth native guis at the heartbeat rate.
       for(ciSynthI is = _synthIs.begin(); is != _synthIs.end(); ++is)
         (*is)->guiHeartBeat();
+
+      if (_latencyCompPending) {
+            _latencyCompPending = false;
+            updateLatencyCompensation();
+            }
+
+      // Parameter changes from plugin guis come without a song update.
+      if (checkFrozenTracks())
+            update(SC_TRACK_MODIFIED);
+
+      // Redraw waves whose peak files are being built in the background.
+      if(MusEGlobal::peakBuilder && MusEGlobal::peakBuilder->takeUpdate())
+        emit songChanged(SC_WAVE_PEAKS);
       
       while (noteFifoSize) {
             int pv = recNoteFifo[noteFifoRindex];
@@ -1862,6 +2246,7 @@ void Song::undo()
       
       redoList->push_back(opGroup);
       undoList->pop_back();
+      redoList->updateMemSize(redoList->back());
 
       if(MusEGlobal::redoAction)
         MusEGlobal::redoAction->setEnabled(true);
@@ -1894,6 +2279,9 @@ void Song::redo()
       
       undoList->push_back(opGroup);
       redoList->pop_back();
+      undoList->updateMemSize(undoList->back());
+      if (MusEGlobal::config.undoMemoryLimit > 0)
+            undoList->trim(size_t(MusEGlobal::config.undoMemoryLimit) << 20);
       
       if(MusEGlobal::undoAction)
         MusEGlobal::undoAction->setEnabled(true);
@@ -1954,8 +2342,11 @@ void Song::clear(bool signal, bool clear_all)
         printf("Song::clear\n");
       
       bounceTrack    = 0;
+      freezingTrack  = 0;
       
       _tracks.clear();
+      if (MusEGlobal::audioScheduler)
+            MusEGlobal::audioScheduler->invalidate();
       _midis.clearDelete();
       _waves.clearDelete();
       _inputs.clearDelete();     // audio input ports
@@ -2080,11 +2471,14 @@ void Song::clear(bool signal, bool clear_all)
 void Song::cleanupForQuit()
 {
       bounceTrack    = 0;
+      freezingTrack  = 0;
 
       if(MusEGlobal::debugMsg)
         printf("MusE: Song::cleanupForQuit...\n");
       
       _tracks.clear();
+      if (MusEGlobal::audioScheduler)
+            MusEGlobal::audioScheduler->invalidate();
       
       if(MusEGlobal::debugMsg)
         printf("deleting _midis\n");
@@ -2261,7 +2655,8 @@ void Song::seqSignal(int fd)
                         if(MusEGlobal::debugMsg)
                           fprintf(stderr, "Song: seqSignal: case f: setFreewheel start\n");
                         
-                        if(MusEGlobal::config.freewheelMode)
+                        _bounceStartUS = MusEGlobal::audioDevice->systemTimeUS();
+                        if(bounceFreewheel())
                           MusEGlobal::audioDevice->setFreewheel(true);
                         
                         break;
@@ -2270,9 +2665,25 @@ void Song::seqSignal(int fd)
                         if(MusEGlobal::debugMsg)
                           fprintf(stderr, "Song: seqSignal: case F: setFreewheel stop\n");
                         
-                        if(MusEGlobal::config.freewheelMode)
+                        if(bounceFreewheel())
                           MusEGlobal::audioDevice->setFreewheel(false);
                         
+                        if(_bounceStartUS)
+                        {
+                          const uint64_t dt = MusEGlobal::audioDevice->systemTimeUS() - _bounceStartUS;
+                          // What was rendered, which ends on a period after the right marker.
+                          const double secs = double(MusEGlobal::audio->bounceFrames()) / double(MusEGlobal::sampleRate);
+                          _bounceSpeed = dt ? secs * 1000000.0 / double(dt) : 0.0;
+                          _bounceStartUS = 0;
+                          if(MusEGlobal::debugMsg)
+                            fprintf(stderr, "MusE: bounced %.1f s in %.1f s, %.1fx realtime\n",
+                                    secs, double(dt) / 1000000.0, _bounceSpeed);
+                        }
+                        
+                        // The freeze file is complete, see stopRolling().
+                        if(freezingTrack)
+                          _freezeDone = true;
+                        
                         MusEGlobal::audio->msgPlay(false);
 #if 0 // DELETETHIS
                         if (record())
@@ -2315,6 +2726,14 @@ void Song::seqSignal(int fd)
                         update(SC_DRUMMAP);
                         break;
 
+                  case 'Q': // Posted audio messages were processed
+                        MusEGlobal::audio->processMsgsDone();
+                        break;
+
+                  case 'L': // A plugin reported a new latency
+                        _latencyCompPending = true;
+                        break;
+
 //                   case 'E': // Midi events are available in the ipc event buffer.
 //                         if(MusEGlobal::song)
 //                           MusEGlobal::song->processIpcInEventBuffers();
@@ -3106,6 +3525,8 @@ void Song::stopRolling(Undo* operations)
       
       if (record())
             MusEGlobal::audio->recordStop(false, opsp);
+      if (freezingTrack)
+            finishFreeze();
       setStopPlay(false);
       
       processAutomationEvents(opsp);
@@ -3420,6 +3841,8 @@ void Song::insertTrack2(Track* track, int idx)
       iTrack i = _tracks.index2iterator(idx);
       
       _tracks.insert(i, track);
+      if (MusEGlobal::audioScheduler)
+            MusEGlobal::audioScheduler->invalidate();
       
       n = _auxs.size();
       for (iTrack i = _tracks.begin(); i != _tracks.end(); ++i) {
@@ -122,6 +122,20 @@ class Song : public QObject {
       float _fCpuLoad;
       float _fDspLoad;
       long _xRunsCount;
+      // Wall clock time the current bounce started rolling, and the
+      //  speed of the last bounce relative to realtime.
+      uint64_t _bounceStartUS;
+      double _bounceSpeed;
+      // Freezing a track, see freezeTrack().
+      bool _freezeDone;             // The freeze bounce reached its end.
+      Pos _freezeLPos;              // Locators to restore afterwards.
+      Pos _freezeRPos;
+      uint64_t _freezeFlushStartUS; // When finishFreeze() started waiting for the file.
+      // The latency compensation is to be worked out again on the next heartbeat.
+      bool _latencyCompPending;
+      void finishFreeze();
+      bool checkFrozenTracks();
+      void freezeStaleSynths();
 
       // Receives events from any threads. For now, specifically for creating new
       //  controllers in the gui thread and adding them safely to the controller lists.
@@ -195,6 +209,7 @@ class Song : public QObject {
       bool dirty;
       WaveTrack* bounceTrack;
       AudioOutput* bounceOutput;
+      AudioTrack* freezingTrack;    // Track rendering its freeze file, if any.
       void updatePos();
 
       void read(Xml&, bool isTemplate=false);
@@ -260,6 +275,16 @@ class Song : public QObject {
       float cpuLoad() const { return _fCpuLoad; }
       float dspLoad() const { return _fDspLoad; }
       long xRunsCount() const { return _xRunsCount; }
+      // Audio time rendered per second of wall time in the last bounce. 0 if unknown.
+      double bounceSpeed() const { return _bounceSpeed; }
+      // Renders the track's output to a temporary file, which then plays instead of its
+      //  synth and plugins until anything it was rendered from changes. Returns false if
+      //  the track cannot be frozen now.
+      bool freezeTrack(AudioTrack*);
+      void unfreezeTrack(AudioTrack*);
+      // Mark freeze files out of date, see AudioTrack::setFreezeStale().
+      void freezeStale(Track*);
+      void freezeStale(const Undo&);
 
       //-----------------------------------------
       //    access tempomap/MusEGlobal::sigmap  (Mastertrack)
@@ -413,6 +438,13 @@ public:
       virtual bool event (QEvent* e );
 #endif
       void executeScript(QWidget *parent, const char* scriptfile, PartList* parts, int quant, bool onlyIfSelected);
+      // Sets the delay of each audio track so that all signals
+      //  meeting at a track or aux arrive with the same latency.
+      void updateLatencyCompensation();
+
+   private slots:
+      void latencyGraphChanged(MusECore::SongChangedStruct_t);
+      void flushFreeze();
 
    public slots:
       void seekTo(int tick);
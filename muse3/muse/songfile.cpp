@@ -50,6 +50,7 @@
 #include "conf.h"
 #include "driver/jackmidi.h"
 #include "keyevent.h"
+#include "binsong.h"
 
 namespace MusEGlobal {
 MusECore::CloneList cloneList;
@@ -316,6 +317,18 @@ Part* Part::readFromXml(Xml& xml, Track* track, bool doClone, bool toTrack)
                               else // ...Otherwise a clone was created, so we don't need the events.
                                 xml.skip(tag);
                         }
+                        else if (tag == "binevents")
+                        {
+                              // Events packed in a chunk of a binary song file, ticks relative to the part.
+                              const int chunk = xml.parseInt();
+                              if(!clone)
+                              {
+                                BinSong* bs = BinSong::current();
+                                if(wave || !bs || !bs->readEvents(chunk, npart))
+                                  printf("Part::readFromXml: warning: cannot read events of part:%s from chunk %d\n",
+                                    npart->name().toLatin1().constData(), chunk);
+                              }
+                        }
                         else
                               xml.unknown("readXmlPart");
                         break;
@@ -436,8 +449,13 @@ void Part::write(int level, Xml& xml, bool isCopy, bool forceWavePaths) const
       if (_mute)
             xml.intTag(level, "mute", _mute);
       if (dumpEvents) {
-            for (ciEvent e = events().begin(); e != events().end(); ++e)
-                  e->second.write(level, xml, *this, forceWavePaths);
+            BinSong* bs = BinSong::current();
+            if (bs && bs->writing() && !isCopy && !wave)
+                  xml.intTag(level, "binevents", bs->writeEvents(this));
+            else {
+                  for (ciEvent e = events().begin(); e != events().end(); ++e)
+                        e->second.write(level, xml, *this, forceWavePaths);
+                  }
             }
       xml.etag(level, "part");
       }
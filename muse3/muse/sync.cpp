@@ -180,12 +180,12 @@ MidiSyncInfo& MidiSyncInfo::copyParams(const MidiSyncInfo &sp)
 //  setTime
 //---------------------------------------------------------
 
-void MidiSyncInfo::setTime()
+void MidiSyncInfo::setTime(uint64_t t)
 {
   // Note: CurTime() makes a system call to gettimeofday(),
   //  which apparently can be slow in some cases. So I avoid calling this function
-  //  too frequently by calling it (at the heartbeat rate) in Song::beat().  T356
-  uint64_t t = curTimeUS();
+  //  too frequently by calling it (at the heartbeat rate) in Song::beat(),
+  //  once for all ports.  T356
 
   if(_clockTrig)
   {
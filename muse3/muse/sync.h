@@ -113,7 +113,8 @@ class MidiSyncInfo
     void setMMCIn(const bool v);   
     void setMTCIn(const bool v);   
     
-    void setTime(); 
+    // t is curTimeUS(), read once for all ports.
+    void setTime(uint64_t t); 
     
     bool recRewOnStart() const            { return _recRewOnStart; }
     void setRecRewOnStart(const bool v)   { _recRewOnStart = v; }
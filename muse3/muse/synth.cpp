@@ -49,6 +49,8 @@
 #include "synti/libsynti/mess.h"
 #include "song.h"
 #include "audio.h"
+#include "dspprofiler.h"
+#include "gconfig.h"
 #include "event.h"
 #include "mpevent.h"
 #include "audio.h"
@@ -1221,6 +1223,14 @@ void SynthI::preProcessAlways()
     _playbackEventBuffers->clearRead();
     //_userEventBuffers->clearRead();
   }
+  // Likewise while frozen, the playback is in the freeze file. User events
+  //  are kept for when the track is unfrozen, as above.
+  else if(frozen())
+  {
+    _playbackEventBuffers->clearRead();
+    _outPlaybackEvents.clear();
+    setStopFlag(false);
+  }
 }
 
 void MessSynthIF::preProcessAlways()
@@ -1241,11 +1251,40 @@ bool SynthI::getData(unsigned pos, int ports, unsigned n, float** buffer)
       int p = midiPort();
       MidiPort* mp = (p != -1) ? &MusEGlobal::midiPorts[p] : 0;
 
-      _sif->getData(mp, pos, ports, n, buffer);
+      const bool eventsDue = stopFlag() ||
+            !eventBuffers(MidiDevice::UserBuffer)->isEmpty(false) ||
+            !eventBuffers(MidiDevice::PlaybackBuffer)->isEmpty(false) ||
+            !_outUserEvents.empty() || !_outPlaybackEvents.empty();
+
+      DspProfileScope profile(static_cast<AudioTrack*>(this), DspProfiler::SYNTH);
+      _sif->getDataOrSkip(mp, pos, ports, n, buffer, eventsDue);
 
       return true;
       }
 
+//---------------------------------------------------------
+//   getDataOrSkip
+//    A synth without audio inputs is not run while no events
+//     are due and its output has been silent for the tail.
+//     Starting or stopping the transport wakes it, as some
+//     synths play along with the transport by themselves.
+//---------------------------------------------------------
+
+void SynthIF::getDataOrSkip(MidiPort* mp, unsigned pos, int ports, unsigned n, float** buffer, bool eventsDue)
+      {
+      _runCycles.fetch_add(1, std::memory_order_relaxed);
+      const bool playing = MusEGlobal::audio->isPlaying();
+      const bool quietIn = MusEGlobal::config.pluginSilenceSkip && !eventsDue &&
+                           playing == _wasPlaying && totalInChannels() == 0;
+      _wasPlaying = playing;
+      if (quietIn && silenceIdle()) {
+            _skippedCycles.fetch_add(1, std::memory_order_relaxed);
+            return;
+            }
+      getData(mp, pos, ports, n, buffer);
+      countQuiet(quietIn && SilenceGate::isSilent(ports, n, buffer), n);
+      }
+
 bool MessSynthIF::getData(MidiPort* /*mp*/, unsigned pos, int /*ports*/, unsigned n, float** buffer)
 {
       const unsigned int syncFrame = MusEGlobal::audio->curSyncFrame();
@@ -130,9 +130,10 @@ class SynthIF : public PluginIBase {
 
    protected:
       SynthI* synti;
+      bool _wasPlaying;   // Transport state in the last cycle, for the silence tracking.
 
    public:
-      SynthIF(SynthI* s) { synti = s; }
+      SynthIF(SynthI* s) { synti = s; _wasPlaying = false; }
       virtual ~SynthIF() {}
 
       // This is only a kludge required to support old songs' midistates. Do not use in any new synth.
@@ -144,6 +145,8 @@ class SynthIF : public PluginIBase {
       virtual bool hasNativeGui() const = 0;
       virtual void preProcessAlways() = 0;
       virtual bool getData(MidiPort*, unsigned pos, int ports, unsigned n, float** buffer) = 0;
+      // Calls getData(), unless idle for silence. The buffers must be cleared.
+      void getDataOrSkip(MidiPort*, unsigned pos, int ports, unsigned n, float** buffer, bool eventsDue);
       virtual MidiPlayEvent receiveEvent() = 0;
       virtual int eventsPending() const = 0;
 
@@ -273,6 +276,7 @@ class SynthI : public AudioTrack, public MidiDevice,
 
       Synth* synth() const          { return synthesizer; }
       virtual bool isSynti() const  { return true; }
+      virtual bool canFreeze() const { return true; }
 
       // Event time and tick must be set by caller beforehand.
       // Overridden here because input from synths may need to be treated specially.
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <cmath>
+#include <algorithm>
 
 #include "tempo.h"
 #include "globals.h"
@@ -51,6 +52,8 @@ TempoList::TempoList()
       _tempoSN     = 1;
       _globalTempo = 100;
       useList      = true;
+      _segmentSN   = 0;
+      rebuildSegments();
       }
 
 TempoList::~TempoList()
@@ -128,6 +131,112 @@ void TempoList::normalize()
               e->first - e->second->tick,
               denom, true);
             }
+      rebuildSegments();
+      }
+
+//---------------------------------------------------------
+//   rebuildSegments
+//---------------------------------------------------------
+
+void TempoList::rebuildSegments()
+      {
+      // Keeps its capacity, so this only allocates when the list grew.
+      _segments.resize(size());
+      unsigned n = 0;
+      for (ciTEvent e = begin(); e != end(); ++e, ++n) {
+            _segments[n].tick  = e->second->tick;
+            _segments[n].frame = e->second->frame;
+            _segments[n].tempo = e->second->tempo;
+            }
+      ++_segmentSN;
+      }
+
+//---------------------------------------------------------
+//   tickSegment
+//    Index of the segment containing tick.
+//---------------------------------------------------------
+
+static bool tickBefore(unsigned tick, const TempoSegment& s)   { return tick < s.tick; }
+static bool frameBefore(unsigned frame, const TempoSegment& s) { return frame < s.frame; }
+
+unsigned TempoList::tickSegment(unsigned tick) const
+      {
+      std::vector<TempoSegment>::const_iterator i =
+        std::upper_bound(_segments.begin(), _segments.end(), tick, tickBefore);
+      return i == _segments.begin() ? 0 : (i - _segments.begin()) - 1;
+      }
+
+unsigned TempoList::tickSegment(unsigned tick, TempoCursor& cur) const
+      {
+      const unsigned n = _segments.size();
+      if (cur._sn == _segmentSN && cur._seg < n && tick >= _segments[cur._seg].tick) {
+            // Usually still the same segment, or one of the next few.
+            for (unsigned s = cur._seg; s < n && s < cur._seg + 4; ++s) {
+                  if (s + 1 == n || tick < _segments[s + 1].tick) {
+                        cur._seg = s;
+                        return s;
+                        }
+                  }
+            }
+      cur._sn  = _segmentSN;
+      cur._seg = tickSegment(tick);
+      return cur._seg;
+      }
+
+//---------------------------------------------------------
+//   frameSegment
+//    Index of the segment containing frame.
+//---------------------------------------------------------
+
+unsigned TempoList::frameSegment(unsigned frame) const
+      {
+      std::vector<TempoSegment>::const_iterator i =
+        std::upper_bound(_segments.begin(), _segments.end(), frame, frameBefore);
+      return i == _segments.begin() ? 0 : (i - _segments.begin()) - 1;
+      }
+
+unsigned TempoList::frameSegment(unsigned frame, TempoCursor& cur) const
+      {
+      const unsigned n = _segments.size();
+      if (cur._sn == _segmentSN && cur._seg < n && frame >= _segments[cur._seg].frame) {
+            for (unsigned s = cur._seg; s < n && s < cur._seg + 4; ++s) {
+                  if (s + 1 == n || frame < _segments[s + 1].frame) {
+                        cur._seg = s;
+                        return s;
+                        }
+                  }
+            }
+      cur._sn  = _segmentSN;
+      cur._seg = frameSegment(frame);
+      return cur._seg;
+      }
+
+//---------------------------------------------------------
+//   segmentTick2frame
+//---------------------------------------------------------
+
+unsigned TempoList::segmentTick2frame(unsigned seg, unsigned tick) const
+      {
+      const TempoSegment& s = _segments[seg];
+      const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
+      const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
+      // Tick resolution is less than frame resolution. 
+      // Round up so that the reciprocal function (frame to tick) matches value for value.
+      return s.frame + muse_multiply_64_div_64_to_64(
+        numer * (uint64_t)s.tempo, tick - s.tick, denom, true);
+      }
+
+//---------------------------------------------------------
+//   segmentFrame2tick
+//---------------------------------------------------------
+
+unsigned TempoList::segmentFrame2tick(unsigned seg, unsigned frame) const
+      {
+      const TempoSegment& s = _segments[seg];
+      const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
+      const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
+      return s.tick + muse_multiply_64_div_64_to_64(
+        numer, frame - s.frame, denom * (uint64_t)s.tempo);
       }
 
 //---------------------------------------------------------
@@ -154,6 +263,7 @@ void TempoList::clear()
             delete i->second;
       TEMPOLIST::clear();
       insert(std::pair<const unsigned, TEvent*> (MAX_TICK+1, new TEvent(500000, 0)));
+      rebuildSegments();
       ++_tempoSN;
       }
 
@@ -359,20 +469,16 @@ unsigned TempoList::tick2frame(unsigned tick, unsigned frame, int* sn) const
 unsigned TempoList::tick2frame(unsigned tick, int* sn) const
       {
       unsigned f;
-      const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
-      const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
       if (useList) {
-            ciTEvent i = upper_bound(tick);
-            if (i == end()) {
+            if (tick > MAX_TICK) {
                   printf("tick2frame(%d,0x%x): not found\n", tick, tick);
                   return 0;
                   }
-            // Tick resolution is less than frame resolution. 
-            // Round up so that the reciprocal function (frame to tick) matches value for value.
-            f = i->second->frame + muse_multiply_64_div_64_to_64(
-              numer * (uint64_t)i->second->tempo, tick - i->second->tick, denom, true);
+            f = segmentTick2frame(tickSegment(tick), tick);
             }
       else {
+            const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
+            const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
             // Tick resolution is less than frame resolution. 
             // Round up so that the reciprocal function (frame to tick) matches value for value.
             f = muse_multiply_64_div_64_to_64(numer * (uint64_t)_tempo, tick, denom, true);
@@ -382,6 +488,13 @@ unsigned TempoList::tick2frame(unsigned tick, int* sn) const
       return f;
       }
 
+unsigned TempoList::tick2frame(unsigned tick, TempoCursor& cur) const
+      {
+      if (!useList || tick > MAX_TICK)
+            return tick2frame(tick);
+      return segmentTick2frame(tickSegment(tick, cur), tick);
+      }
+
 //---------------------------------------------------------
 //   frame2tick
 //    return cached value t if list did not change
@@ -399,29 +512,25 @@ unsigned TempoList::frame2tick(unsigned frame, unsigned t, int* sn) const
 unsigned TempoList::frame2tick(unsigned frame, int* sn) const
       {
       unsigned tick;
-      const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
-      const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
-      if (useList) {
-            ciTEvent e;
-            for (e = begin(); e != end();) {
-                  ciTEvent ee = e;
-                  ++ee;
-                  if (ee == end())
-                        break;
-                  if (frame < ee->second->frame)
-                        break;
-                  e = ee;
-                  }
-            tick = e->second->tick + muse_multiply_64_div_64_to_64(
-              numer, frame - e->second->frame, denom * (uint64_t)e->second->tempo);
-            }
-      else
+      if (useList)
+            tick = segmentFrame2tick(frameSegment(frame), frame);
+      else {
+            const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
+            const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
             tick = muse_multiply_64_div_64_to_64(numer, frame, denom * (uint64_t)_tempo);
+            }
       if (sn)
             *sn = _tempoSN;
       return tick;
       }
 
+unsigned TempoList::frame2tick(unsigned frame, TempoCursor& cur) const
+      {
+      if (!useList)
+            return frame2tick(frame);
+      return segmentFrame2tick(frameSegment(frame, cur), frame);
+      }
+
 //---------------------------------------------------------
 //   deltaTick2frame
 //---------------------------------------------------------
@@ -429,30 +538,20 @@ unsigned TempoList::frame2tick(unsigned frame, int* sn) const
 unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) const
       {
       unsigned int f1, f2;
-      const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
-      const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
       if (useList) {
-            ciTEvent i = upper_bound(tick1);
-            if (i == end()) {
+            if (tick1 > MAX_TICK) {
                   printf("TempoList::deltaTick2frame: tick1:%d not found\n", tick1);
                   // abort();
                   return 0;
                   }
-            // Tick resolution is less than frame resolution. 
-            // Round up so that the reciprocal function (frame to tick) matches value for value.
-            f1 = i->second->frame + muse_multiply_64_div_64_to_64(
-              numer * (uint64_t)i->second->tempo, tick1 - i->second->tick, denom, true);
-
-            i = upper_bound(tick2);
-            if (i == end()) {
+            if (tick2 > MAX_TICK)
                   return 0;
-                  }
-            // Tick resolution is less than frame resolution. 
-            // Round up so that the reciprocal function (frame to tick) matches value for value.
-            f2 = i->second->frame + muse_multiply_64_div_64_to_64(
-              numer * (uint64_t)i->second->tempo, tick2 - i->second->tick, denom, true);
+            f1 = segmentTick2frame(tickSegment(tick1), tick1);
+            f2 = segmentTick2frame(tickSegment(tick2), tick2);
             }
       else {
+            const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
+            const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
             // Tick resolution is less than frame resolution. 
             // Round up so that the reciprocal function (frame to tick) matches value for value.
             f1 = muse_multiply_64_div_64_to_64(numer * (uint64_t)_tempo, tick1, denom, true);
@@ -475,36 +574,14 @@ unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) con
 unsigned TempoList::deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn) const
       {
       unsigned tick1, tick2;
-      const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
-      const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
       if (useList) {
-            ciTEvent e;
-            for (e = begin(); e != end();) {
-                  ciTEvent ee = e;
-                  ++ee;
-                  if (ee == end())
-                        break;
-                  if (frame1 < ee->second->frame)
-                        break;
-                  e = ee;
-                  }
-            tick1 = e->second->tick + muse_multiply_64_div_64_to_64(
-              numer, frame1 - e->second->frame, denom * (uint64_t)e->second->tempo);
-            
-            for (e = begin(); e != end();) {
-                  ciTEvent ee = e;
-                  ++ee;
-                  if (ee == end())
-                        break;
-                  if (frame2 < ee->second->frame)
-                        break;
-                  e = ee;
-                  }
-            tick2 = e->second->tick + muse_multiply_64_div_64_to_64(
-              numer, frame2 - e->second->frame, denom * (uint64_t)e->second->tempo);
+            tick1 = segmentFrame2tick(frameSegment(frame1), frame1);
+            tick2 = segmentFrame2tick(frameSegment(frame2), frame2);
             }
       else
       {
+            const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)_globalTempo * 10000UL;
+            const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
             tick1 = muse_multiply_64_div_64_to_64(numer, frame1, denom * (uint64_t)_tempo);
             tick2 = muse_multiply_64_div_64_to_64(numer, frame2, denom * (uint64_t)_tempo);
       }
@@ -59,6 +59,35 @@ struct TEvent {
             }
       };
 
+//---------------------------------------------------------
+//   TempoSegment
+//    One constant tempo stretch of the list, starting at
+//    tick/frame. Flat copy of the map, for fast lookups.
+//---------------------------------------------------------
+
+struct TempoSegment {
+      unsigned tick;
+      unsigned frame;
+      int tempo;
+      };
+
+//---------------------------------------------------------
+//   TempoCursor
+//    Remembers the segment of the last lookup, so a run of
+//    increasing ticks or frames (events of a part, in
+//    order) costs about one comparison per conversion.
+//    Use one per run, they are not shared between threads.
+//---------------------------------------------------------
+
+class TempoCursor {
+      friend class TempoList;
+      int _sn;
+      unsigned _seg;
+
+   public:
+      TempoCursor() : _sn(-1), _seg(0) {}
+      };
+
 //---------------------------------------------------------
 //   TempoList
 //---------------------------------------------------------
@@ -77,6 +106,16 @@ class TempoList : public TEMPOLIST {
       bool useList;
       int _tempo;             // tempo if not using tempo list
       int _globalTempo;       // %percent 50-200%
+      std::vector<TempoSegment> _segments;  // Rebuilt by normalize().
+      int _segmentSN;
+
+      void rebuildSegments();
+      unsigned tickSegment(unsigned tick) const;
+      unsigned frameSegment(unsigned frame) const;
+      unsigned tickSegment(unsigned tick, TempoCursor& cur) const;
+      unsigned frameSegment(unsigned frame, TempoCursor& cur) const;
+      unsigned segmentTick2frame(unsigned seg, unsigned tick) const;
+      unsigned segmentFrame2tick(unsigned seg, unsigned frame) const;
 
       void add(unsigned tick, int tempo, bool do_normalize = true);
       void add(unsigned tick, TEvent* e, bool do_normalize = true);
@@ -109,6 +148,9 @@ class TempoList : public TEMPOLIST {
       unsigned tick2frame(unsigned tick, int* sn = 0) const;
       unsigned frame2tick(unsigned frame, int* sn = 0) const;
       unsigned frame2tick(unsigned frame, unsigned tick, int* sn) const;
+      // Same as above, for runs of increasing ticks or frames.
+      unsigned tick2frame(unsigned tick, TempoCursor& cur) const;
+      unsigned frame2tick(unsigned frame, TempoCursor& cur) const;
       unsigned deltaTick2frame(unsigned tick1, unsigned tick2, int* sn = 0) const;
       unsigned deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn = 0) const;
       
@@ -260,6 +260,8 @@ void Track::init()
             _peak[i]  = 0.0;
             _isClipped[i] = false;
             }
+      _meterSerial = 0;
+      _meterActive = false;
       }
 
 Track::Track(Track::TrackType t)
@@ -280,6 +282,8 @@ Track::Track(const Track& t, int flags)
         _peak[i]  = 0.0;
         _isClipped[i] = false;
         }
+  _meterSerial = 0;
+  _meterActive = false;
 }
 
 Track::~Track()
@@ -1002,6 +1006,7 @@ MidiTrack::ChangedType_t MidiTrack::setOutChannel(int i, bool doSignal)
   if(_outChannel == i)
     return NothingChanged;
   _outChannel = i;
+  MusEGlobal::song->freezeStale(this);
   ChangedType_t res = ChannelChanged;
   if(updateDrummap(doSignal))
     res |= DrumMapChanged;
@@ -1016,7 +1021,10 @@ MidiTrack::ChangedType_t MidiTrack::setOutPort(int i, bool doSignal)
 {
   if(_outPort == i)
     return NothingChanged;
+  // The synths played before and after.
+  MusEGlobal::song->freezeStale(this);
   _outPort = i;
+  MusEGlobal::song->freezeStale(this);
   ChangedType_t res = PortChanged;
   if(updateDrummap(doSignal))
     res |= DrumMapChanged;
@@ -1034,6 +1042,7 @@ MidiTrack::ChangedType_t MidiTrack::setOutChanAndUpdate(int i, bool doSignal)
     
   removePortCtrlEvents(this);
   _outChannel = i; 
+  MusEGlobal::song->freezeStale(this);
   ChangedType_t res = ChannelChanged;
   if(updateDrummap(doSignal))
     res |= DrumMapChanged;
@@ -1051,7 +1060,9 @@ MidiTrack::ChangedType_t MidiTrack::setOutPortAndUpdate(int i, bool doSignal)
     return NothingChanged;
   
   removePortCtrlEvents(this);
+  MusEGlobal::song->freezeStale(this);
   _outPort = i; 
+  MusEGlobal::song->freezeStale(this);
   ChangedType_t res = PortChanged;
   if(updateDrummap(doSignal))
     res |= DrumMapChanged;
@@ -1069,8 +1080,10 @@ MidiTrack::ChangedType_t MidiTrack::setOutPortAndChannelAndUpdate(int port, int
     return NothingChanged;
   
   removePortCtrlEvents(this);
+  MusEGlobal::song->freezeStale(this);
   _outPort = port; 
   _outChannel = ch;
+  MusEGlobal::song->freezeStale(this);
   ChangedType_t res = PortChanged | ChannelChanged;
   if(updateDrummap(doSignal))
     res |= DrumMapChanged;
@@ -29,6 +29,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <stdint.h>
 
 #include "wave.h" // for SndFileR
 #include "part.h"
@@ -40,6 +42,7 @@
 #include "globaldefs.h"
 #include "cleftypes.h"
 #include "controlfifo.h"
+#include "freeze_state.h"
 
 class QPixmap;
 class QColor;
@@ -47,6 +50,7 @@ class QColor;
 namespace MusECore {
 class Pipeline;
 class PluginI;
+class LatencyCompensator;
 class SynthI;
 class Xml;
 struct DrumMap;
@@ -120,6 +124,8 @@ class Track {
       double _meter[MusECore::MAX_CHANNELS];
       double _peak[MusECore::MAX_CHANNELS];
       bool _isClipped[MusECore::MAX_CHANNELS]; //used in audio mixer strip. Persistent.
+      std::atomic<unsigned> _meterSerial; // Changed whenever the meters, peaks or clip indicators change.
+      bool _meterActive;                  // Some meter was not zero in the last cycle.
 
       int _y;
       int _height;            // visual height in arranger
@@ -274,6 +280,12 @@ class Track {
       double meter(int ch) const  { return _meter[ch]; }
       double peak(int ch) const   { return _peak[ch]; }
       void resetMeter();
+      // Called by the audio thread after metering a cycle. Meters which
+      //  stay at zero do not count as a change.
+      void publishMeter(int channels);
+      // The gui need not redraw meters while this stays the same.
+      unsigned meterSerial() const { return _meterSerial.load(std::memory_order_acquire); }
+      void touchMeter()            { _meterSerial.fetch_add(1, std::memory_order_release); }
 
       bool readProperty(Xml& xml, const QString& tag);
       void setDefaultName(QString base = QString());
@@ -289,7 +301,7 @@ class Track {
       static void setVisible(bool) { }
       bool isVisible();
       inline bool isClipped(int ch) const { if(ch >= MusECore::MAX_CHANNELS) return false; return _isClipped[ch]; }
-      void resetClipper() { for(int ch = 0; ch < MusECore::MAX_CHANNELS; ++ch) _isClipped[ch] = false; }
+      void resetClipper() { for(int ch = 0; ch < MusECore::MAX_CHANNELS; ++ch) _isClipped[ch] = false; touchMeter(); }
       };
 
 //---------------------------------------------------------
@@ -460,6 +472,21 @@ class MidiTrack : public Track {
       void dumpMap();
       };
 
+//---------------------------------------------------------
+//   PrefetchState
+//    Read-ahead state of a wave or frozen track, kept by AudioPrefetch.
+//---------------------------------------------------------
+
+struct PrefetchState {
+      unsigned writePos;           // Frame of the next fifo block, ~0 if not yet known.
+      bool doSeek;                 // Seek the files before the next read.
+      unsigned target;             // Look-ahead in frames, adapted to the read times.
+      double readTime;             // Smoothed seconds per full chunk read.
+      volatile unsigned underruns; // Counted by the audio thread.
+
+      PrefetchState() : writePos(~0U), doSeek(true), target(0), readTime(0.0), underruns(0) { }
+      };
+
 //---------------------------------------------------------
 //   AudioTrack
 //    this track can hold audio automation data and can
@@ -489,6 +516,8 @@ class AudioTrack : public Track {
       bool _sendMetronome;
       AutomationType _automationType;
       double _gain;
+      // Bumped when the gain, an aux send or a controller enable changes.
+      std::atomic<unsigned> _ctrlGuiSerial;
 
       void initBuffers();
       void internal_assign(const Track&, int flags);
@@ -507,6 +536,18 @@ class AudioTrack : public Track {
       float*  audioOutDummyBuf;
       // Internal temporary buffers for getData().
       float** _dataBuffers;
+      // Volume and pan values of the current cycle, two times segmentSize.
+      float* _ctrlRenderBuffer;
+      // Delays the track so that parallel paths line up at the next mix point.
+      // The first half of its channels delay the signal before the aux sends,
+      //  the second half add the output delay after them. Audio thread only.
+      LatencyCompensator* _latencyComp;
+      unsigned long _sendLatencyDelay;
+      unsigned long _outLatencyDelay;
+      // Gui thread copies of what was last sent to the audio thread.
+      LatencyCompensator* _latencyCompPosted;
+      unsigned long _sendLatencyDelayPosted;
+      unsigned long _outLatencyDelayPosted;
 
       // These two are not the same as the number of track channels which is always either 1 (mono) or 2 (stereo):
       // Total number of output channels.
@@ -521,6 +562,20 @@ class AudioTrack : public Track {
       SndFileR _recFile;
       Fifo fifo;                    // fifo -> _recFile
       bool _processed;
+
+      Fifo _prefetchFifo;           // Filled by AudioPrefetch for wave tracks and frozen tracks.
+      PrefetchState _prefetchState;
+
+      // Freeze. The post-rack output is rendered to _freezeFile once and
+      //  played back instead of getData() and the plugins while _frozen.
+      SndFileR _freezeFile;
+      volatile bool _frozen;
+      // The post-rack output while the freeze file is rendered. Filled by
+      //  the audio thread, written to the file by the prefetch thread only.
+      Fifo _freezeFifo;
+      FreezeState _freezeState;
+
+      bool getFrozenData(unsigned pos, int channels, unsigned nframes, float** bp);
       
    public:
       AudioTrack(TrackType t);
@@ -559,6 +614,10 @@ class AudioTrack : public Track {
       void setRecFile(SndFileR sf)       { _recFile = sf; }
 
       CtrlListList* controller()         { return &_controller; }
+      // Changes whenever anything the track's controls show changes.
+      // The gui need not refresh them while it stays the same.
+      unsigned ctrlGuiSerial() const;
+      void touchCtrlGui() { _ctrlGuiSerial.fetch_add(1, std::memory_order_release); }
       // For setting/getting the _controls 'port' values.
       unsigned long parameters() const { return _controlPorts; }
       
@@ -583,6 +642,32 @@ class AudioTrack : public Track {
       void putFifo(int channels, unsigned long n, float** bp);
       // Transfers the recording fifo to _recFile.
       void record();
+
+      // Reads the freeze file. If overwrite is true, copies the data. If false, adds the data.
+      // Called from the prefetch thread, or the audio thread when freewheeling.
+      virtual void fetchData(unsigned pos, unsigned frames, float** bp, bool doSeek, bool overwrite);
+      void clearPrefetchFifo()      { _prefetchFifo.clear(); }
+      Fifo* prefetchFifo()          { return &_prefetchFifo; }
+      PrefetchState& prefetchState() { return _prefetchState; }
+
+      // Only tracks whose output can be rendered from the song can be frozen.
+      virtual bool canFreeze() const { return false; }
+      bool frozen() const                 { return _frozen; }
+      // Audio thread.
+      void setFrozen(bool f)              { _frozen = f; }
+      SndFileR freezeFile() const         { return _freezeFile; }
+      // Gui thread, only while the track is not frozen.
+      void setFreezeFile(SndFileR sf);
+      // Audio thread, while the freeze file is rendered.
+      void putFreezeData(int channels, unsigned n, float** bp);
+      // Transfers the freeze fifo to the freeze file. Prefetch thread only.
+      void flushFreezeFifo();
+      // Whether all the data put so far is in the file.
+      bool freezeFlushed() const          { return _freezeState.flushed(); }
+      bool freezeOverrun() const          { return _freezeState.overrun(); }
+      // Any thread. Marks the freeze file out of date, see Song::checkFrozenTracks().
+      void setFreezeStale()               { _freezeState.setStale(); }
+      bool freezeStale() const            { return _freezeState.stale(); }
       // Returns the recording fifo current count.
       int recordFifoCount() { return fifo.getCount(); }
 
@@ -607,6 +692,15 @@ class AudioTrack : public Track {
 
       void setPrefader(bool val);
       Pipeline* efxPipe()                { return _efxPipe;  }
+      LatencyCompensator* latencyCompensator() const { return _latencyComp; }
+      // Compensation delays in frames, before the aux sends and in addition after them.
+      unsigned long sendLatencyDelay() const { return _sendLatencyDelay; }
+      unsigned long outLatencyDelay() const { return _outLatencyDelay; }
+      // Audio thread. Returns the compensator that was replaced, if any.
+      LatencyCompensator* setLatencyCompensation(LatencyCompensator* comp, unsigned long sendDelay, unsigned long outDelay);
+      // Gui thread. Asks the audio thread to delay the aux sends by sendDelay
+      //  and the outputs by sendDelay + outDelay frames.
+      void requestLatencyCompensation(unsigned long sendDelay, unsigned long outDelay);
       void deleteAllEfxGuis();
       void clearEfxList();
       // Removes any existing plugin and inserts plugin into effects rack, and calls setupPlugin.
@@ -766,6 +860,8 @@ class AudioGroup : public AudioTrack {
 
 class AudioAux : public AudioTrack {
       float* buffer[MusECore::MAX_CHANNELS];
+      // Guards the send buffers when tracks are processed in parallel.
+      std::atomic_flag _sendBufferLock;
       static bool _isVisible;
       int _index;
    public:
@@ -786,6 +882,8 @@ class AudioAux : public AudioTrack {
                 s._trackChannels._inChannels = 0;
                 return s; }
       float** sendBuffer() { return buffer; }
+      void lockSendBuffer()   { while(_sendBufferLock.test_and_set(std::memory_order_acquire)) ; }
+      void unlockSendBuffer() { _sendBufferLock.clear(std::memory_order_release); }
       static  void setVisible(bool t) { _isVisible = t; }
       virtual int height() const;
       static bool visible() { return _isVisible; }
@@ -799,7 +897,6 @@ class AudioAux : public AudioTrack {
 //---------------------------------------------------------
 
 class WaveTrack : public AudioTrack {
-      Fifo _prefetchFifo;  // prefetch Fifo
       static bool _isVisible;
 
       void internal_assign(const Track&, int flags);
@@ -827,10 +924,9 @@ class WaveTrack : public AudioTrack {
       
       virtual bool getData(unsigned, int ch, unsigned, float** bp);
 
-      void clearPrefetchFifo()      { _prefetchFifo.clear(); }
-      Fifo* prefetchFifo()          { return &_prefetchFifo; }
       virtual void setChannels(int n);
       virtual bool hasAuxSend() const { return true; }
+      virtual bool canFreeze() const { return true; }
       bool canEnableRecord() const;
       virtual bool canRecord() const { return true; }
       virtual bool canRecordMonitor() const { return true; }
@@ -29,12 +29,16 @@
 #include "undo.h"
 #include "song.h"
 #include "globals.h"
+#include "gconfig.h"
 #include "audio.h"  
 #include "operations.h"
 #include "tempo.h"
 #include "part.h"
 #include "audiodev.h"
 #include "track.h"
+#include "ctrl.h"
+#include "midievent.h"
+#include "waveevent.h"
 
 #include <string.h>
 #include <QAction>
@@ -126,18 +130,91 @@ void UndoOp::dump()
       }
 
 //---------------------------------------------------------
-//    clearDelete
+//   eventMemSize
+//    An event base is shared by all handles to it, each
+//     holder is charged its share.
 //---------------------------------------------------------
 
-void UndoList::clearDelete()
+static size_t eventMemSize(const Event& e)
+      {
+      if (e.empty())
+            return 0;
+      size_t sz;
+      if (e.type() == Wave)
+            sz = sizeof(WaveEventBase);
+      else
+            sz = sizeof(MidiEventBase) + e.dataLen();
+      const int refs = e.getRefCount();
+      return refs > 1 ? sz / refs : sz;
+      }
+
+static size_t partMemSize(const Part* part)
+      {
+      const EventList& el = part->events();
+      // Map node with its links and colour.
+      size_t sz = sizeof(*part) + el.size() * (sizeof(EventList::value_type) + 4 * sizeof(void*));
+      for (ciEvent ie = el.begin(); ie != el.end(); ++ie)
+            sz += eventMemSize(ie->second);
+      return sz;
+      }
+
+static size_t ctrlListMemSize(const CtrlList* cl)
+      {
+      if (!cl)
+            return 0;
+      return sizeof(*cl) + cl->size() * (sizeof(CtrlList::value_type) + 4 * sizeof(void*));
+      }
+
+//---------------------------------------------------------
+//   memSize
+//    Estimated bytes this operation keeps alive that are
+//     not in the song, in the undo list or else in the
+//     redo list. Clip changes are kept on disk and are
+//     not counted.
+//---------------------------------------------------------
+
+size_t UndoOp::memSize(bool isUndo) const
+      {
+      size_t sz = sizeof(UndoOp);
+      switch(type) {
+            case DeletePart:
+            case AddPart:
+                  if ((type == DeletePart) == isUndo)
+                        sz += partMemSize(part);
+                  break;
+            case DeleteTrack:
+            case AddTrack:
+                  if (track && (type == DeleteTrack) == isUndo) {
+                        const PartList* pl = track->cparts();
+                        for (ciPart ip = pl->begin(); ip != pl->end(); ++ip)
+                              sz += partMemSize(ip->second);
+                        }
+                  break;
+            case AddEvent:
+            case DeleteEvent:
+            case ModifyEvent:
+            case SelectEvent:
+                  sz += eventMemSize(oEvent) + eventMemSize(nEvent);
+                  break;
+            case ModifyAudioCtrlValList:
+                  sz += ctrlListMemSize(_eraseCtrlList) + ctrlListMemSize(_addCtrlList);
+                  break;
+            default:
+                  break;
+            }
+      return sz;
+      }
+
+//---------------------------------------------------------
+//    deleteOps
+//    Deletes what the operations of one step own, which
+//     is not in the song while the step is in this list.
+//---------------------------------------------------------
+
+void UndoList::deleteOps(Undo& u)
 {
-  if(!empty())
-  {
     if (this->isUndo)
     {
-      for(iUndo iu = begin(); iu != end(); ++iu)
-      {
-        Undo& u = *iu;
         for(iUndoOp i = u.begin(); i != u.end(); ++i)
         {
           switch(i->type)
@@ -175,14 +252,9 @@ void UndoList::clearDelete()
                   break;
           }
         }
-        u.clear();
-      }
     }
     else
     {
-      for(riUndo iu = rbegin(); iu != rend(); ++iu)
-      {
-        Undo& u = *iu;
         for(riUndoOp i = u.rbegin(); i != u.rend(); ++i)
         {
           switch(i->type)
@@ -219,14 +291,81 @@ void UndoList::clearDelete()
                   break;
           }
         }
-        u.clear();
-      }
+    }
+    u.clear();
+    u.memBytes = 0;
+}
+
+//---------------------------------------------------------
+//    clearDelete
+//---------------------------------------------------------
+
+void UndoList::clearDelete()
+{
+  if(!empty())
+  {
+    if (this->isUndo)
+    {
+      for(iUndo iu = begin(); iu != end(); ++iu)
+        deleteOps(*iu);
+    }
+    else
+    {
+      for(riUndo iu = rbegin(); iu != rend(); ++iu)
+        deleteOps(*iu);
     }
   }
 
   clear();
 }
 
+//---------------------------------------------------------
+//    trim
+//    Deletes the oldest steps until the list keeps at most
+//     limit bytes alive. The newest step is always kept.
+//    Returns the number of steps deleted.
+//---------------------------------------------------------
+
+int UndoList::trim(size_t limit)
+{
+  size_t sz = memSize();
+  int n = 0;
+  while(sz > limit && size() > 1)
+  {
+    Undo& u = front();
+    sz -= u.memBytes;
+    deleteOps(u);
+    pop_front();
+    ++n;
+  }
+  return n;
+}
+
+//---------------------------------------------------------
+//    memSize
+//---------------------------------------------------------
+
+size_t UndoList::memSize() const
+{
+  size_t sz = 0;
+  for(std::list<Undo>::const_iterator iu = begin(); iu != end(); ++iu)
+    sz += iu->memBytes;
+  return sz;
+}
+
+//---------------------------------------------------------
+//    updateMemSize
+//    Called whenever a step enters the list, since what it
+//     keeps alive depends on which list it is in.
+//---------------------------------------------------------
+
+void UndoList::updateMemSize(Undo& u) const
+{
+  u.memBytes = 0;
+  for(ciUndoOp i = u.begin(); i != u.end(); ++i)
+    u.memBytes += i->memSize(isUndo);
+}
+
 //---------------------------------------------------------
 //    startUndo
 //---------------------------------------------------------
@@ -263,6 +402,9 @@ void Song::endUndo(SongChangedStruct_t flags)
               if (prev_undo->merge_combo(undoList->back()))
                     undoList->pop_back();
         }
+        undoList->updateMemSize(undoList->back());
+        if (MusEGlobal::config.undoMemoryLimit > 0)
+              undoList->trim(size_t(MusEGlobal::config.undoMemoryLimit) << 20);
       }
       
       // Even if the current list was empty, or emptied during appending of given operations to the current list, 
@@ -314,6 +456,11 @@ void Song::setUndoRedoText()
     }
     MusEGlobal::redoAction->setText(s);
   }
+
+  if(MusEGlobal::undoAction)
+    MusEGlobal::undoAction->setStatusTip(tr("Undo: %1 steps using %2 MB, redo: %3 steps using %4 MB")
+      .arg(undoList->size()).arg(double(undoList->memSize()) / (1024 * 1024), 0, 'f', 1)
+      .arg(redoList->size()).arg(double(redoList->memSize()) / (1024 * 1024), 0, 'f', 1));
 }
 
 void Undo::push_back(const UndoOp& op)
@@ -2469,6 +2616,7 @@ void Song::revertOperationGroup3(Undo& operations)
       fprintf(stderr, "Song::revertOperationGroup3 *** Calling pendingOperations.clear()\n");
 #endif      
       pendingOperations.clear();
+      freezeStale(operations);
       for (riUndoOp i = operations.rbegin(); i != operations.rend(); ++i) {
             Track* editable_track = const_cast<Track*>(i->track);
 // uncomment if needed            Track* editable_property_track = const_cast<Track*>(i->_propertyTrack);
@@ -3249,6 +3397,7 @@ void Song::executeOperationGroup3(Undo& operations)
       fprintf(stderr, "Song::executeOperationGroup3 *** Calling pendingOperations.clear()\n");
 #endif                        
       pendingOperations.clear();
+      freezeStale(operations);
       //bool song_has_changed = !operations.empty();
       for (iUndoOp i = operations.begin(); i != operations.end(); ) {
             Track* editable_track = const_cast<Track*>(i->track);
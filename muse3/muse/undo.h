@@ -139,6 +139,8 @@ struct UndoOp {
       
       const char* typeName();
       void dump();
+      // Estimated bytes kept alive outside the song while in the undo (or redo) list.
+      size_t memSize(bool isUndo) const;
       
       UndoOp();
       // NOTE: In these constructors, if noUndo is set, the operation cannot be undone. It is a 'one time' operation, removed after execution.
@@ -167,9 +169,9 @@ struct UndoOp {
 
 class Undo : public std::list<UndoOp> {
    public:
-      Undo() : std::list<UndoOp>() { combobreaker=false; }
-      Undo(const Undo& other) : std::list<UndoOp>(other) { this->combobreaker=other.combobreaker; }
-      Undo& operator=(const Undo& other) { std::list<UndoOp>::operator=(other); this->combobreaker=other.combobreaker; return *this;}
+      Undo() : std::list<UndoOp>() { combobreaker=false; memBytes=0; }
+      Undo(const Undo& other) : std::list<UndoOp>(other) { this->combobreaker=other.combobreaker; this->memBytes=other.memBytes; }
+      Undo& operator=(const Undo& other) { std::list<UndoOp>::operator=(other); this->combobreaker=other.combobreaker; this->memBytes=other.memBytes; return *this;}
 
       bool empty() const;
       
@@ -178,6 +180,10 @@ class Undo : public std::list<UndoOp> {
        *  Defaults to false */
       bool combobreaker; 
       
+      /** bytes kept alive by the operations, set by
+       *  UndoList::updateMemSize() */
+      size_t memBytes;
+      
       /** is possible, merges itself and other by appending
        *  all contents of other at this->end().
        *  returns true if merged, false otherwise.
@@ -199,8 +205,12 @@ typedef Undo::const_reverse_iterator criUndoOp;
 class UndoList : public std::list<Undo> {
    protected:
       bool isUndo;
+      void deleteOps(Undo& u);
    public:
       void clearDelete();
+      int trim(size_t limit);
+      size_t memSize() const;
+      void updateMemSize(Undo& u) const;
       UndoList(bool _isUndo) : std::list<Undo>() { isUndo=_isUndo; }
 };
 
@@ -70,6 +70,21 @@ extern JackAudioDevice* jackAudio;
 static VstIntPtr currentPluginId = 0;
 static sem_t _vstIdLock;
 
+//---------------------------------------------------------
+//   vstTailFrames
+//    The answer to effGetTailSize: 0 is not known, 1 is no
+//     tail, else the tail in frames.
+//---------------------------------------------------------
+
+static long vstTailFrames(VstIntPtr size)
+{
+      if(size == 0)
+            return -1;
+      if(size == 1)
+            return 0;
+      return size;
+}
+
 //-----------------------------------------------------------------------------------------
 //   vstHostCallback
 //   This must be a function, it cannot be a class method so we dispatch to various objects from here.
@@ -666,6 +681,7 @@ VstNativeSynthIF::VstNativeSynthIF(SynthI* s) : SynthIF(s)
       _active = false;
       _editor = NULL;
       _inProcess = false;
+      _tailSize = -1;
        _controls = NULL;
 //       controlsOut = 0;
       _audioInBuffers = NULL;
@@ -2980,6 +2996,7 @@ void VstNativeSynthIF::activate()
   //dispatch(i, effStartProcess, 0, 0, NULL, 0.0f);
   dispatch(effStartProcess, 0, 0, NULL, 0.0f);
 #endif
+  _tailSize = vstTailFrames(dispatch(52 /*effGetTailSize*/, 0, 0, NULL, 0.0f));
   //}
 
 // REMOVE Tim. Or keep? From PluginI::activate().
@@ -3250,6 +3267,7 @@ void VstNativePluginWrapper::activate(LADSPA_Handle handle)
    //        dispatch(i, effMainsChanged, 0, 1, NULL, 0.0f);
    dispatch(state, effMainsChanged, 0, 1, NULL, 0.0f);
    dispatch(state, 71 /*effStartProcess*/, 0, 0, NULL, 0.0f);
+   state->tailSize = vstTailFrames(dispatch(state, 52 /*effGetTailSize*/, 0, 0, NULL, 0.0f));
 
    if(state->plugin->getParameter)
    {
@@ -3314,6 +3332,11 @@ void VstNativePluginWrapper::connectPort(LADSPA_Handle handle, unsigned long por
 
 }
 
+long VstNativePluginWrapper::tailFrames(LADSPA_Handle handle) const
+{
+   return ((VstNativePluginWrapper_State *)handle)->tailSize;
+}
+
 void VstNativePluginWrapper::apply(LADSPA_Handle handle, unsigned long n)
 {
    VstNativePluginWrapper_State *state = (VstNativePluginWrapper_State *)handle;
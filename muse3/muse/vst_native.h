@@ -191,6 +191,7 @@ class VstNativeSynthIF : public SynthIF
       MusEGui::VstNativeEditor* _editor;
       bool _guiVisible;
       bool _inProcess; // To inform the callback of the 'process level' - are we in the audio thread?
+      long _tailSize;  // Asked on activation, see PluginIBase::tailFrames().
 
       // Struct array to keep track of pressed flags and so on. // TODO: Not used yet. REMOVE Tim. Or keep.
       VstNativeGuiWidgets* _gw;
@@ -235,6 +236,7 @@ class VstNativeSynthIF : public SynthIF
       virtual bool getData(MidiPort*, unsigned pos, int ports, unsigned nframes, float** buffer) ;
       virtual MidiPlayEvent receiveEvent();
       virtual int eventsPending() const { return 0; }
+      virtual long tailFrames() const { return _tailSize; }
       virtual int channels() const;
       virtual int totalOutChannels() const;
       virtual int totalInChannels() const;
@@ -291,6 +293,7 @@ public:
    bool guiVisible;
    bool inProcess;
    bool active;
+   long tailSize;   // Asked on activation, see Plugin::tailFrames().
    VstNativePluginWrapper_State()
    {
       plugin = 0;
@@ -302,6 +305,7 @@ public:
       userData.pstate = this;
       inProcess = false;
       active = false;
+      tailSize = -1;
    }
    virtual ~VstNativePluginWrapper_State() {}
    void editorDeleted()
@@ -344,6 +348,7 @@ public:
     virtual void cleanup ( LADSPA_Handle handle );
     virtual void connectPort ( LADSPA_Handle handle, unsigned long port, float *value );
     virtual void apply ( LADSPA_Handle handle, unsigned long n );
+    virtual long tailFrames ( LADSPA_Handle handle ) const;
     virtual LADSPA_PortDescriptor portd ( unsigned long k ) const;
 
     virtual LADSPA_PortRangeHint range ( unsigned long i );
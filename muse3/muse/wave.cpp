@@ -35,6 +35,9 @@
 #include "xml.h"
 #include "song.h"
 #include "wave.h"
+#include "peakfile.h"
+#include "peakbuilder.h"
+#include "wavecache.h"
 #include "app.h"
 #include "filedialog.h"
 #include "arranger/arranger.h"
@@ -53,7 +56,7 @@
 
 namespace MusECore {
 
-const int cacheMag = 128;
+const int cacheMag = PeakFile::BASE_MAG;
 
 
 SndFileList SndFile::sndFiles;
@@ -67,13 +70,15 @@ SndFile::SndFile(const QString& name)
       finfo = new QFileInfo(name);
       sf    = 0;
       sfUI  = 0;
-      csize = 0;
-      cache = 0;
+      peaks = 0;
       openFlag = false;
       sndFiles.push_back(this);
       refCount=0;
       writeBuffer = 0;
       writeSegSize = std::max((size_t)MusEGlobal::segmentSize, (size_t)cacheMag);// cache minimum segment size for write operations
+      readBuffer = 0;
+      readBufferSize = 0;
+      pthread_mutex_init(&readLock, 0);
       }
 
 SndFile::~SndFile()
@@ -88,15 +93,20 @@ SndFile::~SndFile()
                   }
             }
       delete finfo;
-      if (cache) {
-            delete[] cache;
-            cache = 0;
+      if (peaks) {
+            if (MusEGlobal::peakBuilder)
+                  MusEGlobal::peakBuilder->cancel(peaks);
+            delete peaks;
+            peaks = 0;
             }
       if(writeBuffer) {
          delete [] writeBuffer;
           writeBuffer = 0;
       }
-
+      if (MusEGlobal::waveCache)
+            MusEGlobal::waveCache->invalidate(this);
+      delete [] readBuffer;
+      pthread_mutex_destroy(&readLock);
       }
 
 //---------------------------------------------------------
@@ -127,10 +137,8 @@ bool SndFile::openRead(bool createCache, bool showProgress)
 
       writeFlag = false;
       openFlag  = true;
-      if (createCache) {
-        QString cacheName = finfo->absolutePath() + QString("/") + finfo->completeBaseName() + QString(".wca");
-        readCache(cacheName, showProgress);
-      }
+      if (createCache)
+        readCache(cacheName(), showProgress);
       return false;
       }
 
@@ -144,117 +152,91 @@ void SndFile::update(bool showProgress)
       close();
 
       // force recreation of wca data
-      QString cacheName = finfo->absolutePath() +
-         QString("/") + finfo->completeBaseName() + QString(".wca");
-      ::remove(cacheName.toLocal8Bit().constData());
+      ::remove(cacheName().toLocal8Bit().constData());
       if (openRead(true, showProgress)) {
             printf("SndFile::update openRead(%s) failed: %s\n", path().toLocal8Bit().constData(), strerror().toLocal8Bit().constData());
             }
       }
 
+//---------------------------------------------------------
+//   cacheName
+//---------------------------------------------------------
+
+QString SndFile::cacheName() const
+      {
+      return finfo->absolutePath() + QString("/") + finfo->completeBaseName() + QString(".wca");
+      }
+
+//---------------------------------------------------------
+//   cacheProgress
+//---------------------------------------------------------
+
+static bool cacheProgress(void* arg, sf_count_t done, sf_count_t total)
+      {
+      QProgressDialog* progress = (QProgressDialog*)arg;
+      if (progress)
+            progress->setValue(int(done * 100 / total));
+      return true;
+      }
+
 //---------------------------------------------------
 //  create cache
 //---------------------------------------------------
 
-void SndFile::createCache(const QString& path, bool showProgress, bool bWrite, sf_count_t cstart)
+void SndFile::createCache(const QString& path, bool showProgress)
 {
-   if(cstart >= csize)
-      return;
+   if (!peaks)
+      peaks = new PeakFile();
+   else if (MusEGlobal::peakBuilder)
+      MusEGlobal::peakBuilder->cancel(peaks);
    QProgressDialog* progress = 0;
    if (showProgress) {
       QString label(QWidget::tr("create peakfile for "));
       label += basename();
       progress = new QProgressDialog(label,
-                                     QString::null, 0, csize, 0);
+                                     QString::null, 0, 100, 0);
       progress->setMinimumDuration(0);
       progress->show();
    }
-   float data[channels()][cacheMag];
-   float* fp[channels()];
-   for (unsigned k = 0; k < channels(); ++k)
-      fp[k] = &data[k][0];
-   int interval = (csize - cstart) / 10;
-
-   if(!interval)
-      interval = 1;
-   for (int i = cstart; i < csize; i++) {
-      if (showProgress && ((i % interval) == 0))
-         progress->setValue(i);
-      seek(i * cacheMag, 0);
-      read(channels(), fp, cacheMag);
-      for (unsigned ch = 0; ch < channels(); ++ch) {
-         float rms = 0.0;
-         cache[ch][i].peak = 0;
-         for (int n = 0; n < cacheMag; n++) {
-            float fd = data[ch][n];
-            rms += fd * fd;
-            int idata = int(fd * 255.0);
-            if (idata < 0)
-               idata = -idata;
-            if (cache[ch][i].peak < idata)
-               cache[ch][i].peak = idata;
-         }
-         // amplify rms value +12dB
-         int rmsValue = int((sqrt(rms/cacheMag) * 255.0));
-         if (rmsValue > 255)
-            rmsValue = 255;
-         cache[ch][i].rms = rmsValue;
-      }
-   }
-   if (showProgress)
-      progress->setValue(csize);
-   if(bWrite)
-      writeCache(path);
-   if (showProgress)
+   if (!peaks->build(path, finfo->filePath(), cacheProgress, progress))
+      fprintf(stderr, "SndFile::createCache: cannot create peak file for %s\n", path.toLocal8Bit().constData());
+   if (showProgress) {
+      progress->setValue(100);
       delete progress;
-
+   }
 }
 
 //---------------------------------------------------------
 //   readCache
+//    map the peak file, rebuild it if missing or out of date
+//    The rebuild is done in the background if possible,
+//     drawing shows what is ready in the meantime.
 //---------------------------------------------------------
 
 void SndFile::readCache(const QString& path, bool showProgress)
 {
-   if (cache) {
-      delete[] cache;
+   if (!peaks)
+      peaks = new PeakFile();
+   else {
+      if (MusEGlobal::peakBuilder)
+         MusEGlobal::peakBuilder->cancel(peaks);
+      peaks->close();
    }
-   if (samples() == 0)
+   const sf_count_t frames = samples();
+   if (frames == 0)
       return;
-
-   csize = (samples() + cacheMag - 1)/cacheMag;
-   cache = new SampleVtype[channels()];
-   for (unsigned ch = 0; ch < channels(); ++ch)
-   {
-      cache [ch].resize(csize);
-   }
-
-   FILE* cfile = fopen(path.toLocal8Bit().constData(), "r");
-   if (cfile) {
-      for (unsigned ch = 0; ch < channels(); ++ch)
-         fread(&cache[ch] [0], csize * sizeof(SampleV), 1, cfile);
-      fclose(cfile);
+   if (peaks->open(path, finfo->filePath(), channels(), frames))
+      return;
+   if (MusEGlobal::peakBuilder && MusEGlobal::peakBuilder->isRunning()) {
+      if (peaks->create(path, finfo->filePath()))
+         MusEGlobal::peakBuilder->add(peaks);
+      else
+         fprintf(stderr, "SndFile::readCache: cannot create peak file for %s\n", path.toLocal8Bit().constData());
       return;
    }
-
-
-   createCache(path, showProgress, true);
+   createCache(path, showProgress);
 }
 
-//---------------------------------------------------------
-//   writeCache
-//---------------------------------------------------------
-
-void SndFile::writeCache(const QString& path)
-      {
-      FILE* cfile = fopen(path.toLocal8Bit().constData(), "w");
-      if (cfile == 0)
-            return;
-      for (unsigned ch = 0; ch < channels(); ++ch)
-            fwrite(&cache[ch] [0], csize * sizeof(SampleV), 1, cfile);
-      fclose(cfile);
-      }
-
 //---------------------------------------------------------
 //   read
 //---------------------------------------------------------
@@ -342,29 +324,8 @@ void SndFile::read(SampleV* s, int mag, unsigned pos, bool overwrite, bool allow
                     s[ch].rms = 0;    // TODO rms / mag;
                   }
             }
-      else {
-            mag /= cacheMag;
-            int rest = csize - (pos/cacheMag);
-            int end  = mag;
-            if (rest < mag)
-                  end = rest;
-
-            for (unsigned ch = 0; ch < channels(); ++ch) {
-                  int rms = 0;
-                  int off = pos/cacheMag;
-                  for (int offset = off; offset < off+end; offset++) {
-                        rms += cache[ch][offset].rms;
-                        if (s[ch].peak < cache[ch][offset].peak)
-                              s[ch].peak = cache[ch][offset].peak;
-                              }
-
-                  if(overwrite)
-                    s[ch].rms = rms / mag;
-
-                  else
-                    s[ch].rms += rms / mag;
-                  }
-            }
+      else if (peaks)
+            peaks->read(s, channels(), mag, pos, overwrite);
       }
 
 //---------------------------------------------------------
@@ -387,9 +348,9 @@ bool SndFile::openWrite()
             writeBuffer = new float [writeSegSize * std::max(2, sfinfo.channels)];
             openFlag  = true;
             writeFlag = true;
-            QString cacheName = finfo->absolutePath() +
-               QString("/") + finfo->completeBaseName() + QString(".wca");
-            readCache(cacheName, true);
+            if (MusEGlobal::waveCache)
+                  MusEGlobal::waveCache->invalidate(this);
+            readCache(cacheName(), true);
             }
       return sf == 0;
       }
@@ -416,6 +377,8 @@ void SndFile::close()
               sfUI = 0;
       }
       openFlag = false;
+      if (MusEGlobal::waveCache)
+            MusEGlobal::waveCache->invalidate(this);
       }
 
 //---------------------------------------------------------
@@ -517,52 +480,44 @@ size_t SndFile::readWithHeap(int srcChannels, float** dst, size_t n, bool overwr
       }
 
 //---------------------------------------------------------
-//   read
+//   copyFrames
+//    Deinterleaves n frames of a fileChannels wide buffer
+//    into dst[][offs...], converting mono <-> stereo.
 //---------------------------------------------------------
-size_t SndFile::read(int srcChannels, float** dst, size_t n, bool overwrite)
-      {
-      float buffer[n * sfinfo.channels];
-      int rn = readInternal(srcChannels,dst,n,overwrite, buffer);
-      return rn;
-      }
 
-size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer)
+static void copyFrames(const float* src, int fileChannels, int dstChannels, float** dst, size_t offs, size_t n, bool overwrite)
 {
-      size_t rn = sf_readf_float(sf, buffer, n);
-
-      float* src      = buffer;
-      int dstChannels = sfinfo.channels;
-      if (srcChannels == dstChannels) {
+      if (dstChannels == fileChannels) {
             if(overwrite)
-              for (size_t i = 0; i < rn; ++i) {
-                  for (int ch = 0; ch < srcChannels; ++ch)
+              for (size_t i = offs; i < offs + n; ++i) {
+                  for (int ch = 0; ch < dstChannels; ++ch)
                         *(dst[ch]+i) = *src++;
                   }
               else
-              for (size_t i = 0; i < rn; ++i) {
-                  for (int ch = 0; ch < srcChannels; ++ch)
+              for (size_t i = offs; i < offs + n; ++i) {
+                  for (int ch = 0; ch < dstChannels; ++ch)
                         *(dst[ch]+i) += *src++;
                   }
             }
-      else if ((srcChannels == 1) && (dstChannels == 2)) {
+      else if ((dstChannels == 1) && (fileChannels == 2)) {
             // stereo to mono
             if(overwrite)
-              for (size_t i = 0; i < rn; ++i)
-                  *(dst[0] + i) = src[i + i] + src[i + i + 1];
+              for (size_t i = 0; i < n; ++i)
+                  *(dst[0] + offs + i) = src[i + i] + src[i + i + 1];
             else
-              for (size_t i = 0; i < rn; ++i)
-                  *(dst[0] + i) += src[i + i] + src[i + i + 1];
+              for (size_t i = 0; i < n; ++i)
+                  *(dst[0] + offs + i) += src[i + i] + src[i + i + 1];
             }
-      else if ((srcChannels == 2) && (dstChannels == 1)) {
+      else if ((dstChannels == 2) && (fileChannels == 1)) {
             // mono to stereo
             if(overwrite)
-              for (size_t i = 0; i < rn; ++i) {
+              for (size_t i = offs; i < offs + n; ++i) {
                   float data = *src++;
                   *(dst[0]+i) = data;
                   *(dst[1]+i) = data;
                   }
             else
-              for (size_t i = 0; i < rn; ++i) {
+              for (size_t i = offs; i < offs + n; ++i) {
                   float data = *src++;
                   *(dst[0]+i) += data;
                   *(dst[1]+i) += data;
@@ -570,13 +525,107 @@ size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwr
             }
       else {
             printf("SndFile:read channel mismatch %d -> %d\n",
-               srcChannels, dstChannels);
+               dstChannels, fileChannels);
+            }
+}
+
+//---------------------------------------------------------
+//   readScratch
+//    Interleaved buffer for n frames. It only grows, so
+//    after the first few cycles reading does not allocate.
+//    Call with readLock held.
+//---------------------------------------------------------
+
+float* SndFile::readScratch(size_t n)
+      {
+      const size_t size = n * sfinfo.channels;
+      if (size > readBufferSize) {
+            delete [] readBuffer;
+            readBuffer     = new float[size];
+            readBufferSize = size;
             }
+      return readBuffer;
+      }
 
+//---------------------------------------------------------
+//   read
+//---------------------------------------------------------
+size_t SndFile::read(int srcChannels, float** dst, size_t n, bool overwrite)
+      {
+      pthread_mutex_lock(&readLock);
+      int rn = readInternal(srcChannels,dst,n,overwrite, readScratch(n));
+      pthread_mutex_unlock(&readLock);
       return rn;
+      }
 
+size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, size_t offs)
+{
+      sf_count_t rn = sf_readf_float(sf, buffer, n);
+      if (rn <= 0)
+            return 0;
+      copyFrames(buffer, sfinfo.channels, srcChannels, dst, offs, rn, overwrite);
+      return rn;
 }
 
+//---------------------------------------------------------
+//   readAt
+//    Reads n frames starting at frame pos. Decoded blocks
+//    are kept in the shared wave block cache, so looped or
+//    cloned material is only read from disk once. Files
+//    being written to bypass the cache.
+//---------------------------------------------------------
+
+size_t SndFile::readAt(sf_count_t pos, int srcChannels, float** dst, size_t n, bool overwrite)
+      {
+      WaveBlockCache* cache = MusEGlobal::waveCache;
+      if (!cache || !cache->isEnabled() || writeFlag) {
+            pthread_mutex_lock(&readLock);
+            size_t rn = 0;
+            if (sf_seek(sf, pos, SEEK_SET | SFM_READ) != -1)
+                  rn = readInternal(srcChannels, dst, n, overwrite, readScratch(n));
+            pthread_mutex_unlock(&readLock);
+            return rn;
+            }
+
+      const int fileChannels = sfinfo.channels;
+      const sf_count_t bf    = WaveBlockCache::blockFrames(fileChannels);
+      size_t done            = 0;
+
+      pthread_mutex_lock(&readLock);
+      while (done < n) {
+            const sf_count_t p   = pos + done;
+            const sf_count_t bi  = p / bf;
+            const sf_count_t off = p - bi * bf;
+            bool hit;
+            int handle;
+            float* block = cache->acquire(this, bi, &hit, &handle);
+            if (!block) {
+                  // Every block is in use, read around the cache.
+                  if (sf_seek(sf, p, SEEK_SET | SFM_READ) != -1)
+                        done += readInternal(srcChannels, dst, n - done, overwrite, readScratch(n - done), done);
+                  break;
+                  }
+            if (!hit) {
+                  sf_count_t rn = 0;
+                  if (sf_seek(sf, bi * bf, SEEK_SET | SFM_READ) != -1)
+                        rn = sf_readf_float(sf, block, bf);
+                  cache->setFrames(handle, rn > 0 ? rn : 0);
+                  }
+            const sf_count_t avail = cache->frames(handle) - off;
+            if (avail <= 0) {
+                  // Past the end of file. Keep a valid last block.
+                  cache->release(handle, cache->frames(handle) == 0);
+                  break;
+                  }
+            const size_t cn = std::min(size_t(avail), n - done);
+            copyFrames(block + off * fileChannels, fileChannels, srcChannels, dst, done, cn, overwrite);
+            cache->release(handle);
+            done += cn;
+            }
+      pthread_mutex_unlock(&readLock);
+      return done;
+      }
+
 
 //---------------------------------------------------------
 //   write
@@ -661,44 +710,11 @@ size_t SndFile::realWrite(int srcChannels, float** src, size_t n, size_t offs)
 
    if(MusEGlobal::config.liveWaveUpdate)
    { //update cache
-      if(!cache)
-      {
-         cache = new SampleVtype[sfinfo.channels];
-         csize = 0;
-      }
-      sf_count_t cstart = (sfinfo.frames + cacheMag - 1) / cacheMag;
+      if(!peaks)
+         peaks = new PeakFile();
       sfinfo.frames += n;
-      csize = (sfinfo.frames + cacheMag - 1) / cacheMag;
-      for (int ch = 0; ch < sfinfo.channels; ++ch)
-      {
-         cache [ch].resize(csize);
-      }
-
-      for (int i = cstart; i < csize; i++)
-      {
-         for (int ch = 0; ch < sfinfo.channels; ++ch)
-         {
-            float rms = 0.0;
-            cache[ch][i].peak = 0;
-            for (int n = 0; n < cacheMag; n++)
-            {
-               //float fd = data[ch][n];
-               float fd = writeBuffer [n * sfinfo.channels + ch];
-               rms += fd * fd;
-               int idata = int(fd * 255.0);
-               if (idata < 0)
-                  idata = -idata;
-               if (cache[ch][i].peak < idata)
-                  cache[ch][i].peak = idata;
-            }
-            // amplify rms value +12dB
-            int rmsValue = int((sqrt(rms/cacheMag) * 255.0));
-            if (rmsValue > 255)
-               rmsValue = 255;
-            cache[ch][i].rms = rmsValue;
-         }
-      }
-
+      if(!peaks->isBuilding())
+         peaks->appendLive(writeBuffer, sfinfo.channels, n);
    }
 
    return nbr;
@@ -779,7 +795,7 @@ SndFileR getWave(const QString& inName, bool readOnlyFlag, bool openFlag, bool s
                     error = f->openWrite();
                     // if peak cache is older than wave file we reaquire the cache
                     QFileInfo wavinfo(name);
-                    QString cacheName = wavinfo.absolutePath() + QString("/") + wavinfo.completeBaseName() + QString(".wca");
+                    QString cacheName = f->cacheName();
                     QFileInfo wcainfo(cacheName);
                     if (!wcainfo.exists() || wcainfo.lastModified() < wavinfo.lastModified()) {
                           QFile(cacheName).remove();
@@ -1040,8 +1056,7 @@ void ClipBase::read(unsigned srcOffset, float** buffer, int channel, unsigned n)
       {
       if (f.isNull())
             return;
-      f.seek(srcOffset + _spos, 0);
-      f.read(channel, buffer, n);
+      f.readAt(srcOffset + _spos, channel, buffer, n);
       }
 
 ClipBase::~ClipBase()
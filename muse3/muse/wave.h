@@ -24,6 +24,7 @@
 #ifndef __WAVE_H__
 #define __WAVE_H__
 
+#include <pthread.h>
 #include <list>
 #include <vector>
 #include <sndfile.h>
@@ -35,6 +36,7 @@ class QFileInfo;
 namespace MusECore {
 
 class Event;
+class PeakFile;
 
 class Xml;
 
@@ -61,17 +63,19 @@ class SndFile {
       SNDFILE* sf;
       SNDFILE* sfUI;
       SF_INFO sfinfo;
-      SampleVtype* cache;
-      sf_count_t csize;                    //!< frames in cache
+      PeakFile* peaks;
 
       float *writeBuffer;
       size_t writeSegSize;
 
-      void writeCache(const QString& path);
+      float *readBuffer;      // Interleaved scratch of read(), grown on demand.
+      size_t readBufferSize;
+      pthread_mutex_t readLock; // Serializes reads, files are shared by clone parts.
 
       bool openFlag;
       bool writeFlag;
-      size_t readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer);
+      float* readScratch(size_t n);
+      size_t readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, size_t offs = 0);
       size_t realWrite(int channel, float**, size_t n, size_t offs = 0);
       
    protected:
@@ -85,8 +89,9 @@ class SndFile {
       static SndFileList sndFiles;
       static void applyUndoFile(const Event& original, const QString* tmpfile, unsigned sx, unsigned ex);
 
-      void createCache(const QString& path, bool showProgress, bool bWrite, sf_count_t cstart = 0);
+      void createCache(const QString& path, bool showProgress);
       void readCache(const QString& path, bool progress);
+      QString cacheName() const;    //!< path of the peak file
 
       bool openRead(bool createCache=true, bool showProgress=true);        //!< returns true on error
       bool openWrite();       //!< returns true on error
@@ -114,6 +119,8 @@ class SndFile {
 
       size_t read(int channel, float**, size_t, bool overwrite = true);
       size_t readWithHeap(int channel, float**, size_t, bool overwrite = true);
+      // Reads n frames at pos through the shared wave block cache.
+      size_t readAt(sf_count_t pos, int channel, float**, size_t n, bool overwrite = true);
       size_t readDirect(float* buf, size_t n)    { return sf_readf_float(sf, buf, n); }
       size_t write(int channel, float**, size_t);
       size_t writeDirect(float *buf, size_t n) { return sf_writef_float(sf, buf, n); }
@@ -181,6 +188,9 @@ class SndFileR {
       size_t read(int channel, float** f, size_t n, bool overwrite = true) {
             return sf ? sf->read(channel, f, n, overwrite) : 0;
             }
+      size_t readAt(sf_count_t pos, int channel, float** f, size_t n, bool overwrite = true) {
+            return sf ? sf->readAt(pos, channel, f, n, overwrite) : 0;
+            }
       size_t readDirect(float* f, size_t n) { return sf ? sf->readDirect(f, n) : 0; }  
       
       size_t write(int channel, float** f, size_t n) {
@@ -0,0 +1,321 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  wavecache.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wavecache.h"
+#include "gconfig.h"
+
+namespace MusEGlobal {
+MusECore::WaveBlockCache* waveCache = NULL;
+}
+
+namespace MusECore {
+
+void initWaveCache()
+{
+  MusEGlobal::waveCache = new WaveBlockCache(MusEGlobal::config.waveCacheSize);
+}
+
+//---------------------------------------------------------
+//   WaveBlockCache
+//---------------------------------------------------------
+
+WaveBlockCache::WaveBlockCache(size_t megabytes)
+      {
+      pthread_mutex_init(&_lock, 0);
+      _data       = 0;
+      _blocks     = 0;
+      _buckets    = 0;
+      _bucketMask = 0;
+      _head       = -1;
+      _tail       = -1;
+      _free       = -1;
+      _count      = megabytes * 1024 * 1024 / BLOCK_BYTES;
+      resetStats();
+      if (_count <= 0) {
+            _count = 0;
+            return;
+            }
+      if (posix_memalign((void**)&_data, 16, _count * BLOCK_BYTES) != 0) {
+            fprintf(stderr, "WaveBlockCache: cannot allocate %lu MB, cache disabled\n", (unsigned long)megabytes);
+            _data  = 0;
+            _count = 0;
+            return;
+            }
+      _blocks = new Block[_count];
+      for (int i = 0; i < _count; ++i) {
+            Block& b = _blocks[i];
+            b.file   = 0;
+            b.index  = 0;
+            b.frames = 0;
+            b.pins   = 0;
+            b.stale  = false;
+            b.prev   = -1;
+            b.next   = i + 1 < _count ? i + 1 : -1;
+            b.chain  = -1;
+            }
+      _free = 0;
+
+      unsigned buckets = 1;
+      while (buckets < unsigned(_count) * 2)
+            buckets <<= 1;
+      _bucketMask = buckets - 1;
+      _buckets    = new int[buckets];
+      for (unsigned i = 0; i < buckets; ++i)
+            _buckets[i] = -1;
+      }
+
+WaveBlockCache::~WaveBlockCache()
+      {
+      delete[] _buckets;
+      delete[] _blocks;
+      free(_data);
+      pthread_mutex_destroy(&_lock);
+      }
+
+//---------------------------------------------------------
+//   bucket
+//---------------------------------------------------------
+
+unsigned WaveBlockCache::bucket(const SndFile* f, sf_count_t index) const
+      {
+      uint64_t h = (uint64_t(uintptr_t(f)) >> 4) ^ (uint64_t(index) * 0x9E3779B97F4A7C15ULL);
+      h ^= h >> 29;
+      return unsigned(h) & _bucketMask;
+      }
+
+//---------------------------------------------------------
+//   find
+//---------------------------------------------------------
+
+int WaveBlockCache::find(const SndFile* f, sf_count_t index) const
+      {
+      for (int i = _buckets[bucket(f, index)]; i != -1; i = _blocks[i].chain)
+            if (_blocks[i].file == f && _blocks[i].index == index)
+                  return i;
+      return -1;
+      }
+
+//---------------------------------------------------------
+//   hashInsert
+//---------------------------------------------------------
+
+void WaveBlockCache::hashInsert(int i)
+      {
+      int& head = _buckets[bucket(_blocks[i].file, _blocks[i].index)];
+      _blocks[i].chain = head;
+      head = i;
+      }
+
+//---------------------------------------------------------
+//   hashRemove
+//---------------------------------------------------------
+
+void WaveBlockCache::hashRemove(int i)
+      {
+      int* p = &_buckets[bucket(_blocks[i].file, _blocks[i].index)];
+      while (*p != -1) {
+            if (*p == i) {
+                  *p = _blocks[i].chain;
+                  break;
+                  }
+            p = &_blocks[*p].chain;
+            }
+      _blocks[i].chain = -1;
+      }
+
+//---------------------------------------------------------
+//   lruUnlink
+//---------------------------------------------------------
+
+void WaveBlockCache::lruUnlink(int i)
+      {
+      Block& b = _blocks[i];
+      if (b.prev != -1)
+            _blocks[b.prev].next = b.next;
+      else
+            _head = b.next;
+      if (b.next != -1)
+            _blocks[b.next].prev = b.prev;
+      else
+            _tail = b.prev;
+      b.prev = -1;
+      b.next = -1;
+      }
+
+//---------------------------------------------------------
+//   lruPushFront
+//---------------------------------------------------------
+
+void WaveBlockCache::lruPushFront(int i)
+      {
+      Block& b = _blocks[i];
+      b.prev = -1;
+      b.next = _head;
+      if (_head != -1)
+            _blocks[_head].prev = i;
+      _head = i;
+      if (_tail == -1)
+            _tail = i;
+      }
+
+//---------------------------------------------------------
+//   freeBlock
+//    Removes an unpinned block from the hash and LRU list.
+//---------------------------------------------------------
+
+void WaveBlockCache::freeBlock(int i)
+      {
+      hashRemove(i);
+      lruUnlink(i);
+      Block& b = _blocks[i];
+      b.file   = 0;
+      b.frames = 0;
+      b.stale  = false;
+      b.next   = _free;
+      _free    = i;
+      }
+
+//---------------------------------------------------------
+//   victim
+//    A free block, or the least recently used unpinned one.
+//---------------------------------------------------------
+
+int WaveBlockCache::victim()
+      {
+      if (_free != -1) {
+            const int i = _free;
+            _free = _blocks[i].next;
+            _blocks[i].next = -1;
+            return i;
+            }
+      for (int i = _tail; i != -1; i = _blocks[i].prev) {
+            if (_blocks[i].pins == 0) {
+                  hashRemove(i);
+                  lruUnlink(i);
+                  return i;
+                  }
+            }
+      return -1;
+      }
+
+//---------------------------------------------------------
+//   acquire
+//---------------------------------------------------------
+
+float* WaveBlockCache::acquire(const SndFile* f, sf_count_t index, bool* hit, int* handle)
+      {
+      if (!_count)
+            return 0;
+      pthread_mutex_lock(&_lock);
+      int i = find(f, index);
+      if (i != -1) {
+            ++_hits;
+            ++_blocks[i].pins;
+            lruUnlink(i);
+            lruPushFront(i);
+            *hit = true;
+            }
+      else {
+            ++_misses;
+            i = victim();
+            if (i == -1) {
+                  pthread_mutex_unlock(&_lock);
+                  return 0;
+                  }
+            Block& b = _blocks[i];
+            b.file   = f;
+            b.index  = index;
+            b.frames = 0;
+            b.pins   = 1;
+            b.stale  = false;
+            hashInsert(i);
+            lruPushFront(i);
+            *hit = false;
+            }
+      pthread_mutex_unlock(&_lock);
+      *handle = i;
+      return _data + size_t(i) * (BLOCK_BYTES / sizeof(float));
+      }
+
+//---------------------------------------------------------
+//   release
+//---------------------------------------------------------
+
+void WaveBlockCache::release(int handle, bool drop)
+      {
+      pthread_mutex_lock(&_lock);
+      Block& b = _blocks[handle];
+      if (--b.pins == 0 && (drop || b.stale))
+            freeBlock(handle);
+      pthread_mutex_unlock(&_lock);
+      }
+
+//---------------------------------------------------------
+//   invalidate
+//---------------------------------------------------------
+
+void WaveBlockCache::invalidate(const SndFile* f)
+      {
+      if (!_count)
+            return;
+      pthread_mutex_lock(&_lock);
+      for (int i = 0; i < _count; ++i) {
+            Block& b = _blocks[i];
+            if (b.file != f)
+                  continue;
+            if (b.pins)
+                  b.stale = true;
+            else
+                  freeBlock(i);
+            }
+      pthread_mutex_unlock(&_lock);
+      }
+
+//---------------------------------------------------------
+//   resetStats
+//---------------------------------------------------------
+
+void WaveBlockCache::resetStats()
+      {
+      _hits   = 0;
+      _misses = 0;
+      }
+
+//---------------------------------------------------------
+//   printStats
+//---------------------------------------------------------
+
+void WaveBlockCache::printStats() const
+      {
+      const uint64_t total = _hits + _misses;
+      if (!total)
+            return;
+      fprintf(stderr, "WaveBlockCache: %d blocks of %lu kB, %lu hits, %lu misses, hit rate %.1f%%\n",
+              _count, (unsigned long)(BLOCK_BYTES / 1024), (unsigned long)_hits, (unsigned long)_misses,
+              100.0 * double(_hits) / double(total));
+      }
+
+} // namespace MusECore
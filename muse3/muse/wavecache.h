@@ -0,0 +1,110 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  wavecache.h
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+#ifndef __WAVECACHE_H__
+#define __WAVECACHE_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sndfile.h>
+
+namespace MusECore {
+
+class SndFile;
+
+//---------------------------------------------------------
+//   WaveBlockCache
+//    Decoded samples of wave files, in blocks of BLOCK_BYTES
+//     as read from libsndfile (interleaved), shared by all
+//     files and evicted least recently used first.
+//    All memory is allocated up front, so reading through
+//     the cache does not allocate.
+//---------------------------------------------------------
+
+class WaveBlockCache {
+   public:
+      static const size_t BLOCK_BYTES = 128 * 1024;
+
+   private:
+      struct Block {
+            const SndFile* file;     // Zero if free.
+            sf_count_t index;
+            sf_count_t frames;       // Valid frames, set by the loader.
+            int pins;
+            bool stale;              // Invalidated while pinned.
+            int prev;                // LRU list, most recent first.
+            int next;                //  Also links the free list.
+            int chain;               // Hash bucket chain.
+            };
+
+      float* _data;
+      Block* _blocks;
+      int _count;
+      int* _buckets;
+      unsigned _bucketMask;
+      int _head;
+      int _tail;
+      int _free;
+      pthread_mutex_t _lock;
+      uint64_t _hits;
+      uint64_t _misses;
+
+      unsigned bucket(const SndFile* f, sf_count_t index) const;
+      int find(const SndFile* f, sf_count_t index) const;
+      void hashInsert(int i);
+      void hashRemove(int i);
+      void lruUnlink(int i);
+      void lruPushFront(int i);
+      void freeBlock(int i);
+      int victim();
+
+   public:
+      WaveBlockCache(size_t megabytes);
+      ~WaveBlockCache();
+
+      bool isEnabled() const { return _count > 0; }
+      static sf_count_t blockFrames(int channels) { return BLOCK_BYTES / (sizeof(float) * channels); }
+
+      // Returns the pinned block 'index' of 'f', or zero if every block is pinned.
+      // On a miss (*hit false) the caller fills the block and calls setFrames().
+      float* acquire(const SndFile* f, sf_count_t index, bool* hit, int* handle);
+      void setFrames(int handle, sf_count_t frames) { _blocks[handle].frames = frames; }
+      sf_count_t frames(int handle) const           { return _blocks[handle].frames; }
+      void release(int handle, bool drop = false);
+      // Drops all blocks of 'f'. Call when the file changes or is closed.
+      void invalidate(const SndFile* f);
+
+      uint64_t hits() const   { return _hits; }
+      uint64_t misses() const { return _misses; }
+      void resetStats();
+      void printStats() const;
+      };
+
+} // namespace MusECore
+
+namespace MusEGlobal {
+extern MusECore::WaveBlockCache* waveCache;
+}
+
+#endif
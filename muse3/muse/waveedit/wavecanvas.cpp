@@ -149,6 +149,11 @@ WaveCanvas::~WaveCanvas()
 
 void WaveCanvas::songChanged(MusECore::SongChangedStruct_t flags)
       {
+      // Peaks being built in the background only need a repaint.
+      if (flags._flags == SC_WAVE_PEAKS) {
+            redraw();
+            return;
+            }
       if (flags._flags & ~(SC_SELECTION | SC_PART_SELECTION | SC_TRACK_SELECTION)) {
             // TODO FIXME: don't we actually only want SC_PART_*, and maybe SC_TRACK_DELETED?
             //             (same in waveview.cpp)
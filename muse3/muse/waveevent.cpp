@@ -481,8 +481,7 @@ void WaveEventBase::readAudio(WavePart* /*part*/, unsigned offset, float** buffe
   off_t e_off = offset + _spos;
   if(e_off < 0)
     e_off = 0;
-  f.seek(e_off, 0);
-  f.read(channel, buffer, n, overwrite);
+  f.readAt(e_off, channel, buffer, n, overwrite);
       
   return;
   #endif
@@ -99,6 +99,13 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
       fprintf(stderr, "WaveTrack::fetchData %s samples:%u pos:%u overwrite:%d\n", name().toLatin1().constData(), samples, pos, overwrite);
       #endif
 
+      // A frozen track plays its freeze file instead of the parts.
+      if(_frozen)
+      {
+        AudioTrack::fetchData(pos, samples, bp, doSeek, overwrite);
+        return;
+      }
+
       // reset buffer to zero
       if(overwrite)
         for (int i = 0; i < channels(); ++i)
@@ -165,8 +172,6 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
                   for (unsigned int j = 0; j < samples; ++j)
                       bp[i][j] +=MusEGlobal::denormalBias;
             }
-
-      _prefetchFifo.add();
       }
 
 //---------------------------------------------------------
@@ -337,6 +342,7 @@ bool WaveTrack::getData(unsigned framePos, int dstChannels, unsigned nframe, flo
     unsigned pos;
     if(_prefetchFifo.get(dstChannels, nframe, pf_buf, &pos))
     {
+      ++_prefetchState.underruns;
       fprintf(stderr, "WaveTrack::getData(%s) (A) fifo underrun\n", name().toLocal8Bit().constData());
       return have_data;
     }
@@ -348,6 +354,7 @@ bool WaveTrack::getData(unsigned framePos, int dstChannels, unsigned nframe, flo
       {
         if(_prefetchFifo.get(dstChannels, nframe, pf_buf, &pos))
         {
+          ++_prefetchState.underruns;
           fprintf(stderr, "WaveTrack::getData(%s) (B) fifo underrun\n",
               name().toLocal8Bit().constData());
           return have_data;
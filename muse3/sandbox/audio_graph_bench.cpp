@@ -0,0 +1,270 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_graph_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Runs a synthetic 100 track project through AudioGraphPool,
+//  the way AudioScheduler runs the song's audio tracks, and
+//  prints the DSP load per cycle for 1 up to N threads.
+//
+//   muse_audio_graph_bench [threads [cycles [stages]]]
+//
+// The project has 84 stereo wave tracks, routed 12 each into
+//  7 groups, 2 auxs fed by all wave tracks, and one output
+//  fed by the groups and auxs, 94 tracks in all, plus 6
+//  empty inputs to make 100. Every track runs a chain of
+//  'stages' biquads (default 16) on 256 frames, standing in
+//  for its plugin rack. The load is the time per cycle
+//  against the 256 frame period at 48 kHz.
+//  Threads defaults to the number of CPUs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "audio_graph.h"
+
+namespace MusEAudioGraphBench {
+
+static const unsigned FRAMES = 256;
+static const unsigned CHANNELS = 2;
+static const double PERIOD_US = FRAMES * 1000000.0 / 48000.0;
+
+static double nowUS()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+      }
+
+//---------------------------------------------------------
+//   BenchTrack
+//---------------------------------------------------------
+
+struct BenchTrack {
+      std::vector<BenchTrack*> inputs;
+      float buffer[CHANNELS][FRAMES];
+      float state[CHANNELS][2];
+      unsigned phase;
+      bool source;
+      };
+
+//---------------------------------------------------------
+//   process
+//    Sums the inputs, or makes some noise for a wave
+//     track, then filters. 'tmp' is thread scratch.
+//---------------------------------------------------------
+
+static void process(BenchTrack* t, int stages, float* tmp)
+      {
+      for(unsigned c = 0; c < CHANNELS; ++c)
+      {
+        float* out = t->buffer[c];
+        if(t->source)
+        {
+          unsigned p = t->phase + c * 7919;
+          for(unsigned i = 0; i < FRAMES; ++i)
+          {
+            p = p * 1664525u + 1013904223u;
+            out[i] = float(int(p >> 8) - (1 << 23)) / float(1 << 23) * 0.1f;
+          }
+        }
+        else
+        {
+          memset(out, 0, sizeof(float) * FRAMES);
+          for(unsigned k = 0; k < t->inputs.size(); ++k)
+          {
+            const float* in = t->inputs[k]->buffer[c];
+            for(unsigned i = 0; i < FRAMES; ++i)
+              out[i] += in[i];
+          }
+        }
+
+        // A low pass biquad over and over, through the scratch buffer.
+        const float b0 = 0.0675f, b1 = 0.135f, b2 = 0.0675f, a1 = -1.143f, a2 = 0.4128f;
+        float z1 = t->state[c][0], z2 = t->state[c][1];
+        for(int s = 0; s < stages; ++s)
+        {
+          const float* in = (s & 1) ? tmp : out;
+          float* o = (s & 1) ? out : tmp;
+          for(unsigned i = 0; i < FRAMES; ++i)
+          {
+            const float x = in[i];
+            const float y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            o[i] = y;
+          }
+        }
+        if(stages & 1)
+          memcpy(out, tmp, sizeof(float) * FRAMES);
+        t->state[c][0] = z1;
+        t->state[c][1] = z2;
+      }
+      t->phase += FRAMES;
+      }
+
+//---------------------------------------------------------
+//   BenchPool
+//---------------------------------------------------------
+
+class BenchPool : public MusECore::AudioGraphPool {
+      int _stages;
+
+   protected:
+      virtual void processNode(void* user, int worker)
+            {
+            process((BenchTrack*)user, _stages, scratch(worker));
+            }
+
+   public:
+      BenchPool(int stages) : _stages(stages) { }
+      virtual ~BenchPool() { stop(); }
+      };
+
+//---------------------------------------------------------
+//   Project
+//---------------------------------------------------------
+
+struct Project {
+      std::vector<BenchTrack*> tracks;   // In processing order.
+      MusECore::AudioGraph graph;
+
+      Project()
+            {
+            std::vector<BenchTrack*> waves, groups, auxs;
+            for(int i = 0; i < 84; ++i)
+              waves.push_back(add(true));
+            for(int i = 0; i < 7; ++i)
+              groups.push_back(add(false));
+            for(int i = 0; i < 2; ++i)
+              auxs.push_back(add(false));
+            BenchTrack* out = add(false);
+            for(int i = 0; i < 6; ++i)
+              add(false);
+
+            for(unsigned i = 0; i < waves.size(); ++i)
+            {
+              route(waves[i], groups[i / 12]);
+              for(unsigned a = 0; a < auxs.size(); ++a)
+                route(waves[i], auxs[a]);
+            }
+            for(unsigned i = 0; i < groups.size(); ++i)
+              route(groups[i], out);
+            for(unsigned a = 0; a < auxs.size(); ++a)
+              route(auxs[a], out);
+            graph.finish();
+            }
+
+      ~Project()
+            {
+            for(unsigned i = 0; i < tracks.size(); ++i)
+              delete tracks[i];
+            }
+
+      BenchTrack* add(bool source)
+            {
+            BenchTrack* t = new BenchTrack;
+            memset(t->buffer, 0, sizeof(t->buffer));
+            memset(t->state, 0, sizeof(t->state));
+            t->phase  = tracks.size() * 104729;
+            t->source = source;
+            tracks.push_back(t);
+            graph.addNode(t);
+            return t;
+            }
+
+      int index(BenchTrack* t) const
+            {
+            for(unsigned i = 0; i < tracks.size(); ++i)
+              if(tracks[i] == t)
+                return i;
+            return -1;
+            }
+
+      void route(BenchTrack* src, BenchTrack* dst)
+            {
+            dst->inputs.push_back(src);
+            graph.addEdge(index(src), index(dst));
+            }
+      };
+
+//---------------------------------------------------------
+//   runBench
+//---------------------------------------------------------
+
+static void runBench(int threads, int cycles, int stages)
+      {
+      Project project;
+      BenchPool pool(stages);
+      pool.start(threads, 0, FRAMES);
+
+      std::vector<float> tmp(FRAMES);
+      double total = 0.0, worst = 0.0;
+      for(int c = 0; c < cycles + 100; ++c)
+      {
+        const double t0 = nowUS();
+        if(pool.isRunning())
+          pool.run(&project.graph);
+        else
+        {
+          // Serial, the way Audio::process1() pulls the tracks without the scheduler.
+          for(unsigned i = 0; i < project.tracks.size(); ++i)
+            process(project.tracks[i], stages, &tmp[0]);
+        }
+        const double t = nowUS() - t0;
+        // Let the caches and the worker threads warm up first.
+        if(c < 100)
+          continue;
+        total += t;
+        if(t > worst)
+          worst = t;
+      }
+      pool.stop();
+
+      const double avg = total / cycles;
+      printf("%7d %10.1f %10.1f %9.1f%% %9.1f%%\n", threads, avg, worst,
+             100.0 * avg / PERIOD_US, 100.0 * worst / PERIOD_US);
+      }
+
+} // namespace MusEAudioGraphBench
+
+int main(int argc, char** argv)
+      {
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      int maxThreads = argc > 1 ? atoi(argv[1]) : (cpus > 0 ? cpus : 1);
+      const int cycles = argc > 2 ? atoi(argv[2]) : 2000;
+      const int stages = argc > 3 ? atoi(argv[3]) : 16;
+      if(maxThreads < 1)
+        maxThreads = 1;
+      if(maxThreads > MusECore::MAX_AUDIO_WORKER_THREADS)
+        maxThreads = MusECore::MAX_AUDIO_WORKER_THREADS;
+
+      printf("100 tracks, %d biquads each, %u frames, %d cycles, period %.0fus\n",
+             stages, MusEAudioGraphBench::FRAMES, cycles, MusEAudioGraphBench::PERIOD_US);
+      printf("threads  avg us/cyc  max us/cyc  avg load  max load\n");
+      for(int t = 1; t <= maxThreads; ++t)
+        MusEAudioGraphBench::runBench(t, cycles, stages);
+      return 0;
+      }
@@ -0,0 +1,349 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  audio_msg_queue_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Stress test of AudioMsgQueue, used the way Audio uses it.
+//
+//   muse_audio_msg_queue_test [producers [messages [period us]]]
+//
+// Producers defaults to 4, messages per producer to 100000, the
+//  period to 5333 us (256 frames at 48 kHz). An audio thread
+//  wakes once a period and handles up to 256 messages, as
+//  Audio::processMsgs() does: it answers blocking senders on a
+//  pipe and hands posted messages back on a done queue, which
+//  a gui thread empties.
+// Checked are that every message arrives once, in the order
+//  each producer sent it, that every done function is called
+//  once, and that a blocking send returns only after all the
+//  messages posted before it were processed.
+// Timed are edits per second sent blocking, one per period,
+//  against posted.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+
+#include "audio_msg_queue.h"
+
+namespace MusECore {
+
+struct AudioMsg {
+      int producer;
+      unsigned seq;
+      };
+
+} // namespace MusECore
+
+namespace MusEAudioMsgQueueTest {
+
+using MusECore::AudioMsg;
+using MusECore::AudioMsgQueue;
+
+static const int MAX_PRODUCERS = 64;
+static const int MAX_MSGS_PER_CYCLE = 256;
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+//---------------------------------------------------------
+//   Engine
+//    Stands in for Audio.
+//---------------------------------------------------------
+
+struct Engine {
+      AudioMsgQueue queue;
+      AudioMsgQueue doneQueue;
+      std::atomic<unsigned> donePending;
+      int pipeFd[2];
+      unsigned periodUs;
+      std::atomic<bool> running;
+
+      // Written by the audio thread only.
+      unsigned processed[MAX_PRODUCERS];
+      std::atomic<unsigned> processedCount[MAX_PRODUCERS];
+      unsigned outOfOrder;
+      unsigned maxPerCycle;
+
+      // Written by the gui thread only.
+      std::atomic<unsigned> doneCalls;
+      std::atomic<bool> guiRunning;
+
+      Engine() : donePending(0), periodUs(5333), running(true), outOfOrder(0), maxPerCycle(0),
+                 doneCalls(0), guiRunning(true)
+            {
+            for (int i = 0; i < MAX_PRODUCERS; ++i) {
+                  processed[i] = 0;
+                  processedCount[i].store(0);
+                  }
+            if (pipe(pipeFd))
+                  perror("pipe");
+            }
+      ~Engine()
+            {
+            close(pipeFd[0]);
+            close(pipeFd[1]);
+            }
+
+      void put(const AudioMsgQueue::Item& item)
+            {
+            while (!queue.put(item))
+                  usleep(1000);
+            }
+
+      // Audio::sendMsg()
+      void send(AudioMsg* m)
+            {
+            AudioMsgQueue::Item item;
+            item.msg = m;
+            item.done = 0;
+            item.arg = 0;
+            item.serialNo = int(m->seq);
+            put(item);
+            int no = -1;
+            if (read(pipeFd[0], &no, sizeof(int)) != sizeof(int) || no != int(m->seq))
+                  ++outOfOrder;
+            }
+
+      // Audio::postMsg()
+      void post(AudioMsg* m, MusECore::AudioMsgDoneFunc done)
+            {
+            while (donePending.load() >= AudioMsgQueue::SIZE)
+                  usleep(1000);
+            ++donePending;
+            AudioMsgQueue::Item item;
+            item.msg = m;
+            item.done = done;
+            item.arg = this;
+            item.serialNo = -1;
+            put(item);
+            }
+
+      // Audio::processMsgs()
+      void cycle()
+            {
+            AudioMsgQueue::Item item;
+            int n = 0;
+            for (; n < MAX_MSGS_PER_CYCLE && queue.get(&item); ++n) {
+                  AudioMsg* m = item.msg;
+                  if (m->seq != processed[m->producer])
+                        ++outOfOrder;
+                  processed[m->producer] = m->seq + 1;
+                  processedCount[m->producer].fetch_add(1, std::memory_order_release);
+                  if (item.serialNo >= 0) {
+                        const int sn = item.serialNo;
+                        if (write(pipeFd[1], &sn, sizeof(int)) != sizeof(int))
+                              perror("write");
+                        }
+                  if (item.done)
+                        doneQueue.put(item);
+                  }
+            if (unsigned(n) > maxPerCycle)
+                  maxPerCycle = n;
+            }
+
+      // Audio::processMsgsDone()
+      void processDone()
+            {
+            AudioMsgQueue::Item item;
+            while (doneQueue.get(&item)) {
+                  --donePending;
+                  item.done(item.msg, item.arg);
+                  }
+            }
+      };
+
+static void deleteMsg(AudioMsg* m, void* arg)
+      {
+      ++((Engine*)arg)->doneCalls;
+      delete m;
+      }
+
+static void* audioThread(void* arg)
+      {
+      Engine* e = (Engine*)arg;
+      while (e->running.load()) {
+            usleep(e->periodUs);
+            e->cycle();
+            }
+      e->cycle();
+      return 0;
+      }
+
+static void* guiThread(void* arg)
+      {
+      Engine* e = (Engine*)arg;
+      while (e->guiRunning.load()) {
+            e->processDone();
+            usleep(1000);
+            }
+      e->processDone();
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   Producer
+//    Posts its messages. The first producer, which stands
+//     in for the gui thread, sends every 'barrierEvery'th
+//     one blocking, after which all it posted before must
+//     have been processed. Only the gui thread blocks, as
+//     the answers come back on one pipe.
+//---------------------------------------------------------
+
+struct Producer {
+      Engine* engine;
+      int id;
+      unsigned messages;
+      unsigned barrierEvery;
+      unsigned barrierFailures;
+      };
+
+static bool blocks(int id, unsigned barrierEvery, unsigned i)
+      {
+      return id == 0 && barrierEvery && (i + 1) % barrierEvery == 0;
+      }
+
+static void* producerThread(void* arg)
+      {
+      Producer* p = (Producer*)arg;
+      p->barrierFailures = 0;
+      for (unsigned i = 0; i < p->messages; ++i) {
+            AudioMsg* m = new AudioMsg;
+            m->producer = p->id;
+            m->seq = i;
+            if (blocks(p->id, p->barrierEvery, i)) {
+                  p->engine->send(m);
+                  if (p->engine->processedCount[p->id].load(std::memory_order_acquire) != i + 1)
+                        ++p->barrierFailures;
+                  delete m;
+                  }
+            else
+                  p->engine->post(m, deleteMsg);
+            }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   run
+//    Returns the edits per second.
+//---------------------------------------------------------
+
+static double run(int producers, unsigned messages, unsigned barrierEvery, unsigned periodUs,
+                  bool* ok, unsigned* maxPerCycle)
+      {
+      Engine* e = new Engine;
+      e->periodUs = periodUs;
+      pthread_t audio, gui;
+      pthread_create(&audio, 0, audioThread, e);
+      pthread_create(&gui, 0, guiThread, e);
+
+      std::vector<Producer> p(producers);
+      std::vector<pthread_t> t(producers);
+      const double t0 = now();
+      for (int i = 0; i < producers; ++i) {
+            p[i].engine = e;
+            p[i].id = i;
+            p[i].messages = messages;
+            p[i].barrierEvery = barrierEvery;
+            pthread_create(&t[i], 0, producerThread, &p[i]);
+            }
+      for (int i = 0; i < producers; ++i)
+            pthread_join(t[i], 0);
+      // Wait until the audio thread has seen everything.
+      for (int i = 0; i < producers; ++i)
+            while (e->processedCount[i].load(std::memory_order_acquire) != messages)
+                  usleep(1000);
+      const double elapsed = now() - t0;
+
+      e->running.store(false);
+      pthread_join(audio, 0);
+      e->guiRunning.store(false);
+      pthread_join(gui, 0);
+
+      unsigned posted = 0, barrierFailures = 0;
+      for (int i = 0; i < producers; ++i) {
+            for (unsigned k = 0; k < messages; ++k)
+                  if (!blocks(i, barrierEvery, k))
+                        ++posted;
+            barrierFailures += p[i].barrierFailures;
+            }
+      *ok = e->outOfOrder == 0 && barrierFailures == 0 &&
+            e->doneCalls.load() == posted && e->donePending.load() == 0;
+      if (!*ok)
+            printf("  out of order %u, barrier failures %u, done calls %u of %u, pending %u\n",
+                   e->outOfOrder, barrierFailures, e->doneCalls.load(), posted, e->donePending.load());
+      *maxPerCycle = e->maxPerCycle;
+      delete e;
+      return double(producers) * messages / elapsed;
+      }
+
+} // namespace MusEAudioMsgQueueTest
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEAudioMsgQueueTest;
+      const int producers = argc > 1 ? atoi(argv[1]) : 4;
+      const unsigned messages = argc > 2 ? atoi(argv[2]) : 100000;
+      const unsigned periodUs = argc > 3 ? atoi(argv[3]) : 5333;
+      if (producers < 1 || producers > MAX_PRODUCERS) {
+            printf("1 to %d producers\n", MAX_PRODUCERS);
+            return 2;
+            }
+
+      int failed = 0;
+      bool ok;
+      unsigned maxPerCycle;
+      printf("period %u us\n", periodUs);
+      printf("test                                    edits/s  max/cycle  ok\n");
+
+      // As every edit was sent before: one producer, each one waits a cycle.
+      const unsigned blocking = std::max(1u, 1000000 / periodUs);
+      double rate = run(1, blocking, 1, periodUs, &ok, &maxPerCycle);
+      failed += !ok;
+      printf("1 producer, %6u sent blocking    %10.0f %10u  %s\n", blocking, rate, maxPerCycle, ok ? "yes" : "NO");
+
+      rate = run(1, messages, 0, periodUs, &ok, &maxPerCycle);
+      failed += !ok;
+      printf("1 producer, %6u posted           %10.0f %10u  %s\n", messages, rate, maxPerCycle, ok ? "yes" : "NO");
+
+      rate = run(producers, messages, 0, periodUs, &ok, &maxPerCycle);
+      failed += !ok;
+      printf("%d producers, %6u posted each    %10.0f %10u  %s\n", producers, messages, rate, maxPerCycle, ok ? "yes" : "NO");
+
+      // Posted with a blocking send now and then, as a gui does when
+      //  an edit that needs an answer follows a row of knob moves.
+      rate = run(producers, messages / 10, 100, periodUs, &ok, &maxPerCycle);
+      failed += !ok;
+      printf("%d producers, %6u mixed each     %10.0f %10u  %s\n", producers, messages / 10, rate, maxPerCycle, ok ? "yes" : "NO");
+
+      printf("%s\n", failed ? "FAILED" : "all ok");
+      return failed ? 1 : 0;
+      }
@@ -0,0 +1,201 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  dsp_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times the AL::Dsp routines used by the track mixing code,
+//  the generic versions against every SIMD version this cpu
+//  supports (SSE2, AVX2, AVX-512), and checks that each gives
+//  exactly the same samples as the generic one. Exits non-zero
+//  if any routine differs.
+//
+//   muse_dsp_bench [frames [calls]]
+//
+// Frames defaults to 256, calls to 200000. Buffers are offset
+//  by one float, as they are when a period is split by
+//  automation, so the unaligned path is what is timed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "al/al.h"
+#include "al/dsp.h"
+
+namespace AL {
+extern Dsp* createSIMDDsp(const char* isa);
+}
+
+namespace MusEDspBench {
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+enum Routine { PEAK, MIX, MIX_GAIN, CPY_GAIN, PAN_GAIN, LINEAR_RAMP, EXP_RAMP, ROUTINES };
+static const char* routineNames[ROUTINES] = { "peak", "mix", "mixWithGain", "cpyWithGain", "panGain",
+                                              "linearRamp", "expRamp" };
+
+//---------------------------------------------------------
+//   Buffers
+//---------------------------------------------------------
+
+struct Buffers {
+      std::vector<float> mem;
+      float* srcL;
+      float* srcR;
+      float* dstL;
+      float* dstR;
+      unsigned frames;
+
+      Buffers(unsigned n) : mem(4 * (n + 16)), frames(n)
+            {
+            srcL = &mem[1];
+            srcR = srcL + n + 16;
+            dstL = srcR + n + 16;
+            dstR = dstL + n + 16;
+            unsigned p = 12345;
+            for(unsigned i = 0; i < n; ++i)
+            {
+              p = p * 1664525u + 1013904223u;
+              srcL[i] = float(int(p >> 8) - (1 << 23)) / float(1 << 23);
+              p = p * 1664525u + 1013904223u;
+              srcR[i] = float(int(p >> 8) - (1 << 23)) / float(1 << 23);
+            }
+            reset();
+            }
+
+      void reset()
+            {
+            for(unsigned i = 0; i < frames; ++i)
+            {
+              dstL[i] = srcR[frames - 1 - i] * 0.5f;
+              dstR[i] = srcL[frames - 1 - i] * 0.25f;
+            }
+            }
+      };
+
+//---------------------------------------------------------
+//   call
+//    The gains are doubles that do not fit a float,
+//     like a volume times a pan.
+//---------------------------------------------------------
+
+static float call(AL::Dsp* dsp, Routine r, Buffers& b)
+      {
+      const double g1 = 0.7071067811865476, g2 = 0.3090169943749474;
+      switch(r)
+      {
+        case PEAK:     return dsp->peak(b.srcL, b.frames, 0.0f);
+        case MIX:      dsp->mix(b.dstL, b.srcL, b.frames); break;
+        case MIX_GAIN: dsp->mixWithGain(b.dstL, b.srcL, b.frames, g1); break;
+        case CPY_GAIN: dsp->cpyWithGain(b.dstL, b.srcL, b.frames, g1); break;
+        case PAN_GAIN: dsp->panGain(b.dstL, b.dstR, b.srcL, b.srcR, b.frames, g1, g2); break;
+        // A volume fade, and a dB fade of about 6 dB over a 256 frame period.
+        case LINEAR_RAMP: dsp->linearRamp(b.dstL, b.frames, g1, -1.0e-3); break;
+        case EXP_RAMP: dsp->expRamp(b.dstL, b.frames, g1, 0.9972960241953047); break;
+        default: break;
+      }
+      return 0.0f;
+      }
+
+static double time(AL::Dsp* dsp, Routine r, Buffers& b, int calls)
+      {
+      const double t0 = now();
+      for(int c = 0; c < calls; ++c)
+      {
+        // The mixes grow, start over now and then.
+        if((c & 1023) == 0)
+          b.reset();
+        call(dsp, r, b);
+      }
+      return (now() - t0) * 1e9 / calls;
+      }
+
+static bool same(AL::Dsp* a, AL::Dsp* b, Routine r, unsigned frames)
+      {
+      Buffers ba(frames), bb(frames);
+      // Every length up to 'frames', to cover the tails too.
+      for(unsigned n = 0; n <= frames; ++n)
+      {
+        ba.frames = bb.frames = n;
+        const float pa = call(a, r, ba);
+        const float pb = call(b, r, bb);
+        if(memcmp(&pa, &pb, sizeof(float)) ||
+           memcmp(ba.dstL, bb.dstL, frames * sizeof(float)) ||
+           memcmp(ba.dstR, bb.dstR, frames * sizeof(float)))
+          return false;
+      }
+      return true;
+      }
+
+} // namespace MusEDspBench
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEDspBench;
+      const unsigned frames = argc > 1 ? atoi(argv[1]) : 256;
+      const int calls = argc > 2 ? atoi(argv[2]) : 200000;
+
+      // Every version this cpu can run, not only the one
+      //  createSIMDDsp() would pick.
+      static const char* isas[] = { "avx512f", "avx2", "sse2" };
+      AL::Dsp generic;
+      int tested = 0;
+      int failed = 0;
+      for(unsigned i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i)
+      {
+        AL::Dsp* simd = AL::createSIMDDsp(isas[i]);
+        if(!simd)
+        {
+          printf("%s: not supported by this cpu, skipped\n\n", isas[i]);
+          continue;
+        }
+        ++tested;
+        printf("%u frames, %d calls, generic against %s\n", frames, calls, simd->name());
+        printf("routine         generic ns  %8s ns  speedup  identical\n", simd->name());
+        for(int r = 0; r < ROUTINES; ++r)
+        {
+          Buffers b(frames);
+          const double tg = time(&generic, Routine(r), b, calls);
+          const double ts = time(simd, Routine(r), b, calls);
+          const bool ok = same(&generic, simd, Routine(r), frames);
+          if(!ok)
+            ++failed;
+          printf("%-14s %11.1f %11.1f %8.2fx  %s\n", routineNames[r], tg, ts, tg / ts, ok ? "yes" : "NO");
+        }
+        printf("\n");
+        delete simd;
+      }
+      if(tested == 0)
+      {
+        printf("No SIMD routines for this cpu\n");
+        return 1;
+      }
+      if(failed)
+        printf("FAILED: %d routines differ from the generic ones\n", failed);
+      return failed ? 1 : 0;
+      }
@@ -0,0 +1,325 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  dspprofiler_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks the DspProfiler.
+//
+//   muse_dspprofiler_test [dir]
+//
+// Checks
+//   - that nothing is recorded while disabled,
+//   - the statistics of known samples, kept apart per kind,
+//   - that only the last HISTORY samples are kept, but all
+//     are counted,
+//   - that nested scopes do not count their children, also
+//     with two threads at once, and the cycle counts all,
+//   - that reset() takes effect at the next beginCycle(),
+//   - that samples are dropped and counted once the table
+//     is full,
+//   - the CSV written into 'dir' (default /tmp): header,
+//     quoting of names, plugin and cycle columns, rows
+//     without samples left out and the summary lines.
+//  Scopes are timed by spinning on the clock, with some
+//  slack for being preempted. Exits non-zero if any check
+//  fails.
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <QString>
+
+#include "dspprofiler.h"
+
+namespace MusEGlobal {
+int sampleRate = 48000;
+unsigned segmentSize = 256;
+}
+
+namespace MusEDspProfilerTest {
+
+using MusECore::DspProfiler;
+using MusECore::DspProfileScope;
+using MusECore::DspStats;
+using MusECore::DspCsvRow;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+static void spin(unsigned us)
+      {
+      const uint64_t end = DspProfiler::now() + uint64_t(us) * 1000;
+      while (DspProfiler::now() < end)
+            ;
+      }
+
+// Timed scopes get the time spun plus up to this for being preempted.
+static bool near(double us, double expected)
+      {
+      return us >= expected * 0.99 && us <= expected * 1.5 + 200.0;
+      }
+
+// Owners, only their addresses are used.
+static double owners[DspProfiler::MAX_SLOTS + 8];
+
+//---------------------------------------------------------
+//   nested
+//    One cycle: a track which spins 2 ms itself and runs a
+//     plugin of 3 ms and a meter of 1 ms.
+//---------------------------------------------------------
+
+static void nested(const void* track, const void* plugin)
+      {
+      DspProfileScope ts(track, DspProfiler::TRACK);
+      spin(1000);
+      {
+      DspProfileScope ps(plugin, DspProfiler::PLUGIN);
+      spin(3000);
+      }
+      spin(1000);
+      {
+      DspProfileScope ms(track, DspProfiler::METER);
+      spin(1000);
+      }
+      }
+
+struct ThreadJob {
+      const void* track;
+      const void* plugin;
+      };
+
+static void* nestedThread(void* arg)
+      {
+      ThreadJob* j = (ThreadJob*)arg;
+      for (int i = 0; i < 5; ++i)
+            nested(j->track, j->plugin);
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   readLines
+//---------------------------------------------------------
+
+static std::vector<std::string> readLines(const char* path)
+      {
+      std::vector<std::string> lines;
+      FILE* f = fopen(path, "r");
+      if (!f)
+            return lines;
+      char buf[1024];
+      while (fgets(buf, sizeof(buf), f)) {
+            std::string l(buf);
+            if (!l.empty() && l[l.size() - 1] == '\n')
+                  l.erase(l.size() - 1);
+            lines.push_back(l);
+            }
+      fclose(f);
+      return lines;
+      }
+
+//---------------------------------------------------------
+//   fields
+//    Splits a CSV line, names are quoted with "" for ".
+//---------------------------------------------------------
+
+static std::vector<std::string> fields(const std::string& l)
+      {
+      std::vector<std::string> v;
+      std::string cur;
+      bool quoted = false;
+      for (size_t i = 0; i < l.size(); ++i) {
+            const char c = l[i];
+            if (quoted) {
+                  if (c == '"' && i + 1 < l.size() && l[i + 1] == '"') {
+                        cur += '"';
+                        ++i;
+                        }
+                  else if (c == '"')
+                        quoted = false;
+                  else
+                        cur += c;
+                  }
+            else if (c == '"')
+                  quoted = true;
+            else if (c == ',') {
+                  v.push_back(cur);
+                  cur.clear();
+                  }
+            else
+                  cur += c;
+            }
+      v.push_back(cur);
+      return v;
+      }
+
+} // namespace MusEDspProfilerTest
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEDspProfilerTest;
+      const std::string dir = argc > 1 ? argv[1] : "/tmp";
+      DspStats st;
+
+      {
+      DspProfiler p;
+      MusEGlobal::dspProfiler = &p;
+      {
+      DspProfileScope s(&owners[0], DspProfiler::TRACK);
+      }
+      p.record(&owners[0], DspProfiler::PLUGIN, 1000);
+      check(!p.stats(&owners[0], DspProfiler::TRACK, &st), "scopes record nothing while disabled");
+
+      p.setEnabled(true);
+      p.beginCycle();
+      check(!p.stats(&owners[0], DspProfiler::PLUGIN, &st), "enabling forgets what was there");
+
+      for (int i = 100; i >= 1; --i)
+            p.record(&owners[0], DspProfiler::PLUGIN, uint64_t(i) * 1000);
+      const bool got = p.stats(&owners[0], DspProfiler::PLUGIN, &st);
+      check(got && st.count == 100 && st.min == 1.0 && st.max == 100.0 && st.avg == 50.5,
+            "count, min, max and average of 1..100 us");
+      check(got && st.p50 == 50.0 && st.p95 == 95.0 && st.p99 == 99.0, "percentiles of 1..100 us");
+      check(!p.stats(&owners[0], DspProfiler::TRACK, &st), "kinds of one owner are kept apart");
+
+      const unsigned n = DspProfiler::HISTORY + 88;
+      for (unsigned i = 0; i < n; ++i)
+            p.record(&owners[1], DspProfiler::TRACK, uint64_t(i) * 1000);
+      check(p.stats(&owners[1], DspProfiler::TRACK, &st) && st.count == n && st.min == 88.0
+            && st.max == double(n - 1), "last HISTORY samples kept, all counted");
+
+      for (int c = 0; c < 4; ++c) {
+            p.beginCycle();
+            DspProfileScope cs(&p, DspProfiler::CYCLE);
+            nested(&owners[2], &owners[3]);
+            }
+      DspStats track, plugin, meter, cycle;
+      const bool all = p.stats(&owners[2], DspProfiler::TRACK, &track)
+                    && p.stats(&owners[3], DspProfiler::PLUGIN, &plugin)
+                    && p.stats(&owners[2], DspProfiler::METER, &meter)
+                    && p.stats(&p, DspProfiler::CYCLE, &cycle);
+      printf("  track %.0f us, plugin %.0f us, meter %.0f us, cycle %.0f us (p50)\n",
+             track.p50, plugin.p50, meter.p50, cycle.p50);
+      check(all && track.count == 4 && plugin.count == 4 && cycle.count == 4, "one sample per node and cycle");
+      check(all && near(track.p50, 2000.0) && near(plugin.p50, 3000.0) && near(meter.p50, 1000.0),
+            "nested scopes do not count their children");
+      check(all && near(cycle.p50, 6000.0), "the cycle counts everything");
+
+      ThreadJob ja = { &owners[4], &owners[5] };
+      ThreadJob jb = { &owners[6], &owners[7] };
+      pthread_t ta, tb;
+      pthread_create(&ta, 0, nestedThread, &ja);
+      pthread_create(&tb, 0, nestedThread, &jb);
+      pthread_join(ta, 0);
+      pthread_join(tb, 0);
+      DspStats a, b;
+      const bool both = p.stats(&owners[4], DspProfiler::TRACK, &a) && p.stats(&owners[6], DspProfiler::TRACK, &b);
+      check(both && a.count == 5 && b.count == 5 && near(a.p50, 2000.0) && near(b.p50, 2000.0),
+            "two threads keep their nesting apart");
+
+      p.reset();
+      check(p.stats(&owners[0], DspProfiler::PLUGIN, &st), "reset waits for the next cycle");
+      p.beginCycle();
+      check(!p.stats(&owners[0], DspProfiler::PLUGIN, &st) && !p.stats(&p, DspProfiler::CYCLE, &st),
+            "reset forgets all samples at the next cycle");
+
+      for (int i = 0; i < DspProfiler::MAX_SLOTS + 5; ++i)
+            p.record(&owners[i], DspProfiler::TRACK, 1000);
+      check(p.dropped() == 5, "samples beyond a full table are dropped and counted");
+      MusEGlobal::dspProfiler = 0;
+      }
+
+      {
+      DspProfiler p;
+      p.setEnabled(true);
+      p.beginCycle();
+      p.record(&p, DspProfiler::CYCLE, 4000);
+      p.record(&owners[0], DspProfiler::TRACK, 1000);
+      p.record(&owners[0], DspProfiler::TRACK, 3000);
+      p.record(&owners[1], DspProfiler::PLUGIN, 2000);
+
+      std::vector<DspCsvRow> rows;
+      rows.push_back(DspCsvRow(&p, DspProfiler::CYCLE, "cycle", QString("process")));
+      rows.push_back(DspCsvRow(&p, DspProfiler::MIDI, "midi", QString("midi")));
+      rows.push_back(DspCsvRow(&owners[0], DspProfiler::TRACK, "track", QString("Drums, \"kit\"")));
+      DspCsvRow synth(&owners[0], DspProfiler::SYNTH, "synth", QString("Drums"));
+      synth.hasCycles     = true;
+      synth.runCycles     = 6;
+      synth.skippedCycles = 1;
+      rows.push_back(synth);
+      DspCsvRow plugin(&owners[1], DspProfiler::PLUGIN, "plugin", QString("Drums/Reverb"));
+      plugin.hasInstances  = true;
+      plugin.instances     = 2;
+      plugin.shared        = true;
+      plugin.heapBytes     = 3000;
+      plugin.hasCycles     = true;
+      plugin.runCycles     = 10;
+      plugin.skippedCycles = 4;
+      rows.push_back(plugin);
+      rows.push_back(DspCsvRow(&owners[0], DspProfiler::METER, "meter", QString("Drums")));
+
+      const std::string path = dir + "/muse_dspprofiler_test.csv";
+      check(p.writeCsv(QString(path.c_str()), rows), "CSV written");
+      const std::vector<std::string> l = readLines(path.c_str());
+      check(l.size() == 5, "one line per node with samples, and a summary");
+      check(l.size() > 0 && l[0] == "kind,name,count,min_us,avg_us,p50_us,p95_us,p99_us,max_us,load_pct,"
+            "instances,shared,heap_kb_estimate,run_cycles,skipped_cycles", "CSV header");
+      if (l.size() == 5) {
+            const std::vector<std::string> c = fields(l[1]);
+            const std::vector<std::string> t = fields(l[2]);
+            const std::vector<std::string> pl = fields(l[3]);
+            check(c.size() == 15 && c[0] == "cycle" && c[2] == "1" && atof(c[4].c_str()) == 4.0
+                  // 4 us of a 256 frame cycle at 48 kHz.
+                  && fabs(atof(c[9].c_str()) - 0.075) < 1e-6 && c[10].empty() && c[13].empty(),
+                  "cycle line with its load");
+            check(t.size() == 15 && t[0] == "track" && t[1] == "Drums, \"kit\"" && t[2] == "2"
+                  && atof(t[3].c_str()) == 1.0 && atof(t[4].c_str()) == 2.0 && atof(t[8].c_str()) == 3.0,
+                  "track line, name with a quote and a comma");
+            check(pl.size() == 15 && pl[0] == "plugin" && pl[1] == "Drums/Reverb" && pl[10] == "2"
+                  && pl[11] == "1" && pl[12] == "3" && pl[13] == "10" && pl[14] == "4",
+                  "plugin line with instances and cycles");
+            check(l[4] == "# 5 of 16 plugin and synth cycles skipped for silence",
+                  "skipped cycles of all rows, with samples or not");
+            }
+
+      for (int i = 0; i < DspProfiler::MAX_SLOTS + 2; ++i)
+            p.record(&owners[i], DspProfiler::METER, 1000);
+      p.writeCsv(QString(path.c_str()), rows);
+      const std::vector<std::string> full = readLines(path.c_str());
+      // 3 slots are taken, so 5 of the meters do not fit.
+      check(!full.empty() && full.back() == "# 5 samples dropped, table full", "dropped samples noted");
+      unlink(path.c_str());
+      }
+
+      printf("%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
@@ -0,0 +1,324 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  event_list_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks EventChunkList against std::multimap, which EventList
+//  used to be, and times both.
+//
+//   muse_event_list_bench [events [fuzz ops]]
+//
+// Events defaults to 1000000, fuzz ops to 20000. The mapped
+//  type is a reference counted handle like Event.
+// The fuzz test does random inserts, hinted inserts and erases
+//  on both, and checks after every step that the lists are the
+//  same and that iterators and pointers taken before still
+//  point to the same entries.
+// The timings are: appending the events in order, random
+//  inserts, range queries as collectEvents() does them, full
+//  scans, copying, and random erases.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include <malloc.h>
+
+#include "event_chunk_list.h"
+
+namespace MusEEventListBench {
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+static size_t heapBytes()
+      {
+      struct mallinfo2 mi = mallinfo2();
+      return mi.uordblks + mi.hblkhd;
+      }
+
+//---------------------------------------------------------
+//   Handle
+//    Stands in for Event: a pointer to a reference
+//     counted body.
+//---------------------------------------------------------
+
+struct Body {
+      int refs;
+      unsigned id;
+      };
+
+class Handle {
+      Body* b;
+   public:
+      Handle() : b(0) {}
+      explicit Handle(unsigned id) : b(new Body) { b->refs = 1; b->id = id; }
+      Handle(const Handle& o) : b(o.b) { if (b) ++b->refs; }
+      ~Handle() { release(); }
+      Handle& operator=(const Handle& o) {
+            if (o.b)
+                  ++o.b->refs;
+            release();
+            b = o.b;
+            return *this;
+            }
+      void release() { if (b && --b->refs == 0) delete b; b = 0; }
+      unsigned id() const { return b ? b->id : ~0U; }
+      bool operator==(const Handle& o) const { return b == o.b; }
+      };
+
+typedef std::multimap<unsigned, Handle, std::less<unsigned> > MM;
+typedef MusECore::EventChunkList<Handle> CL;
+
+// Code written for the multimap must see the same entries, with
+//  keys that cannot be changed through an iterator.
+static_assert(std::is_same<CL::value_type, MM::value_type>::value, "value_type differs from std::multimap");
+static_assert(std::is_const<std::remove_reference<decltype(CL::iterator()->first)>::type>::value,
+              "key can be changed through an iterator");
+
+static unsigned rnd = 12345;
+static unsigned nextRandom()
+      {
+      rnd = rnd * 1664525u + 1013904223u;
+      return rnd >> 8;
+      }
+
+//---------------------------------------------------------
+//   same
+//---------------------------------------------------------
+
+static bool same(const MM& m, const CL& c)
+      {
+      if (m.size() != c.size())
+            return false;
+      CL::const_iterator ic = c.begin();
+      for (MM::const_iterator im = m.begin(); im != m.end(); ++im, ++ic)
+            if (im->first != ic->first || !(im->second == ic->second))
+                  return false;
+      if (ic != c.end())
+            return false;
+      // Backwards too.
+      CL::const_reverse_iterator rc = c.rbegin();
+      for (MM::const_reverse_iterator rm = m.rbegin(); rm != m.rend(); ++rm, ++rc)
+            if (!(rm->second == rc->second))
+                  return false;
+      return true;
+      }
+
+//---------------------------------------------------------
+//   fuzz
+//---------------------------------------------------------
+
+static bool fuzz(int ops)
+      {
+      MM m;
+      CL c;
+      // Entries held across the operations, as the editors hold them.
+      std::vector<CL::iterator> held;
+      std::vector<const Handle*> heldPtr;
+      std::vector<unsigned> heldId;
+      unsigned id = 0;
+      for (int k = 0; k < ops; ++k) {
+            const unsigned op = nextRandom() % 10;
+            // Few keys, to have many equal ones.
+            const unsigned key = nextRandom() % (m.size() / 4 + 16);
+            if (op < 5 || m.empty()) {
+                  Handle h(id++);
+                  m.insert(MM::value_type(key, h));
+                  c.insert(CL::value_type(key, h));
+                  }
+            else if (op < 7) {
+                  // Hinted insert, right or wrong hint.
+                  Handle h(id++);
+                  CL::iterator hint = c.lower_bound(nextRandom() % (m.size() / 4 + 16));
+                  MM::iterator mhint = m.begin();
+                  std::advance(mhint, std::distance(c.begin(), hint));
+                  m.insert(mhint, MM::value_type(key, h));
+                  c.insert(hint, CL::value_type(key, h));
+                  }
+            else if (op < 9) {
+                  const unsigned n = nextRandom() % m.size();
+                  MM::iterator im = m.begin();
+                  std::advance(im, n);
+                  CL::iterator ic = c.begin();
+                  std::advance(ic, n);
+                  for (unsigned h = held.size(); h > 0; --h)
+                        if (held[h - 1] == ic) {
+                              held.erase(held.begin() + h - 1);
+                              heldPtr.erase(heldPtr.begin() + h - 1);
+                              heldId.erase(heldId.begin() + h - 1);
+                              }
+                  m.erase(im);
+                  c.erase(ic);
+                  }
+            else if (held.size() < 64) {
+                  CL::iterator ic = c.lower_bound(key);
+                  if (ic != c.end()) {
+                        held.push_back(ic);
+                        heldPtr.push_back(&ic->second);
+                        heldId.push_back(ic->second.id());
+                        }
+                  }
+
+            for (unsigned h = 0; h < held.size(); ++h)
+                  if (held[h]->second.id() != heldId[h] || heldPtr[h]->id() != heldId[h]) {
+                        printf("  op %d: held entry %u moved\n", k, heldId[h]);
+                        return false;
+                        }
+            if ((k & 255) == 0 && !same(m, c)) {
+                  printf("  op %d: lists differ\n", k);
+                  return false;
+                  }
+            }
+      if (!same(m, c))
+            return false;
+
+      // Range erase and erase by key.
+      const unsigned key = m.begin()->first;
+      if (m.erase(key) != c.erase(key) || !same(m, c))
+            return false;
+      MM::iterator mf = m.begin(), ml = m.begin();
+      std::advance(mf, m.size() / 3);
+      std::advance(ml, 2 * m.size() / 3);
+      CL::iterator cf = c.begin(), cl = c.begin();
+      std::advance(cf, c.size() / 3);
+      std::advance(cl, 2 * c.size() / 3);
+      m.erase(mf, ml);
+      c.erase(cf, cl);
+      if (!same(m, c))
+            return false;
+
+      CL copy(c);
+      CL swapped;
+      swapped.swap(copy);
+      return same(m, swapped) && copy.empty();
+      }
+
+//---------------------------------------------------------
+//   Timings
+//---------------------------------------------------------
+
+struct Timings {
+      double append, insert, query, scan, copy, erase;
+      size_t bytes;
+      };
+
+template <class L> static unsigned scan(const L& l)
+      {
+      unsigned sum = 0;
+      for (typename L::const_iterator i = l.begin(); i != l.end(); ++i)
+            sum += i->first + i->second.id();
+      return sum;
+      }
+
+template <class L> static Timings timeList(int events, unsigned* check)
+      {
+      Timings t;
+      unsigned sum = 0;
+      std::vector<Handle> handles;
+      handles.reserve(events);
+      for (int i = 0; i < events; ++i)
+            handles.push_back(Handle(i));
+
+      const size_t before = heapBytes();
+      L* l = new L;
+      double t0 = now();
+      // A dense song, 4 events per 24th of a beat.
+      for (int i = 0; i < events; ++i)
+            l->insert(l->end(), typename L::value_type(unsigned(i / 4) * 16, handles[i]));
+      t.append = now() - t0;
+      t.bytes = heapBytes() - before;
+
+      const unsigned last = l->rbegin()->first;
+      rnd = 4711;
+      t0 = now();
+      for (int i = 0; i < 100000; ++i)
+            l->insert(typename L::value_type(nextRandom() % last, handles[i]));
+      t.insert = now() - t0;
+
+      // collectEvents: all events in one period of a 384 tick beat.
+      t0 = now();
+      for (int i = 0; i < 20000; ++i) {
+            const unsigned from = nextRandom() % last;
+            typename L::const_iterator ie = l->lower_bound(from + 48);
+            for (typename L::const_iterator is = l->lower_bound(from); is != ie; ++is)
+                  sum += is->second.id();
+            }
+      t.query = now() - t0;
+
+      t0 = now();
+      for (int i = 0; i < 10; ++i)
+            sum += scan(*l);
+      t.scan = now() - t0;
+
+      t0 = now();
+      L* c = new L(*l);
+      t.copy = now() - t0;
+      sum += c->size();
+      delete c;
+
+      t0 = now();
+      for (int i = 0; i < 100000; ++i) {
+            typename L::iterator it = l->lower_bound(nextRandom() % last);
+            if (it != l->end())
+                  l->erase(it);
+            }
+      t.erase = now() - t0;
+      sum += scan(*l);
+      delete l;
+      *check = sum;
+      return t;
+      }
+
+} // namespace MusEEventListBench
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEEventListBench;
+      const int events = argc > 1 ? atoi(argv[1]) : 1000000;
+      const int ops = argc > 2 ? atoi(argv[2]) : 20000;
+
+      const bool ok = fuzz(ops);
+      printf("fuzz against std::multimap, %d ops: %s\n", ops, ok ? "ok" : "FAILED");
+
+      unsigned sm = 0, sc = 0;
+      const Timings m = timeList<MM>(events, &sm);
+      const Timings c = timeList<CL>(events, &sc);
+      printf("%d events              multimap    chunked\n", events);
+      printf("append in order       %8.1f ms %8.1f ms\n", m.append * 1e3, c.append * 1e3);
+      printf("100k random inserts   %8.1f ms %8.1f ms\n", m.insert * 1e3, c.insert * 1e3);
+      printf("20k range queries     %8.1f ms %8.1f ms\n", m.query * 1e3, c.query * 1e3);
+      printf("10 full scans         %8.1f ms %8.1f ms\n", m.scan * 1e3, c.scan * 1e3);
+      printf("copy                  %8.1f ms %8.1f ms\n", m.copy * 1e3, c.copy * 1e3);
+      printf("100k random erases    %8.1f ms %8.1f ms\n", m.erase * 1e3, c.erase * 1e3);
+      printf("memory                %8.1f MB %8.1f MB\n", m.bytes / 1048576.0, c.bytes / 1048576.0);
+      const bool same = sm == sc;
+      printf("same results: %s\n", same ? "yes" : "NO");
+      return ok && same ? 0 : 1;
+      }
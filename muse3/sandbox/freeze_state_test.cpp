@@ -0,0 +1,223 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  freeze_state_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks the FreezeState of a track's freeze render.
+//
+//   muse_freeze_state_test
+//
+// An audio thread renders blocks into a fifo like
+//  AudioTrack::putFreezeData(), a prefetch thread writes them
+//  to a file in memory like AudioTrack::flushFreezeFifo(), and
+//  the main thread waits for the file like Song::flushFreeze().
+//  The fifo and file stand in for the track's, which need the
+//  whole application. Checks
+//   - that a freeze renders every block, in order, and is
+//     flushed, without an overrun and not stale,
+//   - that an edit marks the freeze stale, and that a new
+//     freeze file clears that,
+//   - that a full fifo drops the block and marks the overrun,
+//   - that waiting for a prefetch thread that stopped writing
+//     times out.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+#include "freeze_state.h"
+
+namespace MusEFreezeStateTest {
+
+using MusECore::FreezeState;
+
+static const unsigned FRAMES = 256;
+static const unsigned BLOCKS = 2000;
+static const unsigned FIFO_BLOCKS = 16;
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+static uint64_t nowUS()
+      {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+      }
+
+//---------------------------------------------------------
+//   Render
+//    A track being frozen: a single reader, single writer
+//     fifo of blocks and the file they end up in.
+//---------------------------------------------------------
+
+struct Render {
+      FreezeState state;
+      float fifo[FIFO_BLOCKS][FRAMES];
+      unsigned fifoPos[FIFO_BLOCKS];
+      std::atomic<unsigned> widx;
+      std::atomic<unsigned> ridx;
+      std::vector<float> file;
+      std::atomic<bool> writing;    // The prefetch thread runs.
+      std::atomic<bool> stopped;
+
+      Render() : widx(0), ridx(0), writing(true), stopped(false) {}
+
+      // Audio thread, see AudioTrack::putFreezeData().
+      void put(unsigned pos) {
+            const unsigned w = widx.load(std::memory_order_relaxed);
+            if (w - ridx.load(std::memory_order_acquire) == FIFO_BLOCKS) {
+                  state.setOverrun();
+                  return;
+                  }
+            for (unsigned i = 0; i < FRAMES; ++i)
+                  fifo[w % FIFO_BLOCKS][i] = float(pos + i);
+            fifoPos[w % FIFO_BLOCKS] = pos;
+            widx.store(w + 1, std::memory_order_release);
+            state.blockPut();
+            }
+      // Prefetch thread, see AudioTrack::flushFreezeFifo().
+      void flush() {
+            unsigned r = ridx.load(std::memory_order_relaxed);
+            while (r != widx.load(std::memory_order_acquire)) {
+                  const unsigned pos = fifoPos[r % FIFO_BLOCKS];
+                  if (file.size() < pos + FRAMES)
+                        file.resize(pos + FRAMES);
+                  for (unsigned i = 0; i < FRAMES; ++i)
+                        file[pos + i] = fifo[r % FIFO_BLOCKS][i];
+                  ridx.store(++r, std::memory_order_release);
+                  state.blockWritten();
+                  }
+            }
+      };
+
+static void* prefetchThread(void* arg)
+      {
+      Render* r = static_cast<Render*>(arg);
+      while (!r->stopped.load()) {
+            if (r->writing.load())
+                  r->flush();
+            usleep(500);
+            }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   waitFlushed
+//    Song::flushFreeze() without the timer. Returns false
+//     if it timed out.
+//---------------------------------------------------------
+
+static bool waitFlushed(Render* r, uint64_t startUS)
+      {
+      while (!r->state.flushed()) {
+            if (FreezeState::flushTimedOut(startUS, nowUS()))
+                  return false;
+            usleep(10000);
+            }
+      return true;
+      }
+
+} // namespace MusEFreezeStateTest
+
+int main()
+      {
+      using namespace MusEFreezeStateTest;
+
+      {
+      Render* r = new Render();
+      pthread_t thread;
+      pthread_create(&thread, 0, prefetchThread, r);
+      // The bounce, the audio thread waits for room like freewheeling does.
+      for (unsigned b = 0; b < BLOCKS; ++b) {
+            while (r->widx.load() - r->ridx.load() == FIFO_BLOCKS)
+                  usleep(100);
+            r->put(b * FRAMES);
+            }
+      const uint64_t start = nowUS();
+      const bool flushed = waitFlushed(r, start);
+      printf("flushed %u blocks in %.1f ms\n", BLOCKS, (nowUS() - start) / 1000.0);
+      r->stopped.store(true);
+      pthread_join(thread, 0);
+
+      bool same = r->file.size() == BLOCKS * FRAMES;
+      for (unsigned i = 0; same && i < r->file.size(); ++i)
+            same = r->file[i] == float(i);
+      check(flushed, "the freeze file is flushed");
+      check(same, "every block is in the freeze file, in order");
+      check(!r->state.overrun() && !r->state.stale(), "no overrun, not stale");
+
+      // An edit of a part, plugin or automation the track was rendered from.
+      r->state.setStale();
+      check(r->state.stale(), "an edit marks the freeze stale");
+      // Freezing again.
+      r->state.reset();
+      check(!r->state.stale() && r->state.flushed(), "a new freeze file is not stale");
+      delete r;
+      }
+
+      {
+      // No prefetch thread, the fifo fills up.
+      Render* r = new Render();
+      for (unsigned b = 0; b < FIFO_BLOCKS; ++b)
+            r->put(b * FRAMES);
+      check(!r->state.overrun(), "a fifo with room takes the blocks");
+      r->put(FIFO_BLOCKS * FRAMES);
+      check(r->state.overrun(), "a full fifo drops the block and marks the overrun");
+      r->flush();
+      check(r->state.flushed() && r->file.size() == FIFO_BLOCKS * FRAMES, "the blocks before the overrun are flushed");
+      delete r;
+      }
+
+      {
+      // The prefetch thread stopped writing.
+      Render* r = new Render();
+      r->writing.store(false);
+      pthread_t thread;
+      pthread_create(&thread, 0, prefetchThread, r);
+      r->put(0);
+      // Started long enough ago that the first look times out.
+      const uint64_t start = nowUS() - uint64_t(FreezeState::FLUSH_TIMEOUT_MS) * 1000 + 50000;
+      const uint64_t t0 = nowUS();
+      const bool flushed = waitFlushed(r, start);
+      const double ms = (nowUS() - t0) / 1000.0;
+      r->stopped.store(true);
+      pthread_join(thread, 0);
+      printf("gave up after %.1f ms\n", ms);
+      check(!flushed && !r->state.flushed(), "waiting for a stopped prefetch thread times out");
+      check(!FreezeState::flushTimedOut(0, uint64_t(FreezeState::FLUSH_TIMEOUT_MS) * 1000)
+            && FreezeState::flushTimedOut(0, uint64_t(FreezeState::FLUSH_TIMEOUT_MS) * 1000 + 1),
+            "the timeout is FLUSH_TIMEOUT_MS");
+      delete r;
+      }
+
+      printf("%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
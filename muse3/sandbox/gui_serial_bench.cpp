@@ -0,0 +1,248 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  gui_serial_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Counts the mixer strip control refreshes of the heartbeat.
+//
+//   muse_gui_serial_bench [tracks] [seconds]
+//
+// Defaults to 64 tracks with 66 controller lists each (gain,
+//  pan and 8 plugins of 8 parameters) and 60 seconds of the
+//  default 20 Hz heartbeat. Runs AudioStrip::heartBeat's
+//  control check three ways:
+//   poll      every strip refreshes on every beat, as before
+//             the serials,
+//   global    one serial for all controller lists,
+//   per list  a serial per list and per track, summed like
+//             AudioTrack::ctrlGuiSerial(),
+//  each with a full refresh every FULL_UPDATE_BEATS beats, for
+//  an idle song, one knob being moved, and that plus four
+//  tracks playing automation. A refresh here reads every
+//  controller and formats its label, standing in for the
+//  widget updates, so the times are only a relative measure.
+//  The refresh counts are exact.
+//  Exits non-zero if a moved control is not shown by the next
+//  beat, or if per list refreshes more strips than global.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <atomic>
+#include <map>
+#include <vector>
+
+namespace MusEGuiSerialBench {
+
+static const int LISTS = 66;
+static const int FULL_UPDATE_BEATS = 16;   // AudioStrip::FULL_UPDATE_BEATS
+static const int AUTOMATED = 4;
+static int failures = 0;
+
+enum Mode { POLL, GLOBAL, PER_LIST };
+static const char* modeNames[] = { "poll", "global", "per list" };
+
+static std::atomic<unsigned> globalSerial(0);
+
+//---------------------------------------------------------
+//   List
+//    A CtrlList, its current value and serial.
+//---------------------------------------------------------
+
+struct List {
+      double cur;
+      std::atomic<unsigned> serial;
+      List() : cur(0.5), serial(0) {}
+      void setCurVal(double v) {
+            cur = v;
+            serial.fetch_add(1, std::memory_order_release);
+            globalSerial.fetch_add(1, std::memory_order_release);
+            }
+      };
+
+struct Track {
+      std::map<int, List*> controller;
+      std::atomic<unsigned> serial;
+      bool automated;
+      Track() : serial(0), automated(false) {
+            for (int i = 0; i < LISTS; ++i)
+                  controller[i] = new List();
+            }
+      ~Track() {
+            for (std::map<int, List*>::iterator i = controller.begin(); i != controller.end(); ++i)
+                  delete i->second;
+            }
+      unsigned ctrlGuiSerial() const {
+            unsigned s = serial.load(std::memory_order_acquire);
+            for (std::map<int, List*>::const_iterator i = controller.begin(); i != controller.end(); ++i)
+                  s += i->second->serial.load(std::memory_order_acquire);
+            return s;
+            }
+      };
+
+//---------------------------------------------------------
+//   Strip
+//    The control part of an AudioStrip.
+//---------------------------------------------------------
+
+struct Strip {
+      Track* track;
+      unsigned serial;
+      int fullCounter;
+      double shown[LISTS];
+      char label[LISTS][16];
+
+      Strip(Track* t, int n) : track(t), serial(0), fullCounter(n % FULL_UPDATE_BEATS) {
+            for (int i = 0; i < LISTS; ++i)
+                  shown[i] = -1.0;
+            }
+      void refresh() {
+            for (std::map<int, List*>::const_iterator i = track->controller.begin(); i != track->controller.end(); ++i) {
+                  const double v = i->second->cur;
+                  shown[i->first] = v;
+                  snprintf(label[i->first], sizeof(label[i->first]), "%.1f dB", 20.0 * log10(v + 1e-6));
+                  }
+            }
+      // Returns whether the controls were refreshed.
+      bool heartBeat(Mode mode, bool playing) {
+            const bool full = ++fullCounter >= FULL_UPDATE_BEATS;
+            if (full)
+                  fullCounter = 0;
+            bool changed = true;
+            unsigned s = 0;
+            if (mode == GLOBAL)
+                  s = globalSerial.load(std::memory_order_acquire);
+            else if (mode == PER_LIST)
+                  s = track->ctrlGuiSerial();
+            if (mode != POLL)
+                  changed = s != serial;
+            if (!(full || changed || (track->automated && playing)))
+                  return false;
+            serial = s;
+            refresh();
+            return true;
+            }
+      };
+
+static uint64_t nowNS()
+      {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+      }
+
+struct Result {
+      uint64_t refreshes;
+      double usPerBeat;
+      };
+
+//---------------------------------------------------------
+//   run
+//    knob: one control of track 0 moves on every beat.
+//    playing: the AUTOMATED tracks after it play automation.
+//---------------------------------------------------------
+
+static Result run(Mode mode, int tracks, int beats, bool knob, bool playing)
+      {
+      std::vector<Track*> tl;
+      std::vector<Strip*> strips;
+      for (int i = 0; i < tracks; ++i) {
+            tl.push_back(new Track());
+            tl.back()->automated = playing && i >= 1 && i <= AUTOMATED;
+            strips.push_back(new Strip(tl.back(), i));
+            }
+      for (int i = 0; i < tracks; ++i)
+            strips[i]->refresh();
+
+      Result r;
+      r.refreshes = 0;
+      uint64_t ns = 0;
+      bool stale = false;
+      for (int b = 0; b < beats; ++b) {
+            double v = 0.0;
+            if (knob) {
+                  v = 0.25 + 0.5 * (b % 100) / 100.0;
+                  tl[0]->controller[b % LISTS]->setCurVal(v);
+                  }
+            // The audio thread moves automated values without a serial bump.
+            for (int i = 0; i < tracks && playing; ++i)
+                  if (tl[i]->automated)
+                        tl[i]->controller[0]->cur = 0.1 + 0.8 * (b % 50) / 50.0;
+
+            const uint64_t t0 = nowNS();
+            for (int i = 0; i < tracks; ++i)
+                  if (strips[i]->heartBeat(mode, playing))
+                        ++r.refreshes;
+            ns += nowNS() - t0;
+            if (knob && strips[0]->shown[b % LISTS] != v)
+                  stale = true;
+            }
+      r.usPerBeat = double(ns) / beats / 1000.0;
+      if (stale) {
+            printf("  %s: a moved control was not shown by the next beat\n", modeNames[mode]);
+            ++failures;
+            }
+      for (int i = 0; i < tracks; ++i) {
+            delete strips[i];
+            delete tl[i];
+            }
+      return r;
+      }
+
+} // namespace MusEGuiSerialBench
+
+int main(int argc, char* argv[])
+      {
+      using namespace MusEGuiSerialBench;
+
+      const int tracks = argc > 1 ? atoi(argv[1]) : 64;
+      const int seconds = argc > 2 ? atoi(argv[2]) : 60;
+      const int beats = seconds * 20;
+      if (tracks <= AUTOMATED || beats <= 0) {
+            fprintf(stderr, "usage: %s [tracks > %d] [seconds > 0]\n", argv[0], AUTOMATED);
+            return 2;
+            }
+      printf("%d tracks, %d controller lists each, %d beats\n", tracks, LISTS, beats);
+
+      struct Scenario { const char* name; bool knob; bool playing; };
+      const Scenario scenarios[] = {
+            { "idle",                      false, false },
+            { "one knob moving",           true,  false },
+            { "knob and 4 automated",      true,  true  },
+            };
+      for (unsigned s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); ++s) {
+            printf("\n%s\n%-10s %12s %14s %12s\n", scenarios[s].name, "mode", "refreshes", "strips/beat", "us/beat");
+            Result r[3];
+            for (int m = POLL; m <= PER_LIST; ++m) {
+                  r[m] = run(Mode(m), tracks, beats, scenarios[s].knob, scenarios[s].playing);
+                  printf("%-10s %12lu %14.2f %12.1f\n", modeNames[m], (unsigned long)r[m].refreshes,
+                         double(r[m].refreshes) / beats, r[m].usPerBeat);
+                  }
+            if (r[PER_LIST].refreshes > r[GLOBAL].refreshes || r[GLOBAL].refreshes > r[POLL].refreshes) {
+                  printf("  per list refreshes more strips than global or poll\n");
+                  ++failures;
+                  }
+            }
+
+      printf("\n%s\n", failures ? "FAILED" : "ok");
+      return failures ? 1 : 0;
+      }
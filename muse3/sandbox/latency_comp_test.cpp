@@ -0,0 +1,290 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  latency_comp_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks the latency compensation on small mixer setups.
+//
+//   muse_latency_comp_test
+//
+// Each setup is a list of tracks with a latency of their own,
+//  a route to one other track and maybe an aux send. The delays
+//  come from computeLatencyDelays(), as Song works them out, and
+//  are run through LatencyCompensator the way AudioTrack does:
+//  the send half before the aux send, the output half after it.
+//  The plugins are stood in for by plain delays.
+// An impulse is sent from each track without inputs in turn, and
+//  the frames it reaches each output at are checked. With the
+//  compensation all paths must arrive on the same frame, that
+//  of the longest path. Without it, -2 means the paths arrive
+//  on different frames.
+// Then a track with a delay is muted, or turned off, for a while
+//  and switched back on, with the compensator handled as
+//  AudioTrack::copyData() does: Not run, and cleared, while the
+//  track is silent. Each frame played carries its own number, so
+//  any frame heard after unmuting that was played before is found.
+//  The same is shown for not clearing.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "latency_compensator.h"
+
+namespace MusELatencyCompTest {
+
+using MusECore::LatencyCompensator;
+using MusECore::LatencyEdge;
+
+static const unsigned long BLOCK = 64;
+static const unsigned long FRAMES = 4096;
+
+//---------------------------------------------------------
+//   Track
+//---------------------------------------------------------
+
+struct Track {
+      const char* name;
+      unsigned long own;      // Plugin latency.
+      int route;              // Track routed to, -1 for none.
+      int aux;                // Aux sent to, -1 for none.
+      bool output;
+      };
+
+//---------------------------------------------------------
+//   arrivals
+//    Runs an impulse from 'source' and returns the first
+//     frame it arrives at each output, -1 if it does not.
+//     Later arrivals on other frames are returned as -2.
+//     Tracks must come before the ones they feed.
+//---------------------------------------------------------
+
+static std::vector<long> arrivals(const std::vector<Track>& t, int source,
+                                  const std::vector<unsigned long>& sendDelay,
+                                  const std::vector<unsigned long>& routeDelay)
+      {
+      const size_t n = t.size();
+      std::vector<LatencyCompensator*> plugin(n), comp(n);
+      for (size_t i = 0; i < n; ++i) {
+            plugin[i] = new LatencyCompensator(1, 2048);
+            plugin[i]->setDelay(t[i].own);
+            // As AudioTrack::setLatencyCompensation() with Song's delays.
+            comp[i] = new LatencyCompensator(2, 2048);
+            comp[i]->setDelay(0, sendDelay[i]);
+            comp[i]->setDelay(1, routeDelay[i] > sendDelay[i] ? routeDelay[i] - sendDelay[i] : 0);
+            }
+      std::vector<std::vector<float> > in(n, std::vector<float>(BLOCK));
+      std::vector<long> arrive(n, -1);
+      for (unsigned long pos = 0; pos < FRAMES; pos += BLOCK) {
+            for (size_t i = 0; i < n; ++i)
+                  memset(&in[i][0], 0, BLOCK * sizeof(float));
+            if (pos == 0)
+                  in[source][0] = 1.0f;
+            for (size_t i = 0; i < n; ++i) {
+                  float* buf = &in[i][0];
+                  plugin[i]->run(BLOCK, &buf);
+                  comp[i]->run(BLOCK, &buf, 1, 0);
+                  if (t[i].aux >= 0)
+                        for (unsigned long k = 0; k < BLOCK; ++k)
+                              in[t[i].aux][k] += buf[k];
+                  comp[i]->run(BLOCK, &buf, 1, 1);
+                  if (t[i].route >= 0)
+                        for (unsigned long k = 0; k < BLOCK; ++k)
+                              in[t[i].route][k] += buf[k];
+                  if (t[i].output)
+                        for (unsigned long k = 0; k < BLOCK; ++k)
+                              if (buf[k] != 0.0f) {
+                                    if (arrive[i] == -1)
+                                          arrive[i] = pos + k;
+                                    else if (arrive[i] != long(pos + k))
+                                          arrive[i] = -2;
+                                    }
+                  }
+            }
+      for (size_t i = 0; i < n; ++i) {
+            delete plugin[i];
+            delete comp[i];
+            }
+      return arrive;
+      }
+
+//---------------------------------------------------------
+//   check
+//---------------------------------------------------------
+
+static bool check(const char* title, const std::vector<Track>& t, long expected)
+      {
+      const size_t n = t.size();
+      std::vector<unsigned long> own(n);
+      std::vector<bool> isOutput(n);
+      std::vector<bool> fed(n, false);
+      std::vector<LatencyEdge> edges;
+      for (size_t i = 0; i < n; ++i) {
+            own[i] = t[i].own;
+            isOutput[i] = t[i].output;
+            if (t[i].route >= 0) {
+                  LatencyEdge e = { int(i), t[i].route, false };
+                  edges.push_back(e);
+                  fed[t[i].route] = true;
+                  }
+            if (t[i].aux >= 0) {
+                  LatencyEdge e = { int(i), t[i].aux, true };
+                  edges.push_back(e);
+                  fed[t[i].aux] = true;
+                  }
+            }
+      std::vector<unsigned long> sendDelay, routeDelay;
+      MusECore::computeLatencyDelays(own, edges, isOutput, &sendDelay, &routeDelay);
+      const std::vector<unsigned long> none(n, 0);
+
+      printf("%s\n", title);
+      bool ok = true;
+      for (size_t s = 0; s < n; ++s) {
+            if (fed[s])
+                  continue;
+            const std::vector<long> with = arrivals(t, s, sendDelay, routeDelay);
+            const std::vector<long> without = arrivals(t, s, none, none);
+            for (size_t o = 0; o < n; ++o) {
+                  if (!t[o].output || without[o] == -1)
+                        continue;
+                  const bool good = with[o] == expected;
+                  ok &= good;
+                  printf("  %-8s to %-8s without %4ld  with %4ld  %s\n", t[s].name, t[o].name,
+                         without[o], with[o], good ? "ok" : "FAILED");
+                  }
+            }
+      return ok;
+      }
+
+//---------------------------------------------------------
+//   unmuted
+//    Plays a track with a send and an output delay, muted
+//     from block 'from' to block 'to'. Frame f of the track
+//     has the value f + 1. Returns how many frames heard
+//     after the mute came from before the unmute, and sets
+//     'late' if the track does not play on delayed by both
+//     delays once those have passed.
+//---------------------------------------------------------
+
+static long unmuted(bool clear, unsigned long from, unsigned long to, bool* late)
+      {
+      const unsigned long sendDelay = 100, outDelay = 60;
+      LatencyCompensator comp(2, 2048);
+      comp.setDelay(0, sendDelay);
+      comp.setDelay(1, outDelay);
+      std::vector<float> buf(BLOCK);
+      long stale = 0;
+      *late = false;
+      for (unsigned long b = 0; b < FRAMES / BLOCK; ++b) {
+            const unsigned long pos = b * BLOCK;
+            for (unsigned long k = 0; k < BLOCK; ++k)
+                  buf[k] = float(pos + k + 1);
+            float* p = &buf[0];
+            if (b >= from && b < to) {
+                  if (clear)
+                        comp.clear();
+                  continue;
+                  }
+            comp.run(BLOCK, &p, 1, 0);
+            comp.run(BLOCK, &p, 1, 1);
+            if (b < to)
+                  continue;
+            for (unsigned long k = 0; k < BLOCK; ++k) {
+                  if (buf[k] != 0.0f && buf[k] <= float(to * BLOCK))
+                        ++stale;
+                  const unsigned long f = pos + k;
+                  if (f >= to * BLOCK + sendDelay + outDelay && buf[k] != float(f + 1 - sendDelay - outDelay))
+                        *late = true;
+                  }
+            }
+      return stale;
+      }
+
+} // namespace MusELatencyCompTest
+
+int main()
+      {
+      using namespace MusELatencyCompTest;
+      int failed = 0;
+
+      // A plugin on one of two tracks.
+      {
+      const Track t[] = {
+            { "dry",   0,   2, -1, false },
+            { "comp",  32,  2, -1, false },
+            { "out",   0,  -1, -1, true  },
+            };
+      failed += !check("two tracks, one with a 32 frame plugin", std::vector<Track>(t, t + 3), 32);
+      }
+
+      // Group and aux return: the dry path of 'send' waits for the reverb.
+      {
+      const Track t[] = {
+            { "dry",   0,   5, -1, false },
+            { "comp",  32,  4, -1, false },
+            { "send",  0,   5,  3, false },
+            { "reverb",100, 5, -1, false },
+            { "group", 64,  5, -1, false },
+            { "out",   0,  -1, -1, true  },
+            };
+      failed += !check("group with a plugin, aux return", std::vector<Track>(t, t + 6), 100);
+      }
+
+      // Groups in groups.
+      {
+      const Track t[] = {
+            { "a",     10,  3, -1, false },
+            { "b",     0,   4, -1, false },
+            { "c",     200, 5, -1, false },
+            { "sub",   20,  4, -1, false },
+            { "bus",   5,   5, -1, false },
+            { "out",   0,  -1, -1, true  },
+            };
+      failed += !check("nested groups", std::vector<Track>(t, t + 6), 200);
+      }
+
+      // Two outputs, one with a limiter on it, leave together.
+      {
+      const Track t[] = {
+            { "main",  0,   2, -1, false },
+            { "phones",16,  3, -1, false },
+            { "out 1", 128,-1, -1, true  },
+            { "out 2", 0,  -1, -1, true  },
+            };
+      failed += !check("two outputs", std::vector<Track>(t, t + 4), 128);
+      }
+
+      // Muted or off for 10 blocks.
+      {
+      bool late = false;
+      const long before = unmuted(false, 4, 14, &late);
+      const long stale = unmuted(true, 4, 14, &late);
+      const bool ok = stale == 0 && !late;
+      printf("muted track, delays of 100 and 60 frames\n");
+      printf("  stale frames heard after unmuting: not cleared %ld, cleared %ld  %s\n",
+             before, stale, ok ? "ok" : "FAILED");
+      failed += !ok;
+      }
+
+      printf("%s\n", failed ? "FAILED" : "all ok");
+      return failed ? 1 : 0;
+      }
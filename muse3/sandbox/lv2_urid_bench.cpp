@@ -0,0 +1,186 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2_urid_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times LV2 uri to id mapping from several threads at once.
+//
+//   muse_lv2_urid_bench [maxThreads [uris [seconds]]]
+//
+// Each thread maps the given number of uris (200 by default)
+//  over and over, for 1, 2, 4 ... maxThreads threads. The
+//  map used by MusE is compared with the std::map under a
+//  mutex it replaced. The 'new' column has every thread
+//  also add a new uri each 1000 lookups.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lv2urid.h"
+
+namespace MusELv2UridBench {
+
+//---------------------------------------------------------
+//   MutexMap
+//    What the LV2 host used before.
+//---------------------------------------------------------
+
+struct CmpStr {
+      bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+      };
+
+class MutexMap {
+      std::map<const char*, uint32_t, CmpStr> _map;
+      std::map<uint32_t, const char*> _rmap;
+      uint32_t _nextId;
+      pthread_mutex_t _lock;
+
+   public:
+      MutexMap() : _nextId(1) { pthread_mutex_init(&_lock, NULL); }
+      ~MutexMap() {
+            for (std::map<const char*, uint32_t, CmpStr>::iterator i = _map.begin(); i != _map.end(); ++i)
+                  free((void*)i->first);
+            pthread_mutex_destroy(&_lock);
+            }
+      uint32_t map(const char* uri) {
+            pthread_mutex_lock(&_lock);
+            uint32_t id;
+            std::map<const char*, uint32_t, CmpStr>::iterator i = _map.find(uri);
+            if (i == _map.end()) {
+                  const char* u = strdup(uri);
+                  _map.insert(std::make_pair(u, _nextId));
+                  _rmap.insert(std::make_pair(_nextId, u));
+                  id = _nextId++;
+                  }
+            else
+                  id = i->second;
+            pthread_mutex_unlock(&_lock);
+            return id;
+            }
+      };
+
+//---------------------------------------------------------
+//   Run
+//---------------------------------------------------------
+
+struct Run {
+      MusECore::LV2UridBiMap* lockFree;
+      MutexMap* mutexMap;
+      const std::vector<std::string>* uris;
+      bool insert;
+      int thread;
+      std::atomic<bool>* stop;
+      uint64_t count;
+      };
+
+static void* runThread(void* arg)
+      {
+      Run* r = (Run*)arg;
+      const std::vector<std::string>& uris = *r->uris;
+      const size_t n = uris.size();
+      uint64_t count = 0;
+      uint64_t passes = 0;
+      uint32_t sum = 0;
+      char extra[64];
+      while (!r->stop->load(std::memory_order_relaxed)) {
+            for (size_t i = 0; i < n; ++i) {
+                  const char* u = uris[i].c_str();
+                  sum += r->lockFree ? r->lockFree->map(u) : r->mutexMap->map(u);
+                  }
+            count += n;
+            if (r->insert && ++passes % (1000 / n + 1) == 0) {
+                  snprintf(extra, sizeof(extra), "urn:muse:bench:%d:%llu", r->thread, (unsigned long long)count);
+                  sum += r->lockFree ? r->lockFree->map(extra) : r->mutexMap->map(extra);
+                  ++count;
+                  }
+            }
+      r->count = count + (sum == 0xffffffff);   // Keep the lookups.
+      return 0;
+      }
+
+static double measure(bool lockFree, bool insert, int threads, const std::vector<std::string>& uris, double seconds)
+      {
+      MusECore::LV2UridBiMap lf;
+      MutexMap mm;
+      for (size_t i = 0; i < uris.size(); ++i) {
+            lf.map(uris[i].c_str());
+            mm.map(uris[i].c_str());
+            }
+      std::atomic<bool> stop(false);
+      std::vector<Run> runs(threads);
+      std::vector<pthread_t> tids(threads);
+      for (int i = 0; i < threads; ++i) {
+            runs[i].lockFree = lockFree ? &lf : 0;
+            runs[i].mutexMap = lockFree ? 0 : &mm;
+            runs[i].uris     = &uris;
+            runs[i].insert   = insert;
+            runs[i].thread   = i;
+            runs[i].stop     = &stop;
+            runs[i].count    = 0;
+            pthread_create(&tids[i], NULL, runThread, &runs[i]);
+            }
+      usleep(useconds_t(seconds * 1000000.0));
+      stop.store(true);
+      uint64_t total = 0;
+      for (int i = 0; i < threads; ++i) {
+            pthread_join(tids[i], NULL);
+            total += runs[i].count;
+            }
+      return total / seconds / 1000000.0;
+      }
+
+} // namespace MusELv2UridBench
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char* argv[])
+      {
+      const int maxThreads = argc > 1 ? atoi(argv[1]) : 8;
+      const int count      = argc > 2 ? atoi(argv[2]) : 200;
+      const double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+
+      std::vector<std::string> uris;
+      char buf[128];
+      for (int i = 0; i < count; ++i) {
+            snprintf(buf, sizeof(buf), "http://lv2plug.in/ns/ext/bench#uri%d", i);
+            uris.push_back(buf);
+            }
+
+      printf("million maps per second, %d uris\n", count);
+      printf("%7s %10s %10s %10s %10s\n", "threads", "mutex", "lockfree", "mutex new", "lf new");
+      for (int t = 1; t <= maxThreads; t *= 2) {
+            printf("%7d %10.2f %10.2f %10.2f %10.2f\n", t,
+                   MusELv2UridBench::measure(false, false, t, uris, seconds),
+                   MusELv2UridBench::measure(true, false, t, uris, seconds),
+                   MusELv2UridBench::measure(false, true, t, uris, seconds),
+                   MusELv2UridBench::measure(true, true, t, uris, seconds));
+            }
+      return 0;
+      }
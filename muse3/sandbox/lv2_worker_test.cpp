@@ -0,0 +1,405 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  lv2_worker_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Stress test of the LV2 worker rings and pool.
+//
+//   muse_lv2_worker_test [instances [seconds]]
+//
+// A run thread schedules one request per instance (300 by
+//  default) every millisecond for 2 seconds, and passes the
+//  responses back after each cycle, as LV2Synth does. The
+//  work is done once by the LV2WorkerPool and once by one
+//  thread per instance, as before the pool. Instance 0 works
+//  slowly on big requests, so its request ring overflows.
+//  Prints the threads of the process and the time from a
+//  request to its response. Also checks the rings on their
+//  own, and that LV2WorkerPool::claim() gives up in time.
+//  Exits non-zero if any check fails: two threads working
+//  for one instance at once, a response out of order or
+//  missing, a full ring not refusing, or a claim timing out
+//  wrongly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "lv2worker.h"
+
+namespace MusELv2WorkerTest {
+
+using MusECore::LV2WorkerRing;
+using MusECore::LV2WorkerClient;
+using MusECore::LV2WorkerPool;
+
+static const uint32_t RING_SIZE = 8192;     // LV2_WORKER_RING_SIZE
+static const int POOL_THREADS = 4;          // LV2_WORKER_MAX_THREADS
+static const unsigned CYCLE_US = 1000;
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+static uint64_t nowUS()
+      {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+      }
+
+static int processThreads()
+      {
+      FILE* f = fopen("/proc/self/status", "r");
+      if (!f)
+            return -1;
+      char line[256];
+      int n = -1;
+      while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "Threads: %d", &n) == 1)
+                  break;
+      fclose(f);
+      return n;
+      }
+
+struct Request {
+      uint32_t seq;
+      uint64_t timeUS;
+      };
+
+struct Response {
+      uint32_t seq;
+      uint64_t requestUS;
+      uint64_t doneUS;
+      };
+
+//---------------------------------------------------------
+//   Instance
+//    A plugin with a worker interface.
+//---------------------------------------------------------
+
+struct Instance : public LV2WorkerClient {
+      bool slow;
+      std::atomic<int> inWork;
+      std::atomic<bool> overlapped;
+      std::atomic<unsigned> badData;
+      std::atomic<unsigned> lostResponses;
+      // Run thread only.
+      uint32_t nextSeq;
+      uint32_t expectSeq;
+      unsigned accepted;
+      unsigned dropped;
+      bool outOfOrder;
+      char buf[RING_SIZE];
+      // One thread per instance.
+      pthread_t thread;
+      sem_t sem;
+      std::atomic<bool> closing;
+
+      Instance(bool s) : slow(s), inWork(0), overlapped(false), badData(0), lostResponses(0),
+                         nextSeq(0), expectSeq(0), accepted(0), dropped(0), outOfOrder(false), closing(false) {
+            wrkRequests = new LV2WorkerRing(RING_SIZE);
+            wrkResponses = new LV2WorkerRing(RING_SIZE);
+            sem_init(&sem, 0, 0);
+            }
+      ~Instance() {
+            delete wrkRequests;
+            delete wrkResponses;
+            sem_destroy(&sem);
+            }
+      uint32_t requestSize(uint32_t seq) const {
+            return slow ? 1000 : sizeof(Request) + (seq * 37) % 500;
+            }
+      };
+
+//---------------------------------------------------------
+//   work
+//    What the plugin does: checks the request and responds.
+//---------------------------------------------------------
+
+static void work(LV2WorkerClient* client, uint32_t size, const void* data)
+      {
+      Instance* in = static_cast<Instance*>(client);
+      if (in->inWork.fetch_add(1) != 0)
+            in->overlapped.store(true);
+      Request rq;
+      memcpy(&rq, data, sizeof(rq));
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      if (size != in->requestSize(rq.seq))
+            in->badData.fetch_add(1);
+      for (uint32_t i = sizeof(Request); i < size; ++i)
+            if (p[i] != (unsigned char)(rq.seq + i)) {
+                  in->badData.fetch_add(1);
+                  break;
+                  }
+      if (in->slow)
+            usleep(20000);
+      Response rs;
+      rs.seq = rq.seq;
+      rs.requestUS = rq.timeUS;
+      rs.doneUS = nowUS();
+      in->inWork.fetch_sub(1);
+      if (!in->wrkResponses->put(sizeof(rs), &rs))
+            in->lostResponses.fetch_add(1);
+      }
+
+static void* instanceThread(void* arg)
+      {
+      Instance* in = static_cast<Instance*>(arg);
+      char* buf = new char[RING_SIZE];
+      while (true) {
+            while (sem_wait(&in->sem) == -1)
+                  ;
+            if (in->closing.load())
+                  break;
+            uint32_t size;
+            while (in->wrkRequests->get(&size, buf))
+                  work(in, size, buf);
+            }
+      delete[] buf;
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   emitResponses
+//    LV2Synth::lv2wrk_emitResponses(). Run thread.
+//---------------------------------------------------------
+
+static void emitResponses(Instance* in, std::vector<uint32_t>* latency)
+      {
+      uint32_t size;
+      while (in->wrkResponses->get(&size, in->buf)) {
+            Response rs;
+            memcpy(&rs, in->buf, sizeof(rs));
+            if (rs.seq != in->expectSeq)
+                  in->outOfOrder = true;
+            in->expectSeq = rs.seq + 1;
+            latency->push_back(uint32_t(rs.doneUS - rs.requestUS));
+            }
+      }
+
+//---------------------------------------------------------
+//   schedule
+//    LV2Synth::lv2wrk_scheduleWork() in run context.
+//---------------------------------------------------------
+
+static void schedule(Instance* in, LV2WorkerPool* pool)
+      {
+      const uint32_t size = in->requestSize(in->nextSeq);
+      Request rq;
+      rq.seq = in->nextSeq;
+      rq.timeUS = nowUS();
+      memcpy(in->buf, &rq, sizeof(rq));
+      for (uint32_t i = sizeof(Request); i < size; ++i)
+            in->buf[i] = (char)(rq.seq + i);
+      if (!in->wrkRequests->put(size, in->buf)) {
+            ++in->dropped;
+            return;
+            }
+      ++in->accepted;
+      ++in->nextSeq;
+      if (pool) {
+            if (!in->wrkBusy.exchange(true))
+                  pool->push(in);
+            }
+      else
+            sem_post(&in->sem);
+      }
+
+//---------------------------------------------------------
+//   stress
+//    With pool 0, one thread per instance.
+//---------------------------------------------------------
+
+static void stress(bool usePool, int instances, int seconds)
+      {
+      const int threadsBefore = processThreads();
+      std::vector<Instance*> il;
+      for (int i = 0; i < instances; ++i)
+            il.push_back(new Instance(i == 0));
+      LV2WorkerPool* pool = 0;
+      if (usePool)
+            pool = new LV2WorkerPool(POOL_THREADS, work, RING_SIZE);
+      else
+            for (int i = 0; i < instances; ++i)
+                  pthread_create(&il[i]->thread, 0, instanceThread, il[i]);
+      const int threads = processThreads() - threadsBefore;
+
+      std::vector<uint32_t> latency;
+      latency.reserve(size_t(instances) * seconds * 1000000 / CYCLE_US);
+      const uint64_t end = nowUS() + uint64_t(seconds) * 1000000;
+      uint64_t next = nowUS();
+      while (nowUS() < end) {
+            for (int i = 0; i < instances; ++i) {
+                  emitResponses(il[i], &latency);
+                  schedule(il[i], pool);
+                  }
+            next += CYCLE_US;
+            const uint64_t now = nowUS();
+            if (next > now)
+                  usleep(next - now);
+            }
+      // Let the work finish.
+      const uint64_t deadline = nowUS() + 10000000;
+      bool done = false;
+      while (!done && nowUS() < deadline) {
+            done = true;
+            for (int i = 0; i < instances; ++i) {
+                  emitResponses(il[i], &latency);
+                  if (il[i]->expectSeq != il[i]->accepted)
+                        done = false;
+                  }
+            if (!done)
+                  usleep(1000);
+            }
+
+      if (pool)
+            delete pool;
+      else
+            for (int i = 0; i < instances; ++i) {
+                  il[i]->closing.store(true);
+                  sem_post(&il[i]->sem);
+                  pthread_join(il[i]->thread, 0);
+                  }
+
+      bool overlapped = false, outOfOrder = false;
+      unsigned badData = 0, lost = 0, accepted = 0, dropped = 0;
+      for (int i = 0; i < instances; ++i) {
+            overlapped = overlapped || il[i]->overlapped.load();
+            outOfOrder = outOfOrder || il[i]->outOfOrder;
+            badData += il[i]->badData.load();
+            lost += il[i]->lostResponses.load();
+            accepted += il[i]->accepted;
+            dropped += il[i]->dropped;
+            }
+      const unsigned slowDropped = il[0]->dropped;
+      for (int i = 0; i < instances; ++i)
+            delete il[i];
+
+      std::sort(latency.begin(), latency.end());
+      const size_t n = latency.size();
+      printf("\n%s: %d worker threads for %d instances\n", usePool ? "pool" : "thread per instance", threads, instances);
+      printf("  %u requests, %u refused by a full ring (%u of them the slow instance)\n", accepted, dropped, slowDropped);
+      if (n)
+            printf("  request to response: p50 %u us, p99 %u us, max %u us\n",
+                   latency[n / 2], latency[(n - 1) * 99 / 100], latency[n - 1]);
+      check(!overlapped, "no instance worked on by two threads at once");
+      check(badData == 0, "every request arrived intact");
+      check(done && lost == 0 && !outOfOrder, "every request answered, in order");
+      check(slowDropped > 0 && dropped == slowDropped, "only the slow instance overflowed its ring");
+      if (usePool)
+            check(threads == POOL_THREADS, "the pool has its threads only");
+      }
+
+//---------------------------------------------------------
+//   ringChecks
+//---------------------------------------------------------
+
+static void ringChecks()
+      {
+      LV2WorkerRing r(RING_SIZE);
+      char msg[RING_SIZE];
+      char out[RING_SIZE];
+      check(!r.put(r.maxSize() + 1, msg) && r.put(r.maxSize(), msg), "the largest message fits an empty ring");
+      uint32_t size = 0;
+      check(r.get(&size, out) && size == r.maxSize() && r.empty(), "and comes out whole");
+
+      // 100 bytes and the size each, the ring wrapping around.
+      unsigned put = 0;
+      for (uint32_t i = 0; i < 100; ++i)
+            msg[i] = (char)i;
+      while (r.put(100, msg))
+            ++put;
+      check(put == RING_SIZE / (100 + sizeof(uint32_t)), "a full ring refuses the next message");
+      bool same = true;
+      unsigned got = 0;
+      while (r.get(&size, out)) {
+            same = same && size == 100 && memcmp(msg, out, 100) == 0;
+            ++got;
+            }
+      check(same && got == put, "every message put comes out intact");
+      }
+
+//---------------------------------------------------------
+//   claimChecks
+//---------------------------------------------------------
+
+static std::atomic<unsigned> claimWorks(0);
+
+static void countWork(LV2WorkerClient*, uint32_t, const void*)
+      {
+      claimWorks.fetch_add(1);
+      }
+
+static void claimChecks()
+      {
+      Instance in(false);
+      LV2WorkerPool pool(1, countWork, RING_SIZE);
+      check(LV2WorkerPool::claim(&in, 50), "claim of an idle instance");
+
+      // Held, as by a pool thread stuck in work().
+      const uint64_t t0 = nowUS();
+      const bool claimed = LV2WorkerPool::claim(&in, 50);
+      const uint64_t ms = (nowUS() - t0) / 1000;
+      printf("claim of a busy instance gave up after %lu ms\n", (unsigned long)ms);
+      check(!claimed && ms >= 50 && ms < 1000, "claim of a busy instance gives up in time");
+
+      // A request put while claimed is done after the release.
+      char msg[16] = { 0 };
+      in.wrkRequests->put(sizeof(msg), msg);
+      pool.release(&in);
+      for (int i = 0; i < 1000 && claimWorks.load() == 0; ++i)
+            usleep(1000);
+      check(claimWorks.load() == 1 && LV2WorkerPool::claim(&in, 1000), "requests put while claimed are done after release");
+      }
+
+} // namespace MusELv2WorkerTest
+
+int main(int argc, char* argv[])
+      {
+      using namespace MusELv2WorkerTest;
+
+      const int instances = argc > 1 ? atoi(argv[1]) : 300;
+      const int seconds = argc > 2 ? atoi(argv[2]) : 2;
+      if (instances < 2 || seconds <= 0) {
+            fprintf(stderr, "usage: %s [instances > 1] [seconds > 0]\n", argv[0]);
+            return 2;
+            }
+
+      ringChecks();
+      claimChecks();
+      stress(true, instances, seconds);
+      stress(false, instances, seconds);
+
+      printf("\n%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
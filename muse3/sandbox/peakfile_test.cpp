@@ -0,0 +1,372 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  peakfile_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks PeakFile against a wave file of known levels, and
+//  times building it.
+//
+//   muse_peakfile_test [dir [seconds]]
+//
+// Writes a stereo wave file of 'seconds' (default 600) at
+//  48 kHz into 'dir' (default /tmp): The left channel is a
+//  DC level of 0.5, the right one a square wave of +-0.25.
+//  Then checks
+//   - the peak and rms read back at every level, also near
+//     the end where fewer bins are there than asked for,
+//   - that the file maps again with open(),
+//   - that a cancelled build is not building any more and
+//     leaves no temporary file behind,
+//   - that two builds of the same peak file at once both
+//     succeed,
+//   - that the PeakBuilder pool fills several files with its
+//     threads, reports progress, cancels a file being filled
+//     and drops queued files when stopped, and how much faster
+//     than one file after another it is.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <sndfile.h>
+
+#include <QString>
+
+#include "peakfile.h"
+#include "peakbuilder.h"
+#include "wave.h"
+
+// peakbuilder.cpp prints its thread count with debugMsg.
+namespace MusEGlobal {
+bool debugMsg = false;
+}
+
+namespace MusEPeakFileTest {
+
+using MusECore::PeakFile;
+using MusECore::SampleV;
+
+static const int RATE = 48000;
+static int failures = 0;
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+//---------------------------------------------------------
+//   writeWave
+//---------------------------------------------------------
+
+static bool writeWave(const QString& path, sf_count_t frames)
+      {
+      SF_INFO info;
+      memset(&info, 0, sizeof(info));
+      info.samplerate = RATE;
+      info.channels   = 2;
+      info.format     = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+      SNDFILE* sf = sf_open(path.toLocal8Bit().constData(), SFM_WRITE, &info);
+      if (!sf)
+            return false;
+      std::vector<float> buf(2 * 4096);
+      for (sf_count_t pos = 0; pos < frames; pos += 4096) {
+            const sf_count_t n = std::min(sf_count_t(4096), frames - pos);
+            for (sf_count_t i = 0; i < n; ++i) {
+                  buf[2 * i]     = 0.5f;
+                  buf[2 * i + 1] = ((pos + i) & 64) ? 0.25f : -0.25f;
+                  }
+            sf_writef_float(sf, &buf[0], n);
+            }
+      sf_close(sf);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   levelsOk
+//    Reads at every magnification, all over the file and
+//     right at its end. In SampleV a peak of 0.5 is 127 and
+//     of 0.25 is 63, an rms of 0.5 is 128 and of 0.25 is 64.
+//---------------------------------------------------------
+
+static bool levelsOk(const PeakFile& pf, sf_count_t frames)
+      {
+      for (int mag = PeakFile::BASE_MAG; mag <= PeakFile::BASE_MAG << 12; mag <<= 1) {
+            std::vector<sf_count_t> positions;
+            for (sf_count_t pos = 0; pos < frames; pos += frames / 7)
+                  positions.push_back(pos);
+            // Only part of the bins asked for are left here.
+            positions.push_back(frames - PeakFile::BASE_MAG);
+            positions.push_back(frames - 1);
+            for (unsigned k = 0; k < positions.size(); ++k) {
+                  SampleV s[2];
+                  memset(s, 0, sizeof(s));
+                  pf.read(s, 2, mag, positions[k], true);
+                  if (s[0].peak != 127 || s[0].rms != 128 || s[1].peak != 63 || s[1].rms != 64) {
+                        printf("  mag %d pos %ld: left %d/%d right %d/%d\n", mag, long(positions[k]),
+                               s[0].peak, s[0].rms, s[1].peak, s[1].rms);
+                        return false;
+                        }
+                  }
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   tempFilesLeft
+//---------------------------------------------------------
+
+static int tempFilesLeft(const QString& dir, const QString& name)
+      {
+      int n = 0;
+      DIR* d = opendir(dir.toLocal8Bit().constData());
+      if (!d)
+            return 0;
+      const QByteArray prefix = (name + ".").toLocal8Bit();
+      while (struct dirent* e = readdir(d))
+            if (strncmp(e->d_name, prefix.constData(), prefix.size()) == 0)
+                  ++n;
+      closedir(d);
+      return n;
+      }
+
+static bool cancelAtOnce(void*, sf_count_t, sf_count_t)
+      {
+      return false;
+      }
+
+struct FillJob {
+      PeakFile* pf;
+      bool ok;
+      };
+
+static void* fillThread(void* arg)
+      {
+      FillJob* job = (FillJob*)arg;
+      job->ok = job->pf->fill();
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   waitBuilt
+//    Waits up to 'seconds' for none of the files to be
+//     building any more. True if they all got there.
+//---------------------------------------------------------
+
+static bool waitBuilt(PeakFile* files, int n, double seconds)
+      {
+      const double deadline = now() + seconds;
+      for (;;) {
+            bool building = false;
+            for (int i = 0; i < n; ++i)
+                  if (files[i].isBuilding())
+                        building = true;
+            if (!building)
+                  return true;
+            if (now() > deadline)
+                  return false;
+            usleep(1000);
+            }
+      }
+
+static QString poolPeakPath(const QString& dir, int i)
+      {
+      return dir + QString("/muse_peakfile_pool_%1.wca").arg(i);
+      }
+
+//---------------------------------------------------------
+//   poolChecks
+//    POOL_FILES peak files of the same wave file through
+//     the PeakBuilder, timed against filling them one
+//     after another in this thread.
+//---------------------------------------------------------
+
+static const int POOL_FILES = 8;
+
+static void poolChecks(const QString& dir, const QString& wave, sf_count_t frames, int seconds)
+      {
+      using MusECore::PeakBuilder;
+      using MusECore::MAX_PEAK_BUILDER_THREADS;
+
+      for (int i = 0; i < POOL_FILES; ++i)
+            unlink(poolPeakPath(dir, i).toLocal8Bit().constData());
+
+      double serial;
+      {
+      PeakFile files[POOL_FILES];
+      const double t0 = now();
+      for (int i = 0; i < POOL_FILES; ++i)
+            files[i].build(poolPeakPath(dir, i), wave);
+      serial = now() - t0;
+      for (int i = 0; i < POOL_FILES; ++i)
+            unlink(poolPeakPath(dir, i).toLocal8Bit().constData());
+      }
+
+      {
+      PeakBuilder pb;
+      pb.start(MAX_PEAK_BUILDER_THREADS);
+      check(pb.isRunning(), "pool started");
+      PeakFile files[POOL_FILES];
+      bool created = true;
+      for (int i = 0; i < POOL_FILES; ++i)
+            created = files[i].create(poolPeakPath(dir, i), wave) && created;
+      const double t0 = now();
+      for (int i = 0; i < POOL_FILES; ++i)
+            pb.add(&files[i]);
+      // Far more than any disk needs, only to not hang on a bug.
+      const bool done = waitBuilt(files, POOL_FILES, 60.0 + seconds);
+      const double pooled = now() - t0;
+      printf("%d files of %d s: one after another %.3f s, pool of %d threads %.3f s (%.2fx)\n",
+             POOL_FILES, seconds, serial, MAX_PEAK_BUILDER_THREADS, pooled, serial / pooled);
+      check(created && done, "pool fills all files");
+      check(pb.takeUpdate(), "pool reports progress");
+      check(!pb.takeUpdate(), "progress is taken only once");
+      bool levels = true;
+      for (int i = 0; i < POOL_FILES; ++i)
+            levels = levelsOk(files[i], frames) && levels;
+      check(levels, "pool built files give the right levels");
+      for (int i = 0; i < POOL_FILES; ++i) {
+            PeakFile c;
+            levels = c.open(poolPeakPath(dir, i), wave, 2, frames) && levels;
+            }
+      check(levels, "pool built files map again with open()");
+      pb.stop();
+      check(!pb.isRunning(), "pool stopped");
+      }
+
+      for (int i = 0; i < POOL_FILES; ++i)
+            unlink(poolPeakPath(dir, i).toLocal8Bit().constData());
+
+      {
+      // One thread, so all but the first file wait in the queue.
+      PeakBuilder pb;
+      pb.start(1);
+      PeakFile files[POOL_FILES];
+      for (int i = 0; i < POOL_FILES; ++i)
+            files[i].create(poolPeakPath(dir, i), wave);
+      for (int i = 0; i < POOL_FILES; ++i)
+            pb.add(&files[i]);
+      // Let the worker pick up the first one.
+      const double deadline = now() + 5.0;
+      while (!pb.takeUpdate() && now() < deadline)
+            usleep(100);
+      pb.cancel(&files[0]);
+      check(!files[0].isBuilding(), "cancel waits for the file being filled");
+      pb.cancel(&files[POOL_FILES - 1]);
+      check(files[POOL_FILES - 1].isBuilding(), "a cancelled queued file is left to its owner");
+      files[POOL_FILES - 1].abort();
+      pb.stop();
+      bool dropped = true;
+      for (int i = 1; i < POOL_FILES; ++i)
+            dropped = !files[i].isBuilding() && dropped;
+      check(dropped, "stop drops the queued files");
+      int left = 0;
+      for (int i = 0; i < POOL_FILES; ++i)
+            left += tempFilesLeft(dir, QString("muse_peakfile_pool_%1.wca").arg(i));
+      check(left == 0, "no temporary files left after cancel and stop");
+      }
+
+      for (int i = 0; i < POOL_FILES; ++i)
+            unlink(poolPeakPath(dir, i).toLocal8Bit().constData());
+      }
+
+} // namespace MusEPeakFileTest
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEPeakFileTest;
+      const QString dir = argc > 1 ? QString(argv[1]) : QString("/tmp");
+      const int seconds = argc > 2 ? atoi(argv[2]) : 600;
+      // Not a whole number of bins, to have a short last bin.
+      const sf_count_t frames = sf_count_t(seconds) * RATE + 50;
+      const QString wave = dir + "/muse_peakfile_test.wav";
+      const QString peak = dir + "/muse_peakfile_test.wca";
+      unlink(peak.toLocal8Bit().constData());
+
+      if (!writeWave(wave, frames)) {
+            printf("cannot write %s\n", wave.toLocal8Bit().constData());
+            return 2;
+            }
+
+      {
+      PeakFile pf;
+      const double t0 = now();
+      const bool ok = pf.build(peak, wave);
+      const double t = now() - t0;
+      printf("built %d s of stereo in %.3f s (%.0fx realtime), %d levels\n",
+             seconds, t, seconds / t, pf.levels());
+      check(ok && !pf.isBuilding(), "build");
+      check(levelsOk(pf, frames), "peak and rms at all levels and at the end");
+      }
+
+      {
+      PeakFile pf;
+      check(pf.open(peak, wave, 2, frames), "open the built file");
+      check(levelsOk(pf, frames), "peak and rms read from the mapped file");
+      }
+
+      {
+      unlink(peak.toLocal8Bit().constData());
+      PeakFile pf;
+      const bool created = pf.create(peak, wave);
+      check(created && pf.isBuilding(), "create is building");
+      const bool filled = pf.fill(cancelAtOnce, 0);
+      check(!filled && !pf.isBuilding(), "cancelled fill is not building");
+      check(tempFilesLeft(dir, "muse_peakfile_test.wca") == 0, "cancelled fill leaves no files");
+      }
+
+      {
+      PeakFile a, b;
+      const bool created = a.create(peak, wave) && b.create(peak, wave);
+      FillJob ja = { &a, false };
+      FillJob jb = { &b, false };
+      pthread_t ta, tb;
+      pthread_create(&ta, 0, fillThread, &ja);
+      pthread_create(&tb, 0, fillThread, &jb);
+      pthread_join(ta, 0);
+      pthread_join(tb, 0);
+      check(created && ja.ok && jb.ok, "two builds of one file at once");
+      check(levelsOk(a, frames) && levelsOk(b, frames), "both give the right levels");
+      check(tempFilesLeft(dir, "muse_peakfile_test.wca") == 0, "no temporary files left");
+      PeakFile c;
+      check(c.open(peak, wave, 2, frames) && levelsOk(c, frames), "the file left behind is good");
+      }
+
+      poolChecks(dir, wave, frames, seconds);
+
+      unlink(peak.toLocal8Bit().constData());
+      unlink(wave.toLocal8Bit().constData());
+      printf("%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
@@ -0,0 +1,149 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  plugin_scan_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times the plugin cache check MusE does at startup.
+//
+//   muse_plugin_scan_bench plugin.so [copies [dir]]
+//
+// Fills dir/ladspa with copies (2000 by default) of the given
+//  LADSPA plugin and points LADSPA_PATH there, then times:
+//    cold     no cache yet, every file is scanned
+//    warm     nothing changed, the cache file is read
+//    added    one more plugin, only that one is scanned
+//    forced   a rescan of everything, as with -R
+// The copies all have the same label, so expect a duplicate
+//  message for each when the results are read. Needs the
+//  muse_plugin_scan program installed.
+// First it checks that a path outside Latin-1 is still found
+//  in the cache index after writing and reading it back.
+//  Exits non-zero if that fails.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+#include "plugin_cache_writer.h"
+#include "plugin_list.h"
+
+namespace MusEPluginScanBench {
+
+//---------------------------------------------------------
+//   fill
+//---------------------------------------------------------
+
+static bool fill(const QString& src, const QString& dir, int first, int count)
+      {
+      for (int i = first; i < first + count; ++i) {
+            const QString dst = dir + QString("/bench_%1.so").arg(i, 5, 10, QChar('0'));
+            if (QFile::exists(dst))
+                  continue;
+            if (!QFile::copy(src, dst)) {
+                  fprintf(stderr, "cannot copy to %s\n", dst.toLocal8Bit().constData());
+                  return false;
+                  }
+            }
+      return true;
+      }
+
+//---------------------------------------------------------
+//   indexRoundTrip
+//---------------------------------------------------------
+
+static bool indexRoundTrip(const QString& src, const QString& dir)
+      {
+      const QString path = dir + QString::fromUtf8("/\xc3\xbcbung_\xe6\x8f\x92\xe4\xbb\xb6.so");
+      const QString cacheDir = dir + "/index_check";
+      QDir(cacheDir).removeRecursively();
+      QFile::remove(path);
+      if (!QFile::copy(src, path)) {
+            fprintf(stderr, "cannot copy to %s\n", path.toLocal8Bit().constData());
+            return false;
+            }
+      MusEPlugin::PluginFileCache out(cacheDir);
+      out.store(path, false, false);
+      out.save();
+      MusEPlugin::PluginFileCache in(cacheDir);
+      in.load();
+      bool ok;
+      const bool found = in.lookup(path, false, &ok);
+      printf("%-8s %s\n", "index", found ? "ok" : "FAILED, the path was not found again");
+      QFile::remove(path);
+      QDir(cacheDir).removeRecursively();
+      return found;
+      }
+
+//---------------------------------------------------------
+//   run
+//---------------------------------------------------------
+
+static void run(const char* name, const QString& scanDir, bool rescan)
+      {
+      MusEPlugin::PluginScanList list;
+      QElapsedTimer timer;
+      timer.start();
+      MusEPlugin::checkPluginCacheFiles(scanDir, &list, false, rescan, QString(),
+                                        MusEPlugin::PluginScanInfoStruct::PluginTypeLADSPA);
+      printf("%-8s %8.3f s\n", name, timer.elapsed() / 1000.0);
+      }
+
+} // namespace MusEPluginScanBench
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char* argv[])
+      {
+      QCoreApplication app(argc, argv);
+      if (argc < 2) {
+            fprintf(stderr, "usage: %s plugin.so [copies [dir]]\n", argv[0]);
+            return 1;
+            }
+      const QString src = QString::fromLocal8Bit(argv[1]);
+      const int copies  = argc > 2 ? atoi(argv[2]) : 2000;
+      const QString dir = argc > 3 ? QString::fromLocal8Bit(argv[3]) : QString("/tmp/muse_plugin_scan_bench");
+
+      const QString pluginDir = dir + "/ladspa";
+      const QString scanDir   = dir + "/scanner";
+      QDir(scanDir).removeRecursively();
+      QDir().mkpath(pluginDir);
+      if (!MusEPluginScanBench::indexRoundTrip(src, dir))
+            return 1;
+      fprintf(stderr, "generating %d plugins in %s\n", copies, pluginDir.toLocal8Bit().constData());
+      if (!MusEPluginScanBench::fill(src, pluginDir, 0, copies))
+            return 1;
+      setenv("LADSPA_PATH", pluginDir.toLocal8Bit().constData(), 1);
+
+      MusEPluginScanBench::run("cold", scanDir, false);
+      MusEPluginScanBench::run("warm", scanDir, false);
+      if (!MusEPluginScanBench::fill(src, pluginDir, copies, 1))
+            return 1;
+      MusEPluginScanBench::run("added", scanDir, false);
+      MusEPluginScanBench::run("forced", scanDir, true);
+      return 0;
+      }
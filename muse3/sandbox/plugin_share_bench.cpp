@@ -0,0 +1,196 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  plugin_share_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times a rack of mono LADSPA effects on multichannel tracks,
+//  with one instance per channel as usual, and with one
+//  instance doing all channels in turn, as MusE does for
+//  plugins found stateless when pluginShareInstances is set.
+//
+//   muse_plugin_share_bench plugin.so [label [rack [cycles]]]
+//
+// The first plugin in the library (or the one with the given
+//  label) must have one audio input and one output. The rack
+//  has 8 of them by default, each run for 10000 cycles of 256
+//  frames on 2 and 8 channel tracks. Whether sharing gives the
+//  same output is not checked here, see Plugin::probeStateless().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <vector>
+
+#include <ladspa.h>
+
+namespace MusEPluginShareBench {
+
+static const unsigned long FRAMES = 256;
+
+static size_t heapInUse()
+      {
+#if __GLIBC_PREREQ(2, 33)
+      struct mallinfo2 mi = mallinfo2();
+      return mi.uordblks + mi.hblkhd;
+#else
+      struct mallinfo mi = mallinfo();
+      return size_t(unsigned(mi.uordblks)) + size_t(unsigned(mi.hblkhd));
+#endif
+      }
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+//---------------------------------------------------------
+//   run
+//    Shared means one instance per rack slot, else one
+//     per slot and channel.
+//---------------------------------------------------------
+
+static void run(const LADSPA_Descriptor* d, int rack, int channels, bool shared, int cycles)
+      {
+      const int perSlot = shared ? 1 : channels;
+      std::vector<float> ctrls(d->PortCount, 0.0f);
+      for (unsigned long k = 0; k < d->PortCount; ++k) {
+            const LADSPA_PortRangeHint& h = d->PortRangeHints[k];
+            if (LADSPA_IS_HINT_BOUNDED_BELOW(h.HintDescriptor) && LADSPA_IS_HINT_BOUNDED_ABOVE(h.HintDescriptor))
+                  ctrls[k] = (h.LowerBound + h.UpperBound) * 0.5f;
+            else if (LADSPA_IS_HINT_BOUNDED_BELOW(h.HintDescriptor))
+                  ctrls[k] = h.LowerBound;
+            }
+      std::vector<float> audio(channels * FRAMES);
+      for (size_t i = 0; i < audio.size(); ++i)
+            audio[i] = float(rand()) / RAND_MAX - 0.5f;
+
+      unsigned long in = 0, out = 0;
+      for (unsigned long k = 0; k < d->PortCount; ++k) {
+            if (!LADSPA_IS_PORT_AUDIO(d->PortDescriptors[k]))
+                  continue;
+            if (LADSPA_IS_PORT_INPUT(d->PortDescriptors[k]))
+                  in = k;
+            else
+                  out = k;
+            }
+
+      const size_t heap = heapInUse();
+      std::vector<LADSPA_Handle> h(rack * perSlot);
+      for (size_t i = 0; i < h.size(); ++i) {
+            h[i] = d->instantiate(d, 48000);
+            if (!h[i]) {
+                  fprintf(stderr, "cannot instantiate\n");
+                  exit(1);
+                  }
+            for (unsigned long k = 0; k < d->PortCount; ++k)
+                  if (LADSPA_IS_PORT_CONTROL(d->PortDescriptors[k]))
+                        d->connect_port(h[i], k, &ctrls[k]);
+            if (d->activate)
+                  d->activate(h[i]);
+            }
+      const size_t used = heapInUse();
+
+      const double start = now();
+      for (int c = 0; c < cycles; ++c) {
+            for (int s = 0; s < rack; ++s) {
+                  for (int ch = 0; ch < channels; ++ch) {
+                        LADSPA_Handle i = h[s * perSlot + (shared ? 0 : ch)];
+                        d->connect_port(i, in, &audio[ch * FRAMES]);
+                        d->connect_port(i, out, &audio[ch * FRAMES]);
+                        d->run(i, FRAMES);
+                        }
+                  }
+            }
+      const double us = (now() - start) * 1e6 / cycles;
+
+      printf("%8d %-12s %9d %10zu %10.2f\n", channels, shared ? "shared" : "per channel",
+             int(h.size()), used > heap ? (used - heap) / 1024 : 0, us);
+
+      for (size_t i = 0; i < h.size(); ++i) {
+            if (d->deactivate)
+                  d->deactivate(h[i]);
+            d->cleanup(h[i]);
+            }
+      }
+
+} // namespace MusEPluginShareBench
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char* argv[])
+      {
+      if (argc < 2) {
+            fprintf(stderr, "usage: %s plugin.so [label [rack [cycles]]]\n", argv[0]);
+            return 1;
+            }
+      const char* label = argc > 2 ? argv[2] : 0;
+      const int rack    = argc > 3 ? atoi(argv[3]) : 8;
+      const int cycles  = argc > 4 ? atoi(argv[4]) : 10000;
+
+      void* lib = dlopen(argv[1], RTLD_NOW);
+      if (!lib) {
+            fprintf(stderr, "%s\n", dlerror());
+            return 1;
+            }
+      LADSPA_Descriptor_Function df = (LADSPA_Descriptor_Function)dlsym(lib, "ladspa_descriptor");
+      if (!df) {
+            fprintf(stderr, "not a LADSPA library\n");
+            return 1;
+            }
+      const LADSPA_Descriptor* d = 0;
+      for (unsigned long i = 0; (d = df(i)) != 0; ++i)
+            if (!label || strcmp(d->Label, label) == 0)
+                  break;
+      if (!d) {
+            fprintf(stderr, "plugin not found\n");
+            return 1;
+            }
+
+      int ins = 0, outs = 0;
+      for (unsigned long k = 0; k < d->PortCount; ++k) {
+            if (LADSPA_IS_PORT_AUDIO(d->PortDescriptors[k])) {
+                  if (LADSPA_IS_PORT_INPUT(d->PortDescriptors[k]))
+                        ++ins;
+                  else
+                        ++outs;
+                  }
+            }
+      if (ins != 1 || outs != 1) {
+            fprintf(stderr, "%s is not a mono plugin\n", d->Label);
+            return 1;
+            }
+
+      printf("%s, rack of %d, %lu frames per cycle\n", d->Label, rack, MusEPluginShareBench::FRAMES);
+      printf("%8s %-12s %9s %10s %10s\n", "channels", "mode", "instances", "heap_kb", "us/cycle");
+      const int channels[] = { 2, 8 };
+      for (int i = 0; i < 2; ++i) {
+            MusEPluginShareBench::run(d, rack, channels[i], false, cycles);
+            MusEPluginShareBench::run(d, rack, channels[i], true, cycles);
+            }
+      return 0;
+      }
@@ -0,0 +1,416 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  prefetch_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Counts prefetch fifo underruns of many stereo wave tracks
+//  played at once, read the old way and the AudioPrefetch way.
+//
+//   muse_prefetch_bench [dir [tracks [seconds [seekMs [threads]]]]]
+//
+// Writes one short stereo float file per track (default 128)
+//  into 'dir' (default /tmp). An audio thread takes a period of
+//  256 frames at 48 kHz from every track's fifo in real time for
+//  'seconds' (default 20), counting a track whose fifo is short
+//  as an underrun, and ticks the prefetch thread after each period.
+//  The files wrap around. As they are most likely on an SSD or in
+//  the drive's cache, 'seekMs' (default 4) is slept to stand in
+//  for the seek of a hard disk whenever a read goes past what the
+//  kernel has read ahead for the file (128 KiB, the default
+//  read_ahead_kb). Reads and seeks go through one lock, like one
+//  disk head, so more threads do not get more seeks done.
+//
+//  old:  One period per track per tick in the prefetch thread,
+//        into a 131072 frame fifo filled up on the seek, as
+//        before the I/O pool.
+//  pool: 256 KiB chunks, the emptiest tracks first, over
+//        'threads' threads (default 4) including the prefetch
+//        thread, up to AudioPrefetch::lookAhead() of each track,
+//        into a fifo of PREFETCH_WINDOW_BYTES.
+//
+//  Prints the time the seek took and the underruns of each way,
+//  and exits non-zero if the pool has any underruns.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "audioprefetch.h"
+
+namespace MusEPrefetchBench {
+
+using MusECore::AudioPrefetch;
+
+static const unsigned RATE     = 48000;
+static const unsigned PERIOD   = 256;
+static const unsigned CHANNELS = 2;
+static const unsigned FRAME_BYTES = CHANNELS * sizeof(float);
+// Frames in each file, the reads wrap around.
+static const unsigned FILE_FRAMES = 2 * RATE;
+// Kernel read-ahead of a file read sequentially.
+static const unsigned READ_AHEAD_FRAMES = 128 * 1024 / FRAME_BYTES;
+// Old fifo: fifoLength blocks of 131072 frames all together, one kept free.
+static const unsigned OLD_FIFO_FRAMES = 131072 - PERIOD;
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+//---------------------------------------------------------
+//   Track
+//---------------------------------------------------------
+
+struct Track {
+      int fd;
+      std::atomic<long> avail;    // Frames in the fifo.
+      unsigned writePos;
+      unsigned readAhead;         // Frame up to which the kernel has read ahead.
+      unsigned target;
+      double readTime;
+      unsigned underruns;
+      };
+
+//---------------------------------------------------------
+//   Bench
+//---------------------------------------------------------
+
+struct Bench {
+      std::vector<Track> tracks;
+      unsigned seekUS;
+      int threads;
+      bool pool;
+      pthread_mutex_t disk;
+
+      sem_t tickSem;
+      std::atomic<bool> quit;
+
+      // Pool of the 'pool' way, as in AudioPrefetch::prefetch().
+      std::vector<Track*> jobs;
+      std::atomic<int> nextJob;
+      sem_t ioStartSem;
+      sem_t ioDoneSem;
+      };
+
+//---------------------------------------------------------
+//   readFrames
+//    Seek if past the read-ahead, and read, under the
+//     disk lock.
+//---------------------------------------------------------
+
+static void readFrames(Bench* b, Track* t, unsigned frames, char* buf)
+      {
+      pthread_mutex_lock(&b->disk);
+      if (t->writePos + frames > t->readAhead) {
+            if (b->seekUS)
+                  usleep(b->seekUS);
+            t->readAhead = t->writePos + std::max(frames, READ_AHEAD_FRAMES);
+            }
+      unsigned pos = t->writePos % FILE_FRAMES;
+      unsigned done = 0;
+      while (done < frames) {
+            const unsigned n = std::min(frames - done, FILE_FRAMES - pos);
+            const off_t off = off_t(pos) * FRAME_BYTES;
+            if (pread(t->fd, buf + size_t(done) * FRAME_BYTES, size_t(n) * FRAME_BYTES, off) < 0)
+                  perror("pread");
+            done += n;
+            pos = 0;
+            }
+      pthread_mutex_unlock(&b->disk);
+      t->writePos += frames;
+      }
+
+//---------------------------------------------------------
+//   refill
+//    AudioPrefetch::refill() without the fifo blocks.
+//---------------------------------------------------------
+
+static const unsigned CHUNK_FRAMES = MusECore::PREFETCH_CHUNK_BYTES / FRAME_BYTES;
+static const unsigned POOL_FIFO_FRAMES = MusECore::PREFETCH_WINDOW_BYTES / FRAME_BYTES;
+
+static void refill(Bench* b, Track* t, char* buf, int tracks)
+      {
+      for (;;) {
+            const long avail = t->avail;
+            if (avail >= long(POOL_FIFO_FRAMES) || avail >= long(t->target))
+                  break;
+            const unsigned frames = std::min(CHUNK_FRAMES, unsigned(POOL_FIFO_FRAMES - avail) / PERIOD * PERIOD);
+            const double t0 = now();
+            readFrames(b, t, frames, buf);
+            const double dt = now() - t0;
+            t->avail += frames;
+
+            const double chunkTime = dt * CHUNK_FRAMES / frames;
+            t->readTime = t->readTime == 0.0 ? chunkTime : t->readTime * 0.9 + chunkTime * 0.1;
+            t->target = AudioPrefetch::lookAhead(t->readTime, tracks, b->threads, CHUNK_FRAMES,
+                                                 POOL_FIFO_FRAMES, RATE);
+            }
+      }
+
+static void runJobs(Bench* b, char* buf)
+      {
+      const int n = b->jobs.size();
+      for (;;) {
+            const int i = b->nextJob.fetch_add(1);
+            if (i >= n)
+                  break;
+            refill(b, b->jobs[i], buf, n);
+            }
+      }
+
+static bool availLess(Track* a, Track* b)
+      {
+      return a->avail < b->avail;
+      }
+
+static void* ioLoop(void* arg)
+      {
+      Bench* b = (Bench*)arg;
+      std::vector<char> buf(MusECore::PREFETCH_CHUNK_BYTES);
+      for (;;) {
+            while (sem_wait(&b->ioStartSem) == -1 && errno == EINTR)
+                  ;
+            if (b->quit)
+                  break;
+            runJobs(b, &buf[0]);
+            sem_post(&b->ioDoneSem);
+            }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   prefetch
+//---------------------------------------------------------
+
+static void prefetch(Bench* b, char* buf)
+      {
+      if (!b->pool) {
+            for (unsigned i = 0; i < b->tracks.size(); ++i) {
+                  Track* t = &b->tracks[i];
+                  if (t->avail + PERIOD > OLD_FIFO_FRAMES)
+                        continue;
+                  readFrames(b, t, PERIOD, buf);
+                  t->avail += PERIOD;
+                  }
+            return;
+            }
+      b->jobs.clear();
+      for (unsigned i = 0; i < b->tracks.size(); ++i)
+            if (b->tracks[i].avail < long(b->tracks[i].target))
+                  b->jobs.push_back(&b->tracks[i]);
+      if (b->jobs.empty())
+            return;
+      std::sort(b->jobs.begin(), b->jobs.end(), availLess);
+      b->nextJob = 0;
+      const int helpers = std::min(b->threads - 1, int(b->jobs.size()) - 1);
+      for (int i = 0; i < helpers; ++i)
+            sem_post(&b->ioStartSem);
+      runJobs(b, buf);
+      for (int i = 0; i < helpers; ++i)
+            while (sem_wait(&b->ioDoneSem) == -1 && errno == EINTR)
+                  ;
+      }
+
+//---------------------------------------------------------
+//   seek
+//    Fills all fifos, the old way a period at a time.
+//---------------------------------------------------------
+
+static void seek(Bench* b, char* buf)
+      {
+      for (unsigned i = 0; i < b->tracks.size(); ++i) {
+            Track* t = &b->tracks[i];
+            t->avail     = 0;
+            t->writePos  = 0;
+            t->readAhead = 0;
+            t->target    = 2 * CHUNK_FRAMES;
+            t->readTime  = 0.0;
+            t->underruns = 0;
+            }
+      if (b->pool)
+            prefetch(b, buf);
+      else
+            for (unsigned k = 0; k < OLD_FIFO_FRAMES / PERIOD; ++k)
+                  prefetch(b, buf);
+      }
+
+static void* prefetchLoop(void* arg)
+      {
+      Bench* b = (Bench*)arg;
+      std::vector<char> buf(MusECore::PREFETCH_CHUNK_BYTES);
+      for (;;) {
+            while (sem_wait(&b->tickSem) == -1 && errno == EINTR)
+                  ;
+            if (b->quit)
+                  break;
+            // Ticks that came in meanwhile have nothing more to do.
+            while (sem_trywait(&b->tickSem) == 0)
+                  ;
+            prefetch(b, &buf[0]);
+            }
+      return 0;
+      }
+
+//---------------------------------------------------------
+//   play
+//    The audio thread. Returns the underruns of all tracks.
+//---------------------------------------------------------
+
+static unsigned play(Bench* b, int seconds)
+      {
+      const long periods = long(seconds) * RATE / PERIOD;
+      const long periodNS = long(PERIOD) * 1000000000L / RATE;
+      struct timespec next;
+      clock_gettime(CLOCK_MONOTONIC, &next);
+      unsigned underruns = 0;
+      for (long p = 0; p < periods; ++p) {
+            next.tv_nsec += periodNS;
+            if (next.tv_nsec >= 1000000000L) {
+                  next.tv_nsec -= 1000000000L;
+                  ++next.tv_sec;
+                  }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0) == EINTR)
+                  ;
+            for (unsigned i = 0; i < b->tracks.size(); ++i) {
+                  Track* t = &b->tracks[i];
+                  if (t->avail >= long(PERIOD))
+                        t->avail -= PERIOD;
+                  else {
+                        ++t->underruns;
+                        ++underruns;
+                        }
+                  }
+            sem_post(&b->tickSem);
+            }
+      return underruns;
+      }
+
+//---------------------------------------------------------
+//   run
+//---------------------------------------------------------
+
+static unsigned run(Bench* b, bool pool, int seconds)
+      {
+      b->pool = pool;
+      b->quit = false;
+      sem_init(&b->tickSem, 0, 0);
+      sem_init(&b->ioStartSem, 0, 0);
+      sem_init(&b->ioDoneSem, 0, 0);
+
+      std::vector<pthread_t> io(pool ? b->threads - 1 : 0);
+      for (unsigned i = 0; i < io.size(); ++i)
+            pthread_create(&io[i], 0, ioLoop, b);
+
+      std::vector<char> buf(MusECore::PREFETCH_CHUNK_BYTES);
+      const double t0 = now();
+      seek(b, &buf[0]);
+      const double seekTime = now() - t0;
+
+      pthread_t pt;
+      pthread_create(&pt, 0, prefetchLoop, b);
+      const unsigned underruns = play(b, seconds);
+
+      b->quit = true;
+      sem_post(&b->tickSem);
+      pthread_join(pt, 0);
+      for (unsigned i = 0; i < io.size(); ++i)
+            sem_post(&b->ioStartSem);
+      for (unsigned i = 0; i < io.size(); ++i)
+            pthread_join(io[i], 0);
+
+      unsigned tracksHit = 0;
+      for (unsigned i = 0; i < b->tracks.size(); ++i)
+            if (b->tracks[i].underruns)
+                  ++tracksHit;
+      printf("%-5s seek %7.3f s, %8u underruns on %3u of %u tracks\n",
+             pool ? "pool" : "old", seekTime, underruns, tracksHit, unsigned(b->tracks.size()));
+
+      sem_destroy(&b->tickSem);
+      sem_destroy(&b->ioStartSem);
+      sem_destroy(&b->ioDoneSem);
+      return underruns;
+      }
+
+} // namespace MusEPrefetchBench
+
+int main(int argc, char** argv)
+      {
+      using namespace MusEPrefetchBench;
+      const std::string dir = argc > 1 ? argv[1] : "/tmp";
+      const int ntracks = argc > 2 ? atoi(argv[2]) : 128;
+      const int seconds = argc > 3 ? atoi(argv[3]) : 20;
+      const double seekMs = argc > 4 ? atof(argv[4]) : 4.0;
+      const int threads = argc > 5 ? atoi(argv[5]) : 4;
+
+      Bench b;
+      b.tracks = std::vector<Track>(ntracks);
+      b.seekUS  = unsigned(seekMs * 1000.0);
+      b.threads = std::max(1, std::min(threads, MusECore::MAX_PREFETCH_IO_THREADS));
+      pthread_mutex_init(&b.disk, 0);
+
+      std::vector<float> data(size_t(FILE_FRAMES) * CHANNELS);
+      for (unsigned i = 0; i < data.size(); ++i)
+            data[i] = float(i % 200) / 100.0f - 1.0f;
+      std::vector<std::string> paths;
+      for (int i = 0; i < ntracks; ++i) {
+            char name[64];
+            snprintf(name, sizeof(name), "/muse_prefetch_bench_%d.raw", i);
+            paths.push_back(dir + name);
+            const int fd = open(paths.back().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                  perror(paths.back().c_str());
+                  return 2;
+                  }
+            if (write(fd, &data[0], data.size() * sizeof(float)) != ssize_t(data.size() * sizeof(float))) {
+                  perror(paths.back().c_str());
+                  return 2;
+                  }
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            b.tracks[i].fd = fd;
+            }
+
+      printf("%d stereo tracks, %d s, %u frame periods at %u Hz, %.1f ms per seek, %d pool threads\n",
+             ntracks, seconds, PERIOD, RATE, seekMs, b.threads);
+      run(&b, false, seconds);
+      const unsigned poolUnderruns = run(&b, true, seconds);
+
+      for (int i = 0; i < ntracks; ++i) {
+            close(b.tracks[i].fd);
+            unlink(paths[i].c_str());
+            }
+      pthread_mutex_destroy(&b.disk);
+      if (poolUnderruns)
+            printf("FAILED: the pool had underruns\n");
+      return poolUnderruns ? 1 : 0;
+      }
@@ -0,0 +1,132 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  rt_arena_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks the realtime arena with event lists and sysex data.
+//
+//   muse_rt_arena_test
+//
+// In fail-safe mode, inside a realtime section:
+//  - every event list insert takes its node from the class
+//    MPEVENT_NODE_SIZE falls in, and none from the heap,
+//  - an EvData block goes back to its class when released,
+//    even after its public dataLen was changed.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "evdata.h"
+#include "mpevent.h"
+#include "midi_consts.h"
+
+namespace MusERTArenaTest {
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+// The class of blocks of n bytes.
+static int classOf(size_t n)
+      {
+      for (int cls = 0; cls < RTArena::CLASSES; ++cls) {
+            RTArena::Stats st;
+            rtArena().stats(cls, &st);
+            if (st.size >= n)
+                  return cls;
+            }
+      return RTArena::CLASSES;
+      }
+
+static unsigned inUse(int cls)
+      {
+      RTArena::Stats st;
+      rtArena().stats(cls, &st);
+      return st.inUse;
+      }
+
+static unsigned failed()
+      {
+      unsigned n = 0;
+      for (int cls = 0; cls <= RTArena::CLASSES; ++cls) {
+            RTArena::Stats st;
+            rtArena().stats(cls, &st);
+            n += st.failed;
+            }
+      return n;
+      }
+
+} // namespace MusERTArenaTest
+
+int main()
+      {
+      using namespace MusERTArenaTest;
+      using namespace MusECore;
+
+      rtArena().setFailSafe(true);
+      printf("event list node %u bytes, class %d\n", unsigned(MPEVENT_NODE_SIZE), classOf(MPEVENT_NODE_SIZE));
+
+      {
+      const int cls = classOf(MPEVENT_NODE_SIZE);
+      const unsigned before = inUse(cls);
+      const unsigned heapBefore = inUse(RTArena::CLASSES);
+      MPEventList* el = new MPEventList();
+      {
+      RTArenaScope rt;
+      for (int i = 0; i < 100; ++i)
+            el->insert(MidiPlayEvent(i, 0, 0, ME_NOTEON, 60, 100));
+      }
+      check(el->size() == 100 && inUse(cls) == before + 100 && inUse(RTArena::CLASSES) == heapBefore,
+            "list inserts take their nodes from the reserved class");
+      check(failed() == 0, "no realtime allocation refused");
+      el->clear();
+      check(inUse(cls) == before, "cleared nodes go back to their class");
+      delete el;
+      }
+
+      {
+      unsigned char sysex[100];
+      for (int i = 0; i < 100; ++i)
+            sysex[i] = i;
+      const int cls = classOf(100 + 16);
+      const unsigned before = inUse(cls);
+      {
+      RTArenaScope rt;
+      EvData d;
+      d.setData(sysex, 100);
+      EvData copy(d);
+      check(d.data && inUse(cls) == before + 1, "sysex data and count share one block");
+      // Anyone may set the length.
+      d.dataLen = 10;
+      copy.dataLen = 3;
+      }
+      check(inUse(cls) == before, "the block goes back to its class after dataLen changed");
+      }
+
+      printf("%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
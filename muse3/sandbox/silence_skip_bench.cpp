@@ -0,0 +1,242 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  silence_skip_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Runs a large, mostly silent session with and without plugins
+//  being stopped in silence, and counts the plugin-cycles skipped.
+//
+//   muse_silence_skip_bench [tracks [plugins [seconds [tail]]]]
+//
+// Tracks default to 32, plugins per track to 4, seconds to 60,
+//  the global tail to 2000 ms, the default of the setting,
+//  at 48000 Hz in cycles of 256 frames. Each track plays 50 ms
+//  of noise near the start and is silent after that.
+// The plugins are stood in for by feedback delays of 10 ms,
+//  250 ms, 1 s and 3 s, mixed with the dry signal, starting
+//  with a different one on each track. They
+//  are gated with SilenceGate the way PluginI::apply() does it:
+//  a skipped plugin passes its input through.
+// Each gated run goes alongside one that never skips, and the
+//  largest difference of the track outputs is reported:
+//    global   the global tail for every plugin
+//    delay    a tail of its own for each plugin, its delay
+//  Both must match the ungated outputs to within -100 dB, exits
+//  non-zero if either doesn't. The default global tail is shorter
+//  than the 3 s delay, whose echoes are lost, so the global check
+//  fails unless a tail of more than 3000 ms is given: the global
+//  tail is lossy, see SilenceGate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#include "silence_gate.h"
+
+namespace MusESilenceSkipBench {
+
+using MusECore::SilenceGate;
+
+static const unsigned SAMPLE_RATE = 48000;
+static const unsigned long CYCLE = 256;
+static const int DEFAULT_TAIL_MS = 2000;
+// The largest difference of a gated output, -100 dB.
+static const float MAX_DIFF = 0.00001f;
+static const int DELAY_MS[] = { 10, 250, 1000, 3000 };
+static const int DELAYS = sizeof(DELAY_MS) / sizeof(DELAY_MS[0]);
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+//---------------------------------------------------------
+//   Delay
+//    Mono feedback delay, dry plus wet.
+//---------------------------------------------------------
+
+struct Delay {
+      std::vector<float> buf;
+      unsigned long pos;
+      int ms;
+
+      Delay(int delayMs) : buf((unsigned long)delayMs * SAMPLE_RATE / 1000), pos(0), ms(delayMs) {}
+
+      void run(const float* in, float* out, unsigned long n)
+            {
+            for (unsigned long i = 0; i < n; ++i) {
+                  const float wet = buf[pos];
+                  buf[pos] = in[i] + 0.5f * wet;
+                  if (++pos == buf.size())
+                        pos = 0;
+                  out[i] = in[i] + wet;
+                  }
+            }
+      };
+
+//---------------------------------------------------------
+//   Session
+//---------------------------------------------------------
+
+struct Session {
+      std::vector<Delay> plugins;       // tracks * perTrack
+      std::vector<SilenceGate> gates;
+      unsigned long runCycles;
+      unsigned long skippedCycles;
+      double seconds;
+      int globalTailMs;
+
+      Session(int tracks, int perTrack) : runCycles(0), skippedCycles(0), seconds(0.0), globalTailMs(DEFAULT_TAIL_MS)
+            {
+            for (int t = 0; t < tracks; ++t)
+                  for (int p = 0; p < perTrack; ++p)
+                        plugins.push_back(Delay(DELAY_MS[(t + p) % DELAYS]));
+            gates.resize(plugins.size());
+            }
+
+      // tailMs: -2 never skips, -1 the global tail, else the delay.
+      void run(int track, int perTrack, float* buf0, float* buf1, int tailMs, float** out)
+            {
+            float* in = buf0;
+            float* res = buf1;
+            for (int p = 0; p < perTrack; ++p) {
+                  Delay& d = plugins[track * perTrack + p];
+                  SilenceGate& g = gates[track * perTrack + p];
+                  ++runCycles;
+                  bool quietIn = false;
+                  if (tailMs != -2) {
+                        quietIn = SilenceGate::isSilent(1, CYCLE, &in);
+                        const unsigned long tail = SilenceGate::tailFrames(tailMs == -1 ? -1 : d.ms, -1,
+                                                      globalTailMs, 0.0f, SAMPLE_RATE);
+                        if (quietIn && g.idle(tail)) {
+                              ++skippedCycles;
+                              continue;         // In place: the input passes through.
+                              }
+                        }
+                  d.run(in, res, CYCLE);
+                  if (tailMs != -2)
+                        g.count(quietIn && SilenceGate::isSilent(1, CYCLE, &res), CYCLE);
+                  float* t = in;
+                  in = res;
+                  res = t;
+                  }
+            *out = in;
+            }
+      };
+
+//---------------------------------------------------------
+//   compare
+//    Runs a gated session next to one which never skips.
+//    Returns the largest difference of their outputs.
+//---------------------------------------------------------
+
+static float compare(const char* name, int tracks, int perTrack, int seconds, int tailMs, int globalTailMs, Session* ref)
+      {
+      Session gated(tracks, perTrack);
+      gated.globalTailMs = globalTailMs;
+      ref->runCycles = ref->skippedCycles = 0;
+      ref->seconds = 0.0;
+      std::vector<float> r0(CYCLE), r1(CYCLE), g0(CYCLE), g1(CYCLE);
+      const unsigned long cycles = (unsigned long)seconds * SAMPLE_RATE / CYCLE;
+      const unsigned long burst = SAMPLE_RATE / 20;
+      unsigned seed = 1;
+      float maxDiff = 0.0f;
+      for (unsigned long c = 0; c < cycles; ++c) {
+            const unsigned long pos = c * CYCLE;
+            double refTime = 0.0, gatedTime = 0.0;
+            for (int t = 0; t < tracks; ++t) {
+                  // 50 ms of noise, each track a little later than the one before.
+                  const unsigned long start = (unsigned long)t * SAMPLE_RATE / 10;
+                  for (unsigned long i = 0; i < CYCLE; ++i) {
+                        float v = 0.0f;
+                        if (pos + i >= start && pos + i < start + burst) {
+                              seed = seed * 1103515245 + 12345;
+                              v = ((seed >> 16) & 0x7fff) / 16384.0f - 1.0f;
+                              }
+                        r0[i] = g0[i] = v;
+                        }
+                  float* ro;
+                  float* go;
+                  double t0 = now();
+                  ref->run(t, perTrack, &r0[0], &r1[0], -2, &ro);
+                  double t1 = now();
+                  gated.run(t, perTrack, &g0[0], &g1[0], tailMs, &go);
+                  double t2 = now();
+                  refTime += t1 - t0;
+                  gatedTime += t2 - t1;
+                  for (unsigned long i = 0; i < CYCLE; ++i) {
+                        const float d = fabsf(ro[i] - go[i]);
+                        if (d > maxDiff)
+                              maxDiff = d;
+                        }
+                  }
+            ref->seconds += refTime;
+            gated.seconds += gatedTime;
+            }
+      printf("%-8s plugin-cycles %9lu  skipped %9lu (%5.1f%%)  %7.3f s, %7.3f s without  max difference %.2g (%.0f dB)\n",
+             name, gated.runCycles, gated.skippedCycles,
+             gated.runCycles ? 100.0 * gated.skippedCycles / gated.runCycles : 0.0,
+             gated.seconds, ref->seconds, maxDiff, maxDiff > 0.0f ? 20.0 * log10(maxDiff) : -999.0);
+      return maxDiff;
+      }
+
+} // namespace MusESilenceSkipBench
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char** argv)
+      {
+      using namespace MusESilenceSkipBench;
+      const int tracks   = argc > 1 ? atoi(argv[1]) : 32;
+      const int perTrack = argc > 2 ? atoi(argv[2]) : 4;
+      const int seconds  = argc > 3 ? atoi(argv[3]) : 60;
+      const int tailMs   = argc > 4 ? atoi(argv[4]) : DEFAULT_TAIL_MS;
+      if (tracks < 1 || perTrack < 1 || seconds < 1 || tailMs < 0) {
+            fprintf(stderr, "usage: %s [tracks [plugins [seconds [tail]]]]\n", argv[0]);
+            return 1;
+            }
+      printf("%d tracks, %d plugins each, %d s, global tail %d ms\n", tracks, perTrack, seconds, tailMs);
+
+      Session ref(tracks, perTrack);
+      const float globalDiff = compare("global", tracks, perTrack, seconds, -1, tailMs, &ref);
+      Session ref2(tracks, perTrack);
+      const float diff = compare("delay", tracks, perTrack, seconds, 0, tailMs, &ref2);
+
+      bool ok = true;
+      if (globalDiff > MAX_DIFF) {
+            printf("FAILED: the global tail of %d ms changes the output by %.0f dB, it cuts off echoes\n",
+                   tailMs, 20.0 * log10(globalDiff));
+            ok = false;
+            }
+      if (diff > MAX_DIFF) {
+            printf("FAILED: own tails change the output by %.0f dB\n", 20.0 * log10(diff));
+            ok = false;
+            }
+      if (ok)
+            printf("all ok\n");
+      return ok ? 0 : 1;
+      }
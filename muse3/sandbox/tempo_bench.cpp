@@ -0,0 +1,200 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  tempo_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times the TempoList lookups on a big tempo map against the
+//  map walks they replaced, and checks they give the same values.
+//
+//   muse_tempo_bench [changes [lookups]]
+//
+// Changes defaults to 10000 tempo changes, one every beat or
+//  two, lookups to 1000000. Timed are tick2frame and frame2tick
+//  on random values, and on increasing values with a cursor,
+//  the way Audio::collectEvents() goes through a part.
+//  Exits non-zero if any value differs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include "tempo.h"
+#include "gconfig.h"
+#include "large_int.h"
+
+namespace MusEGlobal {
+int sampleRate = 48000;
+GlobalConfigValues config;
+}
+
+namespace MusETempoBench {
+
+using MusECore::TempoList;
+using MusECore::TempoCursor;
+using MusECore::ciTEvent;
+using MusECore::muse_multiply_64_div_64_to_64;
+
+static double now()
+      {
+      struct timespec t;
+      clock_gettime(CLOCK_MONOTONIC, &t);
+      return t.tv_sec + t.tv_nsec / 1e9;
+      }
+
+static unsigned rnd = 12345;
+static unsigned nextRandom()
+      {
+      rnd = rnd * 1664525u + 1013904223u;
+      return rnd >> 8;
+      }
+
+//---------------------------------------------------------
+//   oldTick2frame / oldFrame2tick
+//    TempoList's lookups as they were, over the map.
+//---------------------------------------------------------
+
+static unsigned oldTick2frame(const TempoList& tl, unsigned tick)
+      {
+      const uint64_t numer = (uint64_t)MusEGlobal::sampleRate;
+      const uint64_t denom = (uint64_t)MusEGlobal::config.division * (uint64_t)tl.globalTempo() * 10000UL;
+      ciTEvent i = tl.upper_bound(tick);
+      if (i == tl.end())
+            return 0;
+      return i->second->frame + muse_multiply_64_div_64_to_64(
+        numer * (uint64_t)i->second->tempo, tick - i->second->tick, denom, true);
+      }
+
+static unsigned oldFrame2tick(const TempoList& tl, unsigned frame)
+      {
+      const uint64_t numer = (uint64_t)MusEGlobal::config.division * (uint64_t)tl.globalTempo() * 10000UL;
+      const uint64_t denom = (uint64_t)MusEGlobal::sampleRate;
+      ciTEvent e;
+      for (e = tl.begin(); e != tl.end();) {
+            ciTEvent ee = e;
+            ++ee;
+            if (ee == tl.end())
+                  break;
+            if (frame < ee->second->frame)
+                  break;
+            e = ee;
+            }
+      return e->second->tick + muse_multiply_64_div_64_to_64(
+        numer, frame - e->second->frame, denom * (uint64_t)e->second->tempo);
+      }
+
+} // namespace MusETempoBench
+
+int main(int argc, char** argv)
+      {
+      using namespace MusETempoBench;
+      const int changes = argc > 1 ? atoi(argv[1]) : 10000;
+      const int lookups = argc > 2 ? atoi(argv[2]) : 1000000;
+      MusEGlobal::config.division = 384;
+
+      TempoList tl;
+      unsigned tick = 0;
+      for (int i = 0; i < changes; ++i) {
+            tick += 384 * (1 + nextRandom() % 2);
+            // 60 to 180 bpm.
+            tl.addTempo(tick, 333333 + nextRandom() % 666667, false);
+            }
+      tl.normalize();
+      const unsigned lastTick  = tick + 384 * 16;
+      const unsigned lastFrame = tl.tick2frame(lastTick);
+      printf("%d tempo changes, %u ticks, %u frames, %d lookups\n", changes, lastTick, lastFrame, lookups);
+
+      std::vector<unsigned> ticks(lookups), frames(lookups);
+      for (int i = 0; i < lookups; ++i) {
+            // nextRandom() has 24 bits, spread them over the whole song.
+            ticks[i]  = (uint64_t(nextRandom()) * lastTick) >> 24;
+            frames[i] = (uint64_t(nextRandom()) * lastFrame) >> 24;
+            }
+      std::vector<unsigned> sortedTicks(ticks), sortedFrames(frames);
+      std::sort(sortedTicks.begin(), sortedTicks.end());
+      std::sort(sortedFrames.begin(), sortedFrames.end());
+
+      std::vector<unsigned> a(lookups), b(lookups);
+      int failed = 0;
+      printf("lookup                      old ms     new ms  same\n");
+
+      // tick2frame, random.
+      double t0 = now();
+      for (int i = 0; i < lookups; ++i)
+            a[i] = oldTick2frame(tl, ticks[i]);
+      double told = now() - t0;
+      t0 = now();
+      for (int i = 0; i < lookups; ++i)
+            b[i] = tl.tick2frame(ticks[i]);
+      double tnew = now() - t0;
+      bool same = a == b;
+      failed += !same;
+      printf("tick2frame random      %10.1f %10.1f  %s\n", told * 1e3, tnew * 1e3, same ? "yes" : "NO");
+
+      // tick2frame, in order with a cursor.
+      t0 = now();
+      for (int i = 0; i < lookups; ++i)
+            a[i] = oldTick2frame(tl, sortedTicks[i]);
+      told = now() - t0;
+      t0 = now();
+      {
+      TempoCursor cur;
+      for (int i = 0; i < lookups; ++i)
+            b[i] = tl.tick2frame(sortedTicks[i], cur);
+      }
+      tnew = now() - t0;
+      same = a == b;
+      failed += !same;
+      printf("tick2frame cursor      %10.1f %10.1f  %s\n", told * 1e3, tnew * 1e3, same ? "yes" : "NO");
+
+      // frame2tick, random. The old walk is slow, do a hundredth.
+      const int slow = std::max(1, lookups / 100);
+      t0 = now();
+      for (int i = 0; i < slow; ++i)
+            a[i] = oldFrame2tick(tl, frames[i]);
+      told = now() - t0;
+      t0 = now();
+      for (int i = 0; i < slow; ++i)
+            b[i] = tl.frame2tick(frames[i]);
+      tnew = now() - t0;
+      same = std::equal(a.begin(), a.begin() + slow, b.begin());
+      failed += !same;
+      printf("frame2tick random %-4d %10.1f %10.1f  %s\n", slow, told * 1e3, tnew * 1e3, same ? "yes" : "NO");
+
+      // frame2tick, in order with a cursor.
+      t0 = now();
+      for (int i = 0; i < slow; ++i)
+            a[i] = oldFrame2tick(tl, sortedFrames[i * (lookups / slow)]);
+      told = now() - t0;
+      t0 = now();
+      {
+      TempoCursor cur;
+      for (int i = 0; i < slow; ++i)
+            b[i] = tl.frame2tick(sortedFrames[i * (lookups / slow)], cur);
+      }
+      tnew = now() - t0;
+      same = std::equal(a.begin(), a.begin() + slow, b.begin());
+      failed += !same;
+      printf("frame2tick cursor %-4d %10.1f %10.1f  %s\n", slow, told * 1e3, tnew * 1e3, same ? "yes" : "NO");
+
+      return failed ? 1 : 0;
+      }
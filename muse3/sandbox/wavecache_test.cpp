@@ -0,0 +1,239 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  wavecache_test.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Checks the WaveBlockCache.
+//
+//   muse_wavecache_test
+//
+// Uses caches of 1 MB, 8 blocks, and made up file pointers,
+//  the cache never looks into the files. Checks
+//   - hits and misses, and that a hit gives the samples the
+//     miss filled in,
+//   - that the least recently used block is evicted first,
+//     a hit making a block the most recently used,
+//   - that pinned blocks are never evicted, and that acquire()
+//     gives up when every block is pinned,
+//   - that release(drop) and invalidate() free blocks, a
+//     pinned block only once it is released,
+//   - the hit counts of a loop that fits and one that does not,
+//   - that a cache of 0 MB is disabled.
+//  Exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wavecache.h"
+#include "gconfig.h"
+
+namespace MusEGlobal {
+GlobalConfigValues config;
+}
+
+namespace MusEWaveCacheTest {
+
+using MusECore::WaveBlockCache;
+using MusECore::SndFile;
+
+// Blocks in a cache of 1 MB.
+static const int BLOCKS = 1024 * 1024 / WaveBlockCache::BLOCK_BYTES;
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+      {
+      printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+      if (!ok)
+            ++failures;
+      }
+
+// Only compared, never used.
+static char fileKeys[4];
+
+static const SndFile* file(int i)
+      {
+      return reinterpret_cast<const SndFile*>(&fileKeys[i]);
+      }
+
+//---------------------------------------------------------
+//   probe
+//    Acquires and releases a block, filling it in with
+//     its index on a miss. Returns 1 on a hit, 0 on a miss
+//     and -1 if the hit has other samples or nothing was
+//     free.
+//---------------------------------------------------------
+
+static int probe(WaveBlockCache* c, const SndFile* f, sf_count_t index)
+      {
+      bool hit = false;
+      int h = -1;
+      float* p = c->acquire(f, index, &hit, &h);
+      if (!p)
+            return -1;
+      int rv = hit ? 1 : 0;
+      if (hit) {
+            if (c->frames(h) != index + 1 || p[0] != float(index) || p[WaveBlockCache::BLOCK_BYTES / sizeof(float) - 1] != float(index))
+                  rv = -1;
+            }
+      else {
+            for (size_t i = 0; i < WaveBlockCache::BLOCK_BYTES / sizeof(float); ++i)
+                  p[i] = float(index);
+            c->setFrames(h, index + 1);
+            }
+      c->release(h);
+      return rv;
+      }
+
+//---------------------------------------------------------
+//   expect
+//    Probes blocks of file 0 and compares with the hits
+//     expected ('1') and misses ('0').
+//---------------------------------------------------------
+
+static bool expect(WaveBlockCache* c, const sf_count_t* indexes, const char* hits)
+      {
+      bool ok = true;
+      for (int i = 0; hits[i]; ++i) {
+            const int r = probe(c, file(0), indexes[i]);
+            if (r != hits[i] - '0') {
+                  printf("  block %ld: %s, expected %s\n", long(indexes[i]),
+                         r < 0 ? "bad" : r ? "hit" : "miss", hits[i] == '1' ? "hit" : "miss");
+                  ok = false;
+                  }
+            }
+      return ok;
+      }
+
+//---------------------------------------------------------
+//   loop
+//    Plays 'blocks' blocks of file 0 over and over, as a
+//     looped part does. Returns the hits.
+//---------------------------------------------------------
+
+static uint64_t loop(int blocks, int times)
+      {
+      WaveBlockCache c(1);
+      for (int t = 0; t < times; ++t)
+            for (int i = 0; i < blocks; ++i)
+                  probe(&c, file(0), i);
+      return c.hits();
+      }
+
+} // namespace MusEWaveCacheTest
+
+int main()
+      {
+      using namespace MusEWaveCacheTest;
+
+      {
+      // 1 MB, BLOCKS blocks.
+      WaveBlockCache c(1);
+      check(c.isEnabled(), "1 MB cache is enabled");
+
+      const sf_count_t fill[] = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 };
+      check(expect(&c, fill, "0000000011111111"), "blocks miss once, then hit with their samples");
+      check(c.hits() == 8 && c.misses() == 8, "hits and misses counted");
+
+      // Least recently used first, in the comments:
+      //  0 hits        1 2 3 4 5 6 7 0
+      //  8 evicts 1    2 3 4 5 6 7 0 8
+      //  9 evicts 2    3 4 5 6 7 0 8 9
+      //  0, 3 hit      4 5 6 7 8 9 0 3
+      //  1 evicts 4    5 6 7 8 9 0 3 1
+      //  2 evicts 5    6 7 8 9 0 3 1 2
+      //  4 evicts 6    7 8 9 0 3 1 2 4
+      //  5 evicts 7    8 9 0 3 1 2 4 5
+      //  6 evicts 8    9 0 3 1 2 4 5 6
+      //  9 hits        0 3 1 2 4 5 6 9
+      //  8 evicts 0    3 1 2 4 5 6 9 8
+      //  0 evicts 3    1 2 4 5 6 9 8 0
+      const sf_count_t lru[] = { 0, 8, 9, 0, 3, 1, 2, 4, 5, 6, 9, 8, 0 };
+      check(expect(&c, lru, "1001100000100"), "least recently used block evicted first");
+      }
+
+      {
+      WaveBlockCache c(1);
+      const sf_count_t fill[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+      expect(&c, fill, "00000000");
+      // Block 0 stays pinned.
+      bool hit = false;
+      int pinned = -1;
+      c.acquire(file(0), 0, &hit, &pinned);
+      // 8..14 evict 1..7. Then 0 is the least recently used, but
+      //  pinned, so 15 evicts 8, and 8 evicts 9.
+      const sf_count_t fresh[] = { 8, 9, 10, 11, 12, 13, 14, 15, 8 };
+      check(expect(&c, fresh, "000000000"), "new blocks evict around a pinned block");
+      c.release(pinned);
+      const sf_count_t zero[] = { 0 };
+      check(expect(&c, zero, "1"), "the pinned block was not evicted");
+
+      int handles[BLOCKS];
+      bool allPinned = true;
+      for (int i = 0; i < BLOCKS; ++i)
+            allPinned = c.acquire(file(0), 100 + i, &hit, &handles[i]) != 0 && allPinned;
+      int h = -1;
+      check(allPinned && c.acquire(file(0), 200, &hit, &h) == 0, "acquire gives up when every block is pinned");
+      for (int i = 0; i < BLOCKS; ++i)
+            c.release(handles[i]);
+      }
+
+      {
+      WaveBlockCache c(1);
+      bool hit = false;
+      int h = -1;
+      c.acquire(file(0), 0, &hit, &h);
+      c.release(h, true);
+      const sf_count_t zero[] = { 0 };
+      check(expect(&c, zero, "0"), "release with drop frees the block");
+
+      // Blocks of file 1, one of them pinned, and one of file 0.
+      probe(&c, file(1), 0);
+      probe(&c, file(1), 1);
+      int pinned = -1;
+      float* p = c.acquire(file(1), 1, &hit, &pinned);
+      c.invalidate(file(1));
+      check(probe(&c, file(1), 0) == 0, "invalidate frees the blocks of a file");
+      check(p && p[0] == 1.0f && c.frames(pinned) == 2, "a pinned block stays usable after invalidate");
+      check(probe(&c, file(0), 0) == 1, "invalidate leaves other files alone");
+      c.release(pinned);
+      check(probe(&c, file(1), 1) == 0, "the pinned block is freed once released");
+      }
+
+      {
+      const uint64_t fits = loop(BLOCKS, 10);
+      const uint64_t over = loop(BLOCKS + 1, 10);
+      printf("loop of %d blocks 10 times: %lu hits, of %d blocks: %lu hits\n",
+             BLOCKS, (unsigned long)fits, BLOCKS + 1, (unsigned long)over);
+      // LRU keeps a loop that fits, and evicts each block just before
+      //  it is needed again in one that does not.
+      check(fits == 9 * BLOCKS && over == 0, "hits of a loop that fits and of one that does not");
+      }
+
+      {
+      WaveBlockCache c(0);
+      bool hit = false;
+      int h = -1;
+      check(!c.isEnabled() && c.acquire(file(0), 0, &hit, &h) == 0, "0 MB cache is disabled");
+      }
+
+      printf("%s\n", failures ? "FAILED" : "all ok");
+      return failures ? 1 : 0;
+      }
@@ -0,0 +1,273 @@
+//=========================================================
+//  MusE
+//  Linux Music Editor
+//
+//  xml_bench.cpp
+//  (C) Copyright 2018 MusE development team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; version 2 of
+//  the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+//=========================================================
+
+// Times reading a large song file with the Xml parser.
+//
+//   muse_xml_bench [file.med [megabytes]]
+//
+// If the file does not exist a song of the given size (50 MB by
+//  default) is generated first, with midi parts, automation and
+//  plugin state in the layout MusE writes.
+// First checks that non-ASCII names written through a device read
+//  back the same, and that a zero byte does not end the file.
+//  Exits non-zero if they do not.
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QString>
+
+#include "xml.h"
+
+namespace MusEXmlBench {
+
+struct Counts {
+      long tags;
+      long attributes;
+      long numbers;
+      long texts;
+      double sum;       // Keeps the conversions from being optimized away.
+      };
+
+//---------------------------------------------------------
+//   generate
+//---------------------------------------------------------
+
+static bool generate(const char* path, long bytes)
+      {
+      FILE* f = fopen(path, "w");
+      if (f == 0) {
+            perror(path);
+            return false;
+            }
+      MusECore::Xml xml(f);
+      xml.header();
+      int level = xml.putFileVersion(0);
+      xml.tag(level++, "song");
+      xml.strTag(level, "info", "generated by muse_xml_bench");
+      xml.intTag(level, "cpos", 0);
+
+      srand(1);
+      for (int t = 0; ftell(f) < bytes; ++t) {
+            if (t % 4 == 3) {
+                  // Wave track with plugin state and automation.
+                  xml.tag(level++, "wavetrack");
+                  xml.strTag(level, "name", QString("Audio %1").arg(t));
+                  xml.intTag(level, "channels", 2);
+                  xml.tag(level++, "plugin file=\"amp\" label=\"amp_stereo\" channel=\"2\"");
+                  for (int k = 0; k < 8; ++k)
+                        xml.put(level, "<control name=\"Param %d\" val=\"%f\" />", k, rand() / double(RAND_MAX));
+                  xml.strTag(level, "customData", "Some &lt;opaque&gt; state &amp; more");
+                  xml.etag(--level, "plugin");
+                  for (int id = 0; id < 3; ++id) {
+                        xml.nput(level, "<controller id=\"%d\" cur=\"%f\" color=\"#ff0000\" visible=\"1\">\n", id, 0.5);
+                        for (int k = 0; k < 2000; ++k) {
+                              if (k % 8 == 0)
+                                    xml.nput(level + 1, "%d %f, ", k * 480, rand() / double(RAND_MAX));
+                              else
+                                    xml.nput("%d %f, ", k * 480, rand() / double(RAND_MAX));
+                              if (k % 8 == 7)
+                                    xml.nput("\n");
+                              }
+                        xml.etag(level, "controller");
+                        }
+                  xml.etag(--level, "wavetrack");
+                  continue;
+                  }
+            xml.tag(level++, "miditrack");
+            xml.strTag(level, "name", QString("Track %1").arg(t));
+            xml.intTag(level, "device", 0);
+            xml.intTag(level, "channel", t % 16);
+            for (int p = 0; p < 8; ++p) {
+                  xml.tag(level++, "part");
+                  xml.strTag(level, "name", QString("Part %1").arg(p));
+                  xml.put(level, "<poslen tick=\"%d\" len=\"%d\" />", p * 7680, 7680);
+                  xml.intTag(level, "selected", 0);
+                  xml.intTag(level, "color", p % 17);
+                  for (int e = 0; e < 1000; ++e) {
+                        xml.tag(level++, "event tick=\"%d\" len=\"%d\"", e * 96, 90);
+                        xml.intTag(level, "a", 36 + rand() % 60);
+                        xml.intTag(level, "b", 1 + rand() % 127);
+                        xml.intTag(level, "c", 0);
+                        xml.etag(--level, "event");
+                        }
+                  xml.etag(--level, "part");
+                  }
+            xml.etag(--level, "miditrack");
+            }
+      xml.etag(--level, "song");
+      xml.tag(0, "/muse");
+      fclose(f);
+      return true;
+      }
+
+//---------------------------------------------------------
+//   read
+//    Walks the file the way the song readers do: the tag
+//     names are compared, attribute and element values are
+//     converted to numbers, the rest kept as strings.
+//---------------------------------------------------------
+
+static bool isNumberTag(const QString& tag)
+      {
+      return tag == "a" || tag == "b" || tag == "c" || tag == "cpos"
+         || tag == "device" || tag == "channel" || tag == "channels"
+         || tag == "selected" || tag == "color";
+      }
+
+static void read(MusECore::Xml& xml, const QString& name, Counts* n)
+      {
+      for (;;) {
+            MusECore::Xml::Token token = xml.parse();
+            const QString& tag = xml.s1();
+            switch (token) {
+                  case MusECore::Xml::Error:
+                  case MusECore::Xml::End:
+                        return;
+                  case MusECore::Xml::TagStart:
+                        ++n->tags;
+                        if (isNumberTag(tag)) {
+                              n->sum += xml.parseInt();
+                              ++n->numbers;
+                              }
+                        else if (tag == "name" || tag == "info" || tag == "customData")
+                              n->texts += xml.parse1().length();
+                        else
+                              read(xml, QString(tag), n);
+                        break;
+                  case MusECore::Xml::Attribut:
+                        ++n->attributes;
+                        if (tag == "tick" || tag == "len" || tag == "id")
+                              n->sum += xml.s2().toInt();
+                        else if (tag == "val" || tag == "cur")
+                              n->sum += xml.s2().toDouble();
+                        else
+                              n->texts += xml.s2().length();
+                        break;
+                  case MusECore::Xml::Text:
+                        n->texts += tag.length();
+                        break;
+                  case MusECore::Xml::TagEnd:
+                        if (tag == name)
+                              return;
+                        break;
+                  default:
+                        break;
+                  }
+            }
+      }
+
+//---------------------------------------------------------
+//   roundTrip
+//---------------------------------------------------------
+
+static bool roundTrip()
+      {
+      const QString name = QString::fromUtf8("Bass \xc3\xa9t\xc3\xa9 \xe2\x99\xab");
+      QByteArray data;
+      {
+      QBuffer out(&data);
+      out.open(QIODevice::WriteOnly);
+      MusECore::Xml xml(&out);
+      xml.tag(0, "song");
+      xml.strTag(1, "name", name);
+      xml.put(1, "<path>%s</path>", name.toUtf8().constData());
+      xml.etag(0, "song");
+      }
+      // A zero byte in some text, with more to read after it.
+      const char junk[] = "<junk>a\0b</junk>\n<after>1</after>\n</song>";
+      data.replace("</song>", QByteArray(junk, sizeof(junk) - 1));
+
+      QBuffer in(&data);
+      in.open(QIODevice::ReadOnly);
+      MusECore::Xml xml(&in);
+      QString gotName, gotPath;
+      int after = 0;
+      for (;;) {
+            MusECore::Xml::Token token = xml.parse();
+            if (token == MusECore::Xml::Error || token == MusECore::Xml::End)
+                  break;
+            if (token != MusECore::Xml::TagStart)
+                  continue;
+            const QString tag = xml.s1();
+            if (tag == "name")
+                  gotName = xml.parse1();
+            else if (tag == "path")
+                  gotPath = xml.parse1();
+            else if (tag == "junk")
+                  xml.parse1();
+            else if (tag == "after")
+                  after = xml.parseInt();
+            }
+      const bool ok = gotName == name && gotPath == name && after == 1;
+      printf("round trip: name %s, path %s, after a zero byte %s\n",
+         gotName == name ? "ok" : "FAILED", gotPath == name ? "ok" : "FAILED", after == 1 ? "ok" : "FAILED");
+      return ok;
+      }
+
+} // namespace MusEXmlBench
+
+//---------------------------------------------------------
+//   main
+//---------------------------------------------------------
+
+int main(int argc, char* argv[])
+      {
+      const char* path = argc > 1 ? argv[1] : "/tmp/muse_xml_bench.med";
+      const long mb = argc > 2 ? atol(argv[2]) : 50;
+
+      if (!MusEXmlBench::roundTrip())
+            return 1;
+
+      struct stat st;
+      if (stat(path, &st) != 0) {
+            fprintf(stderr, "generating %ld MB in %s\n", mb, path);
+            if (!MusEXmlBench::generate(path, mb * 1024 * 1024))
+                  return 1;
+            if (stat(path, &st) != 0)
+                  return 1;
+            }
+
+      FILE* f = fopen(path, "r");
+      if (f == 0) {
+            perror(path);
+            return 1;
+            }
+      MusEXmlBench::Counts n = { 0, 0, 0, 0, 0.0 };
+      QElapsedTimer timer;
+      timer.start();
+      MusECore::Xml xml(f);
+      MusEXmlBench::read(xml, QString(), &n);
+      const qint64 ms = timer.elapsed();
+      fclose(f);
+
+      const double size = st.st_size / (1024.0 * 1024.0);
+      printf("%s: %.1f MB in %lld ms, %.1f MB/s\n", path, size, (long long)ms,
+         ms > 0 ? size * 1000.0 / ms : 0.0);
+      printf("%ld tags, %ld attributes, %ld numbers, %ld text chars (%g)\n",
+         n.tags, n.attributes, n.numbers, n.texts, n.sum);
+      return 0;
+      }